@@ -102,6 +102,7 @@ Args::Ctor()
   doNormalizeTy = true;
 
   prof_metrics = Analysis::Args::MetricFlg_NULL;
+  prof_jobs = 1;
 
   profflat_computeFinalMetricValues = true;
 
@@ -110,11 +111,13 @@ Args::Ctor()
   // -------------------------------------------------------
 
   out_db_experiment = Analysis_OUT_DB_EXPERIMENT;
+  out_db_binary     = "";
   out_db_csv        = "";
   db_dir            = Analysis_DB_DIR_pfx "-" Analysis_DB_DIR_nm;
   db_copySrcFiles   = true;
   out_db_config     = "";
   db_makeMetricDB   = false;
+  db_sparseMetricDB = false;
   db_addStructId    = false;
 
   out_txt           = Analysis_OUT_TXT;
@@ -145,6 +148,7 @@ Args::dump(std::ostream& os) const
 {
   os << "db_dir= " << db_dir << std::endl;
   os << "out_db_experiment= " << out_db_experiment << std::endl;
+  os << "out_db_binary= " << out_db_binary << std::endl;
   os << "out_db_csv= " << out_db_csv << std::endl;
   os << "out_txt= " << out_txt << std::endl;
 }
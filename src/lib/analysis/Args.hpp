@@ -126,6 +126,7 @@ public:
 
   // Structure files
   std::vector<std::string> structureFiles;
+  std::string structureCacheDir; // binary structure images; disable: ""
 
   // Static analysis files
   std::vector<std::string> instructionFiles;
@@ -178,6 +179,9 @@ public:
 
   uint prof_metrics;
 
+  // Number of threads used to read measurement files (hpcprof)
+  uint prof_jobs;
+
   // TODO: Currently this is always true even though we only need to
   // compute final metric values for (1) hpcproftt (flat) and (2)
   // hpcprof-flat when it computes derived metrics.  However, at the
@@ -189,6 +193,7 @@ public:
   // -------------------------------------------------------
 
 #define Analysis_OUT_DB_EXPERIMENT "experiment.xml"
+#define Analysis_OUT_DB_BINARY     "experiment.db"
 #define Analysis_OUT_DB_CSV        "experiment.csv"
 
 #define Analysis_DB_DIR_pfx        "hpctoolkit"
@@ -197,6 +202,7 @@ public:
 
 
   std::string out_db_experiment; // disable: "", stdout: "-"
+  std::string out_db_binary;     // disable: ""
   std::string out_db_csv;        // disable: "", stdout: "-"
 
   std::string db_dir;            // disable: ""
@@ -205,6 +211,7 @@ public:
   std::string out_db_config;     // disable: "", stdout: "-"
 
   bool db_makeMetricDB;
+  bool db_sparseMetricDB; // write metric-db in the sparse format
   bool db_addStructId;
 
   // -------------------------------------------------------
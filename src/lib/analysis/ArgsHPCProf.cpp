@@ -115,6 +115,9 @@ Options: General:\n\
   -v [<n>], --verbose [<n>]\n\
                        Verbose: generate progress messages to stderr at\n\
                        verbosity level <n>. {1}\n\
+  -j <num>, --jobs <num>\n\
+                       Use <num> threads to read and merge measurement\n\
+                       files. hpcprof-mpi uses <num> threads per rank. {1}\n\
   -V, --version        Print version information.\n\
   -h, --help           Print this help.\n\
   --debug [<n>]        Debug: use debug level <n>. {1}\n\
@@ -129,6 +132,9 @@ Options: Source Code and Static Structure:\n\
   -S <file>, --structure <file>\n\
                        Use hpcstruct structure file <file> for correlation.\n\
                        May pass multiple times (e.g., for shared libraries).\n\
+  --struct-cache <dir> Cache binary images of structure files in <dir>.\n\
+                       Later runs load them instead of parsing XML and\n\
+                       only read the load modules a profile uses.\n\
   -R '<old-path>=<new-path>', --replace-path '<old-path>=<new-path>'\n\
                        Substitute instances of <old-path> with <new-path>;\n\
                        apply to all paths (profile's load map, source code)\n\
@@ -153,9 +159,12 @@ Options: Output:\n\
   -o <db-path>, --db <db-path>, --output <db-path>\n\
                        Specify Experiment database name <db-path>.\n\
                        {./" Analysis_DB_DIR "}\n\
-  --metric-db <yes|no>\n\
+  --metric-db <yes|no|sparse>\n\
                        Control whether to generate a thread-level metric\n\
                        value database for hpcviewer scatter plots. {no}\n\
+                       'sparse' stores only non-zero values (hpcprof-mpi).\n\
+  --xml <yes|no>       Control whether to also write " Analysis_OUT_DB_EXPERIMENT "\n\
+                       next to the binary " Analysis_OUT_DB_BINARY ". {yes}\n\
   --remove-redundancy \n\
                        Eliminate procedure name redundancy in experiment.xml\n\
   --struct-id          Add 'str=nnn' field to profile data with the hpcstruct\n\
@@ -186,6 +195,8 @@ CmdLineParser::OptArgDesc Analysis::ArgsHPCProf::optArgs[] = {
      NULL },
   { 'S', "structure",       CLP::ARG_REQ,  CLP::DUPOPT_CAT,  CLP_SEPARATOR,
      NULL },
+  {  0 , "struct-cache",    CLP::ARG_REQ,  CLP::DUPOPT_CLOB, NULL,
+     NULL },
   { 'R', "replace-path",    CLP::ARG_REQ,  CLP::DUPOPT_CAT,  CLP_SEPARATOR,
      NULL},
 
@@ -207,8 +218,12 @@ CmdLineParser::OptArgDesc Analysis::ArgsHPCProf::optArgs[] = {
      NULL },
   {  0 , "struct-id",       CLP::ARG_NONE, CLP::DUPOPT_CLOB, NULL,
      NULL },
+  {  0 , "xml",             CLP::ARG_REQ,  CLP::DUPOPT_CLOB, NULL,
+     NULL },
 
   // General
+  { 'j', "jobs",            CLP::ARG_REQ,  CLP::DUPOPT_CLOB, NULL,
+     NULL },
   { 'v', "verbose",         CLP::ARG_OPT,  CLP::DUPOPT_CLOB, NULL,
      CLP::isOptArg_long },
   { 'V', "version",         CLP::ARG_NONE, CLP::DUPOPT_CLOB, NULL,
@@ -238,6 +253,7 @@ ArgsHPCProf::ArgsHPCProf()
   // Analysis::Args
   prof_metrics = Analysis::Args::MetricFlg_StatsSum;
 
+  out_db_binary = Analysis_OUT_DB_BINARY;
   db_makeMetricDB = false;
   remove_redundancy = false;
 }
@@ -351,6 +367,14 @@ ArgsHPCProf::parse(int argc, const char* const argv[])
       }
       Diagnostics_SetDiagnosticFilterLevel(verb);
     }
+    if (parser.isOpt("jobs")) {
+      const string& arg = parser.getOptArg("jobs");
+      long jobs = CmdLineParser::toLong(arg);
+      if (jobs < 1) {
+	ARG_ERROR("Invalid value for --jobs/-j option: " << arg);
+      }
+      prof_jobs = (uint)jobs;
+    }
 
     // Check for agent options
     if (parser.isOpt("agent-cilk")) {
@@ -388,6 +412,9 @@ ArgsHPCProf::parse(int argc, const char* const argv[])
       string str = parser.getOptArg("structure");
       StrUtil::tokenize_str(str, CLP_SEPARATOR, structureFiles);
     }
+    if (parser.isOpt("struct-cache")) {
+      structureCacheDir = parser.getOptArg("struct-cache");
+    }
     if (parser.isOpt("normalize")) { 
       const string& arg = parser.getOptArg("normalize");
       doNormalizeTy = parseArg_norm(arg, "--normalize/-N option");
@@ -439,11 +466,23 @@ ArgsHPCProf::parse(int argc, const char* const argv[])
     }
     if (parser.isOpt("metric-db")) {
       const string& arg = parser.getOptArg("metric-db");
-      db_makeMetricDB = CmdLineParser::parseArg_bool(arg, "--metric-db option");
+      if (arg == "sparse") {
+	db_makeMetricDB = true;
+	db_sparseMetricDB = true;
+      }
+      else {
+	db_makeMetricDB = CmdLineParser::parseArg_bool(arg, "--metric-db option");
+      }
     }
     if (parser.isOpt("struct-id")) {
       db_addStructId = true;
     }
+    if (parser.isOpt("xml")) {
+      const string& arg = parser.getOptArg("xml");
+      if (!CmdLineParser::parseArg_bool(arg, "--xml option")) {
+	out_db_experiment = "";
+      }
+    }
 
     // Check for required arguments
     uint numArgs = parser.getNumArgs();
@@ -68,14 +68,22 @@ using std::dec;
 #include <string>
 using std::string;
 
+#include <algorithm>
 #include <climits>
+#include <cstdio>
 #include <cstring>
 #include <map>
 #include <vector>
 
 #include <typeinfo>
 
+#include <condition_variable>
+#include <exception>
+#include <mutex>
+#include <thread>
+
 #include <sys/stat.h>
+#include <inttypes.h>
 
 //*************************** User Include Files ****************************
 
@@ -91,6 +99,8 @@ using std::string;
 #include <lib/prof/CCT-Tree.hpp>
 #include <lib/prof/Metric-Mgr.hpp>
 #include <lib/prof/Metric-ADesc.hpp>
+#include <lib/prof/ExperimentDB.hpp>
+#include <lib/prof/Struct-Image.hpp>
 
 #include <lib/profxml/XercesUtil.hpp>
 #include <lib/profxml/PGMReader.hpp>
@@ -104,9 +114,11 @@ using std::string;
 using namespace xml;
 
 #include <lib/support/diagnostics.h>
+#include <lib/support/FileUtil.hpp>
 #include <lib/support/Logic.hpp>
 #include <lib/support/IOUtil.hpp>
 #include <lib/support/StrUtil.hpp>
+#include <lib/support/realpath.h>
 
 
 //********************************** Macros **********************************
@@ -127,14 +139,143 @@ std::ostream* Analysis::CallPath::dbgOs = NULL; // for parallel debugging
 static void
 coalesceStmts(Prof::Struct::Tree& structure);
 
+static void
+readStructureCached(Prof::Struct::Tree& structure, const Analysis::Args& args,
+		    DocHandlerArgs& docargs);
+
 namespace Analysis {
 
 namespace CallPath {
 
 
+//***************************************************************************
+// ProfileReadQueue: Reads measurement files with a pool of threads,
+// ahead of a consumer that merges them in file order.
+//
+// The merge itself remains serial and in file order.  Profile::merge
+// is neither associative for floating point metric sums nor for the
+// trace cp-id normalization (MergeEffects are relative to the
+// accumulated profile), so a pairwise (tree) merge would not reproduce
+// the serial result.  Reading (I/O, decoding and CCT construction)
+// dominates, and overlaps with the merge of earlier profiles.
+//***************************************************************************
+
+class ProfileReadQueue
+{
+public:
+  ProfileReadQueue(const Util::StringVec& profileFiles,
+		   const Util::UIntVec* groupMap, uint rFlags, uint numThreads)
+    : m_files(profileFiles), m_groupMap(groupMap), m_rFlags(rFlags),
+      m_profs(profileFiles.size(), NULL), m_errors(profileFiles.size()),
+      m_isDone(profileFiles.size(), false),
+      m_nextRead(0), m_nextTake(0), m_window(2 * numThreads), m_stop(false)
+  {
+    for (uint i = 0; i < numThreads; ++i) {
+      m_threads.push_back(std::thread(&ProfileReadQueue::work, this));
+    }
+  }
+
+  ~ProfileReadQueue()
+  {
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_stop = true;
+    }
+    m_cvRead.notify_all();
+    for (uint i = 0; i < m_threads.size(); ++i) {
+      m_threads[i].join();
+    }
+    // reclaim profiles that were read but not taken (error path)
+    for (uint i = 0; i < m_profs.size(); ++i) {
+      delete m_profs[i];
+    }
+  }
+
+  // take: returns the next profile in file order, waiting for it to be
+  //   read if necessary.  Rethrows any exception raised by its reader.
+  Prof::CallPath::Profile*
+  take()
+  {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    uint i = m_nextTake;
+    m_cvTake.wait(lock, [&] { return m_isDone[i]; });
+
+    if (m_errors[i]) {
+      std::rethrow_exception(m_errors[i]);
+    }
+
+    Prof::CallPath::Profile* prof = m_profs[i];
+    m_profs[i] = NULL;
+    m_nextTake++;
+    lock.unlock();
+
+    m_cvRead.notify_all(); // the read window has advanced
+    return prof;
+  }
+
+private:
+  void
+  work()
+  {
+    while (true) {
+      uint i;
+      {
+	std::unique_lock<std::mutex> lock(m_mutex);
+	// bound the number of profiles held in memory
+	m_cvRead.wait(lock, [&] {
+	    return (m_stop || m_nextRead >= m_files.size()
+		    || m_nextRead < m_nextTake + m_window); });
+	if (m_stop || m_nextRead >= m_files.size()) {
+	  return;
+	}
+	i = m_nextRead++;
+      }
+
+      Prof::CallPath::Profile* prof = NULL;
+      std::exception_ptr error;
+      try {
+	uint groupId = (m_groupMap) ? (*m_groupMap)[i] : 0;
+	prof = read(m_files[i], groupId, m_rFlags);
+      }
+      catch (...) {
+	error = std::current_exception();
+      }
+
+      {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_profs[i] = prof;
+	m_errors[i] = error;
+	m_isDone[i] = true;
+      }
+      m_cvTake.notify_all();
+    }
+  }
+
+private:
+  const Util::StringVec& m_files;
+  const Util::UIntVec* m_groupMap;
+  uint m_rFlags;
+
+  std::vector<Prof::CallPath::Profile*> m_profs;
+  std::vector<std::exception_ptr> m_errors;
+  std::vector<bool> m_isDone;
+
+  uint m_nextRead; // next profile to be claimed by a reader
+  uint m_nextTake; // next profile to be taken by the consumer
+  uint m_window;   // max. number of profiles read ahead of the consumer
+  bool m_stop;
+
+  std::mutex m_mutex;
+  std::condition_variable m_cvRead;
+  std::condition_variable m_cvTake;
+  std::vector<std::thread> m_threads;
+};
+
+
 Prof::CallPath::Profile*
 read(const Util::StringVec& profileFiles, const Util::UIntVec* groupMap,
-     int mergeTy, uint rFlags, uint mrgFlags)
+     int mergeTy, uint rFlags, uint mrgFlags, uint numThreads,
+     Prof::CallPath::TraceRemapper* traceRemapper)
 {
   // Special case
   if (profileFiles.empty()) {
@@ -143,23 +284,49 @@ read(const Util::StringVec& profileFiles, const Util::UIntVec* groupMap,
   }
   
   // General case
-  uint groupId = (groupMap) ? (*groupMap)[0] : 0;
-  Prof::CallPath::Profile* prof = read(profileFiles[0], groupId, rFlags);
+  numThreads = std::max(1u, std::min(numThreads, (uint)profileFiles.size()));
 
-  // add the directory into the set of directories
-  prof->addDirectory(profileFiles[0]);
+  ProfileReadQueue* readQueue = NULL;
+  if (numThreads > 1) {
+    readQueue = new ProfileReadQueue(profileFiles, groupMap, rFlags,
+				     numThreads);
+  }
+
+  Prof::CallPath::Profile* prof = NULL;
+  try {
+    for (uint i = 0; i < profileFiles.size(); ++i) {
+      Prof::CallPath::Profile* p = NULL;
+      if (readQueue) {
+	p = readQueue->take();
+      }
+      else {
+	uint groupId = (groupMap) ? (*groupMap)[i] : 0;
+	p = read(profileFiles[i], groupId, rFlags);
+      }
 
-  for (uint i = 1; i < profileFiles.size(); ++i) {
-    groupId = (groupMap) ? (*groupMap)[i] : 0;
-    Prof::CallPath::Profile* p = read(profileFiles[i], groupId, rFlags);
-    prof->merge(*p, mergeTy, mrgFlags);
+      if (i == 0) {
+	prof = p;
+	prof->traceRemapper(traceRemapper);
+      }
+      else {
+	prof->merge(*p, mergeTy, mrgFlags);
 
-    prof->metricMgr()->mergePerfEventStatistics(p->metricMgr());
-    delete p;
+	prof->metricMgr()->mergePerfEventStatistics(p->metricMgr());
+	delete p;
+      }
 
-    // add the directory into the set of directories
-    prof->addDirectory(profileFiles[i]);
+      // add the directory into the set of directories
+      prof->addDirectory(profileFiles[i]);
+    }
+  }
+  catch (...) {
+    delete readQueue;
+    delete prof;
+    throw;
   }
+  delete readQueue;
+  prof->traceRemapper(NULL);
+
   prof->metricMgr()->mergePerfEventStatistics_finalize(profileFiles.size());
   
   return prof;
@@ -205,8 +372,13 @@ readStructure(Prof::Struct::Tree* structure, const Analysis::Args& args)
 {
   DocHandlerArgs docargs(&RealPathMgr::singleton());
 
-  Prof::Struct::readStructure(*structure, args.structureFiles,
-			      PGMDocHandler::Doc_STRUCT, docargs);
+  if (args.structureCacheDir.empty()) {
+    Prof::Struct::readStructure(*structure, args.structureFiles,
+				PGMDocHandler::Doc_STRUCT, docargs);
+  }
+  else {
+    readStructureCached(*structure, args, docargs);
+  }
 
   // BAnal::Struct::makeStructure() creates a Struct::Tree that
   // distinguishes between non-call-site statements and call site
@@ -242,6 +414,96 @@ readStructure(Prof::Struct::Tree* structure, const Analysis::Args& args)
 
 //****************************************************************************
 
+// structureImageName: the cache entry for structure file 'fnm', named
+// by a hash of its real path
+static string
+structureImageName(const string& cacheDir, const string& fnm)
+{
+  string path = RealPath(fnm.c_str());
+
+  uint64_t hash = 14695981039346656037ULL; // FNV-1a
+  for (uint i = 0; i < path.size(); ++i) {
+    hash = (hash ^ (unsigned char)path[i]) * 1099511628211ULL;
+  }
+
+  char buf[32];
+  snprintf(buf, sizeof(buf), "-%016" PRIx64 ".img", hash);
+  return cacheDir + "/" + FileUtil::basename(fnm) + buf;
+}
+
+
+// readStructureCached: Each structure file is read through its binary
+// image in 'args.structureCacheDir', creating the image on first use.
+// Load modules are created only when the profile refers to them (cf.
+// Prof::Struct::ImageLoader).
+static void
+readStructureCached(Prof::Struct::Tree& structure, const Analysis::Args& args,
+		    DocHandlerArgs& docargs)
+{
+  using namespace Prof;
+
+  const string& cacheDir = args.structureCacheDir;
+  try {
+    FileUtil::mkdir(cacheDir);
+  }
+  catch (const Diagnostics::Exception& x) {
+    DIAG_WMsgIf(1, "cannot create structure cache '" << cacheDir << "': "
+		<< x.what());
+  }
+
+  Struct::ImageLoader* loader = new Struct::ImageLoader(&RealPathMgr::singleton());
+  structure.root()->lmLoader(loader);
+
+  for (uint i = 0; i < args.structureFiles.size(); ++i) {
+    const string& fnm = args.structureFiles[i];
+    string imgFnm = structureImageName(cacheDir, fnm);
+
+    if (loader->add(imgFnm, fnm)) {
+      continue;
+    }
+
+    // Make the image from a scratch tree.  Paths are kept as they
+    // appear in the structure file; the loader translates them.
+    //
+    // N.B.: hpcprof-mpi relies on every rank creating structure nodes
+    // (and their ids) in the same order, whether or not it built an
+    // image.  Scratch nodes must not consume ids, and an image that
+    // cannot be cached is used from memory.
+    DIAG_Msg(1, "Caching structure file: " << fnm);
+    std::vector<string> files(1, fnm);
+    string* img = new string;
+    bool isMade = false;
+    uint maxId = Struct::ANode::maxId();
+    {
+      Struct::Tree scratch("");
+      DocHandlerArgs rawargs;
+      Struct::readStructure(scratch, files, PGMDocHandler::Doc_STRUCT, rawargs);
+      try {
+	Struct::Image::make(*img, scratch, fnm);
+	isMade = true;
+      }
+      catch (const Diagnostics::Exception& x) {
+	DIAG_WMsgIf(1, "cannot cache structure file '" << fnm << "': " << x.what());
+      }
+    }
+    Struct::ANode::maxId(maxId);
+
+    if (!isMade) {
+      delete img;
+      Struct::readStructure(structure, files, PGMDocHandler::Doc_STRUCT, docargs);
+      continue;
+    }
+
+    try {
+      Struct::Image::write(*img, imgFnm);
+    }
+    catch (const Diagnostics::Exception& x) {
+      DIAG_WMsgIf(1, "cannot cache structure file '" << fnm << "': " << x.what());
+    }
+    loader->add(img);
+  }
+}
+
 
 static void
 coalesceStmts(Prof::Struct::ANode* node);
@@ -1201,6 +1463,10 @@ static void
 write(Prof::CallPath::Profile& prof, std::ostream& os,
       const Analysis::Args& args);
 
+static void
+visibleMetrics(Prof::CallPath::Profile& prof,
+	       uint& metricBegId, uint& metricEndId);
+
 
 // makeDatabase: assumes Analysis::Args::makeDatabaseDir() has been called
 void
@@ -1218,7 +1484,21 @@ makeDatabase(Prof::CallPath::Profile& prof, const Analysis::Args& args)
   // 2. Copy trace files (if necessary)
   Analysis::Util::copyTraceFiles(db_dir, prof.traceFileNameSet());
 
-  // 3. Create 'experiment.xml' file
+  // 3. Write the binary experiment database
+  if (!args.out_db_binary.empty()) {
+    uint metricBegId, metricEndId;
+    visibleMetrics(prof, metricBegId, metricEndId);
+
+    string name = (args.title.empty()) ? prof.name() : args.title;
+    string binary_fnm = db_dir + "/" + args.out_db_binary;
+    Prof::ExperimentDB::write(prof, binary_fnm, name, metricBegId, metricEndId);
+  }
+
+  if (args.out_db_experiment.empty()) {
+    return;
+  }
+
+  // 4. Create 'experiment.xml' file
   string experiment_fnm = db_dir + "/" + args.out_db_experiment;
   std::ostream* os = IOUtil::OpenOStream(experiment_fnm.c_str());
 
@@ -1227,7 +1507,7 @@ makeDatabase(Prof::CallPath::Profile& prof, const Analysis::Args& args)
   std::streambuf* os_buf = os->rdbuf();
   os_buf->pubsetbuf(outBuf, HPCIO_RWBufferSz);
 
-  // 4. Write data for 'experiment.xml'
+  // 5. Write data for 'experiment.xml'
   Analysis::CallPath::write(prof, *os, args);
   IOUtil::CloseStream(os);
 
@@ -1235,6 +1515,21 @@ makeDatabase(Prof::CallPath::Profile& prof, const Analysis::Args& args)
 }
 
 
+// visibleMetrics: the range [metricBegId, metricEndId) spanning the
+// visible metrics, or npos for both if there are none
+static void
+visibleMetrics(Prof::CallPath::Profile& prof,
+	       uint& metricBegId, uint& metricEndId)
+{
+  using namespace Prof;
+
+  Metric::ADesc* mBeg = prof.metricMgr()->findFirstVisible();
+  Metric::ADesc* mEnd = prof.metricMgr()->findLastVisible();
+  metricBegId = (mBeg) ? mBeg->id()     : Metric::Mgr::npos;
+  metricEndId = (mEnd) ? mEnd->id() + 1 : Metric::Mgr::npos;
+}
+
+
 static void
 write(Prof::CallPath::Profile& prof, std::ostream& os,
       const Analysis::Args& args)
@@ -1256,15 +1551,8 @@ write(Prof::CallPath::Profile& prof, std::ostream& os,
     oFlags |= CCT::Tree::OFlg_StructId;
   }
 
-  uint metricBegId = 0;
-  uint metricEndId = prof.metricMgr()->size();
-
- {
-    Metric::ADesc* mBeg = prof.metricMgr()->findFirstVisible();
-    Metric::ADesc* mEnd = prof.metricMgr()->findLastVisible();
-    metricBegId = (mBeg) ? mBeg->id()     : Metric::Mgr::npos;
-    metricEndId = (mEnd) ? mEnd->id() + 1 : Metric::Mgr::npos;
-  }
+  uint metricBegId, metricEndId;
+  visibleMetrics(prof, metricBegId, metricEndId);
 
   string name = (args.title.empty()) ? prof.name() : args.title;
 
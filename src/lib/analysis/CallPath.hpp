@@ -94,9 +94,15 @@ extern std::ostream* dbgOs; // for parallel debugging
 //
 // ---------------------------------------------------------
 
+// read: reads and merges 'profileFiles' (in order).  When
+//   'numThreads' > 1, files are read by a pool of threads while the
+//   merge proceeds; the result is identical to the serial merge.  If
+//   given, 'traceRemapper' rewrites the trace files normalized by the
+//   merge (cf. CCT::MrgFlg_NormalizeTraceFileY).
 Prof::CallPath::Profile*
 read(const Util::StringVec& profileFiles, const Util::UIntVec* groupMap,
-     int mergeTy, uint rFlags = 0, uint mrgFlags = 0);
+     int mergeTy, uint rFlags = 0, uint mrgFlags = 0, uint numThreads = 1,
+     Prof::CallPath::TraceRemapper* traceRemapper = NULL);
 
 Prof::CallPath::Profile*
 read(const char* prof_fnm, uint groupId, uint rFlags = 0);
@@ -63,6 +63,8 @@
 #include <string>
 using std::string;
 
+#include <vector>
+
 #define __STDC_FORMAT_MACROS
 #include <inttypes.h>
 
@@ -125,6 +127,40 @@ Analysis::Raw::writeAsText_callpath(const char* filenm)
 }
 
 
+// writeAsText_sparseMetricDB: prints the rows of a sparse metric-db
+// ('fs' is just past its header) in the same layout as a dense one.
+static void
+writeAsText_sparseMetricDB(const char* filenm,
+			   const hpcmetricDB_fmt_hdr_t* hdr, FILE* fs)
+{
+  std::vector<hpcmetricDB_fmt_nzidx_t> nzidx(hdr->numNZNodes + 1);
+  for (uint i = 0; i < nzidx.size(); ++i) {
+    int ret = hpcmetricDB_fmt_nzidx_fread(&nzidx[i], fs);
+    if (ret != HPCFMT_OK) {
+      DIAG_Throw("error reading metric-db file '" << filenm << "'");
+    }
+  }
+  if (nzidx.back().nodeId != HPCMETRICDB_FMT_NodeId_NULL
+      || nzidx.back().valueIdx != hdr->numNZValues) {
+    DIAG_Throw("bad node index in metric-db file '" << filenm << "'");
+  }
+
+  std::vector<double> mvals(hdr->numMetrics);
+  for (uint nodeId = 1; nodeId < hdr->numNodes + 1; ++nodeId) {
+    int ret = hpcmetricDB_fmt_sparse_node_fread(hdr, &nzidx[0], nodeId,
+						mvals.data(), fs);
+    if (ret != HPCFMT_OK) {
+      DIAG_Throw("error reading metric-db file '" << filenm << "'");
+    }
+    fprintf(stdout, "(%6u: ", nodeId);
+    for (uint mId = 0; mId < hdr->numMetrics; ++mId) {
+      fprintf(stdout, "%12g ", mvals[mId]);
+    }
+    fprintf(stdout, ")\n");
+  }
+}
+
+
 void
 Analysis::Raw::writeAsText_callpathMetricDB(const char* filenm)
 {
@@ -144,13 +180,19 @@ Analysis::Raw::writeAsText_callpathMetricDB(const char* filenm)
 
     hpcmetricDB_fmt_hdr_fprint(&hdr, stdout);
 
+    if (hpcmetricDB_fmt_isSparse(&hdr)) {
+      writeAsText_sparseMetricDB(filenm, &hdr, fs);
+      hpcio_fclose(fs);
+      return;
+    }
+
     for (uint nodeId = 1; nodeId < hdr.numNodes + 1; ++nodeId) {
       fprintf(stdout, "(%6u: ", nodeId);
       for (uint mId = 0; mId < hdr.numMetrics; ++mId) {
 	double mval = 0;
 	ret = hpcfmt_real8_fread(&mval, fs);
 	if (ret != HPCFMT_OK) {
-	  DIAG_Throw("error reading trace file '" << filenm << "'");
+	  DIAG_Throw("error reading metric-db file '" << filenm << "'");
 	}
 	fprintf(stdout, "%12g ", mval);
       }
@@ -186,10 +228,19 @@ Analysis::Raw::writeAsText_callpathTrace(const char* filenm)
 
     hpctrace_fmt_hdr_fprint(&hdr, stdout);
 
+    bool isCompact = HPCTRACE_FMT_IsCompact(&hdr);
+    hpctrace_fmt_blk_t blk;
+    hpctrace_fmt_blk_init(&blk);
+
     // Read trace records and exit on EOF
     while ( !feof(fs) ) {
       hpctrace_fmt_datum_t datum;
-      ret = hpctrace_fmt_datum_fread(&datum, hdr.flags, fs);
+      if (isCompact) {
+	ret = hpctrace_fmt_datum_blk_fread(&datum, hdr.flags, &blk, fs);
+      }
+      else {
+	ret = hpctrace_fmt_datum_fread(&datum, hdr.flags, fs);
+      }
       if (ret == HPCFMT_EOF) {
 	break;
       }
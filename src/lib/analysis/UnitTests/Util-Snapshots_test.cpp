@@ -0,0 +1,193 @@
+// -*-Mode: C++;-*-
+
+// * BeginRiceCopyright *****************************************************
+//
+// $HeadURL$
+// $Id$
+//
+// --------------------------------------------------------------------------
+// Part of HPCToolkit (hpctoolkit.org)
+//
+// Information about sources of support for research and development of
+// HPCToolkit is at 'hpctoolkit.org' and in 'README.Acknowledgments'.
+// --------------------------------------------------------------------------
+//
+// Copyright ((c)) 2002-2020, Rice University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+//
+// * Neither the name of Rice University (RICE) nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+//
+// This software is provided by RICE and contributors "as is" and any
+// express or implied warranties, including, but not limited to, the
+// implied warranties of merchantability and fitness for a particular
+// purpose are disclaimed. In no event shall RICE or contributors be
+// liable for any direct, indirect, incidental, special, exemplary, or
+// consequential damages (including, but not limited to, procurement of
+// substitute goods or services; loss of use, data, or profits; or
+// business interruption) however caused and on any theory of liability,
+// whether in contract, strict liability, or tort (including negligence
+// or otherwise) arising in any way out of the use of this software, even
+// if advised of the possibility of such damage.
+//
+// ******************************************************* EndRiceCopyright *
+
+//***************************************************************************
+//
+// File:
+//   Util-Snapshots_test.cpp
+//
+// Purpose:
+//   Checks which profile files and snapshots hpcrun wrote for a thread
+//   Analysis::Util::normalizeProfileArgs() keeps, and that it puts
+//   the files of each thread next to each other, the profile first.
+//
+//***************************************************************************
+
+#undef NDEBUG
+
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <unistd.h>
+using namespace std;
+
+#include <lib/analysis/Util.hpp>
+
+using namespace Analysis;
+
+static void touch(const string& path)
+{
+	FILE* f = fopen(path.c_str(), "w");
+	assert(f != NULL);
+	fclose(f);
+}
+
+// the thread runs of 'paths', each as its file names joined by ' '
+static vector<string> threadRuns(const Util::StringVec& paths,
+		const string& dir)
+{
+	vector<string> runs;
+	for (uint i = 0, end; i < paths.size(); i = end)
+	{
+		end = Util::profileThreadEnd(paths, i);
+		string run;
+		for (uint k = i; k < end; k++)
+		{
+			assert(paths[k].compare(0, dir.length(), dir) == 0);
+			run += (k > i ? " " : "") + paths[k].substr(dir.length());
+		}
+		runs.push_back(run);
+	}
+	return runs;
+}
+
+static void checkRuns(const vector<string>& runs,
+		const vector<string>& expected)
+{
+	if (runs != expected)
+	{
+		for (uint i = 0; i < runs.size(); i++)
+		{
+			cout << "\t" << runs[i] << endl;
+		}
+	}
+	assert(runs == expected);
+}
+
+void snapshotSelectionTest()
+{
+	char tmpl[] = "/tmp/snapshotSelectionTest.XXXXXX";
+	assert(mkdtemp(tmpl) != NULL);
+	string dir = string(tmpl) + "/";
+
+	const char* files[] = {
+		// complete profile: its cumulative snapshots are dropped
+		"a.hpcrun", "a.snap000001.hpcrun", "a.snap000002.hpcrun",
+		// no profile: the newest snapshot, by number
+		"b.snap000001.hpcrun", "b.snap000010.hpcrun", "b.snap000002.hpcrun",
+		// flushed, then a snapshot of the rest
+		"c.flushed.hpcrun", "c.snap000004.hpcrun",
+		// delta snapshots all add up, with the profile first
+		"d.delta000002.hpcrun", "d.delta000001.hpcrun", "d.hpcrun",
+		"e.delta000003.hpcrun", "e.flushed.hpcrun",
+		// a complete profile replaces the flushed part
+		"f.flushed.hpcrun", "f.hpcrun",
+		// not snapshot names
+		"g.snap.hpcrun", "g.snapx1.hpcrun", "g.flushed1.hpcrun",
+	};
+	const uint numFiles = sizeof(files) / sizeof(files[0]);
+
+	for (uint i = 0; i < numFiles; i++)
+	{
+		touch(dir + files[i]);
+	}
+
+	const char* expected[] = {
+		"a.hpcrun",
+		"b.snap000010.hpcrun",
+		"c.flushed.hpcrun c.snap000004.hpcrun",
+		"d.hpcrun d.delta000001.hpcrun d.delta000002.hpcrun",
+		"e.flushed.hpcrun e.delta000003.hpcrun",
+		"f.hpcrun",
+		"g.flushed1.hpcrun",
+		"g.snap.hpcrun",
+		"g.snapx1.hpcrun",
+	};
+	vector<string> expectedRuns(expected,
+			expected + sizeof(expected) / sizeof(expected[0]));
+
+	// a directory: names in alphabetical order
+	Util::StringVec dirArg(1, dir);
+	Util::NormalizeProfileArgs_t nArgs = Util::normalizeProfileArgs(dirArg);
+	checkRuns(threadRuns(*nArgs.paths, dir), expectedRuns);
+	for (uint i = 0; i < nArgs.groupMap->size(); i++)
+	{
+		assert((*nArgs.groupMap)[i] == 1);
+	}
+	nArgs.destroy();
+
+	// the same files, one argument each, in reverse order: a thread's
+	// files are still adjacent, threads in order of first appearance
+	Util::StringVec fileArgs;
+	for (uint i = numFiles; i > 0; i--)
+	{
+		fileArgs.push_back(dir + files[i - 1]);
+	}
+	nArgs = Util::normalizeProfileArgs(fileArgs);
+	vector<string> reversedRuns(expectedRuns.rbegin(), expectedRuns.rend());
+	// the g files are three profiles, in argument order
+	reversedRuns[0] = "g.flushed1.hpcrun";
+	reversedRuns[1] = "g.snapx1.hpcrun";
+	reversedRuns[2] = "g.snap.hpcrun";
+	checkRuns(threadRuns(*nArgs.paths, dir), reversedRuns);
+	nArgs.destroy();
+
+	assert(Util::profileBasePath(dir + "c.snap000004.hpcrun") == dir + "c");
+	assert(Util::profileBasePath(dir + "c.flushed.hpcrun") == dir + "c");
+	assert(Util::profileBasePath(dir + "d.delta000001.hpcrun") == dir + "d");
+	assert(Util::profileBasePath("x.y/z.hpcrun") == "x.y/z");
+
+	for (uint i = 0; i < numFiles; i++)
+	{
+		unlink((dir + files[i]).c_str());
+	}
+	rmdir(tmpl);
+
+	cout << "snapshotSelectionTest: ok" << endl;
+}
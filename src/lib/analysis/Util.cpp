@@ -65,11 +65,16 @@
 using std::string;
 
 #include <algorithm>
+#include <map>
+#include <set>
 #include <typeinfo>
 
+#include <cctype>  // isdigit()
+#include <cstdlib> // strtoul()
 #include <cstring> // strlen()
 
 #include <dirent.h> // scandir()
+#include <unistd.h> // unlink()
 
 //*************************** User Include Files ****************************
 
@@ -82,6 +87,7 @@ using std::string;
 
 #include <lib/prof-lean/hpcio.h>
 #include <lib/prof-lean/hpcfmt.h>
+#include <lib/prof-lean/hpcio-container.h>
 #include <lib/prof-lean/hpcrun-fmt.h>
 #include <lib/prof-lean/hpcrunflat-fmt.h>
 
@@ -115,8 +121,198 @@ hpcrunFileFilter(const struct dirent* entry)
 {
   static const string ext = string(".") + HPCRUN_ProfileFnmSfx;
   static const uint extLen = ext.length();
+  static const string extC = string(".") + HPCRUN_ContainerFnmSfx;
+  static const uint extCLen = extC.length();
 
-  return fileExtensionFilter(entry, ext, extLen);
+  return (fileExtensionFilter(entry, ext, extLen)
+	  || fileExtensionFilter(entry, extC, extCLen));
+}
+
+
+// addProfilePath: adds 'path' to 'out'; an hpcrun output container
+// is replaced by its profile members.
+static void
+addProfilePath(Analysis::Util::NormalizeProfileArgs_t& out,
+	       const string& path)
+{
+  uint32_t numMbrs = 0;
+  char** mbrs = hpcio_container_member_paths(path.c_str(),
+					     HPCRUN_ProfileFnmSfx, &numMbrs);
+  if (mbrs) {
+    for (uint32_t i = 0; i < numMbrs; ++i) {
+      string nm = mbrs[i];
+      out.paths->push_back(nm);
+      out.pathLenMax = std::max(out.pathLenMax, (uint)nm.length());
+      out.groupMap->push_back(out.groupMax);
+    }
+    hpcio_container_member_paths_free(mbrs, numMbrs);
+    return;
+  }
+
+  out.paths->push_back(path);
+  out.pathLenMax = std::max(out.pathLenMax, (uint)path.length());
+  out.groupMap->push_back(out.groupMax);
+}
+
+
+// profileStem: 'path' without its ".hpcrun" suffix
+static string
+profileStem(const string& path)
+{
+  static const string ext = string(".") + HPCRUN_ProfileFnmSfx;
+
+  size_t beg = path.find_last_of(string("/") + HPCIO_ContainerMemberSep);
+  beg = (beg == string::npos) ? 0 : beg + 1;
+  if (path.length() > beg + ext.length()
+      && path.compare(path.length() - ext.length(), ext.length(), ext) == 0) {
+    return path.substr(0, path.length() - ext.length());
+  }
+  return path;
+}
+
+
+// isSnapshotName: if profile stem 'nm' is <base>.<infix><seq>, sets
+// 'base' and 'seq' and returns true.  If 'hasSeq' is false, the stem
+// must be <base>.<infix>.
+static bool
+isSnapshotName(const string& nm, const char* infix, string& base, uint& seq,
+	       bool hasSeq = true)
+{
+  size_t dot = nm.rfind('.');
+  if (dot == string::npos || nm.find('/', dot) != string::npos) {
+    return false;
+  }
+  size_t beg = dot + 1, infixLen = strlen(infix);
+  if (nm.compare(beg, infixLen, infix) != 0
+      || (hasSeq == (beg + infixLen == nm.length()))) {
+    return false;
+  }
+  for (size_t i = beg + infixLen; i < nm.length(); ++i) {
+    if (!isdigit(nm[i])) {
+      return false;
+    }
+  }
+  base = nm.substr(0, dot);
+  seq = hasSeq ? strtoul(nm.c_str() + beg + infixLen, NULL, 10) : 0;
+  return true;
+}
+
+
+// the kinds of files that hold (part of) the profile of a thread, in
+// the order in which they are merged
+enum ProfileFileKind {
+  ProfileFile_Final,    // <base>.hpcrun
+  ProfileFile_Flushed,  // <base>.flushed.hpcrun: not complete
+  ProfileFile_Delta,    // <base>.delta<seq>.hpcrun
+  ProfileFile_Snapshot  // <base>.snap<seq>.hpcrun: cumulative
+};
+
+
+static ProfileFileKind
+profileFileKind(const string& path, string& base, uint& seq)
+{
+  string nm = profileStem(path);
+  if (isSnapshotName(nm, HPCRUN_SnapshotFnmInfix, base, seq)) {
+    return ProfileFile_Snapshot;
+  }
+  if (isSnapshotName(nm, HPCRUN_SnapshotDeltaFnmInfix, base, seq)) {
+    return ProfileFile_Delta;
+  }
+  if (isSnapshotName(nm, HPCRUN_FlushedFnmInfix, base, seq, false)) {
+    return ProfileFile_Flushed;
+  }
+  base = nm;
+  seq = 0;
+  return ProfileFile_Final;
+}
+
+
+// selectSnapshots: chooses the files that make up the profile of each
+// thread (cf. hpcrun's snapshot.c), and puts them next to each other,
+// the profile first:
+// - a complete profile, and all delta snapshots;
+// - else, the flushed part of the profile, all delta snapshots and the
+//   newest cumulative snapshot (which holds what the flush did not).
+static void
+selectSnapshots(Analysis::Util::NormalizeProfileArgs_t& out)
+{
+  Analysis::Util::StringVec& paths = *out.paths;
+  Analysis::Util::UIntVec& groups = *out.groupMap;
+
+  struct File {
+    uint thread; // in order of first appearance
+    ProfileFileKind kind;
+    uint seq;
+    uint idx;
+  };
+  std::vector<File> files(paths.size());
+
+  std::map<string, uint> threads;
+  std::vector<bool> hasFinal;
+  std::vector<uint> newest; // newest cumulative snapshot, or paths.size()
+  bool haveParts = false;
+
+  for (uint i = 0; i < paths.size(); ++i) {
+    string base;
+    File& f = files[i];
+    f.kind = profileFileKind(paths[i], base, f.seq);
+    f.idx = i;
+
+    auto it = threads.insert(std::make_pair(base, (uint)threads.size())).first;
+    f.thread = it->second;
+    if (f.thread == hasFinal.size()) {
+      hasFinal.push_back(false);
+      newest.push_back(paths.size());
+    }
+
+    if (f.kind == ProfileFile_Final) {
+      hasFinal[f.thread] = true;
+    }
+    else {
+      haveParts = true;
+    }
+    uint& n = newest[f.thread];
+    if (f.kind == ProfileFile_Snapshot
+	&& (n == paths.size() || f.seq > files[n].seq)) {
+      n = i;
+    }
+  }
+
+  if (!haveParts) {
+    return;
+  }
+
+  std::vector<File> keep;
+  for (uint i = 0; i < files.size(); ++i) {
+    const File& f = files[i];
+    bool complete = hasFinal[f.thread];
+    if (f.kind == ProfileFile_Final || f.kind == ProfileFile_Delta
+	|| (f.kind == ProfileFile_Flushed && !complete)
+	|| (f.kind == ProfileFile_Snapshot && !complete
+	    && newest[f.thread] == i)) {
+      keep.push_back(f);
+    }
+  }
+
+  std::stable_sort(keep.begin(), keep.end(),
+		   [](const File& a, const File& b) {
+		     if (a.thread != b.thread) {
+		       return a.thread < b.thread;
+		     }
+		     if (a.kind != b.kind) {
+		       return a.kind < b.kind;
+		     }
+		     return a.seq < b.seq;
+		   });
+
+  Analysis::Util::StringVec keepPaths(keep.size());
+  Analysis::Util::UIntVec keepGroups(keep.size());
+  for (uint i = 0; i < keep.size(); ++i) {
+    keepPaths[i] = paths[keep[i].idx];
+    keepGroups[i] = groups[keep[i].idx];
+  }
+  paths.swap(keepPaths);
+  groups.swap(keepGroups);
 }
 
 
@@ -202,9 +398,7 @@ normalizeProfileArgs(const StringVec& inPaths)
         for (int i = 0; i < dirEntriesSz; ++i) {
           string nm = path + dirEntries[i]->d_name;
           free(dirEntries[i]);
-          out.paths->push_back(nm);
-          out.pathLenMax = std::max(out.pathLenMax, (uint)nm.length());
-          out.groupMap->push_back(out.groupMax);
+          addProfilePath(out, nm);
         }
         free(dirEntries);
       }
@@ -212,15 +406,37 @@ normalizeProfileArgs(const StringVec& inPaths)
     }
     else {
       out.groupMax++; // obtain next group;
-      out.paths->push_back(path);
-      out.pathLenMax = std::max(out.pathLenMax, (uint)path.length());
-      out.groupMap->push_back(out.groupMax);
+      addProfilePath(out, path);
     }
   }
 
+  selectSnapshots(out);
+
   return out;
 }
 
+
+string
+profileBasePath(const string& path)
+{
+  string base;
+  uint seq;
+  profileFileKind(path, base, seq);
+  return base;
+}
+
+
+uint
+profileThreadEnd(const StringVec& paths, uint beg)
+{
+  string base = profileBasePath(paths[beg]);
+  uint end = beg + 1;
+  while (end < paths.size() && profileBasePath(paths[end]) == base) {
+    end++;
+  }
+  return end;
+}
+
 } // end of Util namespace
 } // end of Analysis namespace
 
@@ -604,7 +820,46 @@ copySourceFile(const string& filenm, const string& dstDir,
 namespace Analysis {
 namespace Util {
 
-// copyTraceFiles:
+// extractMember: copies the container member 'srcFnm' to the file
+// 'dstFnm'.  Returns false on failure.
+static bool
+extractMember(const string& dstFnm, const string& srcFnm)
+{
+  FILE* infs = hpcio_container_member_fopen_r(srcFnm.c_str());
+  if (!infs) {
+    return false;
+  }
+  FILE* outfs = hpcio_fopen_w(dstFnm.c_str(), 1/*overwrite*/);
+  if (!outfs) {
+    hpcio_fclose(infs);
+    return false;
+  }
+
+  bool ok = true;
+  char buf[64 * 1024];
+  size_t n;
+  while ((n = fread(buf, 1, sizeof(buf), infs)) > 0) {
+    if (fwrite(buf, 1, n, outfs) != n) {
+      ok = false;
+      break;
+    }
+  }
+  ok = ok && !ferror(infs);
+
+  hpcio_fclose(infs);
+  if (hpcio_fclose(outfs) != 0) {
+    ok = false;
+  }
+  if (!ok) {
+    unlink(dstFnm.c_str());
+  }
+  return ok;
+}
+
+
+// copyTraceFiles: N.B.: 'dstDir' is a fresh database directory, so an
+// existing trace file there was already rewritten by a
+// Prof::CallPath::TraceRemapper and is kept.
 void
 copyTraceFiles(const std::string& dstDir, const std::set<string>& srcFiles)
 {
@@ -617,14 +872,20 @@ copyTraceFiles(const std::string& dstDir, const std::set<string>& srcFiles)
 
     const string  srcFnm1 = x + "." + HPCPROF_TmpFnmSfx;
     const string& srcFnm2 = x;
-    const string  dstFnm = dstDir + "/" + FileUtil::basename(x);
+    const char*   mbrNm = hpcio_container_member_name(x.c_str());
+    const string  dstFnm = dstDir + "/"
+      + ((mbrNm) ? string(mbrNm) : FileUtil::basename(x));
 
     // Note: the source and destination directories may be on
     // different mount points.  For the trace.tmp files, we try move
     // first (faster), if that fails, try copy and delete.  If any
     // move fails, then always copy (so only one failed move).
 
-    if (FileUtil::isReadable(srcFnm1)) {
+    if (FileUtil::isReadable(dstFnm)) {
+      // already remapped into the database
+      continue;
+    }
+    else if (FileUtil::isReadable(srcFnm1)) {
       // trace.tmp exists: try move, then copy and delete
       bool copyDone = false;
       if (tryMove) {
@@ -650,6 +911,14 @@ copyTraceFiles(const std::string& dstDir, const std::set<string>& srcFiles)
 	}
       }
     }
+    else if (mbrNm) {
+      // container member: extract it (keep the container)
+      DIAG_Msg(2, "trace (extract): '" << srcFnm2 << "' -> '" << dstFnm << "'");
+      if (!extractMember(dstFnm, srcFnm2)) {
+	DIAG_EMsg("While extracting trace files ['"
+		  << srcFnm2 << "' -> '" << dstFnm << "']");
+      }
+    }
     else {
       // no trace.tmp file: always copy (keep original)
       try {
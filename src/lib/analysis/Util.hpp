@@ -139,9 +139,23 @@ public:
 };
 
 
+// normalizeProfileArgs: the profile files in 'inPaths' (files,
+//   directories or output containers).  Of the snapshots that hpcrun
+//   wrote of a thread's profile, only the ones to be merged into it
+//   are kept, next to the profile (cf. profileThreadEnd).
 NormalizeProfileArgs_t
 normalizeProfileArgs(const StringVec& inPaths);
 
+// profileBasePath: the path that the files of one thread's profile
+//   share: 'path' without ".hpcrun" and any snapshot infix.
+std::string
+profileBasePath(const std::string& path);
+
+// profileThreadEnd: the end of the files of the thread whose first
+//   file in 'paths' (from normalizeProfileArgs) is at 'beg'.
+uint
+profileThreadEnd(const StringVec& paths, uint beg);
+
 
 // --------------------------------------------------------------------------
 //
@@ -0,0 +1,240 @@
+// -*-Mode: C++;-*- // technically C99
+
+// * BeginRiceCopyright *****************************************************
+//
+// $HeadURL$
+// $Id$
+//
+// --------------------------------------------------------------------------
+// Part of HPCToolkit (hpctoolkit.org)
+//
+// Information about sources of support for research and development of
+// HPCToolkit is at 'hpctoolkit.org' and in 'README.Acknowledgments'.
+// --------------------------------------------------------------------------
+//
+// Copyright ((c)) 2002-2020, Rice University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+//
+// * Neither the name of Rice University (RICE) nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+//
+// This software is provided by RICE and contributors "as is" and any
+// express or implied warranties, including, but not limited to, the
+// implied warranties of merchantability and fitness for a particular
+// purpose are disclaimed. In no event shall RICE or contributors be
+// liable for any direct, indirect, incidental, special, exemplary, or
+// consequential damages (including, but not limited to, procurement of
+// substitute goods or services; loss of use, data, or profits; or
+// business interruption) however caused and on any theory of liability,
+// whether in contract, strict liability, or tort (including negligence
+// or otherwise) arising in any way out of the use of this software, even
+// if advised of the possibility of such damage.
+//
+// ******************************************************* EndRiceCopyright *
+//***************************************************************************
+//
+// File:
+//   hpcio-buffer_test.c
+//
+// Purpose:
+//   Exercises the background writer of hpcio-buffer (HPCIO_OUTBUF_ASYNC)
+//   and the order of hpcio_outbuf_async_stop() and closing outbufs.
+//
+// Description:
+//   Threads write sequence numbers through outbufs that share a small
+//   pool, so both the queued and the synchronous paths run.  Half of
+//   the outbufs write to a file descriptor, half through a writer
+//   function.  In the second round, the writer is stopped while the
+//   threads are still writing; every close must return and every
+//   output must hold the complete sequence.  Build with
+//
+//     cc -std=gnu99 -I<src> -I<src>/include -I<src>/lib
+//        hpcio-buffer_test.c ../hpcio-buffer.c ../producer_wfq.c
+//        -lpthread
+//
+//***************************************************************************
+
+#undef NDEBUG
+
+#include <assert.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <lib/prof-lean/hpcfmt.h>
+#include <lib/prof-lean/hpcio-buffer.h>
+#include <lib/prof-lean/stdatomic.h>
+
+#define BUF_SIZE     4096
+#define NUM_BUFS     4
+#define NUM_THREADS  8
+#define NUM_VALUES   200000
+
+// a writer function's destination: a growing memory image
+typedef struct image_s {
+  pthread_mutex_t lock;
+  char *data;
+  size_t len;
+} image_t;
+
+typedef struct thread_arg_s {
+  int  id;
+  int  use_writer;
+  char fnm[64];
+  image_t image;
+} thread_arg_t;
+
+static atomic_int num_written = ATOMIC_VAR_INIT(0);
+
+
+static void *
+test_alloc(size_t size)
+{
+  return malloc(size);
+}
+
+
+static ssize_t
+image_write(void *arg, const void *data, size_t size)
+{
+  image_t *image = (image_t *) arg;
+
+  pthread_mutex_lock(&image->lock);
+  image->data = realloc(image->data, image->len + size);
+  memcpy(image->data + image->len, data, size);
+  image->len += size;
+  pthread_mutex_unlock(&image->lock);
+  return size;
+}
+
+
+static void
+check_sequence(const char *data, size_t len)
+{
+  assert(len == NUM_VALUES * sizeof(uint32_t));
+  for (uint32_t i = 0; i < NUM_VALUES; i++) {
+    uint32_t x;
+    memcpy(&x, data + i * sizeof(x), sizeof(x));
+    assert(x == i);
+  }
+}
+
+
+static void *
+test_thread(void *p)
+{
+  thread_arg_t *arg = (thread_arg_t *) p;
+  int flags = HPCIO_OUTBUF_UNLOCKED | HPCIO_OUTBUF_ASYNC;
+  hpcio_outbuf_t *outbuf;
+  int ret;
+
+  if (arg->use_writer) {
+    pthread_mutex_init(&arg->image.lock, NULL);
+    arg->image.data = NULL;
+    arg->image.len = 0;
+    ret = hpcio_outbuf_attach_writer(&outbuf, image_write, &arg->image,
+				     malloc(BUF_SIZE), BUF_SIZE, flags,
+				     test_alloc);
+  }
+  else {
+    int fd = open(arg->fnm, O_CREAT | O_TRUNC | O_WRONLY, 0644);
+    assert(fd >= 0);
+    ret = hpcio_outbuf_attach(&outbuf, fd, malloc(BUF_SIZE), BUF_SIZE,
+			      flags, test_alloc);
+  }
+  assert(ret == HPCFMT_OK);
+
+  for (uint32_t i = 0; i < NUM_VALUES; i++) {
+    assert(hpcio_outbuf_write(outbuf, &i, sizeof(i)) == sizeof(i));
+    if (i == NUM_VALUES / 2) {
+      atomic_fetch_add(&num_written, 1);
+    }
+  }
+  assert(hpcio_outbuf_close(&outbuf) == HPCFMT_OK);
+
+  if (arg->use_writer) {
+    check_sequence(arg->image.data, arg->image.len);
+    free(arg->image.data);
+  }
+  else {
+    FILE *f = fopen(arg->fnm, "r");
+    char *data = malloc(NUM_VALUES * sizeof(uint32_t) + 1);
+    size_t len = fread(data, 1, NUM_VALUES * sizeof(uint32_t) + 1, f);
+    fclose(f);
+    check_sequence(data, len);
+    free(data);
+    unlink(arg->fnm);
+  }
+  return NULL;
+}
+
+
+// Run NUM_THREADS writers; if 'stop_early', stop the background
+// writer once they are half done.
+static void
+run_round(int stop_early)
+{
+  thread_arg_t args[NUM_THREADS];
+  pthread_t threads[NUM_THREADS];
+  pthread_t writer;
+
+  assert(hpcio_outbuf_async_init(NUM_BUFS, BUF_SIZE, test_alloc)
+	 == HPCFMT_OK);
+  assert(pthread_create(&writer, NULL, hpcio_outbuf_async_writer, NULL) == 0);
+
+  atomic_store(&num_written, 0);
+  for (int i = 0; i < NUM_THREADS; i++) {
+    args[i].id = i;
+    args[i].use_writer = i % 2;
+    snprintf(args[i].fnm, sizeof(args[i].fnm), "/tmp/hpcio-buffer-%d-%d",
+	     (int) getpid(), i);
+    assert(pthread_create(&threads[i], NULL, test_thread, &args[i]) == 0);
+  }
+
+  if (stop_early) {
+    while (atomic_load(&num_written) < NUM_THREADS / 2) {
+      sched_yield();
+    }
+    hpcio_outbuf_async_stop();
+    pthread_join(writer, NULL);
+  }
+  for (int i = 0; i < NUM_THREADS; i++) {
+    pthread_join(threads[i], NULL);
+  }
+  if (! stop_early) {
+    hpcio_outbuf_async_stop();
+    pthread_join(writer, NULL);
+  }
+
+  printf("%s: %d threads x %d values ok\n",
+	 stop_early ? "stop while writing" : "stop after close",
+	 NUM_THREADS, NUM_VALUES);
+}
+
+
+int
+main(int argc, char **argv)
+{
+  // a hang (eg, close waiting on a stopped writer) fails the test
+  alarm(120);
+
+  run_round(0);
+  run_round(1);
+  return 0;
+}
@@ -71,6 +71,16 @@
 //
 // Deserves further study: the best way to handle errors from write().
 //
+// With HPCIO_OUTBUF_ASYNC, a full buffer is exchanged for an empty one
+// from a fixed pool and queued (lock free) for a background writer
+// thread, so the caller, often a signal handler, does not wait for
+// the file system.  Only when the pool is exhausted does the caller
+// write synchronously.  For a file descriptor, every write is a
+// pwrite() at an offset reserved when the buffer is queued, so the
+// two paths may overlap.  An outbuf with a writer function instead
+// waits for its queued buffers before writing synchronously, because
+// the writer decides where the data goes.
+//
 //***************************************************************************
 
 //************************* System Include Files ****************************
@@ -79,6 +89,8 @@
 #include <sys/stat.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <sched.h>
+#include <semaphore.h>
 #include <string.h>
 #include <unistd.h>
 
@@ -87,7 +99,9 @@
 
 #include "hpcfmt.h"
 #include "hpcio-buffer.h"
+#include "producer_wfq.h"
 #include "spinlock.h"
+#include "stdatomic.h"
 #include <include/min-max.h>
 
 #define HPCIO_OUTBUF_MAGIC  0x494F4246
@@ -105,12 +119,31 @@ typedef struct hpcio_outbuf_s {
   size_t buf_size;
   size_t in_use;
   int  fd;
+  hpcio_outbuf_writer_t *writer;
+  void *writer_arg;
   int  flags;
   char use_lock;
+  char use_async;
+  off_t offset;            // next file offset, if use_async with an fd
+  atomic_long pending;     // buffers queued for the background writer
+  atomic_int async_err;
   spinlock_t lock;
 } hpcio_outbuf_t;
 
 
+// A full buffer queued for the background writer.  There is one per
+// pool buffer; 'buf' is whichever buffer that slot currently holds.
+
+typedef struct outbuf_job_s {
+  producer_wfq_element_ptr_t next; // must be first
+  int    slot;
+  void   *buf;
+  hpcio_outbuf_t *outbuf;
+  size_t len;
+  off_t  offset;
+} outbuf_job_t;
+
+
 
 //***************************************************************************
 // variables
@@ -119,6 +152,20 @@ typedef struct hpcio_outbuf_s {
 static spinlock_t freelist_lock = SPINLOCK_UNLOCKED;
 static hpcio_outbuf_t *freelist = 0;
 
+// 'active' is cleared by hpcio_outbuf_async_stop(); 'producers'
+// counts the flushes that may still queue a buffer, so stop can wait
+// for them before the writer's final pass over the queue.
+static struct {
+  atomic_int active;
+  atomic_int producers;
+  size_t buf_size;
+  outbuf_job_t *jobs;
+  atomic_uint_least64_t free_slots; // bit i set: jobs[i] is free
+  producer_wfq_t queue;
+  sem_t wakeup;
+  atomic_int stop;
+} async;
+
 
 
 //*************************** Private Functions *****************************
@@ -167,6 +214,91 @@ outbuf_free
 }
 
 
+static ssize_t
+outbuf_write_data(hpcio_outbuf_t *outbuf, const void *data, size_t size)
+{
+  if (outbuf->writer != NULL) {
+    return outbuf->writer(outbuf->writer_arg, data, size);
+  }
+  if (outbuf->use_async) {
+    ssize_t ret = pwrite(outbuf->fd, data, size, outbuf->offset);
+    if (ret > 0) {
+      outbuf->offset += ret;
+    }
+    return ret;
+  }
+  return write(outbuf->fd, data, size);
+}
+
+
+// Wait until the background writer has written all of the outbuf's
+// queued buffers.
+static void
+outbuf_drain(hpcio_outbuf_t *outbuf)
+{
+  while (atomic_load(&outbuf->pending) > 0) {
+    sched_yield();
+  }
+}
+
+
+// Take a free slot of the pool, or return -1 if there is none.
+static int
+async_slot_get(void)
+{
+  uint64_t slots = atomic_load(&async.free_slots);
+  while (slots != 0) {
+    int i = __builtin_ctzll(slots);
+    if (atomic_compare_exchange_weak(&async.free_slots, &slots,
+				     slots & ~((uint64_t) 1 << i))) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+
+static void
+async_slot_put(int i)
+{
+  atomic_fetch_or(&async.free_slots, (uint64_t) 1 << i);
+}
+
+
+// Write one queued buffer (in the background writer).
+static void
+async_job_write(outbuf_job_t *job)
+{
+  hpcio_outbuf_t *outbuf = job->outbuf;
+  size_t amt_done = 0;
+  ssize_t ret;
+
+  while (amt_done < job->len) {
+    errno = 0;
+    if (outbuf->writer != NULL) {
+      ret = outbuf->writer(outbuf->writer_arg, (char *) job->buf + amt_done,
+			   job->len - amt_done);
+    }
+    else {
+      ret = pwrite(outbuf->fd, (char *) job->buf + amt_done,
+		   job->len - amt_done, job->offset + amt_done);
+    }
+    if (ret > 0) {
+      amt_done += ret;
+    }
+    else if (errno != EINTR) {
+      // the data is lost; report it at close
+      atomic_store(&outbuf->async_err, 1);
+      break;
+    }
+  }
+
+  // Don't touch the outbuf after 'pending' drops, it may be closed.
+  async_slot_put(job->slot);
+  atomic_fetch_sub(&outbuf->pending, 1);
+}
+
+
 // Try to write() the entire outbuf.
 //
 // Returns: HPCFMT_OK if the entire buffer was successfully written,
@@ -180,8 +312,8 @@ outbuf_flush_buffer(hpcio_outbuf_t *outbuf)
   amt_done = 0;
   while (amt_done < outbuf->in_use) {
     errno = 0;
-    ret = write(outbuf->fd, outbuf->buf_start + amt_done,
-		outbuf->in_use - amt_done);
+    ret = outbuf_write_data(outbuf, outbuf->buf_start + amt_done,
+			    outbuf->in_use - amt_done);
 
     // Check for short writes.  Note: EINTR is not failure.
     if (ret > 0 || (ret == 0 && errno == EINTR)) {
@@ -209,6 +341,79 @@ outbuf_flush_buffer(hpcio_outbuf_t *outbuf)
 }
 
 
+// Flush a full outbuf: queue it for the background writer if it can,
+// else write() it as above.
+//
+// Returns: HPCFMT_OK if the buffer was queued or written, else
+// HPCFMT_ERR.
+//
+static int
+outbuf_flush_full(hpcio_outbuf_t *outbuf)
+{
+  if (! outbuf->use_async || outbuf->in_use == 0) {
+    return outbuf_flush_buffer(outbuf);
+  }
+
+  // Announce the flush before checking 'active' (both seq_cst): either
+  // stop sees this producer and waits for it, or we see the writer
+  // stopped and write synchronously.
+  atomic_fetch_add(&async.producers, 1);
+  int slot = (atomic_load(&async.active)) ? async_slot_get() : -1;
+  if (slot < 0) {
+    atomic_fetch_sub(&async.producers, 1);
+
+    // pool exhausted (or writer stopped)
+    if (outbuf->writer != NULL) {
+      outbuf_drain(outbuf);
+    }
+    return outbuf_flush_buffer(outbuf);
+  }
+
+  // exchange the full buffer for the slot's empty one
+  outbuf_job_t *job = &async.jobs[slot];
+  void *full = outbuf->buf_start;
+  outbuf->buf_start = job->buf;
+  job->buf = full;
+  job->outbuf = outbuf;
+  job->len = outbuf->in_use;
+  job->offset = outbuf->offset;
+  outbuf->offset += outbuf->in_use;
+  outbuf->in_use = 0;
+
+  atomic_fetch_add(&outbuf->pending, 1);
+  producer_wfq_enqueue(&async.queue, (producer_wfq_element_t *) job);
+  sem_post(&async.wakeup);
+  atomic_fetch_sub(&async.producers, 1);
+
+  return HPCFMT_OK;
+}
+
+
+// Prepare an outbuf with HPCIO_OUTBUF_ASYNC for the background
+// writer, if it is running and has buffers of the outbuf's size.
+static void
+outbuf_async_attach(hpcio_outbuf_t *outbuf)
+{
+  outbuf->use_async = 0;
+  outbuf->offset = 0;
+  atomic_store(&outbuf->pending, 0);
+  atomic_store(&outbuf->async_err, 0);
+
+  if (! (outbuf->flags & HPCIO_OUTBUF_ASYNC) || ! atomic_load(&async.active)
+      || outbuf->buf_size != async.buf_size) {
+    return;
+  }
+  if (outbuf->writer == NULL) {
+    off_t offset = lseek(outbuf->fd, 0, SEEK_CUR);
+    if (offset < 0) {
+      return;
+    }
+    outbuf->offset = offset;
+  }
+  outbuf->use_async = 1;
+}
+
+
 //*************************** Interface Functions ***************************
 
 // Attach the file descriptor to the buffer, initialize and fill in
@@ -241,8 +446,57 @@ hpcio_outbuf_attach
   outbuf->buf_size = buf_size;
   outbuf->in_use = 0;
   outbuf->fd = fd;
+  outbuf->writer = NULL;
+  outbuf->writer_arg = NULL;
+  outbuf->flags = flags;
+  outbuf->use_lock = (flags & HPCIO_OUTBUF_LOCKED);
+  outbuf_async_attach(outbuf);
+  spinlock_unlock(&outbuf->lock);
+
+  *outbuf_ptr = outbuf;
+
+  return HPCFMT_OK;
+}
+
+
+// Like hpcio_outbuf_attach(), but the outbuf is flushed by calling
+// 'writer' instead of write()ing to a file descriptor.  This lets
+// several outbufs share one file, eg, segments of an output container.
+// Close does not close anything; the client owns whatever 'writer_arg'
+// refers to.
+//
+// Returns: HPCFMT_OK on success, else HPCFMT_ERR.
+//
+int
+hpcio_outbuf_attach_writer
+(
+  hpcio_outbuf_t **outbuf_ptr /* out */, 
+  hpcio_outbuf_writer_t *writer,
+  void *writer_arg,
+  void *buf_start, 
+  size_t buf_size, 
+  int flags,
+  allocator_t alloc
+)
+{
+  if (outbuf_ptr == NULL || writer == NULL || buf_start == NULL
+      || buf_size == 0) {
+    return HPCFMT_ERR;
+  }
+
+  hpcio_outbuf_t *outbuf = outbuf_alloc(alloc);
+
+  outbuf->next = NULL;
+  outbuf->magic = HPCIO_OUTBUF_MAGIC;
+  outbuf->buf_start = buf_start;
+  outbuf->buf_size = buf_size;
+  outbuf->in_use = 0;
+  outbuf->fd = -1;
+  outbuf->writer = writer;
+  outbuf->writer_arg = writer_arg;
   outbuf->flags = flags;
   outbuf->use_lock = (flags & HPCIO_OUTBUF_LOCKED);
+  outbuf_async_attach(outbuf);
   spinlock_unlock(&outbuf->lock);
 
   *outbuf_ptr = outbuf;
@@ -271,7 +525,7 @@ hpcio_outbuf_write(hpcio_outbuf_t *outbuf, const void *data, size_t size)
   while (amt_done < size) {
     // flush if needed
     if (size > outbuf->buf_size - outbuf->in_use) {
-      outbuf_flush_buffer(outbuf);
+      outbuf_flush_full(outbuf);
       if (outbuf->in_use == outbuf->buf_size) {
 	// flush failed, no space
 	break;
@@ -306,6 +560,7 @@ hpcio_outbuf_flush(hpcio_outbuf_t *outbuf)
     spinlock_lock(&outbuf->lock);
   }
 
+  outbuf_drain(outbuf);
   int ret = outbuf_flush_buffer(outbuf);
 
   if (outbuf->use_lock) {
@@ -315,9 +570,9 @@ hpcio_outbuf_flush(hpcio_outbuf_t *outbuf)
 }
 
 
-// Flush the outbuf and close() the file descriptor.  Note: the client
-// must explicitly call close at the end of the process.  There is no
-// auto close.
+// Flush the outbuf and close() the file descriptor, if it has one.
+// Note: the client must explicitly call close at the end of the
+// process.  There is no auto close.
 //
 // Returns: HPCFMT_OK on success, else HPCFMT_ERR.
 //
@@ -335,8 +590,10 @@ hpcio_outbuf_close(hpcio_outbuf_t **outbuf_ptr)
     spinlock_lock(&outbuf->lock);
   }
 
+  outbuf_drain(outbuf);
   if (outbuf_flush_buffer(outbuf) == HPCFMT_OK
-      && close(outbuf->fd) == 0) {
+      && atomic_load(&outbuf->async_err) == 0
+      && (outbuf->writer != NULL || close(outbuf->fd) == 0)) {
     // flush and close both succeed
     outbuf->magic = 0;
     outbuf->fd = -1;
@@ -355,3 +612,142 @@ hpcio_outbuf_close(hpcio_outbuf_t **outbuf_ptr)
 
   return ret;
 }
+
+
+// Flush the outbuf and release it, but leave the file descriptor
+// open.  This lets a client that otherwise writes through stdio (and
+// has fflush()ed its stream) write a large section of a file through
+// the outbuf and then resume with stdio.
+//
+// Returns: HPCFMT_OK on success, else HPCFMT_ERR.
+//
+int
+hpcio_outbuf_detach(hpcio_outbuf_t **outbuf_ptr)
+{
+  int ret;
+
+  hpcio_outbuf_t *outbuf = *outbuf_ptr;
+
+  if (outbuf == NULL || outbuf->magic != HPCIO_OUTBUF_MAGIC) {
+    return HPCFMT_ERR;
+  }
+  if (outbuf->use_lock) {
+    spinlock_lock(&outbuf->lock);
+  }
+
+  outbuf_drain(outbuf);
+  ret = outbuf_flush_buffer(outbuf);
+  if (atomic_load(&outbuf->async_err) != 0) {
+    ret = HPCFMT_ERR;
+  }
+  if (outbuf->use_async && outbuf->writer == NULL) {
+    // pwrite() does not move the file offset
+    lseek(outbuf->fd, outbuf->offset, SEEK_SET);
+  }
+  outbuf->magic = 0;
+  outbuf->fd = -1;
+
+  if (outbuf->use_lock) {
+    spinlock_unlock(&outbuf->lock);
+  }
+
+  outbuf_free(*outbuf_ptr);
+
+  *outbuf_ptr = NULL;
+
+  return ret;
+}
+
+
+// Set up the background writer's pool of 'num_bufs' buffers (at most
+// HPCIO_OUTBUF_ASYNC_MAX_BUFS) of 'buf_size' bytes.  Only outbufs of
+// that size use it.  Call this once per process (again in a forked
+// child), before attaching the outbufs and starting the writer thread.
+//
+// Returns: HPCFMT_OK on success, else HPCFMT_ERR.
+//
+int
+hpcio_outbuf_async_init(size_t num_bufs, size_t buf_size, allocator_t alloc)
+{
+  int i;
+
+  atomic_store(&async.active, 0);
+  atomic_store(&async.producers, 0);
+  if (num_bufs == 0 || num_bufs > HPCIO_OUTBUF_ASYNC_MAX_BUFS
+      || buf_size == 0) {
+    return HPCFMT_ERR;
+  }
+
+  async.jobs = (outbuf_job_t *) alloc(num_bufs * sizeof(outbuf_job_t));
+  if (async.jobs == NULL) {
+    return HPCFMT_ERR;
+  }
+  for (i = 0; i < num_bufs; i++) {
+    async.jobs[i].slot = i;
+    async.jobs[i].buf = alloc(buf_size);
+    if (async.jobs[i].buf == NULL) {
+      return HPCFMT_ERR;
+    }
+  }
+  if (sem_init(&async.wakeup, 0, 0) != 0) {
+    return HPCFMT_ERR;
+  }
+
+  async.buf_size = buf_size;
+  atomic_store(&async.free_slots, (num_bufs == HPCIO_OUTBUF_ASYNC_MAX_BUFS) ? ~(uint64_t) 0
+	       : ((uint64_t) 1 << num_bufs) - 1);
+  producer_wfq_init(&async.queue);
+  atomic_store(&async.stop, 0);
+  atomic_store(&async.active, 1);
+
+  return HPCFMT_OK;
+}
+
+
+// The body of the background writer thread: write queued buffers
+// until stopped, then write whatever is still queued, so every
+// outbuf's pending count reaches 0.  The thread should block all
+// signals.
+void *
+hpcio_outbuf_async_writer(void *arg)
+{
+  outbuf_job_t *job;
+
+  for (;;) {
+    while (sem_wait(&async.wakeup) != 0 && errno == EINTR)
+      ;
+
+    while ((job = (outbuf_job_t *) producer_wfq_dequeue(&async.queue))
+	   != NULL) {
+      async_job_write(job);
+    }
+    if (atomic_load(&async.stop)) {
+      // every buffer was queued before 'stop' was set
+      while ((job = (outbuf_job_t *) producer_wfq_dequeue(&async.queue))
+	     != NULL) {
+	async_job_write(job);
+      }
+      break;
+    }
+  }
+  return NULL;
+}
+
+
+// Make the background writer return once the queue is empty.  Flushes
+// from now on write synchronously; stop waits for the ones already
+// queueing a buffer, so none is queued after the writer's final pass.
+// The client then joins the writer thread, after which no outbuf has
+// pending buffers.
+void
+hpcio_outbuf_async_stop(void)
+{
+  if (! atomic_exchange(&async.active, 0)) {
+    return;
+  }
+  while (atomic_load(&async.producers) > 0) {
+    sched_yield();
+  }
+  atomic_store(&async.stop, 1);
+  sem_post(&async.wakeup);
+}
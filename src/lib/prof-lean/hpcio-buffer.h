@@ -57,6 +57,13 @@
 
 typedef struct hpcio_outbuf_s hpcio_outbuf_t;
 
+// Writer for an outbuf that is not backed by a file descriptor (see
+// hpcio_outbuf_attach_writer).  Like write(2), returns the number of
+// bytes written, or -1 on error.  Must be safe inside signal handlers
+// when the outbuf is.
+
+typedef ssize_t hpcio_outbuf_writer_t(void *arg, const void *data, size_t size);
+
 //***************************************************************************
 
 // Flags for hpcio_outbuf_attach().
@@ -64,6 +71,15 @@ typedef struct hpcio_outbuf_s hpcio_outbuf_t;
 #define HPCIO_OUTBUF_LOCKED    0x1
 #define HPCIO_OUTBUF_UNLOCKED  0x2
 
+// Hand full buffers to the background writer (see
+// hpcio_outbuf_async_init), if it is running, instead of writing
+// them in the caller.
+#define HPCIO_OUTBUF_ASYNC     0x4
+
+// Maximum number of buffers in the background writer's pool.
+
+#define HPCIO_OUTBUF_ASYNC_MAX_BUFS  64
+
 #if defined(__cplusplus)
 extern "C" {
 #endif
@@ -80,6 +96,19 @@ hpcio_outbuf_attach
 );
 
 
+int
+hpcio_outbuf_attach_writer
+(
+  hpcio_outbuf_t **outbuf /* out */, 
+  hpcio_outbuf_writer_t *writer,
+  void *writer_arg,
+  void *buf_start, 
+  size_t buf_size, 
+  int flags,
+  allocator_t alloc
+);
+
+
 ssize_t
 hpcio_outbuf_write
 (
@@ -103,6 +132,40 @@ hpcio_outbuf_close
 );
 
 
+int
+hpcio_outbuf_detach
+(
+  hpcio_outbuf_t **outbuf
+);
+
+
+// Background writer.  The client creates one thread that runs
+// hpcio_outbuf_async_writer(), which returns after
+// hpcio_outbuf_async_stop().
+
+int
+hpcio_outbuf_async_init
+(
+  size_t num_bufs,
+  size_t buf_size,
+  allocator_t alloc
+);
+
+
+void *
+hpcio_outbuf_async_writer
+(
+  void *arg
+);
+
+
+void
+hpcio_outbuf_async_stop
+(
+  void
+);
+
+
 #if defined(__cplusplus)
 }
 #endif
@@ -0,0 +1,543 @@
+// -*-Mode: C++;-*- // technically C99
+
+// * BeginRiceCopyright *****************************************************
+//
+// $HeadURL$
+// $Id$
+//
+// --------------------------------------------------------------------------
+// Part of HPCToolkit (hpctoolkit.org)
+//
+// Information about sources of support for research and development of
+// HPCToolkit is at 'hpctoolkit.org' and in 'README.Acknowledgments'.
+// --------------------------------------------------------------------------
+//
+// Copyright ((c)) 2002-2020, Rice University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+//
+// * Neither the name of Rice University (RICE) nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+//
+// This software is provided by RICE and contributors "as is" and any
+// express or implied warranties, including, but not limited to, the
+// implied warranties of merchantability and fitness for a particular
+// purpose are disclaimed. In no event shall RICE or contributors be
+// liable for any direct, indirect, incidental, special, exemplary, or
+// consequential damages (including, but not limited to, procurement of
+// substitute goods or services; loss of use, data, or profits; or
+// business interruption) however caused and on any theory of liability,
+// whether in contract, strict liability, or tort (including negligence
+// or otherwise) arising in any way out of the use of this software, even
+// if advised of the possibility of such damage.
+//
+// ******************************************************* EndRiceCopyright *
+
+//***************************************************************************
+//
+// File:
+//   $HeadURL$
+//
+// Purpose:
+//   Read the members of an hpcrun output container as if they were
+//   files.  See header for interface information.
+//
+//***************************************************************************
+
+//************************* System Include Files ****************************
+
+#ifndef _GNU_SOURCE
+#  define _GNU_SOURCE // fopencookie()
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+
+#include <errno.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+
+//*************************** User Include Files ****************************
+
+#include "hpcio.h"
+#include "hpcio-container.h"
+#include "hpcfmt.h"
+#include "hpcrun-fmt.h"
+
+
+//***************************************************************************
+// type declarations
+//***************************************************************************
+
+// a reading stream over the Data segments of one member
+typedef struct member_stream_s {
+  FILE* fs;                     // the container
+  hpccontainer_fmt_seg_t* segs; // the member's Data segments
+  uint32_t numSegs;
+  uint64_t size;                // sum of the segment lengths
+
+  uint32_t cur;                 // current segment
+  uint64_t curPos;              // position within the current segment
+  uint64_t pos;                 // position within the member
+} member_stream_t;
+
+
+// a member of a loaded container
+typedef struct container_member_s {
+  char* name;
+  uint32_t memberId;
+  uint32_t segBeg;              // its Data segments in 'dataSegs'
+  uint32_t segEnd;
+} container_member_t;
+
+
+// The index of a container, loaded once: its members sorted by name
+// and their Data segments grouped by member.  'fnm', 'dev', 'ino',
+// 'size' and 'mtime' identify the file it was loaded from.
+typedef struct container_index_s {
+  char* fnm;
+  dev_t dev;
+  ino_t ino;
+  off_t size;
+  struct timespec mtime;
+
+  container_member_t* members;  // by name
+  uint32_t numMembers;
+  container_member_t** closeOrder; // in the order they were closed
+  hpccontainer_fmt_seg_t* dataSegs; // by member, then offset
+  uint32_t numDataSegs;
+} container_index_t;
+
+
+// recently loaded container indices, most recent first
+#define CONTAINER_CACHE_LEN 8
+
+static container_index_t* container_cache[CONTAINER_CACHE_LEN];
+
+
+//*************************** Private Functions *****************************
+
+static void*
+container_alloc(size_t nbytes)
+{
+  return malloc(nbytes > 0 ? nbytes : 1);
+}
+
+
+// Returns the offset of the member separator in 'path', if any: the
+// '#' that follows the container's file name suffix.
+static const char*
+member_sep(const char* path)
+{
+  static const size_t sfxLen = sizeof(HPCRUN_ContainerFnmSfx) - 1;
+
+  const char* sep = NULL;
+  for (const char* p = strchr(path, HPCIO_ContainerMemberSep); p;
+       p = strchr(p + 1, HPCIO_ContainerMemberSep)) {
+    if ((size_t)(p - path) > sfxLen && p[-sfxLen - 1] == '.'
+	&& strncmp(p - sfxLen, HPCRUN_ContainerFnmSfx, sfxLen) == 0) {
+      sep = p;
+    }
+  }
+  return sep;
+}
+
+
+static int
+member_cmp(const void* a, const void* b)
+{
+  return strcmp(((const container_member_t*)a)->name,
+		((const container_member_t*)b)->name);
+}
+
+
+static int
+data_seg_cmp(const void* a, const void* b)
+{
+  const hpccontainer_fmt_seg_t* x = (const hpccontainer_fmt_seg_t*)a;
+  const hpccontainer_fmt_seg_t* y = (const hpccontainer_fmt_seg_t*)b;
+  if (x->memberId != y->memberId) {
+    return (x->memberId < y->memberId) ? -1 : 1;
+  }
+  if (x->offset != y->offset) {
+    return (x->offset < y->offset) ? -1 : 1;
+  }
+  return 0;
+}
+
+
+static void
+container_index_free(container_index_t* idx)
+{
+  if (!idx) {
+    return;
+  }
+  for (uint32_t i = 0; i < idx->numMembers; ++i) {
+    free(idx->members[i].name);
+  }
+  free(idx->members);
+  free(idx->closeOrder);
+  free(idx->dataSegs);
+  free(idx->fnm);
+  free(idx);
+}
+
+
+// Reads the segment table and member names of container 'fs' (file
+// 'fnm', described by 'st').  Returns NULL if it is not a container.
+static container_index_t*
+container_index_load(const char* fnm, const struct stat* st, FILE* fs)
+{
+  hpccontainer_fmt_seg_t* segs = NULL;
+  uint32_t numSegs = 0;
+  if (hpccontainer_fmt_segs_fread(&segs, &numSegs, fs, container_alloc)
+      != HPCFMT_OK) {
+    free(segs);
+    return NULL;
+  }
+
+  container_index_t* idx =
+    (container_index_t*) container_alloc(sizeof(*idx));
+  memset(idx, 0, sizeof(*idx));
+  idx->fnm = strdup(fnm);
+  idx->dev = st->st_dev;
+  idx->ino = st->st_ino;
+  idx->size = st->st_size;
+  idx->mtime = st->st_mtim;
+
+  idx->members =
+    (container_member_t*) container_alloc(numSegs * sizeof(container_member_t));
+  idx->dataSegs = segs; // compacted in place below
+
+  for (uint32_t i = 0; i < numSegs; ++i) {
+    if (segs[i].kind == HPCCONTAINER_FMT_SegName) {
+      char* nm = NULL;
+      if (hpccontainer_fmt_name_fread(&nm, &segs[i], fs, container_alloc)
+	  != HPCFMT_OK) {
+	free(nm);
+	continue;
+      }
+      container_member_t* m = &idx->members[idx->numMembers++];
+      m->name = nm;
+      m->memberId = segs[i].memberId;
+      m->segBeg = m->segEnd = 0;
+    }
+    else if (segs[i].kind == HPCCONTAINER_FMT_SegData) {
+      segs[idx->numDataSegs++] = segs[i];
+    }
+  }
+
+  // group Data segments by member, keeping each member's in order
+  qsort(idx->dataSegs, idx->numDataSegs, sizeof(hpccontainer_fmt_seg_t),
+	data_seg_cmp);
+
+  // sort members by name, remembering the order they were closed in
+  // (segBeg holds it until the segment ranges are set below)
+  for (uint32_t i = 0; i < idx->numMembers; ++i) {
+    idx->members[i].segBeg = i;
+  }
+  qsort(idx->members, idx->numMembers, sizeof(container_member_t),
+	member_cmp);
+
+  idx->closeOrder = (container_member_t**)
+    container_alloc(idx->numMembers * sizeof(container_member_t*));
+  for (uint32_t i = 0; i < idx->numMembers; ++i) {
+    idx->closeOrder[idx->members[i].segBeg] = &idx->members[i];
+  }
+
+  // each member's range of Data segments
+  for (uint32_t i = 0; i < idx->numMembers; ++i) {
+    container_member_t* m = &idx->members[i];
+    uint32_t lo = 0, hi = idx->numDataSegs;
+    while (lo < hi) {
+      uint32_t mid = lo + (hi - lo) / 2;
+      if (idx->dataSegs[mid].memberId < m->memberId) {
+	lo = mid + 1;
+      }
+      else {
+	hi = mid;
+      }
+    }
+    m->segBeg = m->segEnd = lo;
+    while (m->segEnd < idx->numDataSegs
+	   && idx->dataSegs[m->segEnd].memberId == m->memberId) {
+      m->segEnd++;
+    }
+  }
+
+  return idx;
+}
+
+
+// Returns the index of container 'fnm', loading it only if it is not
+// cached or the file has changed since.  Opens the container for
+// reading in '*fs' (if 'fs' is non-NULL).  Returns NULL if 'fnm' is
+// not a container.
+static container_index_t*
+container_index_get(const char* fnm, FILE** fs)
+{
+  FILE* f = hpcio_fopen_r(fnm);
+  if (!f) {
+    return NULL;
+  }
+
+  struct stat st;
+  if (fstat(fileno(f), &st) != 0) {
+    hpcio_fclose(f);
+    return NULL;
+  }
+
+  // look 'fnm' up, dropping a stale entry
+  container_index_t* idx = NULL;
+  int i = 0;
+  while (i < CONTAINER_CACHE_LEN && container_cache[i]
+	 && strcmp(container_cache[i]->fnm, fnm) != 0) {
+    ++i;
+  }
+  if (i == CONTAINER_CACHE_LEN) {
+    i = CONTAINER_CACHE_LEN - 1; // evict the least recent
+  }
+  container_index_t* c = container_cache[i];
+  if (c && strcmp(c->fnm, fnm) == 0
+      && c->dev == st.st_dev && c->ino == st.st_ino && c->size == st.st_size
+      && c->mtime.tv_sec == st.st_mtim.tv_sec
+      && c->mtime.tv_nsec == st.st_mtim.tv_nsec) {
+    idx = c;
+  }
+  else {
+    container_index_free(c);
+  }
+  for (int k = i; k < CONTAINER_CACHE_LEN - 1; ++k) {
+    container_cache[k] = container_cache[k + 1];
+  }
+  container_cache[CONTAINER_CACHE_LEN - 1] = NULL;
+
+  if (!idx) {
+    idx = container_index_load(fnm, &st, f);
+  }
+
+  // most recent first
+  if (idx) {
+    for (int k = CONTAINER_CACHE_LEN - 1; k > 0; --k) {
+      container_cache[k] = container_cache[k - 1];
+    }
+    container_cache[0] = idx;
+  }
+
+  if (idx && fs) {
+    *fs = f;
+  }
+  else {
+    hpcio_fclose(f);
+  }
+  return idx;
+}
+
+
+static ssize_t
+member_stream_read(void* cookie, char* buf, size_t size)
+{
+  member_stream_t* ms = (member_stream_t*) cookie;
+  size_t amt_done = 0;
+
+  while (amt_done < size && ms->cur < ms->numSegs) {
+    const hpccontainer_fmt_seg_t* seg = &ms->segs[ms->cur];
+    uint64_t avail = seg->len - ms->curPos;
+    if (avail == 0) {
+      ms->cur++;
+      ms->curPos = 0;
+      continue;
+    }
+
+    size_t amt = (avail < size - amt_done) ? avail : size - amt_done;
+    off_t off = seg->offset + HPCCONTAINER_FMT_SegHdrLen + ms->curPos;
+    ssize_t ret = pread(fileno(ms->fs), buf + amt_done, amt, off);
+    if (ret < 0 && errno == EINTR) {
+      continue;
+    }
+    if (ret <= 0) {
+      return (amt_done > 0) ? (ssize_t)amt_done : -1;
+    }
+    amt_done += ret;
+    ms->curPos += ret;
+    ms->pos += ret;
+  }
+  return amt_done;
+}
+
+
+static int
+member_stream_seek(void* cookie, off64_t* offset, int whence)
+{
+  member_stream_t* ms = (member_stream_t*) cookie;
+
+  int64_t base = 0;
+  if (whence == SEEK_CUR) {
+    base = ms->pos;
+  }
+  else if (whence == SEEK_END) {
+    base = ms->size;
+  }
+  else if (whence != SEEK_SET) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  int64_t pos = base + *offset;
+  if (pos < 0) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  // locate the segment holding 'pos' (positions past the end map to
+  // the end)
+  ms->cur = 0;
+  ms->curPos = ((uint64_t)pos < ms->size) ? (uint64_t)pos : ms->size;
+  while (ms->cur < ms->numSegs && ms->curPos >= ms->segs[ms->cur].len) {
+    ms->curPos -= ms->segs[ms->cur].len;
+    ms->cur++;
+  }
+  ms->pos = pos;
+
+  *offset = pos;
+  return 0;
+}
+
+
+static int
+member_stream_close(void* cookie)
+{
+  member_stream_t* ms = (member_stream_t*) cookie;
+  int ret = hpcio_fclose(ms->fs);
+  free(ms->segs);
+  free(ms);
+  return (ret == 0) ? 0 : EOF;
+}
+
+
+//*************************** Interface Functions ***************************
+
+const char*
+hpcio_container_member_name(const char* path)
+{
+  const char* sep = member_sep(path);
+  return (sep) ? sep + 1 : NULL;
+}
+
+
+char**
+hpcio_container_member_paths(const char* fnm, const char* sfx,
+			     uint32_t* numPaths)
+{
+  *numPaths = 0;
+
+  container_index_t* idx = container_index_get(fnm, NULL);
+  if (!idx) {
+    return NULL;
+  }
+
+  size_t fnmLen = strlen(fnm);
+  size_t sfxLen = (sfx) ? strlen(sfx) : 0;
+
+  char** paths =
+    (char**) container_alloc(idx->numMembers * sizeof(char*));
+  for (uint32_t i = 0; i < idx->numMembers; ++i) {
+    const char* nm = idx->closeOrder[i]->name;
+    size_t nmLen = strlen(nm);
+    if (!sfx || (nmLen > sfxLen + 1 && nm[nmLen - sfxLen - 1] == '.'
+		 && strcmp(nm + nmLen - sfxLen, sfx) == 0)) {
+      char* path = (char*) container_alloc(fnmLen + 1 + nmLen + 1);
+      memcpy(path, fnm, fnmLen);
+      path[fnmLen] = HPCIO_ContainerMemberSep;
+      memcpy(path + fnmLen + 1, nm, nmLen + 1);
+      paths[(*numPaths)++] = path;
+    }
+  }
+
+  return paths;
+}
+
+
+void
+hpcio_container_member_paths_free(char** paths, uint32_t numPaths)
+{
+  for (uint32_t i = 0; i < numPaths; ++i) {
+    free(paths[i]);
+  }
+  free(paths);
+}
+
+
+FILE*
+hpcio_container_member_fopen_r(const char* path)
+{
+  const char* sep = member_sep(path);
+  if (!sep) {
+    errno = ENOENT;
+    return NULL;
+  }
+
+  size_t fnmLen = sep - path;
+  char* fnm = (char*) container_alloc(fnmLen + 1);
+  memcpy(fnm, path, fnmLen);
+  fnm[fnmLen] = '\0';
+
+  FILE* fs = NULL;
+  container_index_t* idx = container_index_get(fnm, &fs);
+  free(fnm);
+  if (!idx) {
+    errno = ENOENT;
+    return NULL;
+  }
+
+  container_member_t key;
+  key.name = (char*) (sep + 1);
+  container_member_t* m = (container_member_t*)
+    bsearch(&key, idx->members, idx->numMembers, sizeof(container_member_t),
+	    member_cmp);
+  if (!m) {
+    hpcio_fclose(fs);
+    errno = ENOENT;
+    return NULL;
+  }
+
+  // copy the member's Data segments: the cached index may be evicted
+  // while the stream is open
+  member_stream_t* ms = (member_stream_t*) container_alloc(sizeof(*ms));
+  ms->fs = fs;
+  ms->numSegs = m->segEnd - m->segBeg;
+  ms->segs = (hpccontainer_fmt_seg_t*)
+    container_alloc(ms->numSegs * sizeof(hpccontainer_fmt_seg_t));
+  memcpy(ms->segs, &idx->dataSegs[m->segBeg],
+	 ms->numSegs * sizeof(hpccontainer_fmt_seg_t));
+  ms->size = 0;
+  for (uint32_t i = 0; i < ms->numSegs; ++i) {
+    ms->size += ms->segs[i].len;
+  }
+  ms->cur = 0;
+  ms->curPos = 0;
+  ms->pos = 0;
+
+  cookie_io_functions_t fns = {
+    member_stream_read, NULL, member_stream_seek, member_stream_close
+  };
+  FILE* ret = fopencookie(ms, "r", fns);
+  if (!ret) {
+    member_stream_close(ms);
+  }
+  return ret;
+}
@@ -0,0 +1,115 @@
+// -*-Mode: C++;-*- // technically C99
+
+// * BeginRiceCopyright *****************************************************
+//
+// $HeadURL$
+// $Id$
+//
+// --------------------------------------------------------------------------
+// Part of HPCToolkit (hpctoolkit.org)
+//
+// Information about sources of support for research and development of
+// HPCToolkit is at 'hpctoolkit.org' and in 'README.Acknowledgments'.
+// --------------------------------------------------------------------------
+//
+// Copyright ((c)) 2002-2020, Rice University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+//
+// * Neither the name of Rice University (RICE) nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+//
+// This software is provided by RICE and contributors "as is" and any
+// express or implied warranties, including, but not limited to, the
+// implied warranties of merchantability and fitness for a particular
+// purpose are disclaimed. In no event shall RICE or contributors be
+// liable for any direct, indirect, incidental, special, exemplary, or
+// consequential damages (including, but not limited to, procurement of
+// substitute goods or services; loss of use, data, or profits; or
+// business interruption) however caused and on any theory of liability,
+// whether in contract, strict liability, or tort (including negligence
+// or otherwise) arising in any way out of the use of this software, even
+// if advised of the possibility of such damage.
+//
+// ******************************************************* EndRiceCopyright *
+
+//***************************************************************************
+//
+// File:
+//   $HeadURL$
+//
+// Purpose:
+//   Read the members of an hpcrun output container (see
+//   hpccontainer_fmt_* in hpcrun-fmt.h) as if they were files.
+//
+//   A member is named by the path "<container-file>#<member-name>".
+//   These routines are for the analysis tools; unlike the rest of
+//   hpcio, they use malloc().  The index of each container is read
+//   once and kept for the containers most recently used, so opening
+//   many members of one container reads its index only once.  They
+//   are not thread-safe.
+//
+//***************************************************************************
+
+#ifndef prof_lean_hpcio_container_h
+#define prof_lean_hpcio_container_h
+
+//************************* System Include Files ****************************
+
+#include <stdio.h>
+#include <inttypes.h>
+
+//*************************** Forward Declarations **************************
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+//***************************************************************************
+
+#define HPCIO_ContainerMemberSep '#'
+
+// hpcio_container_member_name: If 'path' names a container member,
+// returns the member's name (a suffix of 'path'); otherwise NULL.
+const char*
+hpcio_container_member_name(const char* path);
+
+
+// hpcio_container_member_paths: Returns the paths of the members of
+// container 'fnm' whose names end in ".<sfx>" (all members if 'sfx'
+// is NULL), in the order they were closed.  Returns NULL if 'fnm' is
+// not a container.  Release the result with
+// hpcio_container_member_paths_free().
+char**
+hpcio_container_member_paths(const char* fnm, const char* sfx,
+			     uint32_t* numPaths);
+
+void
+hpcio_container_member_paths_free(char** paths, uint32_t numPaths);
+
+
+// hpcio_container_member_fopen_r: Opens the member 'path' for reading
+// (fread, fseek), like hpcio_fopen_r().  Returns NULL (with errno
+// set) if the member does not exist.  Close with hpcio_fclose().
+FILE*
+hpcio_container_member_fopen_r(const char* path);
+
+
+//***************************************************************************
+
+#if defined(__cplusplus)
+} /* extern "C" */
+#endif
+
+#endif /* prof_lean_hpcio_container_h */
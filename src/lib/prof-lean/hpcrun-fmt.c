@@ -636,8 +636,29 @@ hpcrun_fmt_cct_node_fread(hpcrun_fmt_cct_node_t* x,
     hpcrun_fmt_lip_fread(&x->lip, fs);
   }
 
-  for (int i = 0; i < x->num_metrics; ++i) {
-    HPCFMT_ThrowIfError(hpcfmt_int8_fread(&x->metrics[i].bits, fs));
+  if (flags.fields.isSparseMetrics) {
+    for (int i = 0; i < x->num_metrics; ++i) {
+      x->metrics[i].bits = 0;
+    }
+
+    // N.B.: ids at or beyond 'num_metrics' are skipped, which allows a
+    // caller to ignore metric values by passing 'num_metrics' = 0.
+    uint16_t num_nz = 0;
+    HPCFMT_ThrowIfError(hpcfmt_int2_fread(&num_nz, fs));
+    for (uint i = 0; i < num_nz; ++i) {
+      uint16_t mId = 0;
+      uint64_t val = 0;
+      HPCFMT_ThrowIfError(hpcfmt_int2_fread(&mId, fs));
+      HPCFMT_ThrowIfError(hpcfmt_int8_fread(&val, fs));
+      if (mId < x->num_metrics) {
+	x->metrics[mId].bits = val;
+      }
+    }
+  }
+  else {
+    for (int i = 0; i < x->num_metrics; ++i) {
+      HPCFMT_ThrowIfError(hpcfmt_int8_fread(&x->metrics[i].bits, fs));
+    }
   }
   
   return HPCFMT_OK;
@@ -662,14 +683,122 @@ hpcrun_fmt_cct_node_fwrite(hpcrun_fmt_cct_node_t* x,
     HPCFMT_ThrowIfError(hpcrun_fmt_lip_fwrite(&x->lip, fs));
   }
 
-  for (int i = 0; i < x->num_metrics; ++i) {
-    HPCFMT_ThrowIfError(hpcfmt_int8_fwrite(x->metrics[i].bits, fs));
+  if (flags.fields.isSparseMetrics) {
+    if (x->num_metrics > UINT16_MAX) {
+      return HPCFMT_ERR;
+    }
+
+    uint16_t num_nz = 0;
+    for (int i = 0; i < x->num_metrics; ++i) {
+      if (x->metrics[i].bits != 0) {
+	num_nz++;
+      }
+    }
+
+    HPCFMT_ThrowIfError(hpcfmt_int2_fwrite(num_nz, fs));
+    for (int i = 0; i < x->num_metrics; ++i) {
+      if (x->metrics[i].bits != 0) {
+	HPCFMT_ThrowIfError(hpcfmt_int2_fwrite((uint16_t)i, fs));
+	HPCFMT_ThrowIfError(hpcfmt_int8_fwrite(x->metrics[i].bits, fs));
+      }
+    }
+  }
+  else {
+    for (int i = 0; i < x->num_metrics; ++i) {
+      HPCFMT_ThrowIfError(hpcfmt_int8_fwrite(x->metrics[i].bits, fs));
+    }
   }
   
   return HPCFMT_OK;
 }
 
 
+// Big-endian encoders for the outbuf writer: store 'val' at 'buf' and
+// return the number of bytes stored.
+static inline int
+fmt_be_put(unsigned char* buf, uint64_t val, int nbytes)
+{
+  for (int k = 0, shift = 8 * (nbytes - 1); shift >= 0; ++k, shift -= 8) {
+    buf[k] = (val >> shift) & 0xff;
+  }
+  return nbytes;
+}
+
+
+// Space for the fixed part of a node plus at least one metric; larger
+// values batch more metrics per copy into the outbuf.
+#define HPCRUN_FMT_CCTNodeBufSz 512
+
+
+// Append the cct node to the outbuf, in the same encoding as
+// hpcrun_fmt_cct_node_fwrite().  Fields are encoded into a local
+// buffer and copied to the outbuf in batches, avoiding a stdio call
+// per field.
+// Returns: HPCFMT_OK on success, else HPCFMT_ERR.
+int
+hpcrun_fmt_cct_node_outbuf(hpcrun_fmt_cct_node_t* x,
+			   epoch_flags_t flags, hpcio_outbuf_t* outbuf)
+{
+  unsigned char buf[HPCRUN_FMT_CCTNodeBufSz];
+  const int metricSZ = 2 + 8; // worst case: sparse (metric-id, value)
+  int k = 0;
+
+  k += fmt_be_put(buf + k, x->id, 4);
+  k += fmt_be_put(buf + k, x->id_parent, 4);
+
+  if (flags.fields.isLogicalUnwind) {
+    k += fmt_be_put(buf + k, x->as_info.bits, 4);
+  }
+
+  k += fmt_be_put(buf + k, x->lm_id, 2);
+  k += fmt_be_put(buf + k, x->lm_ip, 8);
+
+  if (flags.fields.isLogicalUnwind) {
+    for (int i = 0; i < LUSH_LIP_DATA8_SZ; ++i) {
+      k += fmt_be_put(buf + k, x->lip.data8[i], 8);
+    }
+  }
+
+  if (flags.fields.isSparseMetrics) {
+    if (x->num_metrics > UINT16_MAX) {
+      return HPCFMT_ERR;
+    }
+
+    uint16_t num_nz = 0;
+    for (int i = 0; i < x->num_metrics; ++i) {
+      if (x->metrics[i].bits != 0) {
+	num_nz++;
+      }
+    }
+    k += fmt_be_put(buf + k, num_nz, 2);
+  }
+
+  for (int i = 0; i < x->num_metrics; ++i) {
+    if (flags.fields.isSparseMetrics && x->metrics[i].bits == 0) {
+      continue;
+    }
+
+    if (k + metricSZ > HPCRUN_FMT_CCTNodeBufSz) {
+      if (hpcio_outbuf_write(outbuf, buf, k) != k) {
+	return HPCFMT_ERR;
+      }
+      k = 0;
+    }
+
+    if (flags.fields.isSparseMetrics) {
+      k += fmt_be_put(buf + k, (uint16_t)i, 2);
+    }
+    k += fmt_be_put(buf + k, x->metrics[i].bits, 8);
+  }
+
+  if (hpcio_outbuf_write(outbuf, buf, k) != k) {
+    return HPCFMT_ERR;
+  }
+
+  return HPCFMT_OK;
+}
+
+
 int
 hpcrun_fmt_cct_node_fprint(hpcrun_fmt_cct_node_t* x, FILE* fs,
 			   epoch_flags_t flags, const metric_tbl_t* metricTbl,
@@ -808,10 +937,9 @@ hpctrace_fmt_hdr_fread(hpctrace_fmt_hdr_t* hdr, FILE* infs)
 }
 
 
-// Writer based on outbuf.
-// Returns: HPCFMT_OK on success, else HPCFMT_ERR.
-int
-hpctrace_fmt_hdr_outbuf(hpctrace_hdr_flags_t flags, hpcio_outbuf_t* outbuf)
+static int
+hpctrace_fmt_hdr_outbuf_common(hpctrace_hdr_flags_t flags,
+			       const char* versionStr, hpcio_outbuf_t* outbuf)
 {
   ssize_t ret;
 
@@ -826,7 +954,7 @@ hpctrace_fmt_hdr_outbuf(hpctrace_hdr_flags_t flags, hpcio_outbuf_t* outbuf)
   }
 
   hpcio_outbuf_write(outbuf, HPCTRACE_FMT_Magic, HPCTRACE_FMT_MagicLen);
-  hpcio_outbuf_write(outbuf, HPCTRACE_FMT_Version, HPCTRACE_FMT_VersionLen);
+  hpcio_outbuf_write(outbuf, versionStr, HPCTRACE_FMT_VersionLen);
   hpcio_outbuf_write(outbuf, HPCTRACE_FMT_Endian, HPCTRACE_FMT_EndianLen);
   ret = hpcio_outbuf_write(outbuf, buf, bufSZ);
 
@@ -838,16 +966,35 @@ hpctrace_fmt_hdr_outbuf(hpctrace_hdr_flags_t flags, hpcio_outbuf_t* outbuf)
 }
 
 
-// N.B.: not async safe
+// Writer based on outbuf.
+// Returns: HPCFMT_OK on success, else HPCFMT_ERR.
 int
-hpctrace_fmt_hdr_fwrite(hpctrace_hdr_flags_t flags, FILE* fs)
+hpctrace_fmt_hdr_outbuf(hpctrace_hdr_flags_t flags, hpcio_outbuf_t* outbuf)
+{
+  return hpctrace_fmt_hdr_outbuf_common(flags, HPCTRACE_FMT_Version, outbuf);
+}
+
+
+int
+hpctrace_fmt_hdr_compact_outbuf(hpctrace_hdr_flags_t flags,
+				hpcio_outbuf_t* outbuf)
+{
+  return hpctrace_fmt_hdr_outbuf_common(flags, HPCTRACE_FMT_VersionCompact,
+					outbuf);
+}
+
+
+// N.B.: not async safe
+static int
+hpctrace_fmt_hdr_fwrite_common(hpctrace_hdr_flags_t flags,
+			       const char* versionStr, FILE* fs)
 {
   int nw;
 
   nw = fwrite(HPCTRACE_FMT_Magic,   1, HPCTRACE_FMT_MagicLen, fs);
   if (nw != HPCTRACE_FMT_MagicLen) return HPCFMT_ERR;
 
-  nw = fwrite(HPCTRACE_FMT_Version, 1, HPCTRACE_FMT_VersionLen, fs);
+  nw = fwrite(versionStr, 1, HPCTRACE_FMT_VersionLen, fs);
   if (nw != HPCTRACE_FMT_VersionLen) return HPCFMT_ERR;
 
   nw = fwrite(HPCTRACE_FMT_Endian,  1, HPCTRACE_FMT_EndianLen, fs);
@@ -859,6 +1006,21 @@ hpctrace_fmt_hdr_fwrite(hpctrace_hdr_flags_t flags, FILE* fs)
 }
 
 
+int
+hpctrace_fmt_hdr_fwrite(hpctrace_hdr_flags_t flags, FILE* fs)
+{
+  return hpctrace_fmt_hdr_fwrite_common(flags, HPCTRACE_FMT_Version, fs);
+}
+
+
+int
+hpctrace_fmt_hdr_compact_fwrite(hpctrace_hdr_flags_t flags, FILE* fs)
+{
+  return hpctrace_fmt_hdr_fwrite_common(flags, HPCTRACE_FMT_VersionCompact,
+					fs);
+}
+
+
 int
 hpctrace_fmt_hdr_fprint(hpctrace_fmt_hdr_t* hdr, FILE* fs)
 {
@@ -972,6 +1134,306 @@ hpctrace_fmt_datum_fprint(hpctrace_fmt_datum_t* x, hpctrace_hdr_flags_t flags,
 }
 
 
+//***************************************************************************
+// [hpctrace] compact trace records (version 1.02)
+//***************************************************************************
+
+static inline unsigned char*
+hpctrace_fmt_varint_encode(uint64_t val, unsigned char* buf)
+{
+  while (val >= 0x80) {
+    *buf++ = (val & 0x7f) | 0x80;
+    val >>= 7;
+  }
+  *buf++ = val;
+  return buf;
+}
+
+
+static inline const unsigned char*
+hpctrace_fmt_varint_decode(uint64_t* val, const unsigned char* buf,
+			   const unsigned char* end)
+{
+  uint64_t x = 0;
+  for (int shift = 0; buf < end && shift < 64; shift += 7) {
+    unsigned char b = *buf++;
+    x |= ((uint64_t)(b & 0x7f)) << shift;
+    if (!(b & 0x80)) {
+      *val = x;
+      return buf;
+    }
+  }
+  return NULL;
+}
+
+
+static inline bool
+hpctrace_fmt_datum_isRepeat(const hpctrace_fmt_datum_t* x,
+			    const hpctrace_fmt_datum_t* prev,
+			    hpctrace_hdr_flags_t flags)
+{
+  return (x->cpId == prev->cpId
+	  && (!HPCTRACE_HDR_FLAGS_GET_BIT(flags, HPCTRACE_HDR_FLAGS_DATA_CENTRIC_BIT_POS)
+	      || x->metricId == prev->metricId));
+}
+
+
+static void
+hpctrace_fmt_blk_hdr_encode(hpctrace_fmt_blk_hdr_t* x, unsigned char* buf)
+{
+  int shift, k = 0;
+  for (shift = 24; shift >= 0; shift -= 8) {
+    buf[k++] = (x->numBytes >> shift) & 0xff;
+  }
+  for (shift = 24; shift >= 0; shift -= 8) {
+    buf[k++] = (x->numDatum >> shift) & 0xff;
+  }
+  for (shift = 56; shift >= 0; shift -= 8) {
+    buf[k++] = (x->begTime >> shift) & 0xff;
+  }
+  for (shift = 56; shift >= 0; shift -= 8) {
+    buf[k++] = (x->endTime >> shift) & 0xff;
+  }
+}
+
+
+int
+hpctrace_fmt_blk_hdr_decode(hpctrace_fmt_blk_hdr_t* x,
+			    const unsigned char* buf, size_t bufSz)
+{
+  if (bufSz < HPCTRACE_FMT_BlkHdrLen) {
+    return HPCFMT_ERR;
+  }
+
+  int k = 0;
+  x->numBytes = 0;
+  x->numDatum = 0;
+  x->begTime = 0;
+  x->endTime = 0;
+  for (int i = 0; i < 4; i++) {
+    x->numBytes = (x->numBytes << 8) | buf[k++];
+  }
+  for (int i = 0; i < 4; i++) {
+    x->numDatum = (x->numDatum << 8) | buf[k++];
+  }
+  for (int i = 0; i < 8; i++) {
+    x->begTime = (x->begTime << 8) | buf[k++];
+  }
+  for (int i = 0; i < 8; i++) {
+    x->endTime = (x->endTime << 8) | buf[k++];
+  }
+
+  if (x->numBytes > HPCTRACE_FMT_BlkPayloadMax || x->numDatum > x->numBytes) {
+    return HPCFMT_ERR;
+  }
+  return HPCFMT_OK;
+}
+
+
+void
+hpctrace_fmt_blk_init(hpctrace_fmt_blk_t* blk)
+{
+  blk->hdr.numBytes = 0;
+  blk->hdr.numDatum = 0;
+  blk->hdr.begTime = 0;
+  blk->hdr.endTime = 0;
+  blk->pos = 0;
+  blk->idx = 0;
+  blk->prev.comp = 0;
+  blk->prev.cpId = 0;
+  blk->prev.metricId = 0;
+}
+
+
+void
+hpctrace_fmt_blk_add(hpctrace_fmt_blk_t* blk, hpctrace_fmt_datum_t* x,
+		     hpctrace_hdr_flags_t flags)
+{
+  if (blk->hdr.numDatum == 0) {
+    blk->hdr.begTime = HPCTRACE_FMT_GET_TIME(x->comp);
+    blk->prev.comp = blk->hdr.begTime;
+  }
+  blk->hdr.endTime = HPCTRACE_FMT_GET_TIME(x->comp);
+
+  unsigned char* buf = blk->buf + blk->hdr.numBytes;
+
+  int64_t delta = (int64_t)(x->comp - blk->prev.comp);
+  buf = hpctrace_fmt_varint_encode(((uint64_t)delta << 1) ^ (uint64_t)(delta >> 63),
+				   buf);
+
+  if (hpctrace_fmt_datum_isRepeat(x, &blk->prev, flags)) {
+    *buf++ = 0;
+  }
+  else {
+    buf = hpctrace_fmt_varint_encode((uint64_t)x->cpId + 1, buf);
+    if (HPCTRACE_HDR_FLAGS_GET_BIT(flags, HPCTRACE_HDR_FLAGS_DATA_CENTRIC_BIT_POS)) {
+      buf = hpctrace_fmt_varint_encode(x->metricId, buf);
+    }
+  }
+
+  blk->hdr.numBytes = buf - blk->buf;
+  blk->hdr.numDatum++;
+  blk->prev = *x;
+}
+
+
+int
+hpctrace_fmt_blk_outbuf(hpctrace_fmt_blk_t* blk, hpcio_outbuf_t* outbuf)
+{
+  if (blk->hdr.numDatum == 0) {
+    return HPCFMT_OK;
+  }
+
+  unsigned char hdrBuf[HPCTRACE_FMT_BlkHdrLen];
+  hpctrace_fmt_blk_hdr_encode(&blk->hdr, hdrBuf);
+
+  size_t sz = blk->hdr.numBytes;
+  if (hpcio_outbuf_write(outbuf, hdrBuf, HPCTRACE_FMT_BlkHdrLen)
+        != HPCTRACE_FMT_BlkHdrLen
+      || hpcio_outbuf_write(outbuf, blk->buf, sz) != sz) {
+    return HPCFMT_ERR;
+  }
+
+  hpctrace_fmt_blk_init(blk);
+  return HPCFMT_OK;
+}
+
+
+int
+hpctrace_fmt_blk_fwrite(hpctrace_fmt_blk_t* blk, FILE* fs)
+{
+  if (blk->hdr.numDatum == 0) {
+    return HPCFMT_OK;
+  }
+
+  unsigned char hdrBuf[HPCTRACE_FMT_BlkHdrLen];
+  hpctrace_fmt_blk_hdr_encode(&blk->hdr, hdrBuf);
+
+  HPCFMT_ThrowIfError(hpcfmt_fwrite(hdrBuf, HPCTRACE_FMT_BlkHdrLen, fs));
+  HPCFMT_ThrowIfError(hpcfmt_fwrite(blk->buf, blk->hdr.numBytes, fs));
+
+  hpctrace_fmt_blk_init(blk);
+  return HPCFMT_OK;
+}
+
+
+int
+hpctrace_fmt_blk_fread(hpctrace_fmt_blk_t* blk, FILE* fs)
+{
+  unsigned char hdrBuf[HPCTRACE_FMT_BlkHdrLen];
+
+  size_t nr = fread(hdrBuf, 1, HPCTRACE_FMT_BlkHdrLen, fs);
+  if (nr == 0 && feof(fs)) {
+    return HPCFMT_EOF;
+  }
+
+  hpctrace_fmt_blk_init(blk);
+  HPCFMT_ThrowIfError(hpctrace_fmt_blk_hdr_decode(&blk->hdr, hdrBuf, nr));
+  HPCFMT_ThrowIfError(hpcfmt_fread(blk->buf, blk->hdr.numBytes, fs));
+
+  blk->prev.comp = blk->hdr.begTime;
+  return HPCFMT_OK;
+}
+
+
+int
+hpctrace_fmt_datum_blk_outbuf(hpctrace_fmt_datum_t* x,
+			      hpctrace_hdr_flags_t flags,
+			      hpctrace_fmt_blk_t* blk, hpcio_outbuf_t* outbuf)
+{
+  if (hpctrace_fmt_blk_isFull(blk)) {
+    HPCFMT_ThrowIfError(hpctrace_fmt_blk_outbuf(blk, outbuf));
+  }
+  hpctrace_fmt_blk_add(blk, x, flags);
+  return HPCFMT_OK;
+}
+
+
+int
+hpctrace_fmt_datum_blk_fwrite(hpctrace_fmt_datum_t* x,
+			      hpctrace_hdr_flags_t flags,
+			      hpctrace_fmt_blk_t* blk, FILE* fs)
+{
+  if (hpctrace_fmt_blk_isFull(blk)) {
+    HPCFMT_ThrowIfError(hpctrace_fmt_blk_fwrite(blk, fs));
+  }
+  hpctrace_fmt_blk_add(blk, x, flags);
+  return HPCFMT_OK;
+}
+
+
+int
+hpctrace_fmt_datum_blk_fread(hpctrace_fmt_datum_t* x,
+			     hpctrace_hdr_flags_t flags,
+			     hpctrace_fmt_blk_t* blk, FILE* fs)
+{
+  while (blk->idx >= blk->hdr.numDatum) {
+    int ret = hpctrace_fmt_blk_fread(blk, fs);
+    if (ret != HPCFMT_OK) {
+      return ret; // can be HPCFMT_EOF
+    }
+  }
+
+  const unsigned char* beg = blk->buf + blk->pos;
+  const unsigned char* end = blk->buf + blk->hdr.numBytes;
+  const unsigned char* nxt =
+    hpctrace_fmt_datum_decode(x, &blk->prev, flags, beg, end);
+  if (!nxt) {
+    return HPCFMT_ERR;
+  }
+
+  blk->pos += nxt - beg;
+  blk->idx++;
+  blk->prev = *x;
+  return HPCFMT_OK;
+}
+
+
+const unsigned char*
+hpctrace_fmt_datum_decode(hpctrace_fmt_datum_t* x,
+			  const hpctrace_fmt_datum_t* prev,
+			  hpctrace_hdr_flags_t flags,
+			  const unsigned char* buf, const unsigned char* end)
+{
+  uint64_t zz, code;
+
+  buf = hpctrace_fmt_varint_decode(&zz, buf, end);
+  if (!buf) {
+    return NULL;
+  }
+  int64_t delta = (int64_t)(zz >> 1) ^ -(int64_t)(zz & 1);
+  x->comp = prev->comp + (uint64_t)delta;
+
+  buf = hpctrace_fmt_varint_decode(&code, buf, end);
+  if (!buf) {
+    return NULL;
+  }
+
+  bool isDataCentric =
+    HPCTRACE_HDR_FLAGS_GET_BIT(flags, HPCTRACE_HDR_FLAGS_DATA_CENTRIC_BIT_POS);
+  if (code == 0) {
+    x->cpId = prev->cpId;
+    x->metricId = prev->metricId;
+  }
+  else {
+    x->cpId = (uint32_t)(code - 1);
+    if (isDataCentric) {
+      uint64_t metricId;
+      buf = hpctrace_fmt_varint_decode(&metricId, buf, end);
+      if (!buf) {
+	return NULL;
+      }
+      x->metricId = (uint32_t)metricId;
+    }
+  }
+  if (!isDataCentric) {
+    x->metricId = HPCTRACE_FMT_MetricId_NULL;
+  }
+
+  return buf;
+}
+
+
 //***************************************************************************
 // hpcprof-metricdb (located here for now)
 //***************************************************************************
@@ -984,7 +1446,6 @@ int
 hpcmetricDB_fmt_hdr_fread(hpcmetricDB_fmt_hdr_t* hdr, FILE* infs)
 {
   char tag[HPCMETRICDB_FMT_MagicLen + 1];
-  char version[HPCMETRICDB_FMT_VersionLen + 1];
   char endian[HPCMETRICDB_FMT_EndianLen + 1];
 
   int nr = fread(tag, 1, HPCMETRICDB_FMT_MagicLen, infs);
@@ -997,8 +1458,8 @@ hpcmetricDB_fmt_hdr_fread(hpcmetricDB_fmt_hdr_t* hdr, FILE* infs)
     return HPCFMT_ERR;
   }
 
-  nr = fread(&version, 1, HPCMETRICDB_FMT_VersionLen, infs);
-  version[HPCMETRICDB_FMT_VersionLen] = '\0';
+  nr = fread(hdr->versionStr, 1, HPCMETRICDB_FMT_VersionLen, infs);
+  hdr->versionStr[HPCMETRICDB_FMT_VersionLen] = '\0';
   if (nr != HPCMETRICDB_FMT_VersionLen) {
     return HPCFMT_ERR;
   }
@@ -1008,23 +1469,32 @@ hpcmetricDB_fmt_hdr_fread(hpcmetricDB_fmt_hdr_t* hdr, FILE* infs)
   if (nr != HPCMETRICDB_FMT_EndianLen) {
     return HPCFMT_ERR;
   }
+  hdr->endian = endian[0];
 
   HPCFMT_ThrowIfError(hpcfmt_int4_fread(&(hdr->numNodes), infs));
   HPCFMT_ThrowIfError(hpcfmt_int4_fread(&(hdr->numMetrics), infs));
 
+  hdr->numNZNodes = 0;
+  hdr->numNZValues = 0;
+  if (hpcmetricDB_fmt_isSparse(hdr)) {
+    HPCFMT_ThrowIfError(hpcfmt_int4_fread(&(hdr->numNZNodes), infs));
+    HPCFMT_ThrowIfError(hpcfmt_int8_fread(&(hdr->numNZValues), infs));
+  }
+
   return HPCFMT_OK;
 }
 
 
-int
-hpcmetricDB_fmt_hdr_fwrite(hpcmetricDB_fmt_hdr_t* hdr, FILE* outfs)
+static int
+hpcmetricDB_fmt_hdr_fwrite_common(hpcmetricDB_fmt_hdr_t* hdr,
+				  const char* versionStr, FILE* outfs)
 {
   int nw;
 
   nw = fwrite(HPCMETRICDB_FMT_Magic,   1, HPCMETRICDB_FMT_MagicLen, outfs);
   if (nw != HPCTRACE_FMT_MagicLen) return HPCFMT_ERR;
 
-  nw = fwrite(HPCMETRICDB_FMT_Version, 1, HPCMETRICDB_FMT_VersionLen, outfs);
+  nw = fwrite(versionStr, 1, HPCMETRICDB_FMT_VersionLen, outfs);
   if (nw != HPCMETRICDB_FMT_VersionLen) return HPCFMT_ERR;
 
   nw = fwrite(HPCMETRICDB_FMT_Endian,  1, HPCMETRICDB_FMT_EndianLen, outfs);
@@ -1037,6 +1507,14 @@ hpcmetricDB_fmt_hdr_fwrite(hpcmetricDB_fmt_hdr_t* hdr, FILE* outfs)
 }
 
 
+int
+hpcmetricDB_fmt_hdr_fwrite(hpcmetricDB_fmt_hdr_t* hdr, FILE* outfs)
+{
+  return hpcmetricDB_fmt_hdr_fwrite_common(hdr, HPCMETRICDB_FMT_Version,
+					   outfs);
+}
+
+
 int
 hpcmetricDB_fmt_hdr_fprint(hpcmetricDB_fmt_hdr_t* hdr, FILE* outfs)
 {
@@ -1045,7 +1523,330 @@ hpcmetricDB_fmt_hdr_fprint(hpcmetricDB_fmt_hdr_t* hdr, FILE* outfs)
 
   fprintf(outfs, "(num-nodes:   %u)\n", hdr->numNodes);
   fprintf(outfs, "(num-metrics: %u)\n", hdr->numMetrics);
+  if (hpcmetricDB_fmt_isSparse(hdr)) {
+    fprintf(outfs, "(num-nz-nodes:  %u)\n", hdr->numNZNodes);
+    fprintf(outfs, "(num-nz-values: %"PRIu64")\n", hdr->numNZValues);
+  }
+
+  return HPCFMT_OK;
+}
+
+
+//***************************************************************************
+// [hpcprof-metricdb] sparse format
+//***************************************************************************
+
+int
+hpcmetricDB_fmt_sparse_hdr_fwrite(hpcmetricDB_fmt_hdr_t* hdr, FILE* outfs)
+{
+  HPCFMT_ThrowIfError(hpcmetricDB_fmt_hdr_fwrite_common(hdr,
+                        HPCMETRICDB_FMT_VersionSparse, outfs));
+  HPCFMT_ThrowIfError(hpcfmt_int4_fwrite(hdr->numNZNodes, outfs));
+  HPCFMT_ThrowIfError(hpcfmt_int8_fwrite(hdr->numNZValues, outfs));
+
+  return HPCFMT_OK;
+}
+
+
+int
+hpcmetricDB_fmt_nzidx_fread(hpcmetricDB_fmt_nzidx_t* x, FILE* infs)
+{
+  HPCFMT_ThrowIfError(hpcfmt_int4_fread(&(x->nodeId), infs));
+  HPCFMT_ThrowIfError(hpcfmt_int8_fread(&(x->valueIdx), infs));
+  return HPCFMT_OK;
+}
+
+
+int
+hpcmetricDB_fmt_nzidx_fwrite(hpcmetricDB_fmt_nzidx_t* x, FILE* outfs)
+{
+  HPCFMT_ThrowIfError(hpcfmt_int4_fwrite(x->nodeId, outfs));
+  HPCFMT_ThrowIfError(hpcfmt_int8_fwrite(x->valueIdx, outfs));
+  return HPCFMT_OK;
+}
 
+
+int
+hpcmetricDB_fmt_nzval_fread(hpcmetricDB_fmt_nzval_t* x, FILE* infs)
+{
+  HPCFMT_ThrowIfError(hpcfmt_int4_fread(&(x->metricId), infs));
+  HPCFMT_ThrowIfError(hpcfmt_real8_fread(&(x->value), infs));
+  return HPCFMT_OK;
+}
+
+
+int
+hpcmetricDB_fmt_nzval_fwrite(hpcmetricDB_fmt_nzval_t* x, FILE* outfs)
+{
+  HPCFMT_ThrowIfError(hpcfmt_int4_fwrite(x->metricId, outfs));
+  HPCFMT_ThrowIfError(hpcfmt_real8_fwrite(x->value, outfs));
   return HPCFMT_OK;
 }
 
+
+int
+hpcmetricDB_fmt_sparse_node_fread(const hpcmetricDB_fmt_hdr_t* hdr,
+				  const hpcmetricDB_fmt_nzidx_t* nzidx,
+				  uint32_t nodeId, double* values, FILE* infs)
+{
+  for (uint32_t i = 0; i < hdr->numMetrics; ++i) {
+    values[i] = 0.0;
+  }
+
+  // binary search for 'nodeId' in [0, numNZNodes)
+  uint32_t lo = 0, hi = hdr->numNZNodes;
+  while (lo < hi) {
+    uint32_t mid = lo + (hi - lo) / 2;
+    if (nzidx[mid].nodeId < nodeId) {
+      lo = mid + 1;
+    }
+    else {
+      hi = mid;
+    }
+  }
+  if (lo == hdr->numNZNodes || nzidx[lo].nodeId != nodeId) {
+    return HPCFMT_OK; // all values are zero
+  }
+
+  uint64_t valueBeg = nzidx[lo].valueIdx;
+  uint64_t valueEnd = nzidx[lo + 1].valueIdx;
+
+  off_t valuesOff = (HPCMETRICDB_FMT_SparseHdrLen
+		     + (off_t)(hdr->numNZNodes + 1) * HPCMETRICDB_FMT_NZIdxLen);
+  off_t off = valuesOff + (off_t)valueBeg * HPCMETRICDB_FMT_NZValLen;
+  if (fseeko(infs, off, SEEK_SET) != 0) {
+    return HPCFMT_ERR;
+  }
+
+  for (uint64_t i = valueBeg; i < valueEnd; ++i) {
+    hpcmetricDB_fmt_nzval_t nzval;
+    HPCFMT_ThrowIfError(hpcmetricDB_fmt_nzval_fread(&nzval, infs));
+    if (nzval.metricId >= hdr->numMetrics) {
+      return HPCFMT_ERR;
+    }
+    values[nzval.metricId] = nzval.value;
+  }
+
+  return HPCFMT_OK;
+}
+
+
+
+//***************************************************************************
+// hpcrun output container (located here for now)
+//***************************************************************************
+
+void
+hpccontainer_fmt_hdr_encode(unsigned char* buf)
+{
+  int k = 0;
+  memcpy(buf + k, HPCCONTAINER_FMT_Magic, HPCCONTAINER_FMT_MagicLen);
+  k += HPCCONTAINER_FMT_MagicLen;
+  memcpy(buf + k, HPCCONTAINER_FMT_Version, HPCCONTAINER_FMT_VersionLen);
+  k += HPCCONTAINER_FMT_VersionLen;
+  memcpy(buf + k, HPCCONTAINER_FMT_Endian, HPCCONTAINER_FMT_EndianLen);
+}
+
+
+void
+hpccontainer_fmt_seg_hdr_encode(const hpccontainer_fmt_seg_t* x,
+				unsigned char* buf)
+{
+  int k = 0;
+  k += fmt_be_put(buf + k, x->kind, 4);
+  k += fmt_be_put(buf + k, x->memberId, 4);
+  k += fmt_be_put(buf + k, x->len, 8);
+}
+
+
+void
+hpccontainer_fmt_idx_entry_encode(const hpccontainer_fmt_seg_t* x,
+				  unsigned char* buf)
+{
+  int k = 0;
+  k += fmt_be_put(buf + k, x->kind, 4);
+  k += fmt_be_put(buf + k, x->memberId, 4);
+  k += fmt_be_put(buf + k, x->offset, 8);
+  k += fmt_be_put(buf + k, x->len, 8);
+}
+
+
+void
+hpccontainer_fmt_trailer_encode(uint64_t idxOffset, unsigned char* buf)
+{
+  int k = 0;
+  k += fmt_be_put(buf + k, idxOffset, 8);
+  memcpy(buf + k, HPCCONTAINER_FMT_TrailerTag, HPCCONTAINER_FMT_TagLenX);
+}
+
+
+static int
+hpccontainer_fmt_seg_hdr_fread(hpccontainer_fmt_seg_t* x, uint64_t offset,
+			       FILE* infs)
+{
+  if (fseeko(infs, offset, SEEK_SET) != 0) {
+    return HPCFMT_ERR;
+  }
+  x->offset = offset;
+  HPCFMT_ThrowIfError(hpcfmt_int4_fread(&(x->kind), infs));
+  HPCFMT_ThrowIfError(hpcfmt_int4_fread(&(x->memberId), infs));
+  HPCFMT_ThrowIfError(hpcfmt_int8_fread(&(x->len), infs));
+  return HPCFMT_OK;
+}
+
+
+static int
+hpccontainer_fmt_seg_cmp(const void* a, const void* b)
+{
+  uint64_t x = ((const hpccontainer_fmt_seg_t*)a)->offset;
+  uint64_t y = ((const hpccontainer_fmt_seg_t*)b)->offset;
+  return (x < y) ? -1 : ((x > y) ? 1 : 0);
+}
+
+
+// Reads the index that the trailer refers to, if there is one.
+// Returns: HPCFMT_OK, HPCFMT_EOF if there is no (valid) index, else
+// HPCFMT_ERR.
+static int
+hpccontainer_fmt_idx_fread(hpccontainer_fmt_seg_t** segs, uint32_t* numSegs,
+			   uint64_t fileSz, FILE* infs, hpcfmt_alloc_fn alloc)
+{
+  char tag[HPCCONTAINER_FMT_TagLenX + 1];
+  uint64_t idxOffset;
+
+  if (fileSz < (uint64_t)(HPCCONTAINER_FMT_HeaderLen
+			  + HPCCONTAINER_FMT_SegHdrLen
+			  + HPCCONTAINER_FMT_TrailerLen)
+      || fseeko(infs, fileSz - HPCCONTAINER_FMT_TrailerLen, SEEK_SET) != 0) {
+    return HPCFMT_EOF;
+  }
+  HPCFMT_ThrowIfError(hpcfmt_int8_fread(&idxOffset, infs));
+  if (fread(tag, 1, HPCCONTAINER_FMT_TagLenX, infs) != HPCCONTAINER_FMT_TagLenX) {
+    return HPCFMT_ERR;
+  }
+  tag[HPCCONTAINER_FMT_TagLenX] = '\0';
+
+  hpccontainer_fmt_seg_t idx;
+  uint64_t idxEnd = fileSz - HPCCONTAINER_FMT_TrailerLen;
+  if (strcmp(tag, HPCCONTAINER_FMT_TrailerTag) != 0
+      || idxOffset < HPCCONTAINER_FMT_HeaderLen
+      || idxOffset + HPCCONTAINER_FMT_SegHdrLen > idxEnd
+      || hpccontainer_fmt_seg_hdr_fread(&idx, idxOffset, infs) != HPCFMT_OK
+      || idx.kind != HPCCONTAINER_FMT_SegIndex
+      || idx.len != idxEnd - (idxOffset + HPCCONTAINER_FMT_SegHdrLen)
+      || idx.len % HPCCONTAINER_FMT_IdxEntryLen != 0) {
+    return HPCFMT_EOF;
+  }
+
+  uint32_t n = idx.len / HPCCONTAINER_FMT_IdxEntryLen;
+  *segs = (hpccontainer_fmt_seg_t*) alloc(n * sizeof(hpccontainer_fmt_seg_t));
+  *numSegs = 0;
+  for (uint32_t i = 0; i < n; ++i) {
+    hpccontainer_fmt_seg_t* x = &(*segs)[*numSegs];
+    HPCFMT_ThrowIfError(hpcfmt_int4_fread(&(x->kind), infs));
+    HPCFMT_ThrowIfError(hpcfmt_int4_fread(&(x->memberId), infs));
+    HPCFMT_ThrowIfError(hpcfmt_int8_fread(&(x->offset), infs));
+    HPCFMT_ThrowIfError(hpcfmt_int8_fread(&(x->len), infs));
+    if ((x->kind == HPCCONTAINER_FMT_SegData
+	 || x->kind == HPCCONTAINER_FMT_SegName)
+	&& x->offset >= HPCCONTAINER_FMT_HeaderLen
+	&& x->offset + HPCCONTAINER_FMT_SegHdrLen + x->len <= idxOffset) {
+      (*numSegs)++;
+    }
+  }
+  return HPCFMT_OK;
+}
+
+
+// Scans the segment headers from the front of the container.  If
+// 'segs' is NULL, only counts them.
+static uint32_t
+hpccontainer_fmt_segs_scan(hpccontainer_fmt_seg_t* segs, uint64_t fileSz,
+			   FILE* infs)
+{
+  uint32_t n = 0;
+  uint64_t offset = HPCCONTAINER_FMT_HeaderLen;
+  while (offset + HPCCONTAINER_FMT_SegHdrLen <= fileSz) {
+    hpccontainer_fmt_seg_t x;
+    if (hpccontainer_fmt_seg_hdr_fread(&x, offset, infs) != HPCFMT_OK
+	|| x.kind == HPCCONTAINER_FMT_SegNULL
+	|| x.kind > HPCCONTAINER_FMT_SegIndex
+	|| x.len > fileSz - (offset + HPCCONTAINER_FMT_SegHdrLen)) {
+      break;
+    }
+    if (x.kind != HPCCONTAINER_FMT_SegIndex) {
+      if (segs) {
+	segs[n] = x;
+      }
+      n++;
+    }
+    offset += HPCCONTAINER_FMT_SegHdrLen + x.len;
+  }
+  return n;
+}
+
+
+int
+hpccontainer_fmt_segs_fread(hpccontainer_fmt_seg_t** segs, uint32_t* numSegs,
+			    FILE* infs, hpcfmt_alloc_fn alloc)
+{
+  char tag[HPCCONTAINER_FMT_MagicLenX + 1];
+  char version[HPCCONTAINER_FMT_VersionLenX + 1];
+
+  *segs = NULL;
+  *numSegs = 0;
+
+  if (fseeko(infs, 0, SEEK_END) != 0) {
+    return HPCFMT_ERR;
+  }
+  uint64_t fileSz = ftello(infs);
+  if (fseeko(infs, 0, SEEK_SET) != 0) {
+    return HPCFMT_ERR;
+  }
+
+  int nr = fread(tag, 1, HPCCONTAINER_FMT_MagicLen, infs);
+  tag[HPCCONTAINER_FMT_MagicLen] = '\0';
+  if (nr != HPCCONTAINER_FMT_MagicLen
+      || strcmp(tag, HPCCONTAINER_FMT_Magic) != 0) {
+    return HPCFMT_ERR;
+  }
+  nr = fread(version, 1, HPCCONTAINER_FMT_VersionLen, infs);
+  version[HPCCONTAINER_FMT_VersionLen] = '\0';
+  if (nr != HPCCONTAINER_FMT_VersionLen
+      || atof(version) > atof(HPCCONTAINER_FMT_Version)) {
+    return HPCFMT_ERR;
+  }
+
+  int ret = hpccontainer_fmt_idx_fread(segs, numSegs, fileSz, infs, alloc);
+  if (ret == HPCFMT_ERR) {
+    return HPCFMT_ERR;
+  }
+  if (ret == HPCFMT_EOF) {
+    uint32_t n = hpccontainer_fmt_segs_scan(NULL, fileSz, infs);
+    *segs = (hpccontainer_fmt_seg_t*) alloc(n * sizeof(hpccontainer_fmt_seg_t));
+    *numSegs = hpccontainer_fmt_segs_scan(*segs, fileSz, infs);
+  }
+
+  qsort(*segs, *numSegs, sizeof(hpccontainer_fmt_seg_t),
+	hpccontainer_fmt_seg_cmp);
+  return HPCFMT_OK;
+}
+
+
+int
+hpccontainer_fmt_name_fread(char** name, const hpccontainer_fmt_seg_t* seg,
+			    FILE* infs, hpcfmt_alloc_fn alloc)
+{
+  *name = NULL;
+  if (seg->kind != HPCCONTAINER_FMT_SegName
+      || fseeko(infs, seg->offset + HPCCONTAINER_FMT_SegHdrLen, SEEK_SET) != 0) {
+    return HPCFMT_ERR;
+  }
+
+  *name = (char*) alloc(seg->len + 1);
+  if (fread(*name, 1, seg->len, infs) != seg->len) {
+    return HPCFMT_ERR;
+  }
+  (*name)[seg->len] = '\0';
+  return HPCFMT_OK;
+}
@@ -98,6 +98,21 @@ static const char HPCRUN_TraceFnmSfx[] = "hpctrace";
 // hpcrun log filename suffix
 static const char HPCRUN_LogFnmSfx[] = "log";
 
+// hpcrun profile snapshot filename infixes: snapshot <seq> of profile
+// <name>.hpcrun is written to <name>.<infix><seq>.hpcrun.  A (cumulative)
+// snapshot supersedes earlier ones; delta snapshots add up.
+static const char HPCRUN_SnapshotFnmInfix[] = "snap";
+static const char HPCRUN_SnapshotDeltaFnmInfix[] = "delta";
+
+// infix of a profile that is not complete: the epochs a thread flushed
+// before it ended go to <name>.flushed.hpcrun, which is renamed to
+// <name>.hpcrun once the thread has written all of its profile.
+// A cumulative snapshot written after the flush holds the rest.
+static const char HPCRUN_FlushedFnmInfix[] = "flushed";
+
+// hpcrun output container filename suffix
+static const char HPCRUN_ContainerFnmSfx[] = "hpccontainer";
+
 // hpcprof metric db filename suffix
 static const char HPCPROF_MetricDBSfx[] = "metric-db";
 
@@ -162,6 +177,8 @@ hpcrun_fmt_hdr_free(hpcrun_fmt_hdr_t* hdr, hpcfmt_free_fn dealloc);
 #define HPCRUN_FMT_NV_traceMinTime "trace-min-time"
 #define HPCRUN_FMT_NV_traceMaxTime "trace-max-time"
 
+#define HPCRUN_FMT_NV_snapshot     "snapshot"
+
 #define HPCRUN_FMT_METRIC_HIDE            0
 #define HPCRUN_FMT_METRIC_SHOW            1
 #define HPCRUN_FMT_METRIC_SHOW_INCLUSIVE  2
@@ -175,9 +192,13 @@ static const char HPCRUN_FMT_EpochTag[] = "EPOCH___";
 static const int  HPCRUN_FMT_EpochTagLen = (sizeof(HPCRUN_FMT_EpochTag) - 1);
 
 
+// isSparseMetrics: each cct-node stores only its nonzero metrics as
+//   (metric-id, value) pairs instead of one value per metric.
+//   Requires fewer than 2^16 metrics.
 typedef struct epoch_flags_bitfield {
   bool isLogicalUnwind : 1;
-  uint64_t unused      : 63;
+  bool isSparseMetrics : 1;
+  uint64_t unused      : 62;
 } epoch_flags_bitfield;
 
 
@@ -559,6 +580,10 @@ extern int
 hpcrun_fmt_cct_node_fwrite(hpcrun_fmt_cct_node_t* x,
 			   epoch_flags_t flags, FILE* fs);
 
+extern int
+hpcrun_fmt_cct_node_outbuf(hpcrun_fmt_cct_node_t* x,
+			   epoch_flags_t flags, hpcio_outbuf_t* outbuf);
+
 extern int
 hpcrun_fmt_cct_node_fprint(hpcrun_fmt_cct_node_t* x, FILE* fs,
 			   epoch_flags_t flags, const metric_tbl_t* metricTbl,
@@ -590,11 +615,16 @@ hpcrun_fmt_lip_fprint(lush_lip_t* x, FILE* fs, const char* pre);
 // Header sizes:
 // - version 1.00: 24 bytes
 // - version 1.01: 32 bytes: 24 + sizeof(hpctrace_hdr_flags_t)
+// - version 1.02: 32 bytes (as 1.01); records are compact (see below)
 
 static const char HPCTRACE_FMT_Magic[]   = "HPCRUN-trace______"; // 18 bytes
 static const char HPCTRACE_FMT_Version[] = "01.01";              // 5 bytes
 static const char HPCTRACE_FMT_Endian[]  = "b";                  // 1 byte
 
+// compact format: same magic and endian; distinguished by version
+static const char HPCTRACE_FMT_VersionCompact[] = "01.02";       // 5 bytes
+static const double HPCTRACE_FMT_VersionCompactNum = 1.02;
+
 // Use of bit fields is not recommended as the order of fields 
 // is compiler and architecture dependent.
 /*
@@ -648,16 +678,28 @@ typedef struct hpctrace_fmt_hdr_t {
 } hpctrace_fmt_hdr_t;
 
 
+#define HPCTRACE_FMT_IsCompact(hdr) \
+  ((hdr)->version >= HPCTRACE_FMT_VersionCompactNum)
+
+
 int
 hpctrace_fmt_hdr_fread(hpctrace_fmt_hdr_t* hdr, FILE* infs);
 
 int
 hpctrace_fmt_hdr_outbuf(hpctrace_hdr_flags_t flags, hpcio_outbuf_t* outbuf);
 
+int
+hpctrace_fmt_hdr_compact_outbuf(hpctrace_hdr_flags_t flags,
+				hpcio_outbuf_t* outbuf);
+
 // N.B.: not async safe
 int
 hpctrace_fmt_hdr_fwrite(hpctrace_hdr_flags_t flags, FILE* fs);
 
+// N.B.: not async safe
+int
+hpctrace_fmt_hdr_compact_fwrite(hpctrace_hdr_flags_t flags, FILE* fs);
+
 int
 hpctrace_fmt_hdr_fprint(hpctrace_fmt_hdr_t* hdr, FILE* fs);
 
@@ -725,6 +767,113 @@ hpctrace_fmt_datum_fprint(hpctrace_fmt_datum_t* x, hpctrace_hdr_flags_t flags,
 			  FILE* fs);
 
 
+//***************************************************************************
+// [hpctrace] compact trace records (version 1.02)
+//***************************************************************************
+
+// Records are grouped into blocks that decode independently:
+//
+//   block:   blk-hdr payload
+//   blk-hdr: (24 bytes)
+//     numBytes (4): size of payload
+//     numDatum (4): number of records in payload
+//     begTime  (8): time of first record
+//     endTime  (8): time of last record
+//
+// The block headers form a time index: a reader finds the block
+// containing a given time by skipping 'numBytes' from header to header.
+//
+// Each record in a payload is a sequence of varints (LEB128: 7 bits
+// per byte, low-order first):
+//
+//   zigzag(comp - prev.comp)  (prev.comp = begTime for the first record)
+//   0, if (cpId, metricId) repeat the previous record's; else cpId + 1
+//   metricId                  (if data-centric and not repeated)
+
+#define HPCTRACE_FMT_BlkHdrLen     24
+#define HPCTRACE_FMT_BlkPayloadMax 4096 // max. payload bytes per block
+#define HPCTRACE_FMT_DatumMaxLen   (10 + 5 + 5) // max. bytes per record
+
+typedef struct hpctrace_fmt_blk_hdr_t {
+  uint32_t numBytes;
+  uint32_t numDatum;
+  uint64_t begTime;
+  uint64_t endTime;
+} hpctrace_fmt_blk_hdr_t;
+
+
+// A block being written or read.  Writers append records with
+// hpctrace_fmt_blk_add() and emit the block when hpctrace_fmt_blk_isFull();
+// readers step through the records with hpctrace_fmt_datum_decode().
+typedef struct hpctrace_fmt_blk_t {
+  hpctrace_fmt_blk_hdr_t hdr;
+  uint32_t pos;              // reader: offset of next record in 'buf'
+  uint32_t idx;              // reader: index of next record
+  hpctrace_fmt_datum_t prev; // previous record
+  unsigned char buf[HPCTRACE_FMT_BlkPayloadMax];
+} hpctrace_fmt_blk_t;
+
+
+void
+hpctrace_fmt_blk_init(hpctrace_fmt_blk_t* blk);
+
+#define hpctrace_fmt_blk_isFull(blk) \
+  ((blk)->hdr.numBytes + HPCTRACE_FMT_DatumMaxLen > HPCTRACE_FMT_BlkPayloadMax)
+
+void
+hpctrace_fmt_blk_add(hpctrace_fmt_blk_t* blk, hpctrace_fmt_datum_t* x,
+		     hpctrace_hdr_flags_t flags);
+
+// Writes a non-empty block and re-initializes it.
+int
+hpctrace_fmt_blk_outbuf(hpctrace_fmt_blk_t* blk, hpcio_outbuf_t* outbuf);
+
+// N.B.: not async safe
+int
+hpctrace_fmt_blk_fwrite(hpctrace_fmt_blk_t* blk, FILE* fs);
+
+// Reads the next block and prepares to decode its records.
+// Returns HPCFMT_EOF at the end of the file.
+int
+hpctrace_fmt_blk_fread(hpctrace_fmt_blk_t* blk, FILE* fs);
+
+
+// Appends to 'blk', first writing it if full.
+int
+hpctrace_fmt_datum_blk_outbuf(hpctrace_fmt_datum_t* x,
+			      hpctrace_hdr_flags_t flags,
+			      hpctrace_fmt_blk_t* blk, hpcio_outbuf_t* outbuf);
+
+// N.B.: not async safe
+int
+hpctrace_fmt_datum_blk_fwrite(hpctrace_fmt_datum_t* x,
+			      hpctrace_hdr_flags_t flags,
+			      hpctrace_fmt_blk_t* blk, FILE* fs);
+
+// Reads the next record, reading the next block of 'fs' when 'blk' is
+// exhausted.  Returns HPCFMT_EOF at the end of the file.
+int
+hpctrace_fmt_datum_blk_fread(hpctrace_fmt_datum_t* x,
+			     hpctrace_hdr_flags_t flags,
+			     hpctrace_fmt_blk_t* blk, FILE* fs);
+
+
+// In-memory forms for readers that map trace files.  Returns HPCFMT_ERR
+// if 'buf' does not hold a valid block header.
+int
+hpctrace_fmt_blk_hdr_decode(hpctrace_fmt_blk_hdr_t* x,
+			    const unsigned char* buf, size_t bufSz);
+
+// Decodes the record at 'buf' given the previous record 'prev' of its
+// block (for the first record: comp = begTime, cpId = metricId = 0).
+// Returns the end of the record, or NULL if it is not within 'end'.
+const unsigned char*
+hpctrace_fmt_datum_decode(hpctrace_fmt_datum_t* x,
+			  const hpctrace_fmt_datum_t* prev,
+			  hpctrace_hdr_flags_t flags,
+			  const unsigned char* buf, const unsigned char* end);
+
+
 //***************************************************************************
 // hpcprof-metricdb (located here for now)
 //***************************************************************************
@@ -737,6 +886,10 @@ static const char HPCMETRICDB_FMT_Magic[]   = "HPCPROF-metricdb__"; // 18 bytes
 static const char HPCMETRICDB_FMT_Version[] = "00.10";              // 5 bytes
 static const char HPCMETRICDB_FMT_Endian[]  = "b";                  // 1 byte
 
+// sparse format: same magic and endian; distinguished by version
+static const char HPCMETRICDB_FMT_VersionSparse[] = "01.00";        // 5 bytes
+static const double HPCMETRICDB_FMT_VersionSparseNum = 1.0;
+
 #define HPCMETRICDB_FMT_MagicLenX   (sizeof(HPCMETRICDB_FMT_Magic) - 1)
 #define HPCMETRICDB_FMT_VersionLenX (sizeof(HPCMETRICDB_FMT_Version) - 1)
 #define HPCMETRICDB_FMT_EndianLenX  (sizeof(HPCMETRICDB_FMT_Endian) - 1)
@@ -760,18 +913,188 @@ typedef struct hpcmetricDB_fmt_hdr_t {
   uint32_t numNodes;
   uint32_t numMetrics;
 
+  // sparse format only
+  uint32_t numNZNodes;  // nodes with at least one non-zero value
+  uint64_t numNZValues; // total number of non-zero values
+
 } hpcmetricDB_fmt_hdr_t;
 
 
+static inline bool
+hpcmetricDB_fmt_isSparse(const hpcmetricDB_fmt_hdr_t* hdr)
+{
+  return (hdr->version >= HPCMETRICDB_FMT_VersionSparseNum);
+}
+
+
 int
 hpcmetricDB_fmt_hdr_fread(hpcmetricDB_fmt_hdr_t* hdr, FILE* infs);
 
+// writes a dense header; cf. hpcmetricDB_fmt_sparse_hdr_fwrite
 int
 hpcmetricDB_fmt_hdr_fwrite(hpcmetricDB_fmt_hdr_t* hdr, FILE* outfs);
 
 int
 hpcmetricDB_fmt_hdr_fprint(hpcmetricDB_fmt_hdr_t* hdr, FILE* outfs);
 
+
+//***************************************************************************
+// [hpcprof-metricdb] sparse format
+//***************************************************************************
+
+// A dense metric-db is the header followed by a numNodes x numMetrics
+// matrix of real8 values (row i is CCT node i+1).
+//
+// A sparse metric-db is the header (with numNZNodes and numNZValues)
+// followed by
+//   node-idx = (node-id{4b} value-idx{8b}){numNZNodes + 1}
+//   values   = (metric-id{4b} value{8b}){numNZValues}
+// Node ids in node-idx are strictly ascending; node-idx[i]'s values
+// are values[node-idx[i].value-idx, node-idx[i+1].value-idx).  The
+// last node-idx entry is a sentinel (HPCMETRICDB_FMT_NodeId_NULL,
+// numNZValues).  All records have fixed size, allowing random access
+// by node.
+
+#define HPCMETRICDB_FMT_NodeId_NULL (UINT32_MAX)
+
+typedef struct hpcmetricDB_fmt_nzidx_t {
+  uint32_t nodeId;
+  uint64_t valueIdx;
+} hpcmetricDB_fmt_nzidx_t;
+
+typedef struct hpcmetricDB_fmt_nzval_t {
+  uint32_t metricId; // relative to the first metric in the database
+  double value;
+} hpcmetricDB_fmt_nzval_t;
+
+static const int HPCMETRICDB_FMT_SparseHdrLen =
+  (HPCMETRICDB_FMT_HeaderLen + 4 + 4 + 4 + 8);
+static const int HPCMETRICDB_FMT_NZIdxLen = (4 + 8);
+static const int HPCMETRICDB_FMT_NZValLen = (4 + 8);
+
+
+int
+hpcmetricDB_fmt_sparse_hdr_fwrite(hpcmetricDB_fmt_hdr_t* hdr, FILE* outfs);
+
+int
+hpcmetricDB_fmt_nzidx_fread(hpcmetricDB_fmt_nzidx_t* x, FILE* infs);
+
+int
+hpcmetricDB_fmt_nzidx_fwrite(hpcmetricDB_fmt_nzidx_t* x, FILE* outfs);
+
+int
+hpcmetricDB_fmt_nzval_fread(hpcmetricDB_fmt_nzval_t* x, FILE* infs);
+
+int
+hpcmetricDB_fmt_nzval_fwrite(hpcmetricDB_fmt_nzval_t* x, FILE* outfs);
+
+// hpcmetricDB_fmt_sparse_node_fread: Given the node index 'nzidx'
+//   (the numNZNodes + 1 entries following the header), read the
+//   metric values of node 'nodeId' into 'values' (an array of
+//   hdr->numMetrics reals, zeroed first).
+int
+hpcmetricDB_fmt_sparse_node_fread(const hpcmetricDB_fmt_hdr_t* hdr,
+				  const hpcmetricDB_fmt_nzidx_t* nzidx,
+				  uint32_t nodeId, double* values, FILE* infs);
+
+
+//***************************************************************************
+// hpcrun output container (located here for now)
+//***************************************************************************
+
+// An output container holds all output files ('members') of one
+// process, e.g., the profile and trace of each of its threads, so that
+// a process creates one file instead of two per thread:
+//
+//   container = hdr segment* [index trailer]
+//   hdr       = magic{18b} version{5b} endian{1b}
+//   segment   = kind{4b} member-id{4b} length{8b} payload{length}
+//   index     = segment of kind Index whose payload is one
+//               (kind{4b} member-id{4b} offset{8b} length{8b})
+//               entry per segment; 'offset' locates the segment hdr
+//   trailer   = index-offset{8b} tag{8b}
+//
+// A member's contents are the payloads of its Data segments in offset
+// order.  Its name, the file name it would have had if written as a
+// separate file, is the payload of its Name segment.  Writers reserve
+// space for a segment by atomically advancing the end of the
+// container, so segments of different members interleave.  The index
+// is written when the process exits; without it (e.g., the process
+// crashed) a reader scans segment headers from the front, stopping at
+// the first unwritten (zero) one.
+
+static const char HPCCONTAINER_FMT_Magic[]   = "HPCRUN-container__"; // 18 bytes
+static const char HPCCONTAINER_FMT_Version[] = "01.00";              // 5 bytes
+static const char HPCCONTAINER_FMT_Endian[]  = "b";                  // 1 byte
+
+static const char HPCCONTAINER_FMT_TrailerTag[] = "HPCCIDX_";        // 8 bytes
+
+#define HPCCONTAINER_FMT_MagicLenX   (sizeof(HPCCONTAINER_FMT_Magic) - 1)
+#define HPCCONTAINER_FMT_VersionLenX (sizeof(HPCCONTAINER_FMT_Version) - 1)
+#define HPCCONTAINER_FMT_EndianLenX  (sizeof(HPCCONTAINER_FMT_Endian) - 1)
+#define HPCCONTAINER_FMT_TagLenX     (sizeof(HPCCONTAINER_FMT_TrailerTag) - 1)
+
+static const int HPCCONTAINER_FMT_MagicLen   = HPCCONTAINER_FMT_MagicLenX;
+static const int HPCCONTAINER_FMT_VersionLen = HPCCONTAINER_FMT_VersionLenX;
+static const int HPCCONTAINER_FMT_EndianLen  = HPCCONTAINER_FMT_EndianLenX;
+
+// N.B.: #defines so that they can size arrays
+#define HPCCONTAINER_FMT_HeaderLen					\
+  (HPCCONTAINER_FMT_MagicLenX + HPCCONTAINER_FMT_VersionLenX		\
+   + HPCCONTAINER_FMT_EndianLenX)
+
+#define HPCCONTAINER_FMT_SegHdrLen   (4 + 4 + 8)
+#define HPCCONTAINER_FMT_IdxEntryLen (4 + 4 + 8 + 8)
+#define HPCCONTAINER_FMT_TrailerLen  (8 + HPCCONTAINER_FMT_TagLenX)
+
+// segment kinds
+#define HPCCONTAINER_FMT_SegNULL  0 // unwritten space
+#define HPCCONTAINER_FMT_SegData  1
+#define HPCCONTAINER_FMT_SegName  2
+#define HPCCONTAINER_FMT_SegIndex 3
+
+
+typedef struct hpccontainer_fmt_seg_t {
+  uint32_t kind;
+  uint32_t memberId;
+  uint64_t offset; // of the segment hdr; the payload follows it
+  uint64_t len;    // of the payload
+} hpccontainer_fmt_seg_t;
+
+
+// Writers: encode into 'buf', which must hold HPCCONTAINER_FMT_HeaderLen,
+// _SegHdrLen, _IdxEntryLen or _TrailerLen bytes respectively.  These
+// are safe inside signal handlers.
+
+void
+hpccontainer_fmt_hdr_encode(unsigned char* buf);
+
+void
+hpccontainer_fmt_seg_hdr_encode(const hpccontainer_fmt_seg_t* x,
+				unsigned char* buf);
+
+void
+hpccontainer_fmt_idx_entry_encode(const hpccontainer_fmt_seg_t* x,
+				  unsigned char* buf);
+
+void
+hpccontainer_fmt_trailer_encode(uint64_t idxOffset, unsigned char* buf);
+
+
+// hpccontainer_fmt_segs_fread: reads the Data and Name segments of the
+//   container 'infs' (from its index if it has one, else by scanning)
+//   into '*segs', sorted by offset.  Returns HPCFMT_ERR if 'infs' is
+//   not a container.
+int
+hpccontainer_fmt_segs_fread(hpccontainer_fmt_seg_t** segs, uint32_t* numSegs,
+			    FILE* infs, hpcfmt_alloc_fn alloc);
+
+// hpccontainer_fmt_name_fread: reads the member name in Name segment 'seg'
+int
+hpccontainer_fmt_name_fread(char** name, const hpccontainer_fmt_seg_t* seg,
+			    FILE* infs, hpcfmt_alloc_fn alloc);
+
+
 // --------------------------------------------------------------------------
 // additional sampling info
 // --------------------------------------------------------------------------
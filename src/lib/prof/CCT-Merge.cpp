@@ -91,7 +91,8 @@ namespace CCT {
 //***************************************************************************
 
 MergeContext::MergeContext(Tree* cct, bool doTrackCPIds)
-  : m_cct(cct), m_mrgFlag(0), m_isTrackingCPIds(doTrackCPIds)
+  : m_cct(cct), m_mrgFlag(0), m_mergedNodes(NULL),
+    m_isTrackingCPIds(doTrackCPIds)
 {
   if (isTrackingCPIds()) {
     fillCPIdSet(cct);
@@ -113,6 +114,78 @@ MergeContext::fillCPIdSet(Tree* cct)
 }
 
 
+//***************************************************************************
+// DynChildIdx
+//***************************************************************************
+
+DynChildIdx::Key::Key(const ADynNode& n)
+  : lmIP(n.lmIP_real()), lip0(0), lip1(0), lmId(n.lmId_real()),
+    assocLen(lush_assoc_info__get_path_len(n.assocInfo())),
+    hasLip(n.lip() != NULL), isLeaf(n.isLeaf())
+{
+  if (hasLip) {
+    lip0 = n.lip()->data8[0];
+    lip1 = n.lip()->data8[1];
+  }
+}
+
+
+DynChildIdx::DynChildIdx(ANode* x)
+{
+  insertDescendents(x);
+}
+
+
+bool
+DynChildIdx::isIndexable(const ADynNode& y_dyn)
+{
+  return !(y_dyn.isLeaf() && y_dyn.structure());
+}
+
+
+ADynNode*
+DynChildIdx::find(const ADynNode& y_dyn) const
+{
+  KeyMap::const_iterator it = m_map.find(Key(y_dyn));
+  if (it == m_map.end()) {
+    return NULL;
+  }
+
+  const std::vector<ADynNode*>& candidates = it->second;
+  for (uint i = 0; i < candidates.size(); ++i) {
+    // N.B.: association classes are not an equivalence relation
+    if (ADynNode::isMergable(*candidates[i], y_dyn)) {
+      return candidates[i];
+    }
+  }
+  return NULL;
+}
+
+
+void
+DynChildIdx::insert(ADynNode* x_dyn)
+{
+  m_map[Key(*x_dyn)].push_back(x_dyn);
+}
+
+
+void
+DynChildIdx::insertDescendents(ANode* x)
+{
+  // N.B.: same visit order as ANode::findDynChild()
+  for (ANodeChildIterator it(x); it.Current(); ++it) {
+    ANode* x_child = it.current();
+    ADynNode* x_child_dyn = dynamic_cast<ADynNode*>(x_child);
+    if (x_child_dyn) {
+      insert(x_child_dyn);
+    }
+    else {
+      insertDescendents(x_child);
+    }
+  }
+}
+
+
 //***************************************************************************
 // MergeEffect
 //***************************************************************************
@@ -68,6 +68,7 @@
 #include <vector>
 #include <list>
 #include <set>
+#include <unordered_map>
 
 //*************************** User Include Files ****************************
 
@@ -140,6 +141,7 @@ namespace Prof {
 namespace CCT {
 
 class Tree;
+class ANode;
 
 enum {
   // -------------------------------------------------------
@@ -185,6 +187,27 @@ public:
   { return (m_mrgFlag & MrgFlg_PropagateEffects); }
 
 
+  // -------------------------------------------------------
+  // merged nodes: if a collector is set, each node of the target
+  // tree that receives metric values is appended to it
+  // -------------------------------------------------------
+  void
+  mergedNodes(std::vector<ANode*>* nodes)
+  { m_mergedNodes = nodes; }
+
+  bool
+  isCollectingMergedNodes() const
+  { return (m_mergedNodes != NULL); }
+
+  void
+  noteMergedNode(ANode* x)
+  {
+    if (m_mergedNodes) {
+      m_mergedNodes->push_back(x);
+    }
+  }
+
+
   // -------------------------------------------------------
   //
   // -------------------------------------------------------
@@ -263,6 +286,8 @@ private:
 
   uint m_mrgFlag;
 
+  std::vector<ANode*>* m_mergedNodes;
+
   bool m_isTrackingCPIds;
   CPIdSet m_cpIdSet;
 };
@@ -272,6 +297,89 @@ private:
 } // namespace Prof
 
 
+//***************************************************************************
+// DynChildIdx
+//***************************************************************************
+
+namespace Prof {
+
+namespace CCT {
+
+class ANode;
+class ADynNode;
+
+// DynChildIdx: A transient index over the direct ADynNode descendents
+//   of a node x (cf. ANode::findDynChild()) for merging a high-fanout
+//   node y into x.  Nodes are keyed by the fields that
+//   ADynNode::isMergable() compares for equality (leaf-ness, load
+//   module id and ip, logical ip and association path length);
+//   candidates with equal keys are then checked with isMergable() in
+//   the order findDynChild() would visit them.
+//
+// N.B.: The index does not observe changes to the tree; callers must
+//   insert() nodes linked under x while the index is live.
+class DynChildIdx {
+public:
+  DynChildIdx(ANode* x);
+
+  // isIndexable: whether find() is equivalent to ANode::findDynChild()
+  //   for y_dyn.  (isMergable() has a special case for structured
+  //   leaves that does not depend on the key.)
+  static bool
+  isIndexable(const ADynNode& y_dyn);
+
+  // find: Given y_dyn (where isIndexable(y_dyn)), return the first
+  //   indexed x_dyn for which ADynNode::isMergable(x_dyn, y_dyn) holds.
+  ADynNode*
+  find(const ADynNode& y_dyn) const;
+
+  void
+  insert(ADynNode* x_dyn);
+
+  // the minimum fanout for which an index pays for itself
+  static const uint MinFanout = 16;
+
+private:
+  struct Key {
+    Key(const ADynNode& n);
+
+    bool
+    operator==(const Key& y) const
+    {
+      return (lmId == y.lmId && lmIP == y.lmIP && lip0 == y.lip0
+	      && lip1 == y.lip1 && hasLip == y.hasLip && isLeaf == y.isLeaf
+	      && assocLen == y.assocLen);
+    }
+
+    uint64_t lmIP, lip0, lip1;
+    uint lmId;
+    uint assocLen;
+    bool hasLip, isLeaf;
+  };
+
+  struct KeyHash {
+    size_t
+    operator()(const Key& k) const
+    {
+      uint64_t h = k.lmIP * 0x9e3779b97f4a7c15ULL;
+      h ^= ((uint64_t)k.lmId << 32) ^ k.lip0 ^ (k.lip1 << 1) ^ k.assocLen;
+      return (size_t)(h ^ (h >> 29));
+    }
+  };
+
+  typedef std::unordered_map<Key, std::vector<ADynNode*>, KeyHash> KeyMap;
+
+  void
+  insertDescendents(ANode* x);
+
+  KeyMap m_map;
+};
+
+} // namespace CCT
+
+} // namespace Prof
+
+
 //***************************************************************************
 
 #endif /* prof_Prof_CCT_Merge_hpp */
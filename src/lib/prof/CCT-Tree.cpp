@@ -163,7 +163,8 @@ Tree::~Tree()
 
 
 MergeEffectList*
-Tree::merge(const Tree* y, uint x_newMetricBegIdx, uint mrgFlag, uint oFlag)
+Tree::merge(const Tree* y, uint x_newMetricBegIdx, uint mrgFlag, uint oFlag,
+	    std::vector<ANode*>* mergedNodes)
 {
   Tree* x = this;
   ANode* x_root = root();
@@ -205,10 +206,13 @@ Tree::merge(const Tree* y, uint x_newMetricBegIdx, uint mrgFlag, uint oFlag)
     m_mergeCtxt = new MergeContext(x, doTrackCPIds);
   }
   m_mergeCtxt->flags(mrgFlag);
+  m_mergeCtxt->mergedNodes(mergedNodes);
   
   MergeEffectList* mrgEffects =
     x_root->mergeDeep(y_root, x_newMetricBegIdx, *m_mergeCtxt, oFlag);
 
+  m_mergeCtxt->mergedNodes(NULL);
+
   DIAG_If(0 /*public diag level*/) {
     verifyUniqueCPIds();
   }
@@ -336,7 +340,7 @@ ANode::IntToANodeType(long i)
   return (ANodeTy)i;
 }
 
-uint ANode::s_nextUniqueId = 2;
+std::atomic<uint> ANode::s_nextUniqueId(2);
 
 
 //***************************************************************************
@@ -516,14 +520,12 @@ ANode::aggregateMetricsExcl(const VMAIntervalSet& ivalset)
 }
 
 
-void
-ANode::aggregateMetricsExcl(AProcNode* frame, const VMAIntervalSet& ivalset)
+// Classify 'n' for exclusive metric aggregation: returns whether n is
+// a logical procedure (a frame, or an inline call or macro) and sets
+// 'isInlineMacro'.
+static bool
+isLogicalProcForExcl(ANode* n, bool& isInlineMacro)
 {
-  ANode* n = this;
-
-  // -------------------------------------------------------
-  // Pre-order visit
-  // -------------------------------------------------------
   //
   // laks 2015.10.21: we don't want accumulate the exclusive cost of 
   // an inlined statement to the caller. Instead, we assume an inline
@@ -533,7 +535,7 @@ ANode::aggregateMetricsExcl(AProcNode* frame, const VMAIntervalSet& ivalset)
   bool isFrame = (typeid(*n) == typeid(ProcFrm));
   bool isProc  = (typeid(*n) == typeid(Proc));
 
-  bool isInlineMacro = false;
+  isInlineMacro = false;
   bool isInlineCall  = false;
 
   NonUniformDegreeTreeNode *parent = n->Parent();
@@ -559,7 +561,20 @@ ANode::aggregateMetricsExcl(AProcNode* frame, const VMAIntervalSet& ivalset)
     isInlineMacro = !isInlineCall && myprocname.compare(GUARD_NAME) == 0;
   }
 
-  bool isLogicalProc   = isFrame || isInlineCall || isInlineMacro;
+  return isFrame || isInlineCall || isInlineMacro;
+}
+
+
+void
+ANode::aggregateMetricsExcl(AProcNode* frame, const VMAIntervalSet& ivalset)
+{
+  ANode* n = this;
+
+  // -------------------------------------------------------
+  // Pre-order visit
+  // -------------------------------------------------------
+  bool isInlineMacro;
+  bool isLogicalProc   = isLogicalProcForExcl(n, isInlineMacro);
   AProcNode * frameNxt = (isLogicalProc) ? static_cast<AProcNode*>(n) : frame;
 
   // -------------------------------------------------------
@@ -593,6 +608,138 @@ ANode::aggregateMetricsExcl(AProcNode* frame, const VMAIntervalSet& ivalset)
 }
 
 
+//***************************************************************************
+// PartialTree
+//***************************************************************************
+
+PartialTree::PartialTree(ANode* root, const std::vector<ANode*>& nodes)
+  : m_root(root)
+{
+  m_children[root]; // the root is always in the span
+  m_nodes.push_back(root);
+
+  // Link each node into the span, stopping at the first ancestor
+  // that is already there.
+  for (uint i = 0; i < nodes.size(); ++i) {
+    ANode* n = nodes[i];
+    while (n != root && m_children.find(n) == m_children.end()) {
+      m_children[n];
+      m_nodes.push_back(n);
+
+      ANode* n_parent = n->parent();
+      DIAG_Assert(n_parent, "PartialTree: node is not a descendent of root");
+      m_children[n_parent].push_back(n);
+      n = n_parent;
+    }
+  }
+}
+
+
+void
+PartialTree::zeroMetrics(uint mBegId, uint mEndId)
+{
+  if ( !(mBegId < mEndId) ) {
+    return; // short circuit
+  }
+
+  for (uint i = 0; i < m_nodes.size(); ++i) {
+    m_nodes[i]->zeroMetrics(mBegId, mEndId);
+  }
+}
+
+
+void
+PartialTree::aggregateMetricsIncl(const VMAIntervalSet& ivalset)
+{
+  if (ivalset.empty()) {
+    return; // short circuit
+  }
+
+  aggregateMetricsIncl(m_root, ivalset);
+}
+
+
+void
+PartialTree::aggregateMetricsIncl(ANode* n, const VMAIntervalSet& ivalset)
+{
+  // post-order, as in ANode::aggregateMetricsIncl()
+  const std::vector<ANode*>* kids = children(n);
+  if (kids) {
+    for (uint i = 0; i < kids->size(); ++i) {
+      aggregateMetricsIncl((*kids)[i], ivalset);
+    }
+  }
+
+  if (n != m_root) {
+    ANode* n_parent = n->parent();
+
+    for (VMAIntervalSet::const_iterator it = ivalset.begin();
+	 it != ivalset.end(); ++it) {
+      const VMAInterval& ival = *it;
+      uint mBegId = (uint)ival.beg(), mEndId = (uint)ival.end();
+
+      for (uint mId = mBegId; mId < mEndId; ++mId) {
+	double mVal = n->demandMetric(mId, mEndId/*size*/);
+	n_parent->demandMetric(mId, mEndId/*size*/) += mVal;
+      }
+    }
+  }
+}
+
+
+void
+PartialTree::aggregateMetricsExcl(const VMAIntervalSet& ivalset)
+{
+  if (ivalset.empty()) {
+    return; // short circuit
+  }
+
+  // N.B.: as in ANode::aggregateMetricsExcl(), the root has no
+  // enclosing frame
+  aggregateMetricsExcl(m_root, NULL, ivalset);
+}
+
+
+void
+PartialTree::aggregateMetricsExcl(ANode* n, AProcNode* frame,
+				  const VMAIntervalSet& ivalset)
+{
+  // Pre-order visit
+  bool isInlineMacro;
+  bool isLogicalProc   = isLogicalProcForExcl(n, isInlineMacro);
+  AProcNode * frameNxt = (isLogicalProc) ? static_cast<AProcNode*>(n) : frame;
+
+  // Tree traversal
+  const std::vector<ANode*>* kids = children(n);
+  if (kids) {
+    for (uint i = 0; i < kids->size(); ++i) {
+      aggregateMetricsExcl((*kids)[i], frameNxt, ivalset);
+    }
+  }
+
+  // Post-order visit
+  if (typeid(*n) == typeid(CCT::Stmt) || isInlineMacro) {
+    ANode* n_parent = n->parent();
+
+    for (VMAIntervalSet::const_iterator it = ivalset.begin();
+        it != ivalset.end(); ++it) {
+      const VMAInterval& ival = *it;
+      uint mBegId = (uint)ival.beg(), mEndId = (uint)ival.end();
+
+      for (uint mId = mBegId; mId < mEndId; ++mId) {
+        double mVal = n->demandMetric(mId, mEndId/*size*/);
+        n_parent->demandMetric(mId, mEndId/*size*/) += mVal;
+        if (frame && frame != n_parent) {
+          frame->demandMetric(mId, mEndId/*size*/) += mVal;
+        }
+      }
+    }
+  }
+}
+
+
+//***************************************************************************
+
 void
 ANode::computeMetrics(const Metric::Mgr& mMgr, uint mBegId, uint mEndId,
 		      bool doFinal)
@@ -604,9 +751,41 @@ ANode::computeMetrics(const Metric::Mgr& mMgr, uint mBegId, uint mEndId,
   // N.B. pre-order walk assumes point-wise metrics
   // Cf. Analysis::Flat::Driver::computeDerivedBatch().
 
+  // Compile the metrics' expressions (in metric order, as in
+  // computeMetricsMe()) into one program and run it on batches of nodes
+  uint numMetrics = mMgr.size();
+
+  Metric::AExprProgram prog;
+  for (uint mId = mBegId; mId < mEndId; ++mId) {
+    const Metric::ADesc* m = mMgr.metric(mId);
+    const Metric::DerivedDesc* mm = dynamic_cast<const Metric::DerivedDesc*>(m);
+    if (mm && mm->expr()) {
+      const Metric::AExpr* expr = mm->expr();
+      expr->compileNF(prog);
+      if (doFinal) {
+	expr->compile(prog);
+	prog.emitStore(mId, numMetrics/*size*/);
+      }
+    }
+  }
+
+  if (prog.empty()) {
+    return;
+  }
+
+  Metric::IData* batch[Metric::AExprProgram::BatchSz];
+  std::vector<double> stack;
+  uint batchSz = 0;
+
   for (ANodeIterator it(this); it.Current(); ++it) {
-    ANode* n = it.current();
-    n->computeMetricsMe(mMgr, mBegId, mEndId, doFinal);
+    batch[batchSz++] = it.current();
+    if (batchSz == Metric::AExprProgram::BatchSz) {
+      prog.eval(batch, batchSz, stack);
+      batchSz = 0;
+    }
+  }
+  if (batchSz > 0) {
+    prog.eval(batch, batchSz, stack);
   }
 }
 
@@ -643,9 +822,60 @@ ANode::computeMetricsIncr(const Metric::Mgr& mMgr, uint mBegId, uint mEndId,
   // N.B. pre-order walk assumes point-wise metrics
   // Cf. Analysis::Flat::Driver::computeDerivedBatch().
 
+  // Resolve the expressions and the function once, then apply them to
+  // batches of nodes (in metric order for each node, as in
+  // computeMetricsIncrMe())
+  vector<const Metric::AExprIncr*> exprs;
+  for (uint mId = mBegId; mId < mEndId; ++mId) {
+    const Metric::ADesc* m = mMgr.metric(mId);
+    const Metric::DerivedIncrDesc* mm =
+      dynamic_cast<const Metric::DerivedIncrDesc*>(m);
+    if (mm && mm->expr()) {
+      exprs.push_back(mm->expr());
+    }
+  }
+
+  if (exprs.empty()) {
+    return;
+  }
+
+  double (Metric::AExprIncr::*exprFn)(Metric::IData&) const = NULL;
+  switch (fn) {
+    case Metric::AExprIncr::FnInit:
+      exprFn = &Metric::AExprIncr::initialize; break;
+    case Metric::AExprIncr::FnInitSrc:
+      exprFn = &Metric::AExprIncr::initializeSrc; break;
+    case Metric::AExprIncr::FnAccum:
+      exprFn = &Metric::AExprIncr::accumulate; break;
+    case Metric::AExprIncr::FnCombine:
+      exprFn = &Metric::AExprIncr::combine; break;
+    case Metric::AExprIncr::FnFini:
+      exprFn = &Metric::AExprIncr::finalize; break;
+    default:
+      DIAG_Die(DIAG_UnexpectedInput);
+  }
+
+  const uint BatchSz = Metric::AExprProgram::BatchSz;
+  ANode* batch[BatchSz];
+  uint batchSz = 0;
+
+  auto applyBatch = [&]() {
+    for (uint i = 0; i < exprs.size(); ++i) {
+      for (uint k = 0; k < batchSz; ++k) {
+	(exprs[i]->*exprFn)(*batch[k]);
+      }
+    }
+    batchSz = 0;
+  };
+
   for (ANodeIterator it(this); it.Current(); ++it) {
-    ANode* n = it.current();
-    n->computeMetricsIncrMe(mMgr, mBegId, mEndId, fn);
+    batch[batchSz++] = it.current();
+    if (batchSz == BatchSz) {
+      applyBatch();
+    }
+  }
+  if (batchSz > 0) {
+    applyBatch();
   }
 }
 
@@ -834,6 +1064,14 @@ ANode::mergeDeep(ANode* y, uint x_newMetricBegIdx, MergeContext& mrgCtxt,
   //    recur.
   // ------------------------------------------------------------
   MergeEffectList* effctLst = new MergeEffectList;
+
+  // For high-fanout nodes, avoid a linear findDynChild() per child of
+  // y.  The index lives only for this merge step.
+  DynChildIdx* x_childIdx = NULL;
+  if (y->childCount() >= DynChildIdx::MinFanout
+      && x->childCount() >= DynChildIdx::MinFanout) {
+    x_childIdx = new DynChildIdx(x);
+  }
   
   for (ANodeChildIterator it(y); it.Current(); /* */) {
     ANode* y_child = it.current();
@@ -843,7 +1081,13 @@ ANode::mergeDeep(ANode* y, uint x_newMetricBegIdx, MergeContext& mrgCtxt,
 
     MergeEffectList* effctLst1 = NULL;
 
-    ADynNode* x_child_dyn = x->findDynChild(*y_child_dyn);
+    ADynNode* x_child_dyn = NULL;
+    if (x_childIdx && DynChildIdx::isIndexable(*y_child_dyn)) {
+      x_child_dyn = x_childIdx->find(*y_child_dyn);
+    }
+    else {
+      x_child_dyn = x->findDynChild(*y_child_dyn);
+    }
 
 #define MERGE_ACTION 0
 #define MERGE_ERROR 0
@@ -865,6 +1109,14 @@ ANode::mergeDeep(ANode* y, uint x_newMetricBegIdx, MergeContext& mrgCtxt,
 	effctLst1 = y_child->mergeDeep_fixInsert(x_newMetricBegIdx, mrgCtxt);
 
 	y_child->link(x);
+	if (mrgCtxt.isCollectingMergedNodes()) {
+	  for (ANodeIterator it1(y_child); it1.Current(); ++it1) {
+	    mrgCtxt.noteMergedNode(it1.current());
+	  }
+	}
+	if (x_childIdx) {
+	  x_childIdx->insert(y_child_dyn);
+	}
       }
     }
     else {
@@ -875,6 +1127,7 @@ ANode::mergeDeep(ANode* y, uint x_newMetricBegIdx, MergeContext& mrgCtxt,
 		 << "\n  y: " << y_child_dyn->toStringMe(Tree::OFlg_Debug));
       MergeEffect effct =
 	x_child_dyn->mergeMe(*y_child_dyn, &mrgCtxt, x_newMetricBegIdx);
+      mrgCtxt.noteMergedNode(x_child_dyn);
       if (mrgCtxt.doPropagateEffects() && !effct.isNoop()) {
 	effctLst->push_back(effct);
       }
@@ -890,6 +1143,8 @@ ANode::mergeDeep(ANode* y, uint x_newMetricBegIdx, MergeContext& mrgCtxt,
     delete effctLst1;
   }
 
+  delete x_childIdx;
+
   return effctLst;
 }
 
@@ -68,9 +68,12 @@
 #include <vector>
 #include <list>
 #include <set>
+#include <unordered_map>
 
 #include <typeinfo>
 
+#include <atomic>
+
 #include <cstring> // for memcpy
 
 //*************************** User Include Files ****************************
@@ -172,11 +175,13 @@ public:
   { return m_metadata; }
   
   // -------------------------------------------------------
-  // Given a Tree, merge into 'this'
+  // Given a Tree, merge into 'this'.  If 'mergedNodes' is non-NULL,
+  // append each node of 'this' that receives metric values.
   // -------------------------------------------------------
   MergeEffectList*
   merge(const Tree* y, uint x_newMetricBegIdx,
-	uint mrgFlag = 0, uint oFlag = 0);
+	uint mrgFlag = 0, uint oFlag = 0,
+	std::vector<ANode*>* mergedNodes = NULL);
 
   // -------------------------------------------------------
   // dense ids (only used when explicitly requested)
@@ -320,19 +325,15 @@ public:
   ANode(ANodeTy type, ANode* parent, Struct::ACodeNode* strct = NULL)
     : NonUniformDegreeTreeNode(parent),
       Metric::IData(),
-      m_type(type), m_id(s_nextUniqueId), m_strct(strct)
-  {
-    s_nextUniqueId += 2; // cf. HPCRUN_FMT_RetainIdFlag
-  }
+      m_type(type), m_id(nextUniqueId()), m_strct(strct)
+  { }
 
   ANode(ANodeTy type,
 	ANode* parent, Struct::ACodeNode* strct, const Metric::IData& metrics)
     : NonUniformDegreeTreeNode(parent),
       Metric::IData(metrics),
-      m_type(type), m_id(s_nextUniqueId), m_strct(strct)
-  {
-    s_nextUniqueId += 2; // cf. HPCRUN_FMT_RetainIdFlag
-  }
+      m_type(type), m_id(nextUniqueId()), m_strct(strct)
+  { }
 
   virtual ~ANode()
   { }
@@ -341,10 +342,9 @@ public:
   ANode(const ANode& x)
     : NonUniformDegreeTreeNode(NULL),
       Metric::IData(x),
-      m_type(x.m_type), m_id(s_nextUniqueId), m_strct(x.m_strct)
+      m_type(x.m_type), m_id(nextUniqueId()), m_strct(x.m_strct)
   {
     zeroLinks();
-    s_nextUniqueId += 2; // cf. HPCRUN_FMT_RetainIdFlag
   }
 
   // deep copy of internals (but without children)
@@ -355,8 +355,7 @@ public:
       //NonUniformDegreeTreeNode::operator=(x);
       Metric::IData::operator=(x);
       m_type = x.m_type;
-      m_id = s_nextUniqueId;
-      s_nextUniqueId += 2;
+      m_id = nextUniqueId();
       // m_id: skip
       m_strct = x.m_strct;
     }
@@ -679,7 +678,12 @@ protected:
 
 
 private:
-  static uint s_nextUniqueId;
+  // N.B.: profiles may be read concurrently (Analysis::CallPath::read)
+  static uint
+  nextUniqueId()
+  { return s_nextUniqueId.fetch_add(2); } // cf. HPCRUN_FMT_RetainIdFlag
+
+  static std::atomic<uint> s_nextUniqueId;
   
 protected:
   ANodeTy m_type; // obsolete with typeid(), but hard to replace
@@ -1499,6 +1503,66 @@ class Stmt
 };
 
 
+//***************************************************************************
+// PartialTree
+//***************************************************************************
+
+// PartialTree: The part of a CCT spanned by a set of nodes and all of
+//   their ancestors, e.g., the nodes that one profile was merged into
+//   (cf. Tree::merge()).  When every node outside the span has zero
+//   values for a set of metrics, aggregating and zeroing those metrics
+//   over the span gives the same result as over the whole tree, but
+//   costs time proportional to the span, not the tree.
+class PartialTree
+{
+public:
+  // 'root' must be an ancestor of (or equal to) each node in 'nodes'
+  PartialTree(ANode* root, const std::vector<ANode*>& nodes);
+
+  ~PartialTree()
+  { }
+
+  // nodes in the span, in no particular order
+  const std::vector<ANode*>&
+  nodes() const
+  { return m_nodes; }
+
+  // cf. ANode::zeroMetricsDeep()
+  void
+  zeroMetrics(uint mBegId, uint mEndId);
+
+  // cf. ANode::aggregateMetricsIncl()
+  void
+  aggregateMetricsIncl(const VMAIntervalSet& ivalset);
+
+  // cf. ANode::aggregateMetricsExcl()
+  void
+  aggregateMetricsExcl(const VMAIntervalSet& ivalset);
+
+private:
+  typedef std::unordered_map<ANode*, std::vector<ANode*> > ChildMap;
+
+  void
+  aggregateMetricsIncl(ANode* n, const VMAIntervalSet& ivalset);
+
+  void
+  aggregateMetricsExcl(ANode* n, AProcNode* frame,
+		       const VMAIntervalSet& ivalset);
+
+  const std::vector<ANode*>*
+  children(ANode* n) const
+  {
+    ChildMap::const_iterator it = m_children.find(n);
+    return (it != m_children.end()) ? &(it->second) : NULL;
+  }
+
+private:
+  ANode* m_root;
+  std::vector<ANode*> m_nodes;
+  ChildMap m_children;
+};
+
+
 } // namespace CCT
 
 } // namespace Prof
@@ -105,6 +105,7 @@ using namespace xml;
 
 
 #include <lib/prof-lean/hpcfmt.h>
+#include <lib/prof-lean/hpcio-container.h>
 #include <lib/prof-lean/hpcrun-fmt.h>
 #include <lib/prof-lean/hpcrun-metric.h>
 
@@ -166,9 +167,11 @@ Profile::Profile(const std::string name)
 
   m_traceMinTime = UINT64_MAX;
   m_traceMaxTime = 0;
+  m_traceRemapper = NULL;
 
   m_mMgr = new Metric::Mgr;
   m_isMetricMgrVirtual = false;
+  m_isSparseMetricDB = false;
 
   m_loadmap = new LoadMap;
 
@@ -190,7 +193,8 @@ Profile::~Profile()
 
 
 uint
-Profile::merge(Profile& y, int mergeTy, uint mrgFlag)
+Profile::merge(Profile& y, int mergeTy, uint mrgFlag,
+	       std::vector<CCT::ANode*>* mergedNodes)
 {
   Profile& x = (*this);
 
@@ -226,7 +230,10 @@ Profile::merge(Profile& y, int mergeTy, uint mrgFlag)
   DIAG_WMsgIf(x.m_fmtVersion != y.m_fmtVersion,
 	      "CallPath::Profile::merge(): ignoring incompatible versions: "
 	      << x.m_fmtVersion << " vs. " << y.m_fmtVersion);
-  DIAG_WMsgIf(x.m_flags.bits != y.m_flags.bits,
+  // N.B.: isSparseMetrics only describes the on-disk node encoding
+  epoch_flags_t x_flags = x.m_flags, y_flags = y.m_flags;
+  x_flags.fields.isSparseMetrics = y_flags.fields.isSparseMetrics = false;
+  DIAG_WMsgIf(x_flags.bits != y_flags.bits,
 	      "CallPath::Profile::merge(): ignoring incompatible flags: "
 	      << x.m_flags.bits << " vs. " << y.m_flags.bits);
   DIAG_WMsgIf(x.m_measurementGranularity != y.m_measurementGranularity,
@@ -266,13 +273,14 @@ Profile::merge(Profile& y, int mergeTy, uint mrgFlag)
   }
 
   CCT::MergeEffectList* mrgEffects2 =
-    x.cct()->merge(y.cct(), x_newMetricBegIdx, mrgFlag);
+    x.cct()->merge(y.cct(), x_newMetricBegIdx, mrgFlag, 0/*oFlag*/,
+		   mergedNodes);
 
   DIAG_Assert(Logic::implies(mrgEffects2 && !mrgEffects2->empty(),
 			     mrgFlag & CCT::MrgFlg_NormalizeTraceFileY),
 	      "CallPath::Profile::merge: there should only be CCT::MergeEffects when MrgFlg_NormalizeTraceFileY is passed");
 
-  y.merge_fixTrace(mrgEffects2);
+  y.merge_fixTrace(mrgEffects2, x.m_traceRemapper);
   delete mrgEffects2;
 
   return firstMergedMetric;
@@ -381,10 +389,9 @@ Profile::merge_fixCCT(const std::vector<LoadMap::MergeEffect>* mrgEffects)
 
 
 void
-Profile::merge_fixTrace(const CCT::MergeEffectList* mrgEffects)
+Profile::merge_fixTrace(const CCT::MergeEffectList* mrgEffects,
+			TraceRemapper* traceRemapper)
 {
-  typedef std::map<uint, uint> UIntToUIntMap;
-
   // early exit for trivial case
   if (m_traceFileName.empty()) {
     return;
@@ -395,118 +402,36 @@ Profile::merge_fixTrace(const CCT::MergeEffectList* mrgEffects)
 
   // N.B.: We could build a map of old->new cpIds within
   // Profile::merge(), but the list of effects is more general and
-  // extensible.  There are no asymptotic problems with building the
-  // following map for local use.
-  UIntToUIntMap cpIdMap;
+  // extensible.  cpIds are dense, so a table indexed by old cpId
+  // translates each trace record in constant time.
+  uint maxOldId = 0;
+  for (CCT::MergeEffectList::const_iterator it = mrgEffects->begin();
+       it != mrgEffects->end(); ++it) {
+    maxOldId = std::max(maxOldId, it->old_cpId);
+  }
+
+  TraceRemapper::CpIdMap* cpIdMap = new TraceRemapper::CpIdMap(maxOldId + 1);
+  for (uint i = 0; i < cpIdMap->size(); ++i) {
+    (*cpIdMap)[i] = i;
+  }
   for (CCT::MergeEffectList::const_iterator it = mrgEffects->begin();
        it != mrgEffects->end(); ++it) {
-    const CCT::MergeEffect& effct = *it;
-    cpIdMap.insert(std::make_pair(effct.old_cpId, effct.new_cpId));
+    (*cpIdMap)[it->old_cpId] = it->new_cpId;
   }
 
   // ------------------------------------------------------------
   // Rewrite trace file
   // ------------------------------------------------------------
-  int ret;
 
   DIAG_MsgIf(0, "Profile::merge_fixTrace: " << m_traceFileName);
 
-  string traceFileNameTmp = m_traceFileName + "." + HPCPROF_TmpFnmSfx;
-
-  char* infsBuf = new char[HPCIO_RWBufferSz];
-  char* outfsBuf = new char[HPCIO_RWBufferSz];
-
-  const string& inFnm = m_traceFileName;
-  FILE* infs = hpcio_fopen_r(inFnm.c_str());
-  if (!infs) {
-    std::string errorString;
-    hpcrun_getFileErrorString(inFnm, errorString);
-    DIAG_EMsg("failed to open trace file " << errorString << "; skip this one."); 
-    return; 
-  }
-
-  ret = setvbuf(infs, infsBuf, _IOFBF, HPCIO_RWBufferSz);
-  DIAG_AssertWarn(ret == 0, inFnm << ": Profile::merge_fixTrace: setvbuf!");
-
-  hpctrace_fmt_hdr_t hdr;
-  ret = hpctrace_fmt_hdr_fread(&hdr, infs);
-  if (ret == HPCFMT_ERR) {
-    std::string errorString;
-    hpcrun_getFileErrorString(inFnm, errorString);
-    DIAG_EMsg("failed reading header from trace measurement file " << errorString << "; skip this one."); 
-    hpcio_fclose(infs);
-    return;
-  }
-
-  const string& outFnm = traceFileNameTmp;
-  FILE* outfs = hpcio_fopen_w(outFnm.c_str(), 1/*overwrite*/);
-  if (!outfs) {
-    if (errno == EDQUOT) {
-      DIAG_EMsg("disk quota exceeded; unable to open trace result file  " << 
-		outFnm << "; aborting.");
-      hpcio_fclose(infs);
-      prof_abort(-1);
-    } else {
-      std::string errorString;
-      hpcrun_getFileErrorString(outFnm, errorString);
-      DIAG_EMsg("failed opening trace result file " << errorString << 
-		"when processing trace measurement file " << inFnm << "; skip this one.");
-      hpcio_fclose(infs);
-      return; 
-    }
-  }
-
-  ret = setvbuf(outfs, outfsBuf, _IOFBF, HPCIO_RWBufferSz);
-  DIAG_AssertWarn(ret == 0, outFnm << ": Profile::merge_fixTrace: setvbuf!");
-
-  ret = hpctrace_fmt_hdr_fwrite(hdr.flags, outfs);
-  if (ret == HPCFMT_ERR) goto badwrite;
-
-  while ( !feof(infs) ) {
-    // 1. Read trace record (exit on EOF)
-    hpctrace_fmt_datum_t datum;
-    ret = hpctrace_fmt_datum_fread(&datum, hdr.flags, infs);
-    if (ret == HPCFMT_EOF) {
-      break;
-    } else if (ret == HPCFMT_ERR) {
-      DIAG_EMsg("failed reading a record from trace measurement file " << inFnm << "; skip this one.");
-      hpcio_fclose(infs);
-      hpcio_fclose(outfs);
-      unlink(outFnm.c_str()); // delete incomplete output file
-      return;
-    }
-    
-    // 2. Translate cct id
-    uint cctId_old = datum.cpId;
-    uint cctId_new = datum.cpId;
-    UIntToUIntMap::iterator it = cpIdMap.find(cctId_old);
-    if (it != cpIdMap.end()) {
-      cctId_new = it->second;
-      DIAG_MsgIf(0, "  " << cctId_old << " -> " << cctId_new);
-    }
-    datum.cpId = cctId_new;
-
-    // 3. Write new trace record
-    ret = hpctrace_fmt_datum_fwrite(&datum, hdr.flags, outfs);
-    if (ret == HPCFMT_ERR) goto badwrite;
+  if (traceRemapper) {
+    traceRemapper->add(m_traceFileName, cpIdMap); // takes ownership
   }
-
-  hpcio_fclose(infs);
-  hpcio_fclose(outfs);
-
-  delete[] infsBuf;
-  delete[] outfsBuf;
-  return;
-
-badwrite:
-  {
-    std::string errorString;
-    hpcrun_getFileErrorString(outFnm, errorString);
-    DIAG_EMsg("failed writing trace result file " << errorString << "; aborting.");
-    hpcio_fclose(infs);
-    hpcio_fclose(outfs);
-    unlink(outFnm.c_str()); // delete incomplete output file
-    prof_abort(-1);
+  else {
+    string traceFileNameTmp = m_traceFileName + "." + HPCPROF_TmpFnmSfx;
+    TraceRemapper::remap(m_traceFileName, traceFileNameTmp, *cpIdMap);
+    delete cpIdMap;
   }
 }
 
@@ -874,7 +799,10 @@ Profile::writeXML_hdr(std::ostream& os, uint metricBeg, uint metricEnd,
       os << " db-glob=\"" << m->dbFileGlob() << "\""
 	 << " db-id=\"" << m->dbId() << "\""
 	 << " db-num-metrics=\"" << m->dbNumMetrics() << "\""
-	 << " db-header-sz=\"" << HPCMETRICDB_FMT_HeaderLen << "\""
+	 << " db-fmt=\"" << (m_isSparseMetricDB ? "sparse" : "dense") << "\""
+	 << " db-header-sz=\"" << (m_isSparseMetricDB
+				   ? HPCMETRICDB_FMT_SparseHdrLen
+				   : HPCMETRICDB_FMT_HeaderLen) << "\""
 	 << "/>\n";
     }
   }
@@ -999,7 +927,9 @@ Profile::make(const char* fnm, uint rFlags, FILE* outfs)
 {
   int ret;
 
-  FILE* fs = hpcio_fopen_r(fnm);
+  // a profile may also be a member of an hpcrun output container
+  FILE* fs = (hpcio_container_member_name(fnm)) ?
+    hpcio_container_member_fopen_r(fnm) : hpcio_fopen_r(fnm);
   if (!fs) {
     if (errno == ENOENT)
       fprintf(stderr, "ERROR: measurement file or directory '%s' does not exist\n",
@@ -1515,6 +1445,9 @@ Profile::fmt_cct_fread(Profile& prof, FILE* infs, uint rFlags,
   // N.B.: numMetricsSrc <= [numMetricsDst = prof.metricMgr()->size()]
   uint numMetricsSrc = metricTbl.len;
 
+  // N.B.: hpcrun_fmt_cct_node_fread() handles both dense and sparse
+  // (prof.m_flags.fields.isSparseMetrics) nodes; with sparse nodes it
+  // zero-fills and skips values whose metric id is >= numMetricsSrc.
   if (rFlags & RFlg_NoMetricValues) {
     numMetricsSrc = 0;
   }
@@ -78,6 +78,7 @@
 #include "LoadMap.hpp"
 #include "CCT-Tree.hpp"
 #include "StringSet.hpp"
+#include "CallPath-TraceRemapper.hpp"
 
 #include <lib/support/FileUtil.hpp> // dirname
 
@@ -131,6 +132,18 @@ public:
   traceFileNameSet()
   { return m_traceFileNameSet; }
 
+  // If set, trace files normalized by merge() are rewritten by
+  // 'x' (directly into its destination directory) rather than
+  // serially into a temporary file next to the original (cf.
+  // Analysis::Util::copyTraceFiles()).  Not owned.
+  TraceRemapper*
+  traceRemapper() const
+  { return m_traceRemapper; }
+
+  void
+  traceRemapper(TraceRemapper* x)
+  { m_traceRemapper = x; }
+
   // enable/disable redundancy of procedure names
   // @param flag: true  -- redundancy is eliminated
   // 		  false -- redundancy is allowed
@@ -190,6 +203,16 @@ public:
   isMetricMgrVirtual(bool x)
   { m_isMetricMgrVirtual = x; }
 
+  // isSparseMetricDB: whether the metric-db files of this profile's
+  //   database are in the sparse format (cf. hpcmetricDB_fmt_isSparse)
+  bool
+  isSparseMetricDB() const
+  { return m_isSparseMetricDB; }
+
+  void
+  isSparseMetricDB(bool x)
+  { m_isSparseMetricDB = x; }
+
   // -------------------------------------------------------
   // LoadMap
   // -------------------------------------------------------
@@ -241,11 +264,14 @@ public:
 
   // merge: Given a Profile y, merge y into x = 'this'.  The 'mergeTy'
   //   parameter indicates how to merge y's metrics into x.  Returns
-  //   the index of the first merged metric in x.
+  //   the index of the first merged metric in x.  If 'mergedNodes'
+  //   is non-NULL, the nodes of x's CCT that receive metric values
+  //   are appended to it (cf. CCT::PartialTree).
   // ASSUMES: both x and y are in canonical form (canonicalize())
   // WARNING: the merge may change/destroy y
   uint
-  merge(Profile& y, int mergeTy, uint mrgFlag = 0);
+  merge(Profile& y, int mergeTy, uint mrgFlag = 0,
+	std::vector<CCT::ANode*>* mergedNodes = NULL);
 
   // -------------------------------------------------------
   //
@@ -360,7 +386,8 @@ private:
   merge_fixCCT(const std::vector<LoadMap::MergeEffect>* mrgEffects);
 
   void
-  merge_fixTrace(const CCT::MergeEffectList* mrgEffects);
+  merge_fixTrace(const CCT::MergeEffectList* mrgEffects,
+		 TraceRemapper* traceRemapper);
 
 
 private:
@@ -375,12 +402,14 @@ private:
   std::string m_traceFileName;   // non-empty, if relevant
   StringSet m_traceFileNameSet;
   uint64_t m_traceMinTime, m_traceMaxTime;
+  TraceRemapper* m_traceRemapper;
 
   //typedef std::map<std::string, std::string> StrToStrMap;
   //StrToStrMap m_nvPairMap;
 
   Metric::Mgr* m_mMgr;
   bool m_isMetricMgrVirtual;
+  bool m_isSparseMetricDB;
 
   LoadMap* m_loadmap;
 
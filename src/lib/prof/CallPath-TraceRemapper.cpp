@@ -0,0 +1,625 @@
+// -*-Mode: C++;-*-
+
+// * BeginRiceCopyright *****************************************************
+//
+// $HeadURL$
+// $Id$
+//
+// --------------------------------------------------------------------------
+// Part of HPCToolkit (hpctoolkit.org)
+//
+// Information about sources of support for research and development of
+// HPCToolkit is at 'hpctoolkit.org' and in 'README.Acknowledgments'.
+// --------------------------------------------------------------------------
+//
+// Copyright ((c)) 2002-2020, Rice University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+//
+// * Neither the name of Rice University (RICE) nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+//
+// This software is provided by RICE and contributors "as is" and any
+// express or implied warranties, including, but not limited to, the
+// implied warranties of merchantability and fitness for a particular
+// purpose are disclaimed. In no event shall RICE or contributors be
+// liable for any direct, indirect, incidental, special, exemplary, or
+// consequential damages (including, but not limited to, procurement of
+// substitute goods or services; loss of use, data, or profits; or
+// business interruption) however caused and on any theory of liability,
+// whether in contract, strict liability, or tort (including negligence
+// or otherwise) arising in any way out of the use of this software, even
+// if advised of the possibility of such damage.
+//
+// ******************************************************* EndRiceCopyright *
+
+//***************************************************************************
+//
+// File:
+//   $HeadURL$
+//
+// Purpose:
+//   [The purpose of this file]
+//
+// Description:
+//   [The set of functions, macros, etc. defined in the file]
+//
+//***************************************************************************
+
+//************************* System Include Files ****************************
+
+#include <string>
+using std::string;
+
+#include <algorithm>
+#include <deque>
+#include <utility>
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+
+#include <stdint.h>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+//*************************** User Include Files ****************************
+
+#include <include/uint.h>
+
+#include "CallPath-TraceRemapper.hpp"
+#include "FileError.hpp"
+
+#include <lib/prof-lean/hpcio.h>
+#include <lib/prof-lean/hpcio-container.h>
+#include <lib/prof-lean/hpcrun-fmt.h>
+
+#include <lib/support/diagnostics.h>
+#include <lib/support/FileUtil.hpp>
+
+//*************************** Forward Declarations **************************
+
+// implementations of prof_abort will be separately defined for MPI and 
+// non-MPI contexts
+extern void 
+prof_abort
+(
+  int error_code
+);
+
+
+//***************************************************************************
+
+// Outcome of one rewrite.  RemapFailed means the result could not be
+// written (e.g., the disk is full) and the run must abort.  Rewrites
+// may run on worker threads, so the abort is left to the caller.
+enum RemapStatus {
+  RemapOk,
+  RemapSkipped,
+  RemapFailed
+};
+
+
+// Trace files are big-endian (cf. hpcfmt_int4_fread())
+static inline uint32_t
+readBE4(const unsigned char* p)
+{
+  return (((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16)
+	  | ((uint32_t)p[2] << 8) | (uint32_t)p[3]);
+}
+
+
+static inline void
+writeBE4(unsigned char* p, uint32_t x)
+{
+  p[0] = (x >> 24) & 0xff;
+  p[1] = (x >> 16) & 0xff;
+  p[2] = (x >> 8) & 0xff;
+  p[3] = x & 0xff;
+}
+
+
+// readTraceHdr: finds the size of the header and of each record of the
+// trace file in 'buf' (cf. hpctrace_fmt_hdr_fread() and
+// hpctrace_fmt_datum_fread()).  For compact traces, 'datumSz' is 0.
+// Returns false if the header is invalid.
+static bool
+readTraceHdr(const unsigned char* buf, size_t bufSz,
+	     size_t& hdrSz, size_t& datumSz, hpctrace_hdr_flags_t& flags)
+{
+  const size_t versionOff = HPCTRACE_FMT_MagicLen;
+  const size_t flagsOff = (versionOff + HPCTRACE_FMT_VersionLen
+			   + HPCTRACE_FMT_EndianLen);
+
+  if (bufSz < flagsOff
+      || memcmp(buf, HPCTRACE_FMT_Magic, HPCTRACE_FMT_MagicLen) != 0) {
+    return false;
+  }
+
+  hpctrace_fmt_hdr_t hdr;
+  memcpy(hdr.versionStr, buf + versionOff, HPCTRACE_FMT_VersionLen);
+  hdr.versionStr[HPCTRACE_FMT_VersionLen] = '\0';
+  hdr.version = atof(hdr.versionStr);
+
+  flags = 0;
+  hdrSz = flagsOff;
+  if (hdr.version > 1.0) {
+    if (bufSz < flagsOff + HPCTRACE_FMT_FlagsLen) {
+      return false;
+    }
+    flags = (((hpctrace_hdr_flags_t)readBE4(buf + flagsOff) << 32)
+	     | readBE4(buf + flagsOff + 4));
+    hdrSz += HPCTRACE_FMT_FlagsLen;
+  }
+
+  if (HPCTRACE_FMT_IsCompact(&hdr)) {
+    datumSz = 0;
+    return true;
+  }
+
+  datumSz = sizeof(uint64_t) + sizeof(uint32_t); // time, cpId
+  if (HPCTRACE_HDR_FLAGS_GET_BIT(flags,
+				 HPCTRACE_HDR_FLAGS_DATA_CENTRIC_BIT_POS)) {
+    datumSz += sizeof(uint32_t); // metricId
+  }
+  return true;
+}
+
+
+// readMember: reads the container member 'fnm' (see
+// hpcio-container.h), which cannot be mapped, into a malloc'd buffer.
+// Returns NULL on failure.
+static const unsigned char*
+readMember(const string& fnm, size_t& sz)
+{
+  FILE* fs = hpcio_container_member_fopen_r(fnm.c_str());
+  if (!fs) {
+    return NULL;
+  }
+
+  unsigned char* buf = NULL;
+  if (fseeko(fs, 0, SEEK_END) == 0) {
+    off_t len = ftello(fs);
+    rewind(fs);
+    if (len > 0) {
+      sz = len;
+      buf = (unsigned char*)malloc(sz);
+      if (buf && fread(buf, 1, sz, fs) != sz) {
+	free(buf);
+	buf = NULL;
+      }
+    }
+  }
+  hpcio_fclose(fs);
+  return buf;
+}
+
+
+static void
+releaseInput(const unsigned char* inBuf, size_t sz, bool isMember)
+{
+  if (!inBuf) {
+    return;
+  }
+  if (isMember) {
+    free((void*)inBuf);
+  }
+  else {
+    munmap((void*)inBuf, sz);
+  }
+}
+
+
+// remapFixed: fixed-size records: creates 'dstFnm' with the size of
+// the input, copies it and translates cpIds in place.
+static RemapStatus
+remapFixed(const unsigned char* inBuf, size_t sz, size_t hdrSz,
+	   size_t datumSz, const string& srcFnm, const string& dstFnm,
+	   const Prof::CallPath::TraceRemapper::CpIdMap& cpIdMap)
+{
+  std::string errorString;
+
+  int outfd = open(dstFnm.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+  int ret = (outfd < 0) ? errno : posix_fallocate(outfd, 0, sz);
+  unsigned char* outBuf = NULL;
+  if (ret == 0) {
+    void* p = mmap(NULL, sz, PROT_READ | PROT_WRITE, MAP_SHARED, outfd, 0);
+    if (p != MAP_FAILED) {
+      outBuf = (unsigned char*)p;
+    }
+    else {
+      ret = errno;
+    }
+  }
+
+  if (!outBuf) {
+    if (outfd >= 0) {
+      close(outfd);
+      unlink(dstFnm.c_str()); // delete incomplete output file
+    }
+    if (ret == EDQUOT || ret == ENOSPC) {
+      DIAG_EMsg("disk full or quota exceeded; unable to open trace result file  " << 
+		dstFnm << "; aborting.");
+      return RemapFailed;
+    }
+    errno = ret;
+    hpcrun_getFileErrorString(dstFnm, errorString);
+    DIAG_EMsg("failed opening trace result file " << errorString << 
+	      "when processing trace measurement file " << srcFnm << "; skip this one.");
+    return RemapSkipped;
+  }
+
+  memcpy(outBuf, inBuf, sz);
+
+  size_t numDatum = (sz - hdrSz) / datumSz;
+  DIAG_WMsgIf(hdrSz + numDatum * datumSz != sz,
+	      "trace measurement file " << srcFnm << " ends with a partial record");
+
+  const size_t cpIdOff = sizeof(uint64_t);
+  unsigned char* datum = outBuf + hdrSz + cpIdOff;
+  for (size_t i = 0; i < numDatum; ++i, datum += datumSz) {
+    uint32_t cpId = readBE4(datum);
+    if (cpId < cpIdMap.size()) {
+      writeBE4(datum, cpIdMap[cpId]);
+    }
+  }
+
+  ret = munmap(outBuf, sz);
+  if (close(outfd) != 0 || ret != 0) {
+    hpcrun_getFileErrorString(dstFnm, errorString);
+    DIAG_EMsg("failed writing trace result file " << errorString << "; aborting.");
+    unlink(dstFnm.c_str()); // delete incomplete output file
+    return RemapFailed;
+  }
+  return RemapOk;
+}
+
+
+// remapCompact: compact records (cf. hpctrace_fmt_blk_t): record sizes
+// depend on the cpIds, so blocks are decoded and re-encoded.
+static RemapStatus
+remapCompact(const unsigned char* inBuf, size_t sz, size_t hdrSz,
+	     hpctrace_hdr_flags_t flags, const string& srcFnm,
+	     const string& dstFnm,
+	     const Prof::CallPath::TraceRemapper::CpIdMap& cpIdMap)
+{
+  std::string errorString;
+
+  FILE* outfs = hpcio_fopen_w(dstFnm.c_str(), 1/*overwrite*/);
+  if (!outfs) {
+    if (errno == EDQUOT || errno == ENOSPC) {
+      DIAG_EMsg("disk full or quota exceeded; unable to open trace result file  " << 
+		dstFnm << "; aborting.");
+      return RemapFailed;
+    }
+    hpcrun_getFileErrorString(dstFnm, errorString);
+    DIAG_EMsg("failed opening trace result file " << errorString << 
+	      "when processing trace measurement file " << srcFnm << "; skip this one.");
+    return RemapSkipped;
+  }
+
+  char* outfsBuf = new char[HPCIO_RWBufferSz];
+  setvbuf(outfs, outfsBuf, _IOFBF, HPCIO_RWBufferSz);
+
+  hpctrace_fmt_blk_t* outBlk = new hpctrace_fmt_blk_t;
+  hpctrace_fmt_blk_init(outBlk);
+
+  bool isBadRead = false;
+  int ret = hpctrace_fmt_hdr_compact_fwrite(flags, outfs);
+
+  const unsigned char* end = inBuf + sz;
+  const unsigned char* blkBuf = inBuf + hdrSz;
+  while (ret == HPCFMT_OK && blkBuf < end) {
+    hpctrace_fmt_blk_hdr_t blkHdr;
+    if (hpctrace_fmt_blk_hdr_decode(&blkHdr, blkBuf, end - blkBuf) != HPCFMT_OK
+	|| blkHdr.numBytes > (size_t)(end - blkBuf) - HPCTRACE_FMT_BlkHdrLen) {
+      isBadRead = true;
+      break;
+    }
+    const unsigned char* p = blkBuf + HPCTRACE_FMT_BlkHdrLen;
+    const unsigned char* blkEnd = p + blkHdr.numBytes;
+
+    hpctrace_fmt_datum_t prev, datum;
+    prev.comp = blkHdr.begTime;
+    prev.cpId = prev.metricId = 0;
+    for (uint i = 0; i < blkHdr.numDatum && ret == HPCFMT_OK; ++i) {
+      p = hpctrace_fmt_datum_decode(&datum, &prev, flags, p, blkEnd);
+      if (!p) {
+	isBadRead = true;
+	break;
+      }
+      prev = datum;
+
+      if (datum.cpId < cpIdMap.size()) {
+	datum.cpId = cpIdMap[datum.cpId];
+      }
+      ret = hpctrace_fmt_datum_blk_fwrite(&datum, flags, outBlk, outfs);
+    }
+    if (isBadRead) {
+      break;
+    }
+    blkBuf = blkEnd;
+  }
+  if (ret == HPCFMT_OK) {
+    ret = hpctrace_fmt_blk_fwrite(outBlk, outfs);
+  }
+  if (hpcio_fclose(outfs) != 0) {
+    ret = HPCFMT_ERR;
+  }
+
+  delete outBlk;
+  delete[] outfsBuf;
+
+  if (ret != HPCFMT_OK) {
+    hpcrun_getFileErrorString(dstFnm, errorString);
+    DIAG_EMsg("failed writing trace result file " << errorString << "; aborting.");
+    unlink(dstFnm.c_str()); // delete incomplete output file
+    return RemapFailed;
+  }
+  if (isBadRead) {
+    DIAG_EMsg("failed reading a record from trace measurement file " << srcFnm << "; skip this one.");
+    unlink(dstFnm.c_str()); // delete incomplete output file
+    return RemapSkipped;
+  }
+  return RemapOk;
+}
+
+
+// remapFile: cf. TraceRemapper::remap
+static RemapStatus
+remapFile(const string& srcFnm, const string& dstFnm,
+	  const Prof::CallPath::TraceRemapper::CpIdMap& cpIdMap)
+{
+  std::string errorString;
+
+  // ------------------------------------------------------------
+  // Map trace file (or read a container member)
+  // ------------------------------------------------------------
+  bool isMember = (hpcio_container_member_name(srcFnm.c_str()) != NULL);
+  const unsigned char* inBuf = NULL;
+  size_t sz = 0;
+
+  if (isMember) {
+    inBuf = readMember(srcFnm, sz);
+    if (!inBuf) {
+      hpcrun_getFileErrorString(srcFnm, errorString);
+      DIAG_EMsg("failed to open trace file " << errorString << "; skip this one.");
+      return RemapSkipped;
+    }
+  }
+  else {
+    int infd = open(srcFnm.c_str(), O_RDONLY);
+    if (infd < 0) {
+      hpcrun_getFileErrorString(srcFnm, errorString);
+      DIAG_EMsg("failed to open trace file " << errorString << "; skip this one.");
+      return RemapSkipped;
+    }
+
+    struct stat statbuf;
+    if (fstat(infd, &statbuf) == 0 && statbuf.st_size > 0) {
+      sz = statbuf.st_size;
+      void* p = mmap(NULL, sz, PROT_READ, MAP_PRIVATE, infd, 0);
+      if (p != MAP_FAILED) {
+	inBuf = (const unsigned char*)p;
+	madvise(p, sz, MADV_SEQUENTIAL);
+      }
+    }
+    close(infd);
+  }
+
+  size_t hdrSz = 0, datumSz = 0;
+  hpctrace_hdr_flags_t flags = 0;
+  if (!inBuf || !readTraceHdr(inBuf, sz, hdrSz, datumSz, flags)) {
+    hpcrun_getFileErrorString(srcFnm, errorString);
+    DIAG_EMsg("failed reading header from trace measurement file " << errorString << "; skip this one.");
+    releaseInput(inBuf, sz, isMember);
+    return RemapSkipped;
+  }
+
+  // ------------------------------------------------------------
+  // Translate cct ids
+  // ------------------------------------------------------------
+  RemapStatus ret;
+  if (datumSz > 0) {
+    ret = remapFixed(inBuf, sz, hdrSz, datumSz, srcFnm, dstFnm, cpIdMap);
+  }
+  else {
+    ret = remapCompact(inBuf, sz, hdrSz, flags, srcFnm, dstFnm, cpIdMap);
+  }
+
+  releaseInput(inBuf, sz, isMember);
+  return ret;
+}
+
+
+//***************************************************************************
+
+namespace Prof {
+
+namespace CallPath {
+
+
+struct TraceRemapper::Queue
+{
+  typedef std::pair<std::string, CpIdMap*> Job;
+
+  Queue(uint window)
+    : numActive(0), window(window), stop(false), failed(false)
+  { }
+
+  std::deque<Job> jobs;
+  uint numActive; // number of jobs being processed
+  uint window;    // max. number of pending jobs
+  bool stop;
+  bool failed;    // a rewrite failed fatally (RemapFailed)
+
+  std::mutex mutex;
+  std::condition_variable cvWork; // a job was queued (or stop)
+  std::condition_variable cvDone; // a job was taken or finished
+  std::vector<std::thread> threads;
+};
+
+
+TraceRemapper::TraceRemapper(const std::string& dstDir, uint numThreads)
+  : m_dstDir(dstDir)
+{
+  numThreads = std::max(1u, numThreads);
+  m_queue = new Queue(2 * numThreads);
+  for (uint i = 0; i < numThreads; ++i) {
+    m_queue->threads.push_back(std::thread(&TraceRemapper::work, this));
+  }
+}
+
+
+TraceRemapper::~TraceRemapper()
+{
+  wait();
+  stopWorkers();
+  delete m_queue;
+}
+
+
+void
+TraceRemapper::add(const std::string& srcFnm, CpIdMap* cpIdMap)
+{
+  Queue& q = *m_queue;
+  {
+    std::unique_lock<std::mutex> lock(q.mutex);
+    q.cvDone.wait(lock, [&] { return q.failed || q.jobs.size() < q.window; });
+    if (!q.failed) {
+      q.jobs.push_back(Queue::Job(srcFnm, cpIdMap));
+      cpIdMap = NULL;
+    }
+  }
+  if (cpIdMap) {
+    delete cpIdMap;
+    abortOnFailure();
+  }
+  q.cvWork.notify_one();
+}
+
+
+void
+TraceRemapper::wait()
+{
+  Queue& q = *m_queue;
+  bool failed;
+  {
+    std::unique_lock<std::mutex> lock(q.mutex);
+    q.cvDone.wait(lock, [&] {
+	return q.failed || (q.jobs.empty() && q.numActive == 0); });
+    failed = q.failed;
+  }
+  if (failed) {
+    abortOnFailure();
+  }
+}
+
+
+void
+TraceRemapper::work()
+{
+  Queue& q = *m_queue;
+  while (true) {
+    Queue::Job job;
+    {
+      std::unique_lock<std::mutex> lock(q.mutex);
+      q.cvWork.wait(lock, [&] { return q.stop || q.failed || !q.jobs.empty(); });
+      if (q.failed || q.jobs.empty()) {
+	return;
+      }
+      job = q.jobs.front();
+      q.jobs.pop_front();
+      q.numActive++;
+    }
+    q.cvDone.notify_all(); // the queue has room
+
+    const char* mbrNm = hpcio_container_member_name(job.first.c_str());
+    const string dstFnm = m_dstDir + "/"
+      + ((mbrNm) ? string(mbrNm) : FileUtil::basename(job.first));
+    DIAG_Msg(2, "trace (remap): '" << job.first << "' -> '" << dstFnm << "'");
+    RemapStatus ret = remapFile(job.first, dstFnm, *job.second);
+    delete job.second;
+
+    {
+      std::lock_guard<std::mutex> lock(q.mutex);
+      q.numActive--;
+      if (ret == RemapFailed) {
+	q.failed = true;
+      }
+    }
+    q.cvDone.notify_all();
+    if (ret == RemapFailed) {
+      q.cvWork.notify_all(); // other workers stop taking jobs
+    }
+  }
+}
+
+
+// stopWorkers: lets the workers finish their current job and joins
+// them.  Jobs still queued are dropped.
+void
+TraceRemapper::stopWorkers()
+{
+  Queue& q = *m_queue;
+  {
+    std::lock_guard<std::mutex> lock(q.mutex);
+    q.stop = true;
+  }
+  q.cvWork.notify_all();
+  for (uint i = 0; i < q.threads.size(); ++i) {
+    q.threads[i].join();
+  }
+  q.threads.clear();
+
+  for (uint i = 0; i < q.jobs.size(); ++i) {
+    delete q.jobs[i].second;
+  }
+  q.jobs.clear();
+}
+
+
+// abortOnFailure: a worker could not write a result.  prof_abort may
+// be MPI_Abort, so call it from this (the caller's) thread once the
+// workers are joined.
+void
+TraceRemapper::abortOnFailure()
+{
+  stopWorkers();
+  prof_abort(-1);
+}
+
+
+bool
+TraceRemapper::remap(const std::string& srcFnm, const std::string& dstFnm,
+		     const CpIdMap& cpIdMap)
+{
+  RemapStatus ret = remapFile(srcFnm, dstFnm, cpIdMap);
+  if (ret == RemapFailed) {
+    prof_abort(-1);
+  }
+  return (ret == RemapOk);
+}
+
+
+} // namespace CallPath
+
+} // namespace Prof
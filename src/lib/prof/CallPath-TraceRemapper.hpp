@@ -0,0 +1,158 @@
+// -*-Mode: C++;-*-
+
+// * BeginRiceCopyright *****************************************************
+//
+// $HeadURL$
+// $Id$
+//
+// --------------------------------------------------------------------------
+// Part of HPCToolkit (hpctoolkit.org)
+//
+// Information about sources of support for research and development of
+// HPCToolkit is at 'hpctoolkit.org' and in 'README.Acknowledgments'.
+// --------------------------------------------------------------------------
+//
+// Copyright ((c)) 2002-2020, Rice University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+//
+// * Neither the name of Rice University (RICE) nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+//
+// This software is provided by RICE and contributors "as is" and any
+// express or implied warranties, including, but not limited to, the
+// implied warranties of merchantability and fitness for a particular
+// purpose are disclaimed. In no event shall RICE or contributors be
+// liable for any direct, indirect, incidental, special, exemplary, or
+// consequential damages (including, but not limited to, procurement of
+// substitute goods or services; loss of use, data, or profits; or
+// business interruption) however caused and on any theory of liability,
+// whether in contract, strict liability, or tort (including negligence
+// or otherwise) arising in any way out of the use of this software, even
+// if advised of the possibility of such damage.
+//
+// ******************************************************* EndRiceCopyright *
+
+//***************************************************************************
+//
+// File:
+//   $HeadURL$
+//
+// Purpose:
+//   Rewrites trace files with normalized call path ids.
+//
+// Description:
+//   When a profile is merged into the canonical CCT, the call path
+//   ids (cpIds) of its nodes may change; its trace file must be
+//   rewritten to match (cf. CallPath::Profile::merge_fixTrace()).
+//
+//   A rewrite maps the input file and translates each cpId through a
+//   dense table.  Fixed-size records are copied into an output file of
+//   the same size and translated in place; compact (delta-encoded)
+//   records are decoded and re-encoded block by block.
+//   TraceRemapper queues such rewrites for a pool of threads that
+//   write directly into the database directory, overlapping them with
+//   the (serial) merge of later profiles.
+//
+//***************************************************************************
+
+#ifndef prof_Prof_CallPath_TraceRemapper_hpp
+#define prof_Prof_CallPath_TraceRemapper_hpp
+
+//************************* System Include Files ****************************
+
+#include <string>
+#include <vector>
+
+//*************************** User Include Files ****************************
+
+#include <include/uint.h>
+
+#include <lib/support/Unique.hpp>
+
+//*************************** Forward Declarations ***************************
+
+//***************************************************************************
+
+namespace Prof {
+
+namespace CallPath {
+
+
+class TraceRemapper
+  : public Unique // non copyable
+{
+public:
+  // cpIdMap[old cpId] = new cpId; ids beyond its end are unchanged
+  typedef std::vector<uint> CpIdMap;
+
+  // Rewritten trace files are placed in 'dstDir' under their original
+  // base names.
+  TraceRemapper(const std::string& dstDir, uint numThreads);
+
+  // waits for all queued rewrites
+  ~TraceRemapper();
+
+  const std::string&
+  dstDir() const
+  { return m_dstDir; }
+
+  // add: queues a rewrite of 'srcFnm' and takes ownership of
+  // 'cpIdMap'.  Blocks while too many rewrites are pending so that the
+  // tables of only a bounded number of trace files are held at a time.
+  // Like wait, aborts (prof_abort) from the calling thread if a queued
+  // rewrite could not be written.
+  void
+  add(const std::string& srcFnm, CpIdMap* cpIdMap);
+
+  // wait: blocks until all queued rewrites are done
+  void
+  wait();
+
+  // remap: rewrites trace file 'srcFnm' as 'dstFnm', translating cpIds
+  // through 'cpIdMap'.  Returns true on success; on failure 'dstFnm'
+  // does not exist.  Aborts (prof_abort) if 'dstFnm' cannot be
+  // written for lack of space.
+  static bool
+  remap(const std::string& srcFnm, const std::string& dstFnm,
+	const CpIdMap& cpIdMap);
+
+private:
+  void
+  work();
+
+  void
+  stopWorkers();
+
+  void
+  abortOnFailure();
+
+private:
+  std::string m_dstDir;
+
+  // job queue and worker threads.  N.B.: kept out of this header,
+  // which is included after Metric-AExpr's 'epsilon' macro.
+  struct Queue;
+  Queue* m_queue;
+};
+
+
+} // namespace CallPath
+
+} // namespace Prof
+
+
+//***************************************************************************
+
+#endif /* prof_Prof_CallPath_TraceRemapper_hpp */
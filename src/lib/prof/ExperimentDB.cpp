@@ -0,0 +1,630 @@
+// -*-Mode: C++;-*-
+
+// * BeginRiceCopyright *****************************************************
+//
+// $HeadURL$
+// $Id$
+//
+// --------------------------------------------------------------------------
+// Part of HPCToolkit (hpctoolkit.org)
+//
+// Information about sources of support for research and development of
+// HPCToolkit is at 'hpctoolkit.org' and in 'README.Acknowledgments'.
+// --------------------------------------------------------------------------
+//
+// Copyright ((c)) 2002-2020, Rice University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+//
+// * Neither the name of Rice University (RICE) nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+//
+// This software is provided by RICE and contributors "as is" and any
+// express or implied warranties, including, but not limited to, the
+// implied warranties of merchantability and fitness for a particular
+// purpose are disclaimed. In no event shall RICE or contributors be
+// liable for any direct, indirect, incidental, special, exemplary, or
+// consequential damages (including, but not limited to, procurement of
+// substitute goods or services; loss of use, data, or profits; or
+// business interruption) however caused and on any theory of liability,
+// whether in contract, strict liability, or tort (including negligence
+// or otherwise) arising in any way out of the use of this software, even
+// if advised of the possibility of such damage.
+//
+// ******************************************************* EndRiceCopyright *
+
+//***************************************************************************
+//
+// File:
+//   $HeadURL$
+//
+// Purpose:
+//   [The purpose of this file]
+//
+// Description:
+//   [The set of functions, macros, etc. defined in the file]
+//
+//***************************************************************************
+
+//************************* System Include Files ****************************
+
+#include <string>
+using std::string;
+
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+//*************************** User Include Files ****************************
+
+#include <include/uint.h>
+
+#include "ExperimentDB.hpp"
+
+#include "CallPath-Profile.hpp"
+#include "CCT-Tree.hpp"
+#include "CCT-TreeIterator.hpp"
+#include "FileError.hpp"
+#include "Metric-Mgr.hpp"
+#include "Struct-Tree.hpp"
+
+#include <lib/prof-lean/hpcio.h>
+
+#include <lib/support/diagnostics.h>
+
+
+//***************************************************************************
+// Writer
+//***************************************************************************
+
+namespace Prof {
+
+namespace ExperimentDB {
+
+namespace {
+
+class StringTbl {
+public:
+  StringTbl()
+  { m_buf.push_back('\0'); } // offset 0: ""
+
+  uint32_t
+  insert(const string& s)
+  {
+    if (s.empty()) {
+      return 0;
+    }
+    std::unordered_map<string, uint32_t>::iterator it = m_map.find(s);
+    if (it != m_map.end()) {
+      return it->second;
+    }
+    if (m_buf.size() + s.size() + 1 > 0xffffffffu) {
+      DIAG_Throw("experiment database string table exceeds 4GB");
+    }
+    uint32_t off = (uint32_t)m_buf.size();
+    m_buf.append(s.c_str(), s.size() + 1);
+    m_map.insert(std::make_pair(s, off));
+    return off;
+  }
+
+  const string&
+  buf() const
+  { return m_buf; }
+
+private:
+  string m_buf;
+  std::unordered_map<string, uint32_t> m_map;
+};
+
+
+// preorder: orders the CCT as experiment.xml does, recording each
+// node's parent and the end of its subtree.
+static void
+preorder(const CCT::ANode* x, uint32_t parentIdx,
+	 std::vector<const CCT::ANode*>& nodes,
+	 std::vector<uint32_t>& parents, std::vector<uint32_t>& ends)
+{
+  uint32_t idx = (uint32_t)nodes.size();
+  nodes.push_back(x);
+  parents.push_back(parentIdx);
+  ends.push_back(0);
+
+  for (CCT::ANodeSortedChildIterator it(x, CCT::ANodeSortedIterator::cmpByStructureInfo);
+       it.current(); it++) {
+    preorder(it.current(), idx, nodes, parents, ends);
+  }
+  ends[idx] = (uint32_t)nodes.size();
+}
+
+
+static uint64_t
+firstVMA(const Struct::ACodeNode* s)
+{
+  const VMAIntervalSet& vmaset = s->vmaSet();
+  return (vmaset.empty()) ? 0 : vmaset.begin()->beg();
+}
+
+
+class Writer {
+public:
+  Writer(const string& fnm)
+    : m_fnm(fnm), m_fs(NULL), m_buf(NULL), m_pos(0)
+  { }
+
+  ~Writer()
+  {
+    if (m_fs) {
+      hpcio_fclose(m_fs);
+      unlink(m_fnm.c_str()); // delete incomplete output file
+    }
+    delete[] m_buf;
+  }
+
+  void
+  open()
+  {
+    m_fs = hpcio_fopen_w(m_fnm.c_str(), 1/*overwrite*/);
+    if (!m_fs) {
+      fail("failed opening experiment database ");
+    }
+    m_buf = new char[HPCIO_RWBufferSz];
+    setvbuf(m_fs, m_buf, _IOFBF, HPCIO_RWBufferSz);
+  }
+
+  void
+  put(const void* data, size_t sz)
+  {
+    if (sz > 0 && fwrite(data, 1, sz, m_fs) != sz) {
+      fail("failed writing experiment database ");
+    }
+    m_pos += sz;
+  }
+
+  // align: pads to the next 8-byte boundary
+  void
+  align()
+  {
+    static const char zero[8] = { 0 };
+    put(zero, (8 - (m_pos % 8)) % 8);
+  }
+
+  uint64_t
+  pos() const
+  { return m_pos; }
+
+  void
+  finish(const Hdr& hdr)
+  {
+    if (fseek(m_fs, 0, SEEK_SET) != 0) {
+      fail("failed writing experiment database ");
+    }
+    put(&hdr, sizeof(hdr));
+    if (hpcio_fclose(m_fs) != 0) {
+      m_fs = NULL;
+      fail("failed writing experiment database ");
+    }
+    m_fs = NULL;
+  }
+
+private:
+  void
+  fail(const char* what)
+  {
+    string errorString;
+    hpcrun_getFileErrorString(m_fnm, errorString);
+    DIAG_Throw(what << errorString);
+  }
+
+  string   m_fnm;
+  FILE*    m_fs;
+  char*    m_buf;
+  uint64_t m_pos;
+};
+
+} // namespace
+
+
+void
+write(const Prof::CallPath::Profile& prof, const string& fnm,
+      const string& title, uint mBegId, uint mEndId)
+{
+  const Metric::Mgr& mMgr = *prof.metricMgr();
+  if (mBegId == Metric::Mgr::npos || mEndId == Metric::Mgr::npos) {
+    mBegId = mEndId = 0; // no visible metrics
+  }
+  mEndId = std::min(mEndId, (uint)mMgr.size());
+
+  StringTbl strings;
+  Hdr hdr;
+  memset(&hdr, 0, sizeof(hdr));
+  memcpy(hdr.magic, HPCPROF_ExperimentDBMagic, sizeof(hdr.magic));
+  hdr.version   = HPCPROF_ExperimentDBVersion;
+  hdr.byteOrder = HPCPROF_ExperimentDBByteOrder;
+  hdr.title     = strings.insert(title);
+
+  // ------------------------------------------------------------
+  // metric and structure tables (small; built in memory)
+  // ------------------------------------------------------------
+  std::vector<MetricRec> metrics;
+  for (uint i = mBegId; i < mEndId; ++i) {
+    const Metric::ADesc* m = mMgr.metric(i);
+    MetricRec r;
+    memset(&r, 0, sizeof(r));
+    r.id          = m->id();
+    r.name        = strings.insert(m->name());
+    r.description = strings.insert(m->description());
+    r.partner     = (m->partner()) ? m->partner()->id() : NullIdx;
+    r.type        = (uint8_t)m->type();
+    r.visibility  = (uint8_t)m->visibility();
+    r.flags       = ((m->doDispPercent() ? MetricFlg_DispPercent : 0)
+		     | (m->isSortKey() ? MetricFlg_SortKey : 0)
+		     | (m->isPercent() ? MetricFlg_Percent : 0));
+    metrics.push_back(r);
+  }
+
+  std::vector<StructRec> structs;
+  if (prof.structure()) {
+    for (Struct::ANodeIterator it(prof.structure()->root()); it.Current(); ++it) {
+      const Struct::ANode* s = it.current();
+      StructRec r;
+      memset(&r, 0, sizeof(r));
+      r.id     = s->id();
+      r.parent = (s->parent()) ? s->parent()->id() : NullIdx;
+      r.type   = (uint8_t)s->type();
+
+      switch (s->type()) {
+      case Struct::ANode::TyRoot:
+      case Struct::ANode::TyGroup:
+      case Struct::ANode::TyLM:
+      case Struct::ANode::TyFile:
+      case Struct::ANode::TyProc:
+	r.name = strings.insert(s->name());
+	break;
+      case Struct::ANode::TyAlien:
+	r.name = strings.insert(s->name());
+	r.fileName =
+	  strings.insert(static_cast<const Struct::Alien*>(s)->fileName());
+	break;
+      case Struct::ANode::TyLoop:
+	r.fileName =
+	  strings.insert(static_cast<const Struct::Loop*>(s)->fileName());
+	break;
+      default:
+	break;
+      }
+
+      if (s->type() != Struct::ANode::TyRoot) {
+	const Struct::ACodeNode* c = static_cast<const Struct::ACodeNode*>(s);
+	r.begLine = c->begLine();
+	r.endLine = c->endLine();
+	r.vma     = firstVMA(c);
+      }
+      structs.push_back(r);
+    }
+  }
+  std::sort(structs.begin(), structs.end(),
+	    [](const StructRec& a, const StructRec& b) { return a.id < b.id; });
+
+  // ------------------------------------------------------------
+  // node order
+  // ------------------------------------------------------------
+  std::vector<const CCT::ANode*> nodes;
+  std::vector<uint32_t> parents, ends;
+  if (prof.cct()->root()) {
+    preorder(prof.cct()->root(), NullIdx, nodes, parents, ends);
+  }
+
+  // ------------------------------------------------------------
+  // write sections
+  // ------------------------------------------------------------
+  Writer w(fnm);
+  w.open();
+  w.put(&hdr, sizeof(hdr));
+
+  hdr.strings.offset = w.pos();
+  hdr.strings.count  = strings.buf().size();
+  w.put(strings.buf().data(), strings.buf().size());
+  w.align();
+
+  hdr.metrics.offset = w.pos();
+  hdr.metrics.count  = metrics.size();
+  w.put(metrics.data(), metrics.size() * sizeof(MetricRec));
+
+  hdr.structs.offset = w.pos();
+  hdr.structs.count  = structs.size();
+  w.put(structs.data(), structs.size() * sizeof(StructRec));
+
+  hdr.nodes.offset = w.pos();
+  hdr.nodes.count  = nodes.size();
+  uint64_t metricBeg = 0;
+  for (uint32_t i = 0; i < nodes.size(); ++i) {
+    const CCT::ANode* n = nodes[i];
+    NodeRec r;
+    memset(&r, 0, sizeof(r));
+    r.id         = n->id();
+    r.parent     = parents[i];
+    r.subtreeEnd = ends[i];
+    r.structId   = n->structureId();
+    r.type       = (uint8_t)n->type();
+    r.line       = n->begLine();
+
+    switch (n->type()) {
+    case CCT::ANode::TyProcFrm:
+    case CCT::ANode::TyProc: {
+      const CCT::AProcNode* p = static_cast<const CCT::AProcNode*>(n);
+      if (p->structure()) {
+	r.lmId   = p->lmId();
+	r.fileId = p->fileId();
+	r.procId = p->procId();
+      }
+      r.flags = (p->isAlien()) ? NodeFlg_Alien : 0;
+      break;
+    }
+    case CCT::ANode::TyLoop:
+      if (n->structure()) {
+	r.fileId = static_cast<const CCT::Loop*>(n)->fileId();
+	r.vma    = firstVMA(n->structure());
+      }
+      break;
+    case CCT::ANode::TyCall:
+      r.cpId = static_cast<const CCT::Call*>(n)->cpId();
+      r.vma  = static_cast<const CCT::Call*>(n)->lmRA();
+      break;
+    case CCT::ANode::TyStmt:
+      r.cpId = static_cast<const CCT::Stmt*>(n)->cpId();
+      r.vma  = static_cast<const CCT::Stmt*>(n)->lmIP();
+      break;
+    default:
+      break;
+    }
+
+    uint mEnd = std::min(mEndId, n->numMetrics());
+    uint32_t cnt = 0;
+    for (uint m = mBegId; m < mEnd; ++m) {
+      if (n->hasMetric(m)) {
+	cnt++;
+      }
+    }
+    r.metricBeg = metricBeg;
+    r.metricCnt = cnt;
+    metricBeg += cnt;
+
+    w.put(&r, sizeof(r));
+  }
+
+  hdr.metricVals.offset = w.pos();
+  hdr.metricVals.count  = metricBeg;
+  for (uint32_t i = 0; i < nodes.size(); ++i) {
+    const CCT::ANode* n = nodes[i];
+    uint mEnd = std::min(mEndId, n->numMetrics());
+    for (uint m = mBegId; m < mEnd; ++m) {
+      if (n->hasMetric(m)) {
+	MetricValRec v;
+	v.metricId = m;
+	v.pad0     = 0;
+	v.value    = n->metric(m);
+	w.put(&v, sizeof(v));
+      }
+    }
+  }
+
+  hdr.fileSize = w.pos();
+  w.finish(hdr);
+}
+
+
+//***************************************************************************
+// Reader
+//***************************************************************************
+
+Reader::Reader()
+  : m_addr(NULL), m_size(0), m_hdr(NULL), m_strings(NULL), m_metrics(NULL),
+    m_structs(NULL), m_nodes(NULL), m_metricVals(NULL)
+{
+}
+
+
+Reader::~Reader()
+{
+  close();
+}
+
+
+void
+Reader::open(const string& fnm)
+{
+  close();
+
+  int fd = ::open(fnm.c_str(), O_RDONLY);
+  if (fd < 0) {
+    DIAG_Throw("error opening experiment database '" << fnm << "': "
+	       << strerror(errno));
+  }
+
+  struct stat st;
+  if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(Hdr)) {
+    ::close(fd);
+    DIAG_Throw("invalid experiment database '" << fnm << "'");
+  }
+
+  void* addr = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if (addr == MAP_FAILED) {
+    DIAG_Throw("error mapping experiment database '" << fnm << "': "
+	       << strerror(errno));
+  }
+  m_addr = addr;
+  m_size = st.st_size;
+
+  const char* base = (const char*)m_addr;
+  const Hdr* hdr = (const Hdr*)base;
+
+  const char* err = NULL;
+  if (memcmp(hdr->magic, HPCPROF_ExperimentDBMagic, sizeof(hdr->magic)) != 0) {
+    err = "not an experiment database";
+  }
+  else if (hdr->byteOrder != HPCPROF_ExperimentDBByteOrder) {
+    err = "byte order does not match this host";
+  }
+  else if (hdr->version != HPCPROF_ExperimentDBVersion) {
+    err = "unsupported version";
+  }
+  else if (hdr->fileSize != m_size) {
+    err = "truncated file";
+  }
+  else {
+    const Section* sec[] = { &hdr->strings, &hdr->metrics, &hdr->structs,
+			     &hdr->nodes, &hdr->metricVals };
+    const size_t recSz[] = { 1, sizeof(MetricRec), sizeof(StructRec),
+			     sizeof(NodeRec), sizeof(MetricValRec) };
+    for (uint i = 0; i < sizeof(recSz) / sizeof(recSz[0]); ++i) {
+      if (sec[i]->offset > m_size
+	  || sec[i]->count > (m_size - sec[i]->offset) / recSz[i]
+	  || (recSz[i] > 1 && sec[i]->offset % 8 != 0)) {
+	err = "corrupt section table";
+	break;
+      }
+    }
+    if (!err && (hdr->strings.count == 0
+		 || base[hdr->strings.offset + hdr->strings.count - 1] != '\0')) {
+      err = "corrupt string table";
+    }
+    if (!err) {
+      err = validateNodes((const NodeRec*)(base + hdr->nodes.offset),
+			  hdr->nodes.count, hdr->metricVals.count);
+    }
+    if (!err) {
+      // ids are dense preorder ids, so at most the node count
+      const NodeRec* nodes = (const NodeRec*)(base + hdr->nodes.offset);
+      m_idToIdx.assign((size_t)hdr->nodes.count + 1, NullIdx);
+      for (uint32_t i = 0; i < hdr->nodes.count; ++i) {
+	if (m_idToIdx[nodes[i].id] != NullIdx) {
+	  err = "duplicate node id";
+	  break;
+	}
+	m_idToIdx[nodes[i].id] = i;
+      }
+    }
+  }
+
+  if (err) {
+    close();
+    DIAG_Throw("invalid experiment database '" << fnm << "': " << err);
+  }
+
+  m_hdr        = hdr;
+  m_strings    = base + hdr->strings.offset;
+  m_metrics    = (const MetricRec*)(base + hdr->metrics.offset);
+  m_structs    = (const StructRec*)(base + hdr->structs.offset);
+  m_nodes      = (const NodeRec*)(base + hdr->nodes.offset);
+  m_metricVals = (const MetricValRec*)(base + hdr->metricVals.offset);
+}
+
+
+// validateNodes: checks that the node records form one preorder tree
+// and that their metric values are in the value section, so that the
+// accessors never leave the mapping.  Returns an error message or NULL.
+const char*
+Reader::validateNodes(const NodeRec* nodes, uint64_t numNodes,
+		      uint64_t numVals)
+{
+  if (numNodes >= NullIdx) {
+    return "too many nodes";
+  }
+  if (numNodes > 0 && (nodes[0].parent != NullIdx
+		       || nodes[0].subtreeEnd != numNodes)) {
+    return "corrupt root node";
+  }
+
+  for (uint64_t i = 0; i < numNodes; ++i) {
+    const NodeRec& n = nodes[i];
+    if (n.subtreeEnd <= i || n.subtreeEnd > numNodes) {
+      return "corrupt node subtree";
+    }
+    // the parent precedes the node and its subtree encloses the node's
+    if (i > 0 && (n.parent >= i || n.subtreeEnd > nodes[n.parent].subtreeEnd)) {
+      return "corrupt node parent";
+    }
+    if (n.metricBeg > numVals || n.metricCnt > numVals - n.metricBeg) {
+      return "corrupt node metric values";
+    }
+    if (n.id > numNodes) {
+      return "corrupt node id";
+    }
+  }
+  return NULL;
+}
+
+
+void
+Reader::close()
+{
+  if (m_addr) {
+    munmap(m_addr, m_size);
+  }
+  m_addr = NULL;
+  m_size = 0;
+  m_hdr = NULL;
+  m_strings = NULL;
+  m_metrics = NULL;
+  m_structs = NULL;
+  m_nodes = NULL;
+  m_metricVals = NULL;
+  m_idToIdx.clear();
+}
+
+
+const StructRec*
+Reader::findStruct(uint32_t id) const
+{
+  const StructRec* beg = m_structs;
+  const StructRec* end = m_structs + numStructs();
+  const StructRec* x =
+    std::lower_bound(beg, end, id,
+		     [](const StructRec& r, uint32_t id) { return r.id < id; });
+  return (x != end && x->id == id) ? x : NULL;
+}
+
+
+uint32_t
+Reader::findNode(uint32_t id) const
+{
+  return (id < m_idToIdx.size()) ? m_idToIdx[id] : NullIdx;
+}
+
+
+double
+Reader::metric(uint32_t idx, uint32_t metricId) const
+{
+  const MetricValRec* beg = metricVals(idx);
+  const MetricValRec* end = beg + m_nodes[idx].metricCnt;
+  const MetricValRec* x =
+    std::lower_bound(beg, end, metricId,
+		     [](const MetricValRec& v, uint32_t id) { return v.metricId < id; });
+  return (x != end && x->metricId == metricId) ? x->value : 0.0;
+}
+
+
+} // namespace ExperimentDB
+
+} // namespace Prof
@@ -0,0 +1,328 @@
+// -*-Mode: C++;-*-
+
+// * BeginRiceCopyright *****************************************************
+//
+// $HeadURL$
+// $Id$
+//
+// --------------------------------------------------------------------------
+// Part of HPCToolkit (hpctoolkit.org)
+//
+// Information about sources of support for research and development of
+// HPCToolkit is at 'hpctoolkit.org' and in 'README.Acknowledgments'.
+// --------------------------------------------------------------------------
+//
+// Copyright ((c)) 2002-2020, Rice University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+//
+// * Neither the name of Rice University (RICE) nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+//
+// This software is provided by RICE and contributors "as is" and any
+// express or implied warranties, including, but not limited to, the
+// implied warranties of merchantability and fitness for a particular
+// purpose are disclaimed. In no event shall RICE or contributors be
+// liable for any direct, indirect, incidental, special, exemplary, or
+// consequential damages (including, but not limited to, procurement of
+// substitute goods or services; loss of use, data, or profits; or
+// business interruption) however caused and on any theory of liability,
+// whether in contract, strict liability, or tort (including negligence
+// or otherwise) arising in any way out of the use of this software, even
+// if advised of the possibility of such damage.
+//
+// ******************************************************* EndRiceCopyright *
+
+//***************************************************************************
+//
+// File:
+//   $HeadURL$
+//
+// Purpose:
+//   Binary experiment database: a compact, mmap-able alternative to
+//   experiment.xml.
+//
+// Description:
+//   The file is a fixed-size header followed by sections of fixed-size
+//   records (8-byte aligned):
+//
+//     Hdr | strings | metrics | structs | nodes | metric values
+//
+//   - strings: NUL-terminated strings referenced by byte offset; offset
+//     0 is the empty string.
+//   - metrics: one MetricRec per metric in the database
+//   - structs: one StructRec per static structure node, sorted by id
+//   - nodes: one NodeRec per CCT node in preorder (children in the same
+//     order as experiment.xml).  A node's children are the records
+//     in (idx, subtreeEnd); a node's metric values are the MetricValRec
+//     records [metricBeg, metricBeg + metricCnt), sorted by metric id.
+//
+//   Values are stored in the writer's byte order; Hdr::byteOrder lets a
+//   reader reject a file written on a host of the other endianness.
+//
+//***************************************************************************
+
+#ifndef prof_Prof_ExperimentDB_hpp
+#define prof_Prof_ExperimentDB_hpp
+
+//************************* System Include Files ****************************
+
+#include <string>
+#include <vector>
+
+#include <stdint.h>
+
+//*************************** User Include Files ****************************
+
+#include <include/uint.h>
+
+//*************************** Forward Declarations ***************************
+
+namespace Prof {
+namespace CallPath {
+class Profile;
+}
+}
+
+
+//***************************************************************************
+// File format
+//***************************************************************************
+
+namespace Prof {
+
+namespace ExperimentDB {
+
+#define HPCPROF_ExperimentDBMagic   "HPCTKEDB"
+#define HPCPROF_ExperimentDBVersion 1
+#define HPCPROF_ExperimentDBByteOrder 0x01020304u
+
+const uint32_t NullIdx = 0xffffffff;
+
+
+struct Section {
+  uint64_t offset; // file offset of the first record
+  uint64_t count;  // number of records (bytes, for the string section)
+};
+
+
+struct Hdr {
+  char     magic[8];
+  uint32_t version;
+  uint32_t byteOrder;
+  uint64_t fileSize;
+  uint32_t title;     // string offset
+  uint32_t reserved0;
+
+  Section  strings;
+  Section  metrics;
+  Section  structs;
+  Section  nodes;
+  Section  metricVals;
+
+  uint64_t reserved[2];
+};
+
+
+enum MetricFlg {
+  MetricFlg_DispPercent = 0x01,
+  MetricFlg_SortKey     = 0x02,
+  MetricFlg_Percent     = 0x04
+};
+
+struct MetricRec {
+  uint32_t id;          // Metric::ADesc::id()
+  uint32_t name;        // string offset
+  uint32_t description; // string offset
+  uint32_t partner;     // metric id of incl/excl partner or NullIdx
+  uint8_t  type;        // Metric::ADesc::ADescTy
+  uint8_t  visibility;  // HPCRUN_FMT_METRIC_*
+  uint8_t  flags;       // MetricFlg
+  uint8_t  pad0;
+  uint32_t pad1;
+};
+
+
+struct StructRec {
+  uint32_t id;          // Struct::ANode::id()
+  uint32_t parent;      // id of parent or NullIdx for the root
+  uint8_t  type;        // Struct::ANode::ANodeTy
+  uint8_t  pad0[3];
+  uint32_t name;        // string offset
+  uint32_t fileName;    // string offset (Alien and Loop only)
+  uint32_t begLine;
+  uint32_t endLine;
+  uint32_t pad1;
+  uint64_t vma;         // lowest vma or 0
+};
+
+
+enum NodeFlg {
+  NodeFlg_Alien = 0x01
+};
+
+struct NodeRec {
+  uint32_t id;          // CCT::ANode::id()
+  uint32_t parent;      // record index of parent or NullIdx for the root
+  uint32_t subtreeEnd;  // record index one past the last descendant
+  uint32_t structId;    // StructRec id or 0
+  uint8_t  type;        // CCT::ANode::ANodeTy
+  uint8_t  flags;       // NodeFlg
+  uint16_t pad0;
+  uint32_t line;
+  uint32_t cpId;        // Call and Stmt: call path id used by traces
+  uint32_t lmId;        // ProcFrm and Proc: struct ids of the
+  uint32_t fileId;      //   enclosing load module, file and procedure;
+  uint32_t procId;      //   Loop: file
+  uint64_t vma;         // Call: return address; Stmt: ip; Loop: first vma
+  uint64_t metricBeg;   // index of first MetricValRec
+  uint32_t metricCnt;
+  uint32_t pad1;
+};
+
+
+struct MetricValRec {
+  uint32_t metricId;
+  uint32_t pad0;
+  double   value;
+};
+
+
+//***************************************************************************
+// Writer
+//***************************************************************************
+
+// write: writes 'prof' to 'fnm' including metric values
+// [mBegId, mEndId) of each node; throws on error.  Expects
+// CCT::Tree::makeDensePreorderIds() ids, as does experiment.xml.
+void
+write(const Prof::CallPath::Profile& prof, const std::string& fnm,
+      const std::string& title, uint mBegId, uint mEndId);
+
+
+//***************************************************************************
+// Reader
+//***************************************************************************
+
+// Reader: random-access view of a mapped database.  All accessors are
+// O(1) except findStruct (O(log n)) and metric (O(log k) for k values
+// at the node).  open builds the id index, so a Reader is safe to
+// share between threads once open.
+class Reader {
+public:
+  Reader();
+  ~Reader();
+
+  // open: maps and validates 'fnm' (header, sections and node
+  // records) and indexes the nodes by id; throws on error
+  void
+  open(const std::string& fnm);
+
+  void
+  close();
+
+  const Hdr&
+  hdr() const
+  { return *m_hdr; }
+
+  const char*
+  str(uint32_t off) const
+  { return (off < m_hdr->strings.count) ? m_strings + off : ""; }
+
+  const char*
+  title() const
+  { return str(m_hdr->title); }
+
+  // metrics
+  uint32_t
+  numMetrics() const
+  { return (uint32_t)m_hdr->metrics.count; }
+
+  const MetricRec&
+  metricDesc(uint32_t i) const
+  { return m_metrics[i]; }
+
+  // static structure
+  uint32_t
+  numStructs() const
+  { return (uint32_t)m_hdr->structs.count; }
+
+  const StructRec&
+  structRec(uint32_t i) const
+  { return m_structs[i]; }
+
+  const StructRec*
+  findStruct(uint32_t id) const;
+
+  // calling context tree: record 0 is the root
+  uint32_t
+  numNodes() const
+  { return (uint32_t)m_hdr->nodes.count; }
+
+  const NodeRec&
+  node(uint32_t idx) const
+  { return m_nodes[idx]; }
+
+  uint32_t
+  firstChild(uint32_t idx) const
+  { return (idx + 1 < m_nodes[idx].subtreeEnd) ? idx + 1 : NullIdx; }
+
+  uint32_t
+  nextSibling(uint32_t idx) const
+  {
+    uint32_t p = m_nodes[idx].parent;
+    uint32_t nxt = m_nodes[idx].subtreeEnd;
+    return (p != NullIdx && nxt < m_nodes[p].subtreeEnd) ? nxt : NullIdx;
+  }
+
+  // findNode: record index of the node with CCT id 'id' or NullIdx
+  uint32_t
+  findNode(uint32_t id) const;
+
+  // metric values of a node
+  const MetricValRec*
+  metricVals(uint32_t idx) const
+  { return m_metricVals + m_nodes[idx].metricBeg; }
+
+  double
+  metric(uint32_t idx, uint32_t metricId) const;
+
+private:
+  Reader(const Reader&);
+  Reader& operator=(const Reader&);
+
+  static const char*
+  validateNodes(const NodeRec* nodes, uint64_t numNodes, uint64_t numVals);
+
+  void*  m_addr;
+  size_t m_size;
+
+  const Hdr*          m_hdr;
+  const char*         m_strings;
+  const MetricRec*    m_metrics;
+  const StructRec*    m_structs;
+  const NodeRec*      m_nodes;
+  const MetricValRec* m_metricVals;
+
+  std::vector<uint32_t> m_idToIdx;
+};
+
+
+} // namespace ExperimentDB
+
+} // namespace Prof
+
+//***************************************************************************
+
+#endif /* prof_Prof_ExperimentDB_hpp */
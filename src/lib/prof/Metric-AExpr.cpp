@@ -101,6 +101,15 @@ AExpr::toString() const
 }
 
 
+void
+AExpr::compile_opands(AExprProgram& prog, AExpr** opands, uint sz)
+{
+  for (uint i = 0; i < sz; ++i) {
+    opands[i]->compile(prog);
+  }
+}
+
+
 void
 AExpr::dump_opands(std::ostream& os, AExpr** opands, uint sz, const char* sep)
 {
@@ -139,6 +148,14 @@ Neg::eval(const Metric::IData& mdata) const
 }
 
 
+void
+Neg::compile(AExprProgram& prog) const
+{
+  m_expr->compile(prog);
+  prog.emitOp(AExprProgram::OpNeg, 1);
+}
+
+
 std::ostream&
 Neg::dumpMe(std::ostream& os) const
 {
@@ -177,6 +194,15 @@ Power::eval(const Metric::IData& mdata) const
 }
 
 
+void
+Power::compile(AExprProgram& prog) const
+{
+  m_base->compile(prog);
+  m_exponent->compile(prog);
+  prog.emitOp(AExprProgram::OpPower, 2);
+}
+
+
 std::ostream&
 Power::dumpMe(std::ostream& os) const
 {
@@ -209,6 +235,15 @@ Divide::eval(const Metric::IData& mdata) const
 }
 
 
+void
+Divide::compile(AExprProgram& prog) const
+{
+  m_numerator->compile(prog);
+  m_denominator->compile(prog);
+  prog.emitOp(AExprProgram::OpDivide, 2);
+}
+
+
 std::ostream&
 Divide::dumpMe(std::ostream& os) const
 {
@@ -237,6 +272,15 @@ Minus::eval(const Metric::IData& mdata) const
 }
 
 
+void
+Minus::compile(AExprProgram& prog) const
+{
+  m_minuend->compile(prog);
+  m_subtrahend->compile(prog);
+  prog.emitOp(AExprProgram::OpMinus, 2);
+}
+
+
 std::ostream&
 Minus::dumpMe(std::ostream& os) const
 {
@@ -271,6 +315,14 @@ Plus::eval(const Metric::IData& mdata) const
 }
 
 
+void
+Plus::compile(AExprProgram& prog) const
+{
+  compile_opands(prog, m_opands, m_sz);
+  prog.emitOp(AExprProgram::OpPlus, m_sz);
+}
+
+
 std::ostream&
 Plus::dumpMe(std::ostream& os) const
 {
@@ -308,6 +360,14 @@ Times::eval(const Metric::IData& mdata) const
 }
 
 
+void
+Times::compile(AExprProgram& prog) const
+{
+  compile_opands(prog, m_opands, m_sz);
+  prog.emitOp(AExprProgram::OpTimes, m_sz);
+}
+
+
 std::ostream&
 Times::dumpMe(std::ostream& os) const
 {
@@ -345,6 +405,14 @@ Max::eval(const Metric::IData& mdata) const
 }
 
 
+void
+Max::compile(AExprProgram& prog) const
+{
+  compile_opands(prog, m_opands, m_sz);
+  prog.emitOp(AExprProgram::OpMax, m_sz);
+}
+
+
 std::ostream&
 Max::dumpMe(std::ostream& os) const
 {
@@ -386,6 +454,14 @@ Min::eval(const Metric::IData& mdata) const
 }
 
 
+void
+Min::compile(AExprProgram& prog) const
+{
+  compile_opands(prog, m_opands, m_sz);
+  prog.emitOp(AExprProgram::OpMin, m_sz);
+}
+
+
 std::ostream&
 Min::dumpMe(std::ostream& os) const
 {
@@ -419,6 +495,14 @@ Mean::eval(const Metric::IData& mdata) const
 }
 
 
+void
+Mean::compile(AExprProgram& prog) const
+{
+  compile_opands(prog, m_opands, m_sz);
+  prog.emitOp(AExprProgram::OpMean, m_sz);
+}
+
+
 std::ostream&
 Mean::dumpMe(std::ostream& os) const
 {
@@ -453,6 +537,14 @@ StdDev::eval(const Metric::IData& mdata) const
 }
 
 
+void
+StdDev::compile(AExprProgram& prog) const
+{
+  compile_opands(prog, m_opands, m_sz);
+  prog.emitOp(AExprProgram::OpStdDev, m_sz);
+}
+
+
 std::ostream&
 StdDev::dumpMe(std::ostream& os) const
 {
@@ -492,6 +584,14 @@ CoefVar::eval(const Metric::IData& mdata) const
 }
 
 
+void
+CoefVar::compile(AExprProgram& prog) const
+{
+  compile_opands(prog, m_opands, m_sz);
+  prog.emitOp(AExprProgram::OpCoefVar, m_sz);
+}
+
+
 std::ostream&
 CoefVar::dumpMe(std::ostream& os) const
 {
@@ -531,6 +631,14 @@ RStdDev::eval(const Metric::IData& mdata) const
 }
 
 
+void
+RStdDev::compile(AExprProgram& prog) const
+{
+  compile_opands(prog, m_opands, m_sz);
+  prog.emitOp(AExprProgram::OpRStdDev, m_sz);
+}
+
+
 std::ostream&
 RStdDev::dumpMe(std::ostream& os) const
 {
@@ -54,6 +54,10 @@
 //
 // Assumes all sources are known when evaluation rule is invoked.
 //
+// Besides eval()/evalNF(), an expression can be compiled into an
+// AExprProgram (compile()/compileNF()) that evaluates it for a batch
+// of nodes at a time with the same arithmetic.
+//
 // Currently supported expressions are
 //   Const  : double constant                      : leaf
 //   Var    : variable with a String name          : leaf
@@ -87,6 +91,7 @@
 
 #include "Metric-IData.hpp"
 #include "Metric-IDBExpr.hpp"
+#include "Metric-AExprProgram.hpp"
 
 #include <lib/support/NaN.h>
 #include <lib/support/Unique.hpp>
@@ -147,6 +152,18 @@ public:
     return z;
   }
 
+  // compile: appends to 'prog' instructions that push eval()'s value
+  virtual void
+  compile(AExprProgram& prog) const = 0;
+
+  // compileNF: appends to 'prog' instructions that perform evalNF()
+  virtual void
+  compileNF(AExprProgram& prog) const
+  {
+    compile(prog);
+    prog.emitStore(m_accumId[0]);
+  }
+
 
   static bool
   isok(double x)
@@ -319,6 +336,19 @@ protected:
   }
 
 
+  void
+  compileStdDevNF(AExprProgram& prog, AExpr** opands, uint sz) const
+  {
+    compile_opands(prog, opands, sz);
+    prog.emitOp(AExprProgram::OpSumSquares, sz);
+    prog.emitStore(m_accumId[1]); // sum of squares
+    prog.emitStore(m_accumId[0]); // sum
+  }
+
+
+  static void
+  compile_opands(AExprProgram& prog, AExpr** opands, uint sz);
+
   static void
   dump_opands(std::ostream& os, AExpr** opands, uint sz,
 	      const char* sep = ", ");
@@ -349,6 +379,10 @@ public:
   eval(const Metric::IData& GCC_ATTR_UNUSED mdata) const
   { return m_c; }
 
+  virtual void
+  compile(AExprProgram& prog) const
+  { prog.emitConst(m_c); }
+
 
   // ------------------------------------------------------------
   // Metric::IDBExpr: exported formulas for Flat and Callers view
@@ -390,6 +424,9 @@ public:
   virtual double
   eval(const Metric::IData& mdata) const;
 
+  virtual void
+  compile(AExprProgram& prog) const;
+
 
   // ------------------------------------------------------------
   // Metric::IDBExpr: exported formulas for Flat and Callers view
@@ -435,6 +472,10 @@ public:
   eval(const Metric::IData& mdata) const
   { return mdata.demandMetric(m_metricId); }
 
+  virtual void
+  compile(AExprProgram& prog) const
+  { prog.emitVar(m_metricId); }
+
 
   // ------------------------------------------------------------
   // Metric::IDBExpr: exported formulas for Flat and Callers view
@@ -490,6 +531,9 @@ public:
   virtual double
   eval(const Metric::IData& mdata) const;
 
+  virtual void
+  compile(AExprProgram& prog) const;
+
 
   // ------------------------------------------------------------
   // Metric::IDBExpr:
@@ -540,6 +584,9 @@ public:
   virtual double
   eval(const Metric::IData& mdata) const;
 
+  virtual void
+  compile(AExprProgram& prog) const;
+
   // ------------------------------------------------------------
   // Metric::IDBExpr:
   // ------------------------------------------------------------
@@ -587,6 +634,9 @@ public:
   virtual double
   eval(const Metric::IData& mdata) const;
 
+  virtual void
+  compile(AExprProgram& prog) const;
+
   // ------------------------------------------------------------
   // Metric::IDBExpr:
   // ------------------------------------------------------------
@@ -631,6 +681,9 @@ public:
   virtual double
   eval(const Metric::IData& mdata) const;
 
+  virtual void
+  compile(AExprProgram& prog) const;
+
   // ------------------------------------------------------------
   // Metric::IDBExpr:
   // ------------------------------------------------------------
@@ -681,6 +734,9 @@ public:
   virtual double
   eval(const Metric::IData& mdata) const;
 
+  virtual void
+  compile(AExprProgram& prog) const;
+
   // ------------------------------------------------------------
   // Metric::IDBExpr:
   // ------------------------------------------------------------
@@ -727,6 +783,9 @@ public:
   virtual double
   eval(const Metric::IData& mdata) const;
 
+  virtual void
+  compile(AExprProgram& prog) const;
+
   // ------------------------------------------------------------
   // Metric::IDBExpr:
   // ------------------------------------------------------------
@@ -776,6 +835,9 @@ public:
   virtual double
   eval(const Metric::IData& mdata) const;
 
+  virtual void
+  compile(AExprProgram& prog) const;
+
   // ------------------------------------------------------------
   // Metric::IDBExpr:
   // ------------------------------------------------------------
@@ -825,6 +887,9 @@ public:
   virtual double
   eval(const Metric::IData& mdata) const;
 
+  virtual void
+  compile(AExprProgram& prog) const;
+
   virtual double
   evalNF(Metric::IData& mdata) const
   {
@@ -833,6 +898,14 @@ public:
     return z;
   }
 
+  virtual void
+  compileNF(AExprProgram& prog) const
+  {
+    compile_opands(prog, m_opands, m_sz);
+    prog.emitOp(AExprProgram::OpPlus, m_sz);
+    prog.emitStore(m_accumId[0]);
+  }
+
 
   // ------------------------------------------------------------
   // Metric::IDBExpr:
@@ -886,10 +959,17 @@ public:
   virtual double
   eval(const Metric::IData& mdata) const;
 
+  virtual void
+  compile(AExprProgram& prog) const;
+
   virtual double
   evalNF(Metric::IData& mdata) const
   { return evalStdDevNF(mdata, m_opands, m_sz); }
 
+  virtual void
+  compileNF(AExprProgram& prog) const
+  { compileStdDevNF(prog, m_opands, m_sz); }
+
 
   // ------------------------------------------------------------
   // Metric::IDBExpr: exported formulas for Flat and Callers view
@@ -952,10 +1032,17 @@ public:
   virtual double
   eval(const Metric::IData& mdata) const;
 
+  virtual void
+  compile(AExprProgram& prog) const;
+
   virtual double
   evalNF(Metric::IData& mdata) const
   { return evalStdDevNF(mdata, m_opands, m_sz); }
 
+  virtual void
+  compileNF(AExprProgram& prog) const
+  { compileStdDevNF(prog, m_opands, m_sz); }
+
 
   // ------------------------------------------------------------
   // Metric::IDBExpr: exported formulas for Flat and Callers view
@@ -1018,10 +1105,17 @@ public:
   virtual double
   eval(const Metric::IData& mdata) const;
 
+  virtual void
+  compile(AExprProgram& prog) const;
+
   virtual double
   evalNF(Metric::IData& mdata) const
   { return evalStdDevNF(mdata, m_opands, m_sz); }
 
+  virtual void
+  compileNF(AExprProgram& prog) const
+  { compileStdDevNF(prog, m_opands, m_sz); }
+
 
   // ------------------------------------------------------------
   // Metric::IDBExpr: exported formulas for Flat and Callers view
@@ -1086,6 +1180,10 @@ public:
   eval(const Metric::IData& GCC_ATTR_UNUSED mdata) const
   { return (double)m_numSrc; }
 
+  virtual void
+  compile(AExprProgram& prog) const
+  { prog.emitConst((double)m_numSrc); }
+
 
   // ------------------------------------------------------------
   // Metric::IDBExpr: exported formulas for Flat and Callers view
@@ -0,0 +1,325 @@
+// -*-Mode: C++;-*-
+
+// * BeginRiceCopyright *****************************************************
+//
+// $HeadURL$
+// $Id$
+//
+// --------------------------------------------------------------------------
+// Part of HPCToolkit (hpctoolkit.org)
+//
+// Information about sources of support for research and development of
+// HPCToolkit is at 'hpctoolkit.org' and in 'README.Acknowledgments'.
+// --------------------------------------------------------------------------
+//
+// Copyright ((c)) 2002-2020, Rice University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+//
+// * Neither the name of Rice University (RICE) nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+//
+// This software is provided by RICE and contributors "as is" and any
+// express or implied warranties, including, but not limited to, the
+// implied warranties of merchantability and fitness for a particular
+// purpose are disclaimed. In no event shall RICE or contributors be
+// liable for any direct, indirect, incidental, special, exemplary, or
+// consequential damages (including, but not limited to, procurement of
+// substitute goods or services; loss of use, data, or profits; or
+// business interruption) however caused and on any theory of liability,
+// whether in contract, strict liability, or tort (including negligence
+// or otherwise) arising in any way out of the use of this software, even
+// if advised of the possibility of such damage.
+//
+// ******************************************************* EndRiceCopyright *
+
+//***************************************************************************
+//
+// File:
+//    $HeadURL$
+//
+// Purpose:
+//    [The purpose of this file]
+//
+// Description:
+//    [The set of functions, macros, etc. defined in the file]
+//
+//***************************************************************************
+
+//************************* System Include Files ****************************
+
+#include <iostream>
+using std::endl;
+
+#include <vector>
+#include <algorithm>
+
+#include <cmath>
+#include <cfloat>
+
+//*************************** User Include Files ****************************
+
+#include <include/uint.h>
+
+#include "Metric-AExprProgram.hpp"
+#include "Metric-AExpr.hpp" // AExpr::isok(), epsilon
+
+#include <lib/support/diagnostics.h>
+#include <lib/support/NaN.h>
+
+//*************************** Forward Declarations **************************
+
+
+//***************************************************************************
+
+namespace Prof {
+namespace Metric {
+
+//***************************************************************************
+// AExprProgram
+//***************************************************************************
+
+void
+AExprProgram::emit(const Instr& instr, uint numPop, uint numPush)
+{
+  DIAG_Assert(numPop <= m_depth, "AExprProgram: stack underflow");
+  m_code.push_back(instr);
+  m_depth = m_depth - numPop + numPush;
+  m_maxDepth = std::max(m_maxDepth, m_depth);
+}
+
+
+// N.B.: Every operation must perform the arithmetic of the
+// corresponding AExpr::eval() or evalNF() in the same order.
+void
+AExprProgram::eval(Metric::IData* const* nodes, uint n,
+		   std::vector<double>& stack) const
+{
+  DIAG_Assert(n <= BatchSz, "AExprProgram::eval: batch too large");
+
+  if (stack.size() < m_maxDepth * BatchSz) {
+    stack.resize(m_maxDepth * BatchSz);
+  }
+
+  uint sp = 0; // number of slots in use
+  for (uint i = 0; i < m_code.size(); ++i) {
+    const Instr& instr = m_code[i];
+    uint base = sp - instr.n; // first operand of an operation
+    double* z = &stack[base * BatchSz];
+
+    switch (instr.op) {
+      case OpConst:
+	z = &stack[sp * BatchSz];
+	for (uint k = 0; k < n; ++k) {
+	  z[k] = instr.c;
+	}
+	sp++;
+	break;
+
+      case OpVar:
+	z = &stack[sp * BatchSz];
+	for (uint k = 0; k < n; ++k) {
+	  z[k] = nodes[k]->demandMetric(instr.mId);
+	}
+	sp++;
+	break;
+
+      case OpNeg:
+	for (uint k = 0; k < n; ++k) {
+	  z[k] = -z[k];
+	}
+	sp = base + 1;
+	break;
+
+      case OpPower: {
+	const double* e = z + BatchSz;
+	for (uint k = 0; k < n; ++k) {
+	  z[k] = pow(z[k], e[k]);
+	}
+	sp = base + 1;
+	break;
+      }
+
+      case OpDivide: {
+	const double* d = z + BatchSz;
+	for (uint k = 0; k < n; ++k) {
+	  z[k] = (AExpr::isok(d[k]) && d[k] != 0.0) ? (z[k] / d[k])
+	    : c_FP_NAN_d;
+	}
+	sp = base + 1;
+	break;
+      }
+
+      case OpMinus: {
+	const double* s = z + BatchSz;
+	for (uint k = 0; k < n; ++k) {
+	  z[k] = z[k] - s[k];
+	}
+	sp = base + 1;
+	break;
+      }
+
+      case OpPlus:
+      case OpMean: {
+	double sum[BatchSz];
+	std::fill(sum, sum + n, 0.0);
+	for (uint j = 0; j < instr.n; ++j) {
+	  const double* x = z + j * BatchSz;
+	  for (uint k = 0; k < n; ++k) {
+	    sum[k] += x[k];
+	  }
+	}
+	for (uint k = 0; k < n; ++k) {
+	  z[k] = (instr.op == OpMean) ? (sum[k] / (double)instr.n) : sum[k];
+	}
+	sp = base + 1;
+	break;
+      }
+
+      case OpTimes: {
+	double prod[BatchSz];
+	std::fill(prod, prod + n, 1.0);
+	for (uint j = 0; j < instr.n; ++j) {
+	  const double* x = z + j * BatchSz;
+	  for (uint k = 0; k < n; ++k) {
+	    prod[k] *= x[k];
+	  }
+	}
+	std::copy(prod, prod + n, z);
+	sp = base + 1;
+	break;
+      }
+
+      case OpMin: {
+	// observational min (cf. Min::eval())
+	double min[BatchSz];
+	std::fill(min, min + n, DBL_MAX);
+	for (uint j = 0; j < instr.n; ++j) {
+	  const double* x = z + j * BatchSz;
+	  for (uint k = 0; k < n; ++k) {
+	    if (x[k] != 0.0) {
+	      min[k] = std::min(min[k], x[k]);
+	    }
+	  }
+	}
+	for (uint k = 0; k < n; ++k) {
+	  z[k] = (min[k] == DBL_MAX) ? DBL_MIN : min[k];
+	}
+	sp = base + 1;
+	break;
+      }
+
+      case OpMax:
+	for (uint j = 1; j < instr.n; ++j) {
+	  const double* x = z + j * BatchSz;
+	  for (uint k = 0; k < n; ++k) {
+	    z[k] = std::max(z[k], x[k]);
+	  }
+	}
+	sp = base + 1;
+	break;
+
+      case OpStdDev:
+      case OpCoefVar:
+      case OpRStdDev: {
+	// cf. AExpr::evalVariance()
+	double mean[BatchSz], var[BatchSz];
+	std::fill(mean, mean + n, 0.0);
+	std::fill(var, var + n, 0.0);
+	for (uint j = 0; j < instr.n; ++j) {
+	  const double* x = z + j * BatchSz;
+	  for (uint k = 0; k < n; ++k) {
+	    double delta = x[k] - mean[k];
+	    mean[k] += delta / (j + 1);
+	    var[k] += delta * (x[k] - mean[k]);
+	  }
+	}
+	for (uint k = 0; k < n; ++k) {
+	  double sdev = sqrt(var[k] / instr.n);
+	  if (instr.op == OpStdDev) {
+	    z[k] = sdev;
+	  }
+	  else if (instr.op == OpCoefVar) {
+	    z[k] = (mean[k] > epsilon) ? (sdev / mean[k]) : 0.0;
+	  }
+	  else {
+	    z[k] = (mean[k] > epsilon) ? ((sdev / mean[k]) * 100) : 0.0;
+	  }
+	}
+	sp = base + 1;
+	break;
+      }
+
+      case OpSumSquares: {
+	// cf. AExpr::evalSumSquares()
+	double sum[BatchSz], sumSq[BatchSz];
+	std::fill(sum, sum + n, 0.0);
+	std::fill(sumSq, sumSq + n, 0.0);
+	for (uint j = 0; j < instr.n; ++j) {
+	  const double* x = z + j * BatchSz;
+	  for (uint k = 0; k < n; ++k) {
+	    sum[k] += x[k];
+	    sumSq[k] += (x[k] * x[k]);
+	  }
+	}
+	std::copy(sum, sum + n, z);
+	std::copy(sumSq, sumSq + n, z + BatchSz);
+	sp = base + 2;
+	break;
+      }
+
+      case OpStore:
+	z = &stack[(sp - 1) * BatchSz];
+	for (uint k = 0; k < n; ++k) {
+	  nodes[k]->demandMetric(instr.mId, instr.size) = z[k];
+	}
+	sp--;
+	break;
+
+      default:
+	DIAG_Die(DIAG_UnexpectedInput);
+    }
+  }
+}
+
+
+std::ostream&
+AExprProgram::dump(std::ostream& os) const
+{
+  static const char* opNames[] = {
+    "const", "var", "neg", "power", "divide", "minus", "plus", "times",
+    "min", "max", "mean", "stddev", "coefvar", "r-stddev", "sum-squares",
+    "store"
+  };
+
+  for (uint i = 0; i < m_code.size(); ++i) {
+    const Instr& instr = m_code[i];
+    os << i << ": " << opNames[instr.op];
+    if (instr.op == OpConst) {
+      os << " " << instr.c;
+    }
+    else if (instr.op == OpVar || instr.op == OpStore) {
+      os << " $" << instr.mId;
+    }
+    else {
+      os << " #" << instr.n;
+    }
+    os << endl;
+  }
+  return os;
+}
+
+
+} // namespace Metric
+} // namespace Prof
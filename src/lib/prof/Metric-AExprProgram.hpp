@@ -0,0 +1,203 @@
+// -*-Mode: C++;-*-
+
+// * BeginRiceCopyright *****************************************************
+//
+// $HeadURL$
+// $Id$
+//
+// --------------------------------------------------------------------------
+// Part of HPCToolkit (hpctoolkit.org)
+//
+// Information about sources of support for research and development of
+// HPCToolkit is at 'hpctoolkit.org' and in 'README.Acknowledgments'.
+// --------------------------------------------------------------------------
+//
+// Copyright ((c)) 2002-2020, Rice University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+//
+// * Neither the name of Rice University (RICE) nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+//
+// This software is provided by RICE and contributors "as is" and any
+// express or implied warranties, including, but not limited to, the
+// implied warranties of merchantability and fitness for a particular
+// purpose are disclaimed. In no event shall RICE or contributors be
+// liable for any direct, indirect, incidental, special, exemplary, or
+// consequential damages (including, but not limited to, procurement of
+// substitute goods or services; loss of use, data, or profits; or
+// business interruption) however caused and on any theory of liability,
+// whether in contract, strict liability, or tort (including negligence
+// or otherwise) arising in any way out of the use of this software, even
+// if advised of the possibility of such damage.
+//
+// ******************************************************* EndRiceCopyright *
+
+//***************************************************************************
+//
+// File:
+//    $HeadURL$
+//
+// Purpose:
+//    A Metric::AExpr compiled into a flat program that is evaluated
+//    for a batch of Metric::IData (e.g., CCT nodes) at a time.
+//
+// Description:
+//    An AExprProgram is a sequence of stack instructions produced by
+//    AExpr::compile() and AExpr::compileNF().  Each stack slot holds
+//    one value per node of the batch, so that every instruction is a
+//    simple loop over the batch instead of a virtual call per node.
+//    The arithmetic is that of the AExpr interpreter (the same
+//    operations in the same order), so the results are identical.
+//
+//***************************************************************************
+
+#ifndef prof_Prof_Metric_AExprProgram_hpp
+#define prof_Prof_Metric_AExprProgram_hpp
+
+//************************* System Include Files ****************************
+
+#include <iostream>
+#include <vector>
+
+//*************************** User Include Files ****************************
+
+#include <include/uint.h>
+
+#include "Metric-IData.hpp"
+
+//*************************** Forward Declarations **************************
+
+
+//***************************************************************************
+
+namespace Prof {
+namespace Metric {
+
+//***************************************************************************
+// AExprProgram
+//***************************************************************************
+
+class AExprProgram {
+public:
+  // maximum number of nodes evaluated by one call to eval()
+  static const uint BatchSz = 256;
+
+  enum OpTy {
+    // push a value
+    OpConst,      // c
+    OpVar,        // metric 'mId'
+
+    // pop 'n' operands and push the result (cf. class AExpr)
+    OpNeg,
+    OpPower,
+    OpDivide,
+    OpMinus,
+    OpPlus,
+    OpTimes,
+    OpMin,
+    OpMax,
+    OpMean,
+    OpStdDev,
+    OpCoefVar,
+    OpRStdDev,
+
+    // pop 'n' operands and push their sum and sum of squares
+    OpSumSquares,
+
+    // pop a value into metric 'mId' (the metric vector has at least
+    // 'size' elements afterwards)
+    OpStore
+  };
+
+  struct Instr {
+    Instr(OpTy op_, uint n_, uint mId_, uint size_, double c_)
+      : op(op_), n(n_), mId(mId_), size(size_), c(c_)
+    { }
+
+    OpTy   op;
+    uint   n;
+    uint   mId;
+    uint   size;
+    double c;
+  };
+
+public:
+  AExprProgram()
+    : m_depth(0), m_maxDepth(0)
+  { }
+
+  ~AExprProgram()
+  { }
+
+  // --------------------------------------------------------
+  // Code generation
+  // --------------------------------------------------------
+
+  void
+  emitConst(double c)
+  { emit(Instr(OpConst, 0, 0, 0, c), 0, 1); }
+
+  void
+  emitVar(uint mId)
+  { emit(Instr(OpVar, 0, mId, 0, 0.0), 0, 1); }
+
+  // emitOp: an operation with 'n' operands
+  void
+  emitOp(OpTy op, uint n)
+  { emit(Instr(op, n, 0, 0, 0.0), n, (op == OpSumSquares) ? 2 : 1); }
+
+  void
+  emitStore(uint mId, uint size = 0)
+  { emit(Instr(OpStore, 0, mId, size, 0.0), 1, 0); }
+
+  bool
+  empty() const
+  { return m_code.empty(); }
+
+  uint
+  size() const
+  { return m_code.size(); }
+
+  // --------------------------------------------------------
+  // Evaluation
+  // --------------------------------------------------------
+
+  // eval: runs the program for 'nodes[0 .. n)', n <= BatchSz, using
+  // 'stack' as scratch space
+  void
+  eval(Metric::IData* const* nodes, uint n, std::vector<double>& stack) const;
+
+  // --------------------------------------------------------
+  //
+  // --------------------------------------------------------
+
+  std::ostream&
+  dump(std::ostream& os = std::cerr) const;
+
+private:
+  void
+  emit(const Instr& instr, uint numPop, uint numPush);
+
+private:
+  std::vector<Instr> m_code;
+  uint m_depth;    // stack depth after m_code
+  uint m_maxDepth;
+};
+
+
+} // namespace Metric
+} // namespace Prof
+
+#endif /* prof_Prof_Metric_AExprProgram_hpp */
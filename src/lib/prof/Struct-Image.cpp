@@ -0,0 +1,610 @@
+// -*-Mode: C++;-*-
+
+// * BeginRiceCopyright *****************************************************
+//
+// $HeadURL$
+// $Id$
+//
+// --------------------------------------------------------------------------
+// Part of HPCToolkit (hpctoolkit.org)
+//
+// Information about sources of support for research and development of
+// HPCToolkit is at 'hpctoolkit.org' and in 'README.Acknowledgments'.
+// --------------------------------------------------------------------------
+//
+// Copyright ((c)) 2002-2020, Rice University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+//
+// * Neither the name of Rice University (RICE) nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+//
+// This software is provided by RICE and contributors "as is" and any
+// express or implied warranties, including, but not limited to, the
+// implied warranties of merchantability and fitness for a particular
+// purpose are disclaimed. In no event shall RICE or contributors be
+// liable for any direct, indirect, incidental, special, exemplary, or
+// consequential damages (including, but not limited to, procurement of
+// substitute goods or services; loss of use, data, or profits; or
+// business interruption) however caused and on any theory of liability,
+// whether in contract, strict liability, or tort (including negligence
+// or otherwise) arising in any way out of the use of this software, even
+// if advised of the possibility of such damage.
+//
+// ******************************************************* EndRiceCopyright *
+
+//***************************************************************************
+//
+// File:
+//   $HeadURL$
+//
+// Purpose:
+//   [The purpose of this file]
+//
+// Description:
+//   [The set of functions, macros, etc. defined in the file]
+//
+//***************************************************************************
+
+//************************* System Include Files ****************************
+
+#include <string>
+using std::string;
+
+#include <vector>
+#include <map>
+#include <unordered_map>
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+//*************************** User Include Files ****************************
+
+#include <include/uint.h>
+
+#include "Struct-Image.hpp"
+#include "Struct-Tree.hpp"
+
+#include <lib/support/diagnostics.h>
+#include <lib/support/FileUtil.hpp>
+#include <lib/support/NonUniformDegreeTree.hpp>
+#include <lib/support/RealPathMgr.hpp>
+
+
+//***************************************************************************
+// Writer
+//***************************************************************************
+
+namespace Prof {
+
+namespace Struct {
+
+namespace Image {
+
+namespace {
+
+class StringTbl {
+public:
+  StringTbl()
+  { m_buf.push_back('\0'); } // offset 0: ""
+
+  uint32_t
+  insert(const string& s)
+  {
+    if (s.empty()) {
+      return 0;
+    }
+    std::unordered_map<string, uint32_t>::iterator it = m_map.find(s);
+    if (it != m_map.end()) {
+      return it->second;
+    }
+    if (m_buf.size() + s.size() + 1 > 0xffffffffu) {
+      DIAG_Throw("structure image string table exceeds 4GB");
+    }
+    uint32_t off = (uint32_t)m_buf.size();
+    m_buf.append(s.c_str(), s.size() + 1);
+    m_map.insert(std::make_pair(s, off));
+    return off;
+  }
+
+  const string&
+  buf() const
+  { return m_buf; }
+
+private:
+  string m_buf;
+  std::unordered_map<string, uint32_t> m_map;
+};
+
+
+class Builder {
+public:
+  void
+  addLM(const LM* lm)
+  {
+    LMRec r;
+    memset(&r, 0, sizeof(r));
+    r.name    = strings.insert(lm->name());
+    r.nodeBeg = (uint32_t)nodes.size();
+    addChildren(lm, NullIdx);
+    r.nodeEnd = (uint32_t)nodes.size();
+    lms.push_back(r);
+  }
+
+  // linkAliens: resolve Alien -> Proc links once all Procs are known
+  void
+  linkAliens()
+  {
+    for (uint i = 0; i < aliens.size(); ++i) {
+      const Alien* a = aliens[i].first;
+      std::map<const Proc*, uint32_t>::iterator it = procIdx.find(a->proc());
+      nodes[aliens[i].second].proc = (it != procIdx.end()) ? it->second : NullIdx;
+    }
+  }
+
+  StringTbl strings;
+  std::vector<LMRec> lms;
+  std::vector<NodeRec> nodes;
+  std::vector<VMARec> vmas;
+
+private:
+  void
+  addChildren(const ANode* x, uint32_t parentIdx)
+  {
+    for (NonUniformDegreeTreeNodeChildIterator it(x); it.Current(); ++it) {
+      addNode(static_cast<const ANode*>(it.Current()), parentIdx);
+    }
+  }
+
+  void
+  addNode(const ANode* x, uint32_t parentIdx)
+  {
+    uint32_t idx = (uint32_t)nodes.size();
+    const ACodeNode* c = static_cast<const ACodeNode*>(x);
+
+    NodeRec r;
+    memset(&r, 0, sizeof(r));
+    r.parent  = parentIdx;
+    r.type    = (uint8_t)x->type();
+    r.begLine = c->begLine();
+    r.endLine = c->endLine();
+    r.origId  = c->m_origId;
+    r.proc    = NullIdx;
+
+    switch (x->type()) {
+    case ANode::TyFile:
+      r.name = strings.insert(x->name());
+      break;
+    case ANode::TyProc:
+      r.name     = strings.insert(x->name());
+      r.linkName = strings.insert(static_cast<const Proc*>(x)->linkName());
+      procIdx[static_cast<const Proc*>(x)] = idx;
+      break;
+    case ANode::TyAlien:
+      r.name     = strings.insert(x->name());
+      r.fileName = strings.insert(static_cast<const Alien*>(x)->fileName());
+      aliens.push_back(std::make_pair(static_cast<const Alien*>(x), idx));
+      break;
+    case ANode::TyLoop:
+      r.fileName = strings.insert(static_cast<const Loop*>(x)->fileName());
+      break;
+    case ANode::TyStmt: {
+      Stmt* s = const_cast<Stmt*>(static_cast<const Stmt*>(x));
+      r.stmtType = (uint8_t)s->stmtType();
+      r.target   = s->target();
+      r.device   = strings.insert(s->device());
+      break;
+    }
+    default:
+      DIAG_Throw("structure images do not support "
+		 << ANode::ANodeTyToName(x->type()) << " nodes");
+    }
+
+    const VMAIntervalSet& vmaset = c->vmaSet();
+    r.vmaBeg = (uint32_t)vmas.size();
+    r.vmaCnt = (uint32_t)vmaset.size();
+    for (VMAIntervalSet::const_iterator it = vmaset.begin();
+	 it != vmaset.end(); ++it) {
+      VMARec v = { it->beg(), it->end() };
+      vmas.push_back(v);
+    }
+
+    nodes.push_back(r);
+    addChildren(x, idx);
+  }
+
+  std::map<const Proc*, uint32_t> procIdx;
+  std::vector<std::pair<const Alien*, uint32_t> > aliens;
+};
+
+
+// append: appends 'sz' bytes to 'img', padding to an 8-byte boundary
+static void
+append(string& img, const void* data, size_t sz)
+{
+  img.append((const char*)data, sz);
+  img.append((8 - (img.size() % 8)) % 8, '\0');
+}
+
+} // namespace
+
+
+void
+make(string& img, const Tree& structure, const string& srcFnm)
+{
+  struct stat st;
+  if (stat(srcFnm.c_str(), &st) != 0) {
+    DIAG_Throw("cannot stat structure file '" << srcFnm << "': "
+	       << strerror(errno));
+  }
+
+  Builder b;
+  const Root* root = structure.root();
+  for (NonUniformDegreeTreeNodeChildIterator it(root); it.Current(); ++it) {
+    const ANode* x = static_cast<const ANode*>(it.Current());
+    if (x->type() != ANode::TyLM) {
+      DIAG_Throw("structure images do not support "
+		 << ANode::ANodeTyToName(x->type()) << " nodes");
+    }
+    b.addLM(static_cast<const LM*>(x));
+  }
+  b.linkAliens();
+
+  Hdr hdr;
+  memset(&hdr, 0, sizeof(hdr));
+  memcpy(hdr.magic, HPCPROF_StructImageMagic, sizeof(hdr.magic));
+  hdr.version      = HPCPROF_StructImageVersion;
+  hdr.byteOrder    = HPCPROF_StructImageByteOrder;
+  hdr.srcSize      = st.st_size;
+  hdr.srcMtimeSec  = st.st_mtim.tv_sec;
+  hdr.srcMtimeNsec = st.st_mtim.tv_nsec;
+  hdr.srcDev       = st.st_dev;
+  hdr.srcIno       = st.st_ino;
+
+  img.clear();
+  append(img, &hdr, sizeof(hdr));
+
+  hdr.strings.offset = img.size();
+  hdr.strings.count  = b.strings.buf().size();
+  append(img, b.strings.buf().data(), b.strings.buf().size());
+
+  hdr.lms.offset = img.size();
+  hdr.lms.count  = b.lms.size();
+  append(img, b.lms.data(), b.lms.size() * sizeof(LMRec));
+
+  hdr.nodes.offset = img.size();
+  hdr.nodes.count  = b.nodes.size();
+  append(img, b.nodes.data(), b.nodes.size() * sizeof(NodeRec));
+
+  hdr.vmas.offset = img.size();
+  hdr.vmas.count  = b.vmas.size();
+  append(img, b.vmas.data(), b.vmas.size() * sizeof(VMARec));
+
+  hdr.fileSize = img.size();
+  img.replace(0, sizeof(hdr), (const char*)&hdr, sizeof(hdr));
+}
+
+
+void
+write(const string& img, const string& imgFnm)
+{
+  // Write to a private temporary file and rename it into place so that
+  // concurrent hpcprof(-mpi) processes never see a partial image.
+  char sfx[64];
+  snprintf(sfx, sizeof(sfx), ".%lx-%d.tmp", gethostid(), (int)getpid());
+  string tmpFnm = imgFnm + sfx;
+
+  FILE* fs = fopen(tmpFnm.c_str(), "w");
+  if (!fs) {
+    DIAG_Throw("failed opening structure image '" << tmpFnm << "': "
+	       << strerror(errno));
+  }
+
+  bool ok = (fwrite(img.data(), 1, img.size(), fs) == img.size());
+  ok = (fclose(fs) == 0) && ok;
+  ok = ok && (rename(tmpFnm.c_str(), imgFnm.c_str()) == 0);
+  if (!ok) {
+    int err = errno;
+    unlink(tmpFnm.c_str());
+    DIAG_Throw("failed writing structure image '" << imgFnm << "': "
+	       << strerror(err));
+  }
+}
+
+} // namespace Image
+
+
+//***************************************************************************
+// ImageLoader
+//***************************************************************************
+
+ImageLoader::ImageLoader(const RealPathMgr* realpathMgr)
+  : m_realpathMgr(realpathMgr)
+{
+}
+
+
+ImageLoader::~ImageLoader()
+{
+  for (uint i = 0; i < m_lms.size(); ++i) {
+    delete m_lms[i];
+  }
+  for (uint i = 0; i < m_mappings.size(); ++i) {
+    munmap(m_mappings[i].addr, m_mappings[i].size);
+  }
+  for (uint i = 0; i < m_images.size(); ++i) {
+    delete m_images[i];
+  }
+}
+
+
+bool
+ImageLoader::add(const string& imgFnm, const string& srcFnm)
+{
+  using namespace Image;
+
+  struct stat src_st, img_st;
+  if (stat(srcFnm.c_str(), &src_st) != 0) {
+    return false;
+  }
+
+  int fd = open(imgFnm.c_str(), O_RDONLY);
+  if (fd < 0) {
+    return false;
+  }
+  if (fstat(fd, &img_st) != 0 || (size_t)img_st.st_size < sizeof(Hdr)) {
+    close(fd);
+    return false;
+  }
+
+  void* addr = mmap(NULL, img_st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (addr == MAP_FAILED) {
+    return false;
+  }
+
+  size_t size = img_st.st_size;
+  const Hdr* hdr = (const Hdr*)addr;
+
+  bool ok = (isValid(hdr, size)
+	     && hdr->srcSize == (uint64_t)src_st.st_size
+	     && hdr->srcMtimeSec == (uint64_t)src_st.st_mtim.tv_sec
+	     && hdr->srcMtimeNsec == (uint64_t)src_st.st_mtim.tv_nsec
+	     && hdr->srcDev == (uint64_t)src_st.st_dev
+	     && hdr->srcIno == (uint64_t)src_st.st_ino);
+  if (!ok) {
+    DIAG_Msg(2, "ignoring stale or invalid structure image '" << imgFnm << "'");
+    munmap(addr, size);
+    return false;
+  }
+
+  Mapping m = { addr, size };
+  m_mappings.push_back(m);
+  addLMs(hdr);
+  return true;
+}
+
+
+void
+ImageLoader::add(string* img)
+{
+  const Image::Hdr* hdr = (const Image::Hdr*)img->data();
+  if (img->size() < sizeof(Image::Hdr) || !isValid(hdr, img->size())) {
+    delete img;
+    DIAG_Throw("invalid structure image");
+  }
+  m_images.push_back(img);
+  addLMs(hdr);
+}
+
+
+bool
+ImageLoader::isValid(const Image::Hdr* hdr, size_t size)
+{
+  using namespace Image;
+
+  const char* base = (const char*)hdr;
+
+  bool ok = (memcmp(hdr->magic, HPCPROF_StructImageMagic, sizeof(hdr->magic)) == 0
+	     && hdr->version == HPCPROF_StructImageVersion
+	     && hdr->byteOrder == HPCPROF_StructImageByteOrder
+	     && hdr->fileSize == size);
+
+  const Section* sec[] = { &hdr->strings, &hdr->lms, &hdr->nodes, &hdr->vmas };
+  const size_t recSz[] = { 1, sizeof(LMRec), sizeof(NodeRec), sizeof(VMARec) };
+  for (uint i = 0; ok && i < sizeof(recSz) / sizeof(recSz[0]); ++i) {
+    ok = (sec[i]->offset <= size && sec[i]->offset % 8 == 0
+	  && sec[i]->count <= (size - sec[i]->offset) / recSz[i]);
+  }
+  ok = ok && (hdr->strings.count > 0
+	      && base[hdr->strings.offset + hdr->strings.count - 1] == '\0');
+
+  const LMRec* lms = (const LMRec*)(base + hdr->lms.offset);
+  for (uint i = 0; ok && i < hdr->lms.count; ++i) {
+    ok = (lms[i].name < hdr->strings.count && lms[i].nodeBeg <= lms[i].nodeEnd
+	  && lms[i].nodeEnd <= hdr->nodes.count);
+  }
+  return ok;
+}
+
+
+void
+ImageLoader::addLMs(const Image::Hdr* hdr)
+{
+  const char* base = (const char*)hdr;
+  const char* strings = base + hdr->strings.offset;
+  const Image::LMRec* lms = (const Image::LMRec*)(base + hdr->lms.offset);
+
+  for (uint i = 0; i < hdr->lms.count; ++i) {
+    PendingLM* lm = new PendingLM;
+    lm->hdr = hdr;
+    lm->lmIdx = i;
+    lm->isLoaded = false;
+    m_lms.push_back(lm);
+
+    string nm_real = realpath(strings + lms[i].name);
+    RealPathMgr::singleton().realpath(nm_real);
+    m_lmMap_realpath.insert(std::make_pair(nm_real, lm));
+    m_lmMap_basename.insert(std::make_pair(FileUtil::basename(nm_real), lm));
+  }
+}
+
+
+void
+ImageLoader::load(Root* root, const string& nm_real)
+{
+  // cf. Root::findLM: names without a directory also match by basename
+  PendingMap& map = (nm_real == FileUtil::basename(nm_real))
+    ? m_lmMap_basename : m_lmMap_realpath;
+
+  std::pair<PendingMap::iterator, PendingMap::iterator> range =
+    map.equal_range(nm_real);
+  for (PendingMap::iterator it = range.first; it != range.second; ++it) {
+    if (!it->second->isLoaded) {
+      loadLM(root, it->second);
+    }
+  }
+}
+
+
+// loadLM: mirrors PGMDocHandler::startElement for Doc_STRUCT
+void
+ImageLoader::loadLM(Root* root, PendingLM* pending)
+{
+  using namespace Image;
+
+  // N.B.: mark first; LM::demand calls back into Root::findLM
+  pending->isLoaded = true;
+
+  const Hdr* hdr = pending->hdr;
+  const char* base = (const char*)hdr;
+  const char* strings = base + hdr->strings.offset;
+  const LMRec& lmRec = ((const LMRec*)(base + hdr->lms.offset))[pending->lmIdx];
+  const NodeRec* nodes = (const NodeRec*)(base + hdr->nodes.offset);
+  const VMARec* vmas = (const VMARec*)(base + hdr->vmas.offset);
+
+#define STR(off) ((off) < hdr->strings.count ? strings + (off) : "")
+
+  LM* lm = LM::demand(root, realpath(STR(lmRec.name)));
+
+  uint32_t numNodes = lmRec.nodeEnd - lmRec.nodeBeg;
+  std::vector<ACodeNode*> made(numNodes, NULL);
+
+  for (uint32_t i = 0; i < numNodes; ++i) {
+    const NodeRec& r = nodes[lmRec.nodeBeg + i];
+
+    if ((uint64_t)r.vmaBeg + r.vmaCnt > hdr->vmas.count) {
+      DIAG_Throw("corrupt structure image for '" << lm->name() << "'");
+    }
+
+    ACodeNode* parent = lm;
+    if (r.parent != NullIdx) {
+      uint32_t p = r.parent - lmRec.nodeBeg;
+      if (r.parent < lmRec.nodeBeg || p >= i || !made[p]) {
+	DIAG_Throw("corrupt structure image for '" << lm->name() << "'");
+      }
+      parent = made[p];
+    }
+
+    ACodeNode* x = NULL;
+    switch (r.type) {
+    case ANode::TyFile:
+      x = File::demand(lm, realpath(STR(r.name)));
+      break;
+    case ANode::TyProc: {
+      File* file = dynamic_cast<File*>(parent);
+      if (!file) {
+	DIAG_Throw("corrupt structure image for '" << lm->name() << "'");
+      }
+      string nm = STR(r.name);
+      Proc* proc = file->findProc(nm);
+      if (proc && !proc->vmaSet().empty() && r.vmaCnt > 0) {
+	proc = NULL;
+      }
+      if (!proc) {
+	proc = new Proc(nm, file, STR(r.linkName), false, r.begLine, r.endLine);
+	proc->m_origId = r.origId;
+	for (uint32_t v = r.vmaBeg; v < r.vmaBeg + r.vmaCnt; ++v) {
+	  proc->vmaSet().insert(vmas[v].beg, vmas[v].end);
+	}
+      }
+      x = proc;
+      break;
+    }
+    case ANode::TyAlien: {
+      string nm = STR(r.name);
+      Alien* alien = new Alien(parent, realpath(STR(r.fileName)), nm, nm,
+			       r.begLine, r.endLine);
+      uint32_t p = r.proc - lmRec.nodeBeg;
+      if (r.proc != NullIdx && r.proc >= lmRec.nodeBeg && p < i) {
+	alien->proc(dynamic_cast<Proc*>(made[p]));
+      }
+      x = alien;
+      break;
+    }
+    case ANode::TyLoop: {
+      string fnm = realpath(STR(r.fileName));
+      x = new Loop(parent, fnm, r.begLine, r.endLine);
+      break;
+    }
+    case ANode::TyStmt: {
+      Stmt* stmt = new Stmt(parent, r.begLine, r.endLine, 0, 0,
+			    (Stmt::StmtType)r.stmtType);
+      if (r.target) {
+	stmt->target(r.target);
+      }
+      if (r.device) {
+	stmt->device(STR(r.device));
+      }
+      x = stmt;
+      break;
+    }
+    default:
+      DIAG_Throw("corrupt structure image for '" << lm->name() << "'");
+    }
+
+    if (r.type == ANode::TyAlien || r.type == ANode::TyLoop
+	|| r.type == ANode::TyStmt) {
+      x->m_origId = r.origId;
+      for (uint32_t v = r.vmaBeg; v < r.vmaBeg + r.vmaCnt; ++v) {
+	x->vmaSet().insert(vmas[v].beg, vmas[v].end);
+      }
+    }
+    made[i] = x;
+  }
+
+#undef STR
+}
+
+
+string
+ImageLoader::realpath(const string& nm) const
+{
+  string path = nm;
+  if (m_realpathMgr) {
+    m_realpathMgr->realpath(path);
+  }
+  return path;
+}
+
+
+} // namespace Struct
+
+} // namespace Prof
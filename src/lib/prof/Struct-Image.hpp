@@ -0,0 +1,243 @@
+// -*-Mode: C++;-*-
+
+// * BeginRiceCopyright *****************************************************
+//
+// $HeadURL$
+// $Id$
+//
+// --------------------------------------------------------------------------
+// Part of HPCToolkit (hpctoolkit.org)
+//
+// Information about sources of support for research and development of
+// HPCToolkit is at 'hpctoolkit.org' and in 'README.Acknowledgments'.
+// --------------------------------------------------------------------------
+//
+// Copyright ((c)) 2002-2020, Rice University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+//
+// * Neither the name of Rice University (RICE) nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+//
+// This software is provided by RICE and contributors "as is" and any
+// express or implied warranties, including, but not limited to, the
+// implied warranties of merchantability and fitness for a particular
+// purpose are disclaimed. In no event shall RICE or contributors be
+// liable for any direct, indirect, incidental, special, exemplary, or
+// consequential damages (including, but not limited to, procurement of
+// substitute goods or services; loss of use, data, or profits; or
+// business interruption) however caused and on any theory of liability,
+// whether in contract, strict liability, or tort (including negligence
+// or otherwise) arising in any way out of the use of this software, even
+// if advised of the possibility of such damage.
+//
+// ******************************************************* EndRiceCopyright *
+
+//***************************************************************************
+//
+// File:
+//   $HeadURL$
+//
+// Purpose:
+//   Binary images of hpcstruct structure files.
+//
+// Description:
+//   A structure image holds the load modules of one structure file as
+//   fixed-size records (8-byte aligned):
+//
+//     Hdr | strings | lms | nodes | vmas
+//
+//   Each load module's subtree is a contiguous run of nodes in
+//   preorder, so ImageLoader can map the image and create only the load
+//   modules that Root::findLM asks for.
+//
+//   Names are stored as they appear in the structure file and passed
+//   through the loader's RealPathMgr when a load module is created.
+//   The header records the size, mtime and inode of the structure file
+//   the image was made from; a mismatch makes the image stale.
+//
+//***************************************************************************
+
+#ifndef prof_Prof_Struct_Image_hpp
+#define prof_Prof_Struct_Image_hpp
+
+//************************* System Include Files ****************************
+
+#include <string>
+#include <vector>
+#include <map>
+
+#include <stdint.h>
+
+//*************************** User Include Files ****************************
+
+#include <include/uint.h>
+
+#include "Struct-Tree.hpp"
+
+//*************************** Forward Declarations ***************************
+
+class RealPathMgr;
+
+//***************************************************************************
+
+namespace Prof {
+
+namespace Struct {
+
+namespace Image {
+
+#define HPCPROF_StructImageMagic     "HPCSTRIM"
+#define HPCPROF_StructImageVersion   1
+#define HPCPROF_StructImageByteOrder 0x01020304u
+
+const uint32_t NullIdx = 0xffffffff;
+
+
+struct Section {
+  uint64_t offset;
+  uint64_t count;
+};
+
+
+struct Hdr {
+  char     magic[8];
+  uint32_t version;
+  uint32_t byteOrder;
+  uint64_t fileSize;
+
+  // identity of the structure file
+  uint64_t srcSize;
+  uint64_t srcMtimeSec;
+  uint64_t srcMtimeNsec;
+  uint64_t srcDev;
+  uint64_t srcIno;
+
+  Section  strings;
+  Section  lms;
+  Section  nodes;
+  Section  vmas;
+};
+
+
+struct LMRec {
+  uint32_t name;     // string offset
+  uint32_t nodeBeg;  // nodes [nodeBeg, nodeEnd): the LM's descendants
+  uint32_t nodeEnd;
+  uint32_t pad0;
+};
+
+
+struct NodeRec {
+  uint32_t parent;   // node index or NullIdx for a child of the LM
+  uint8_t  type;     // ANode::ANodeTy: TyFile, TyProc, TyAlien, TyLoop, TyStmt
+  uint8_t  stmtType; // Stmt::StmtType
+  uint16_t pad0;
+  uint32_t name;     // File, Proc, Alien: name
+  uint32_t linkName; // Proc: link name
+  uint32_t fileName; // Alien, Loop: file name
+  uint32_t device;   // Stmt: device
+  uint32_t begLine;
+  uint32_t endLine;
+  uint32_t origId;
+  uint32_t proc;     // Alien: node index of its Proc or NullIdx
+  uint64_t target;   // Stmt
+  uint32_t vmaBeg;   // vmas [vmaBeg, vmaBeg + vmaCnt)
+  uint32_t vmaCnt;
+};
+
+
+struct VMARec {
+  uint64_t beg;
+  uint64_t end;
+};
+
+
+// make: sets 'img' to the image of the load modules of 'structure' (as
+// read from the structure file 'srcFnm').  Throws if 'structure'
+// contains nodes an image cannot represent (e.g., Groups).
+void
+make(std::string& img, const Tree& structure, const std::string& srcFnm);
+
+// write: atomically replaces 'imgFnm' with 'img'
+void
+write(const std::string& img, const std::string& imgFnm);
+
+} // namespace Image
+
+
+// --------------------------------------------------------------------------
+// ImageLoader: maps structure images and creates their load modules
+// when Root::findLM first asks for them.
+// --------------------------------------------------------------------------
+class ImageLoader : public LMLoader {
+public:
+  ImageLoader(const RealPathMgr* realpathMgr = NULL);
+
+  virtual ~ImageLoader();
+
+  // add: maps 'imgFnm' if it is a valid image of 'srcFnm'; returns
+  // false (and maps nothing) otherwise.
+  bool
+  add(const std::string& imgFnm, const std::string& srcFnm);
+
+  // add: uses an image from Image::make; takes ownership of 'img'
+  void
+  add(std::string* img);
+
+  virtual void
+  load(Root* root, const std::string& nm_real);
+
+private:
+  struct Mapping {
+    void*  addr;
+    size_t size;
+  };
+
+  struct PendingLM {
+    const Image::Hdr* hdr;
+    uint32_t lmIdx;
+    bool isLoaded;
+  };
+
+  typedef std::multimap<std::string, PendingLM*> PendingMap;
+
+  static bool
+  isValid(const Image::Hdr* hdr, size_t size);
+
+  void
+  addLMs(const Image::Hdr* hdr);
+
+  void
+  loadLM(Root* root, PendingLM* lm);
+
+  std::string
+  realpath(const std::string& nm) const;
+
+  const RealPathMgr* m_realpathMgr;
+  std::vector<Mapping> m_mappings;
+  std::vector<std::string*> m_images;
+  std::vector<PendingLM*> m_lms;
+  PendingMap m_lmMap_realpath;
+  PendingMap m_lmMap_basename;
+};
+
+
+} // namespace Struct
+
+} // namespace Prof
+
+//***************************************************************************
+
+#endif /* prof_Prof_Struct_Image_hpp */
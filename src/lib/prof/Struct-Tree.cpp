@@ -248,6 +248,7 @@ Root::Ctor(const char* nm)
   groupMap = new GroupMap();
   lmMap_realpath = new LMMap();
   lmMap_basename = new LMMap();
+  m_lmLoader = NULL;
 }
 
 
@@ -260,6 +261,7 @@ Root::operator=(const Root& x)
     groupMap = NULL;
     lmMap_realpath = NULL;
     lmMap_basename = NULL;
+    m_lmLoader = NULL;
   }
   return *this;
 }
@@ -274,6 +276,21 @@ Root::findLM(const char* nm) const
   string nm_real = nm;
   s_realpathMgr.realpath(nm_real);
 
+  LM* x = findLM_real(nm_real);
+
+  if (!x && m_lmLoader) {
+    // N.B.: the loader creates load modules, hence the const_cast
+    m_lmLoader->load(const_cast<Root*>(this), nm_real);
+    x = findLM_real(nm_real);
+  }
+
+  return x;
+}
+
+
+LM*
+Root::findLM_real(const string& nm_real) const
+{
   LMMap::iterator it1 = lmMap_realpath->find(nm_real);
   LM* x = (it1 != lmMap_realpath->end()) ? it1->second : NULL;
 
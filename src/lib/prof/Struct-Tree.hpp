@@ -344,6 +344,11 @@ public:
   maxId()
   { return s_nextUniqueId - 1; }
 
+  // maxId: resets the id counter (e.g., after discarding a scratch tree)
+  static void
+  maxId(uint x)
+  { s_nextUniqueId = x + 1; }
+
   // name:
   // nameQual: qualified name [built dynamically]
   virtual const std::string&
@@ -861,6 +866,24 @@ public:
 // Stmt
 //***************************************************************************
 
+// --------------------------------------------------------------------------
+// LMLoader supplies load modules whose structure is created on demand
+// (cf. Struct::ImageLoader).  Root::findLM consults the loader before
+// reporting a load module as missing.
+// --------------------------------------------------------------------------
+class LMLoader {
+public:
+  virtual ~LMLoader()
+  { }
+
+  // load: create the load module(s) named 'nm_real' (a realpath) under
+  // 'root'.  If 'nm_real' has no directory part, create the load
+  // module(s) with that basename.
+  virtual void
+  load(Root* root, const std::string& nm_real) = 0;
+};
+
+
 // --------------------------------------------------------------------------
 // Root is root of the scope tree
 // --------------------------------------------------------------------------
@@ -893,6 +916,7 @@ public:
     delete groupMap;
     delete lmMap_realpath;
     delete lmMap_basename;
+    delete m_lmLoader;
   }
 
   virtual const std::string&
@@ -921,6 +945,15 @@ public:
   findLM(const std::string& nm) const
   { return findLM(nm.c_str()); }
 
+  // lmLoader: load modules not yet in the tree are requested from
+  // 'x' on lookup.  Root takes ownership of 'x'.
+  void
+  lmLoader(LMLoader* x)
+  {
+    delete m_lmLoader;
+    m_lmLoader = x;
+  }
+
   Group*
   findGroup(const char* nm) const
   {
@@ -971,6 +1004,9 @@ private:
   void
   insertLMMap(LM* lm);
 
+  LM*
+  findLM_real(const std::string& nm_real) const;
+
   friend class Group;
   friend class LM;
 
@@ -982,6 +1018,8 @@ private:
   LMMap* lmMap_realpath; // mapped by 'realpath'
   LMMap* lmMap_basename;
 
+  LMLoader* m_lmLoader;
+
 #if 0
   static RealPathMgr& s_realpathMgr;
 #endif
@@ -1634,6 +1672,10 @@ public:
   name(const std::string& n)
   { m_name = n; }
 
+  Prof::Struct::Proc*
+  proc() const
+  { return m_proc; }
+
   void
   proc(Prof::Struct::Proc *proc)
   { m_proc = proc; }
@@ -0,0 +1,128 @@
+// -*-Mode: C++;-*-
+
+// * BeginRiceCopyright *****************************************************
+//
+// $HeadURL$
+// $Id$
+//
+// --------------------------------------------------------------------------
+// Part of HPCToolkit (hpctoolkit.org)
+//
+// Information about sources of support for research and development of
+// HPCToolkit is at 'hpctoolkit.org' and in 'README.Acknowledgments'.
+// --------------------------------------------------------------------------
+//
+// Copyright ((c)) 2002-2020, Rice University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+//
+// * Neither the name of Rice University (RICE) nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+//
+// This software is provided by RICE and contributors "as is" and any
+// express or implied warranties, including, but not limited to, the
+// implied warranties of merchantability and fitness for a particular
+// purpose are disclaimed. In no event shall RICE or contributors be
+// liable for any direct, indirect, incidental, special, exemplary, or
+// consequential damages (including, but not limited to, procurement of
+// substitute goods or services; loss of use, data, or profits; or
+// business interruption) however caused and on any theory of liability,
+// whether in contract, strict liability, or tort (including negligence
+// or otherwise) arising in any way out of the use of this software, even
+// if advised of the possibility of such damage.
+//
+// ******************************************************* EndRiceCopyright *
+
+//***************************************************************************
+//
+// File:
+//   CCT-Merge_test.cpp
+//
+// Purpose:
+//   Checks and times CCT merges at high-fanout nodes (cf. DynChildIdx).
+//
+// Description:
+//   Merges two trees whose roots have n call children each, half of
+//   them shared, and checks that shared children are merged and the
+//   others inserted.  The time per child should stay flat as n grows;
+//   a linear findDynChild() search makes it grow with n.
+//
+//***************************************************************************
+
+#undef NDEBUG
+
+#include <lib/prof/CallPath-Profile.hpp>
+#include <lib/prof/CCT-Tree.hpp>
+
+#include <cassert>
+#include <ctime>
+#include <iostream>
+using namespace std;
+
+using namespace Prof;
+
+// Returns a tree whose root has 'n' call children at ips beg, beg+16, ...
+static CCT::Tree* makeWideTree(CallPath::Profile& prof, uint n, VMA beg)
+{
+	CCT::Tree* tree = new CCT::Tree(&prof);
+	CCT::ANode* root = new CCT::Root("root");
+	tree->root(root);
+
+	Metric::IData metrics(1);
+	metrics.metric(0) = 1.0;
+	for (uint i = 0; i < n; i++)
+	{
+		CCT::Call* call = new CCT::Call(root, 0, lush_assoc_info_NULL,
+				1 /*lmId*/, beg + 16 * i, 0, NULL, metrics);
+		new CCT::Stmt(call, 0, lush_assoc_info_NULL,
+				1 /*lmId*/, beg + 16 * i + 4, 0, NULL, metrics);
+	}
+	return tree;
+}
+
+void cctMergeTest()
+{
+	CallPath::Profile prof("cct-merge");
+
+	uint fanouts[] = { 1000, 4000, 16000 };
+	for (int f = 0; f < 3; f++)
+	{
+		uint n = fanouts[f];
+		CCT::Tree* x = makeWideTree(prof, n, 0x1000);
+		CCT::Tree* y = makeWideTree(prof, n, 0x1000 + 16 * (n / 2));
+
+		clock_t start = clock();
+		delete x->merge(y, 0 /*x_newMetricBegIdx*/);
+		double ms = 1000.0 * (clock() - start) / CLOCKS_PER_SEC;
+
+		// n/2 shared children merged, n/2 new ones inserted
+		uint numChildren = x->root()->childCount();
+		assert(numChildren == n + n / 2);
+
+		for (CCT::ANodeChildIterator it(x->root()); it.Current(); ++it)
+		{
+			CCT::ADynNode* call = dynamic_cast<CCT::ADynNode*>(it.current());
+			assert(call && call->childCount() == 1);
+			double expect = (call->lmIP_real() >= 0x1000 + 16 * (n / 2)
+					&& call->lmIP_real() < 0x1000 + 16 * n) ? 2.0 : 1.0;
+			assert(call->metric(0) == expect);
+		}
+
+		cout << "Merged " << n << " children into " << n << " in " << ms
+				<< " ms (" << 1.0e3 * ms / n << " us/child)" << endl;
+
+		delete x;
+		delete y;
+	}
+}
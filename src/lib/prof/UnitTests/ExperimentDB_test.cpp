@@ -0,0 +1,237 @@
+// -*-Mode: C++;-*-
+
+// * BeginRiceCopyright *****************************************************
+//
+// $HeadURL$
+// $Id$
+//
+// --------------------------------------------------------------------------
+// Part of HPCToolkit (hpctoolkit.org)
+//
+// Information about sources of support for research and development of
+// HPCToolkit is at 'hpctoolkit.org' and in 'README.Acknowledgments'.
+// --------------------------------------------------------------------------
+//
+// Copyright ((c)) 2002-2020, Rice University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+//
+// * Neither the name of Rice University (RICE) nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+//
+// This software is provided by RICE and contributors "as is" and any
+// express or implied warranties, including, but not limited to, the
+// implied warranties of merchantability and fitness for a particular
+// purpose are disclaimed. In no event shall RICE or contributors be
+// liable for any direct, indirect, incidental, special, exemplary, or
+// consequential damages (including, but not limited to, procurement of
+// substitute goods or services; loss of use, data, or profits; or
+// business interruption) however caused and on any theory of liability,
+// whether in contract, strict liability, or tort (including negligence
+// or otherwise) arising in any way out of the use of this software, even
+// if advised of the possibility of such damage.
+//
+// ******************************************************* EndRiceCopyright *
+
+//***************************************************************************
+//
+// File:
+//   ExperimentDB_test.cpp
+//
+// Purpose:
+//   Writes a small profile to an experiment database, reads it back
+//   and checks that the reader rejects corrupt node records.
+//
+//***************************************************************************
+
+#undef NDEBUG
+
+#include <lib/prof/CallPath-Profile.hpp>
+#include <lib/prof/CCT-Tree.hpp>
+#include <lib/prof/ExperimentDB.hpp>
+#include <lib/prof/Metric-ADesc.hpp>
+#include <lib/prof/Metric-Mgr.hpp>
+
+#include <lib/support/diagnostics.h>
+
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <unistd.h>
+using namespace std;
+
+using namespace Prof;
+
+static const uint TEST_FANOUT = 5;
+
+// root -> TEST_FANOUT calls -> one stmt each; metric 0 at every call
+// and stmt, metric 1 only at odd stmts
+static void makeProfile(CallPath::Profile& prof)
+{
+	prof.metricMgr()->insert(new Metric::SampledDesc("CYCLES", "cycles",
+			1, false, "", "", ""));
+	prof.metricMgr()->insert(new Metric::SampledDesc("MISSES", "misses",
+			1, false, "", "", ""));
+
+	CCT::ANode* root = prof.cct()->root();
+	for (uint i = 0; i < TEST_FANOUT; i++)
+	{
+		Metric::IData metrics(2);
+		metrics.metric(0) = 10.0 * (i + 1);
+		CCT::Call* call = new CCT::Call(root, 0, lush_assoc_info_NULL,
+				1 /*lmId*/, 0x1000 + 16 * i, 0, NULL, metrics);
+
+		metrics.metric(0) = 1.0 * (i + 1);
+		metrics.metric(1) = (i % 2) ? 0.5 : 0.0;
+		new CCT::Stmt(call, i + 1 /*cpId*/, lush_assoc_info_NULL,
+				1 /*lmId*/, 0x1000 + 16 * i + 4, 0, NULL, metrics);
+	}
+	prof.cct()->makeDensePreorderIds();
+}
+
+static vector<char> readFile(const string& fnm)
+{
+	FILE* f = fopen(fnm.c_str(), "rb");
+	assert(f != NULL);
+	fseek(f, 0, SEEK_END);
+	vector<char> buf(ftell(f));
+	fseek(f, 0, SEEK_SET);
+	assert(fread(&buf[0], 1, buf.size(), f) == buf.size());
+	fclose(f);
+	return buf;
+}
+
+static void writeFile(const string& fnm, const vector<char>& buf)
+{
+	FILE* f = fopen(fnm.c_str(), "wb");
+	assert(f != NULL);
+	assert(fwrite(&buf[0], 1, buf.size(), f) == buf.size());
+	fclose(f);
+}
+
+// Returns true if the reader accepts 'buf'
+static bool opens(const string& fnm, const vector<char>& buf)
+{
+	writeFile(fnm, buf);
+	ExperimentDB::Reader db;
+	try {
+		db.open(fnm);
+	}
+	catch (const Diagnostics::Exception& x) {
+		return false;
+	}
+	return true;
+}
+
+static void checkRoundTrip(const string& fnm)
+{
+	ExperimentDB::Reader db;
+	db.open(fnm);
+
+	assert(string(db.title()) == "round trip");
+	assert(db.numMetrics() == 2);
+	assert(string(db.str(db.metricDesc(0).name)) == "CYCLES");
+	assert(string(db.str(db.metricDesc(1).name)) == "MISSES");
+
+	// preorder: root, then call/stmt pairs
+	assert(db.numNodes() == 1 + 2 * TEST_FANOUT);
+	assert(db.node(0).parent == ExperimentDB::NullIdx);
+	assert(db.node(0).type == CCT::ANode::TyRoot);
+
+	uint i = 0;
+	for (uint32_t c = db.firstChild(0); c != ExperimentDB::NullIdx;
+			c = db.nextSibling(c), i++)
+	{
+		const ExperimentDB::NodeRec& call = db.node(c);
+		assert(call.type == CCT::ANode::TyCall && call.parent == 0);
+		assert(db.metric(c, 0) == 10.0 * (i + 1));
+		assert(db.metric(c, 1) == 0.0 && call.metricCnt == 1);
+
+		uint32_t s = db.firstChild(c);
+		assert(s == c + 1 && db.nextSibling(s) == ExperimentDB::NullIdx);
+		const ExperimentDB::NodeRec& stmt = db.node(s);
+		assert(stmt.type == CCT::ANode::TyStmt && stmt.parent == c);
+		assert(stmt.cpId == i + 1 && stmt.vma == 0x1000 + 16 * i + 4);
+		assert(db.metric(s, 0) == 1.0 * (i + 1));
+		assert(db.metric(s, 1) == ((i % 2) ? 0.5 : 0.0));
+		assert(db.findNode(stmt.id) == s);
+	}
+	assert(i == TEST_FANOUT);
+}
+
+void experimentDBTest()
+{
+	char path[64];
+	snprintf(path, sizeof(path), "/tmp/prof-experimentdb-%d", (int) getpid());
+	string fnm = path;
+	string badFnm = fnm + ".bad";
+
+	CallPath::Profile prof("round trip");
+	makeProfile(prof);
+	ExperimentDB::write(prof, fnm, "round trip", 0, 2);
+	checkRoundTrip(fnm);
+
+	vector<char> good = readFile(fnm);
+	assert(opens(badFnm, good));
+
+	ExperimentDB::Hdr hdr;
+	memcpy(&hdr, &good[0], sizeof(hdr));
+	size_t nodeOff = hdr.nodes.offset;
+	size_t recSz = sizeof(ExperimentDB::NodeRec);
+
+	// truncated file
+	vector<char> bad(good.begin(), good.end() - 8);
+	assert(!opens(badFnm, bad));
+
+	// each corruption of the first stmt (record 2) must be rejected
+	ExperimentDB::NodeRec* stmt;
+	for (int what = 0; what < 7; what++)
+	{
+		bad = good;
+		stmt = (ExperimentDB::NodeRec*) &bad[nodeOff + 2 * recSz];
+		switch (what)
+		{
+		case 0: stmt->parent = 7; break;               // after the node
+		case 1: stmt->parent = ExperimentDB::NullIdx; break;
+		case 2: stmt->subtreeEnd = 2; break;           // empty subtree
+		case 3: stmt->subtreeEnd = 0x7fffffff; break;  // past the end
+		case 4: stmt->metricCnt = 1000; break;         // past the values
+		case 5: stmt->id = 0x7fffffff; break;          // past the count
+		case 6: stmt->id = (stmt - 1)->id; break;      // duplicate
+		}
+		assert(!opens(badFnm, bad));
+	}
+
+	// a subtree that leaves its parent's
+	bad = good;
+	stmt = (ExperimentDB::NodeRec*) &bad[nodeOff + 2 * recSz];
+	stmt->subtreeEnd = 4;
+	assert(!opens(badFnm, bad));
+
+	// metric values that start past the end
+	bad = good;
+	stmt = (ExperimentDB::NodeRec*) &bad[nodeOff + 2 * recSz];
+	stmt->metricBeg = hdr.metricVals.count + 1;
+	stmt->metricCnt = 0;
+	assert(!opens(badFnm, bad));
+
+	cout << "Experiment database round trip of " << 1 + 2 * TEST_FANOUT
+			<< " nodes ok" << endl;
+
+	unlink(fnm.c_str());
+	unlink(badFnm.c_str());
+}
@@ -0,0 +1,377 @@
+// -*-Mode: C++;-*-
+
+// * BeginRiceCopyright *****************************************************
+//
+// $HeadURL$
+// $Id$
+//
+// --------------------------------------------------------------------------
+// Part of HPCToolkit (hpctoolkit.org)
+//
+// Information about sources of support for research and development of
+// HPCToolkit is at 'hpctoolkit.org' and in 'README.Acknowledgments'.
+// --------------------------------------------------------------------------
+//
+// Copyright ((c)) 2002-2020, Rice University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+//
+// * Neither the name of Rice University (RICE) nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+//
+// This software is provided by RICE and contributors "as is" and any
+// express or implied warranties, including, but not limited to, the
+// implied warranties of merchantability and fitness for a particular
+// purpose are disclaimed. In no event shall RICE or contributors be
+// liable for any direct, indirect, incidental, special, exemplary, or
+// consequential damages (including, but not limited to, procurement of
+// substitute goods or services; loss of use, data, or profits; or
+// business interruption) however caused and on any theory of liability,
+// whether in contract, strict liability, or tort (including negligence
+// or otherwise) arising in any way out of the use of this software, even
+// if advised of the possibility of such damage.
+//
+// ******************************************************* EndRiceCopyright *
+
+//***************************************************************************
+//
+// File:
+//   Metric-AExprProgram_test.cpp
+//
+// Purpose:
+//   Checks that compiled derived-metric programs (Metric::AExprProgram)
+//   compute exactly what the AExpr interpreter computes, and times
+//   both, as well as batched and per-node AExprIncr summaries.
+//
+// Description:
+//   Evaluates expressions that use every AExpr node type, including
+//   their non-finalized (NF) forms and divisions by zero, through
+//   AExpr::eval()/evalNF() and through a compiled program, and
+//   compares every metric value bit for bit.  Then it computes derived
+//   metrics and summary statistics over a CCT with both paths and
+//   prints the times.
+//
+//***************************************************************************
+
+#undef NDEBUG
+
+#include <lib/prof/CallPath-Profile.hpp>
+#include <lib/prof/CCT-Tree.hpp>
+#include <lib/prof/Metric-ADesc.hpp>
+#include <lib/prof/Metric-AExpr.hpp>
+#include <lib/prof/Metric-AExprIncr.hpp>
+#include <lib/prof/Metric-AExprProgram.hpp>
+#include <lib/prof/Metric-Mgr.hpp>
+
+#include <cassert>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <iostream>
+#include <vector>
+using namespace std;
+
+using namespace Prof;
+using Metric::AExpr;
+
+static const uint PRG_SRC = 4;      // source metrics: 0 .. PRG_SRC-1
+static const uint PRG_NODES = 1000;
+
+static double msSince(clock_t start)
+{
+	return 1000.0 * (clock() - start) / CLOCKS_PER_SEC;
+}
+
+static AExpr* var(uint mId)
+{
+	static const char* names[] = { "a", "b", "c", "d" };
+	return new Metric::Var(names[mId], mId);
+}
+
+static AExpr** ops(AExpr* x, AExpr* y, AExpr* z = NULL)
+{
+	AExpr** v = new AExpr*[3];
+	v[0] = x;
+	v[1] = y;
+	v[2] = z;
+	return v;
+}
+
+// Expressions using every node type, with source metrics 0..3
+static vector<AExpr*> makeExprs()
+{
+	vector<AExpr*> ex;
+	ex.push_back(new Metric::Const(2.5));
+	ex.push_back(new Metric::Neg(var(0)));
+	ex.push_back(var(1));
+	ex.push_back(new Metric::Power(var(0), new Metric::Const(2)));
+	ex.push_back(new Metric::Power(var(1), new Metric::Const(0.5))); // NaNs
+	ex.push_back(new Metric::Divide(var(0), var(1)));
+	ex.push_back(new Metric::Divide(var(0), new Metric::Const(0))); // by 0
+	ex.push_back(new Metric::Divide(new Metric::Minus(var(2), var(2)),
+					new Metric::Const(0)));
+	ex.push_back(new Metric::Minus(var(0), var(3)));
+	ex.push_back(new Metric::Plus(ops(var(0), var(1), new Metric::Const(3)), 3));
+	ex.push_back(new Metric::Times(ops(var(2), var(3)), 2));
+	ex.push_back(new Metric::Min(ops(var(0), var(1), var(2)), 3));
+	ex.push_back(new Metric::Max(ops(var(0), new Metric::Neg(var(1))), 2));
+	ex.push_back(new Metric::Mean(ops(var(0), var(1), var(3)), 3));
+	ex.push_back(new Metric::StdDev(ops(var(0), var(1), var(2)), 3));
+	ex.push_back(new Metric::CoefVar(ops(var(0), var(1), var(2)), 3));
+	ex.push_back(new Metric::RStdDev(ops(var(1), var(3)), 2));
+	ex.push_back(new Metric::Plus(ops(new Metric::NumSource(4), var(2)), 2));
+	ex.push_back(new Metric::Divide(new Metric::Times(ops(var(0), var(1)), 2),
+					new Metric::Plus(ops(var(2), var(3)), 2)));
+	return ex;
+}
+
+// Source values with zeros, negatives and equal values
+static void fillSources(Metric::IData& d, uint i)
+{
+	for (uint m = 0; m < PRG_SRC; m++)
+	{
+		uint r = (i * 7919 + m * 104729) % 1009;
+		d.demandMetric(m) = (r % 4 == 0) ? 0.0 : (r / 7.0 - 40.0);
+	}
+	if (i % 10 == 0)
+	{
+		d.metric(1) = d.metric(0); // zero variance
+	}
+}
+
+static bool sameBits(double x, double y)
+{
+	return memcmp(&x, &y, sizeof(double)) == 0;
+}
+
+static void checkExprs()
+{
+	vector<AExpr*> ex = makeExprs();
+	uint numMetrics = PRG_SRC + ex.size();
+	uint accumBeg = numMetrics;
+	for (uint i = 0; i < ex.size(); i++)
+	{
+		ex[i]->accumId(0, accumBeg + 2 * i);
+		ex[i]->accumId(1, accumBeg + 2 * i + 1);
+	}
+
+	vector<Metric::IData> byEval(PRG_NODES), byProg(PRG_NODES);
+	for (uint i = 0; i < PRG_NODES; i++)
+	{
+		fillSources(byEval[i], i);
+		fillSources(byProg[i], i);
+	}
+
+	for (uint i = 0; i < PRG_NODES; i++)
+	{
+		for (uint k = 0; k < ex.size(); k++)
+		{
+			ex[k]->evalNF(byEval[i]);
+			byEval[i].demandMetric(PRG_SRC + k, numMetrics) = ex[k]->eval(byEval[i]);
+		}
+	}
+
+	Metric::AExprProgram prog;
+	for (uint k = 0; k < ex.size(); k++)
+	{
+		ex[k]->compileNF(prog);
+		ex[k]->compile(prog);
+		prog.emitStore(PRG_SRC + k, numMetrics);
+	}
+
+	vector<Metric::IData*> nodes;
+	for (uint i = 0; i < PRG_NODES; i++)
+	{
+		nodes.push_back(&byProg[i]);
+	}
+	vector<double> stack;
+	uint batchSz = Metric::AExprProgram::BatchSz;
+	for (uint i = 0; i < PRG_NODES; i += batchSz)
+	{
+		uint n = min(batchSz, PRG_NODES - i);
+		prog.eval(&nodes[i], n, stack);
+	}
+
+	for (uint i = 0; i < PRG_NODES; i++)
+	{
+		assert(byEval[i].numMetrics() == byProg[i].numMetrics());
+		for (uint m = 0; m < byEval[i].numMetrics(); m++)
+		{
+			assert(sameBits(byEval[i].metric(m), byProg[i].metric(m)));
+		}
+	}
+
+	cout << "Program of " << ex.size() << " expressions (" << prog.size()
+			<< " instructions) matches eval() at " << PRG_NODES << " nodes" << endl;
+
+	for (uint k = 0; k < ex.size(); k++)
+	{
+		delete ex[k];
+	}
+}
+
+// A CCT of 8^5 call paths with source metrics at every node
+static CCT::Tree* makeTree(CallPath::Profile& prof)
+{
+	CCT::Tree* tree = new CCT::Tree(&prof);
+	tree->root(new CCT::Root("root"));
+
+	vector<CCT::ANode*> level(1, tree->root());
+	uint i = 0;
+	for (uint depth = 0; depth < 5; depth++)
+	{
+		vector<CCT::ANode*> next;
+		for (uint p = 0; p < level.size(); p++)
+		{
+			for (uint c = 0; c < 8; c++, i++)
+			{
+				Metric::IData metrics;
+				fillSources(metrics, i);
+				next.push_back(new CCT::Call(level[p], 0, lush_assoc_info_NULL,
+						1 /*lmId*/, 0x1000 + 16 * i, 0, NULL, metrics));
+			}
+		}
+		level.swap(next);
+	}
+	return tree;
+}
+
+static void checkSameMetrics(const CCT::Tree* x, const CCT::Tree* y,
+		uint numMetrics)
+{
+	CCT::ANodeIterator itX(x->root(), NULL, false, IteratorStack::PreOrder);
+	CCT::ANodeIterator itY(y->root(), NULL, false, IteratorStack::PreOrder);
+	for (; itX.Current() && itY.Current(); ++itX, ++itY)
+	{
+		for (uint m = 0; m < numMetrics; m++)
+		{
+			assert(sameBits(itX.current()->demandMetric(m),
+					itY.current()->demandMetric(m)));
+		}
+	}
+	assert(!itX.Current() && !itY.Current());
+}
+
+// Times derived metrics (AExpr) and summary statistics (AExprIncr)
+// over a CCT, as a program/batch and per node
+static void benchExprs()
+{
+	CallPath::Profile prof("aexpr-program");
+	Metric::Mgr& mMgr = *prof.metricMgr();
+	for (uint m = 0; m < PRG_SRC; m++)
+	{
+		mMgr.insert(new Metric::SampledDesc("src", "src", 1, false, "", "", ""));
+	}
+
+	vector<AExpr*> ex = makeExprs();
+	uint drvdBeg = mMgr.size();
+	uint accumBeg = drvdBeg + ex.size();
+	for (uint k = 0; k < ex.size(); k++)
+	{
+		ex[k]->accumId(0, accumBeg + 2 * k);
+		ex[k]->accumId(1, accumBeg + 2 * k + 1);
+		mMgr.insert(new Metric::DerivedDesc("drvd", "drvd", ex[k]));
+	}
+	uint drvdEnd = mMgr.size();
+
+	uint incrBeg = mMgr.size();
+	mMgr.insert(new Metric::DerivedIncrDesc("sum", "", new Metric::SumIncr(accumBeg + 50, 0)));
+	mMgr.insert(new Metric::DerivedIncrDesc("min", "", new Metric::MinIncr(accumBeg + 51, 1)));
+	mMgr.insert(new Metric::DerivedIncrDesc("max", "", new Metric::MaxIncr(accumBeg + 52, 2)));
+	mMgr.insert(new Metric::DerivedIncrDesc("mean", "", new Metric::MeanIncr(accumBeg + 53, 3)));
+	mMgr.insert(new Metric::DerivedIncrDesc("sdev", "", new Metric::StdDevIncr(accumBeg + 54, accumBeg + 55, 0)));
+	mMgr.insert(new Metric::DerivedIncrDesc("cfvar", "", new Metric::CoefVarIncr(accumBeg + 56, accumBeg + 57, 1)));
+	mMgr.insert(new Metric::DerivedIncrDesc("rsdev", "", new Metric::RStdDevIncr(accumBeg + 58, accumBeg + 59, 2)));
+	uint incrEnd = mMgr.size();
+
+	// the number of sources (for means) is a metric, as in hpcprof-mpi
+	uint numSrcId = accumBeg + 60;
+	uint numMetrics = numSrcId + 1;
+	for (uint mId = incrBeg; mId < incrEnd; mId++)
+	{
+		const Metric::DerivedIncrDesc* m =
+				dynamic_cast<const Metric::DerivedIncrDesc*>(mMgr.metric(mId));
+		m->expr()->numSrcVarId(numSrcId);
+		if (m->expr()->numAccum() == 2)
+		{
+			m->expr()->srcId(1, 3); // combine() adds a sum of squares
+		}
+	}
+
+	CCT::Tree* batched = makeTree(prof);
+	CCT::Tree* perNode = makeTree(prof);
+	for (CCT::ANodeIterator it(batched->root()); it.Current(); ++it)
+	{
+		it.current()->demandMetric(numSrcId) = 3.0;
+	}
+	for (CCT::ANodeIterator it(perNode->root()); it.Current(); ++it)
+	{
+		it.current()->demandMetric(numSrcId) = 3.0;
+	}
+
+	clock_t start = clock();
+	batched->root()->computeMetrics(mMgr, drvdBeg, drvdEnd, true);
+	double progMs = msSince(start);
+
+	start = clock();
+	for (CCT::ANodeIterator it(perNode->root()); it.Current(); ++it)
+	{
+		it.current()->computeMetricsMe(mMgr, drvdBeg, drvdEnd, true);
+	}
+	double evalMs = msSince(start);
+
+	Metric::AExprIncr::FnTy fns[] = {
+		Metric::AExprIncr::FnInit, Metric::AExprIncr::FnAccum,
+		Metric::AExprIncr::FnCombine, Metric::AExprIncr::FnFini
+	};
+
+	start = clock();
+	for (uint f = 0; f < 4; f++)
+	{
+		batched->root()->computeMetricsIncr(mMgr, incrBeg, incrEnd, fns[f]);
+	}
+	double incrBatchMs = msSince(start);
+
+	start = clock();
+	for (uint f = 0; f < 4; f++)
+	{
+		for (CCT::ANodeIterator it(perNode->root()); it.Current(); ++it)
+		{
+			it.current()->computeMetricsIncrMe(mMgr, incrBeg, incrEnd, fns[f]);
+		}
+	}
+	double incrNodeMs = msSince(start);
+
+	checkSameMetrics(batched, perNode, numMetrics);
+
+	uint numNodes = 0;
+	for (CCT::ANodeIterator it(batched->root()); it.Current(); ++it)
+	{
+		numNodes++;
+	}
+	cout << ex.size() << " derived metrics over " << numNodes << " nodes: "
+			<< progMs << " ms compiled, " << evalMs << " ms eval()" << endl;
+	cout << (incrEnd - incrBeg) << " summary metrics x 4 passes: "
+			<< incrBatchMs << " ms batched, " << incrNodeMs << " ms per node"
+			<< endl;
+
+	delete batched;
+	delete perNode;
+}
+
+void aexprProgramTest()
+{
+	checkExprs();
+	benchExprs();
+}
@@ -75,6 +75,9 @@ using std::string;
 #include <vector>
 using std::vector;
 
+#include <algorithm> // sort()
+#include <utility>   // pair
+
 #include <cstdlib> // getenv()
 #include <cmath>   // ceil()
 #include <climits> // UCHAR_MAX, PATH_MAX
@@ -139,17 +142,21 @@ makeDerivedMetricDescs(Prof::CallPath::Profile& profGbl,
 
 static void
 makeSummaryMetrics_Lcl(Prof::CallPath::Profile& profGbl,
-		       const string& profileFile,
+		       const Analysis::Util::StringVec& profileFiles,
 		       const Analysis::Args& args, uint groupId, uint groupMax,
 		       vector<VMAIntervalSet*>& groupIdToGroupMetricsMap,
 		       int myRank);
 
 static void
 makeThreadMetrics_Lcl(Prof::CallPath::Profile& profGbl,
-		      const string& profileFile,
+		      const Analysis::Util::StringVec& profileFiles,
 		      const Analysis::Args& args, uint groupId, uint groupMax,
 		      int myRank);
 
+static Prof::CallPath::Profile*
+readThreadProfile(const Analysis::Util::StringVec& profileFiles,
+		  uint groupId, uint rFlags);
+
 static string
 makeDBFileName(const string& dbDir, uint groupId, const string& profileFile);
 
@@ -157,6 +164,11 @@ static void
 writeMetricsDB(Prof::CallPath::Profile& profGbl, uint mBegId, uint mEndId,
 	       const string& metricDBFnm);
 
+static void
+writeSparseMetricsDB(Prof::CallPath::Profile& profGbl, uint mBegId,
+		     uint mEndId, const string& metricDBFnm,
+		     const vector<Prof::CCT::ANode*>* nodes = NULL);
+
 
 static void
 writeStructure(const Prof::Struct::Tree& structure, const char* baseNm,
@@ -308,7 +320,8 @@ realmain(int argc, char* const* argv)
   Analysis::Util::UIntVec* groupMap =
     (nArgs.groupMax > 1) ? nArgs.groupMap : NULL;
 
-  profLcl = Analysis::CallPath::read(*nArgs.paths, groupMap, mergeTy, rFlags);
+  profLcl = Analysis::CallPath::read(*nArgs.paths, groupMap, mergeTy, rFlags,
+				     /*mrgFlags*/ 0, args.prof_jobs);
 
   // -------------------------------------------------------
   // 1b. Create canonical CCT (metrics merged by <group>.<name>.*)
@@ -424,6 +437,7 @@ realmain(int argc, char* const* argv)
     if (!args.db_makeMetricDB) {
       profGbl->metricMgr()->zeroDBInfo();
     }
+    profGbl->isSparseMetricDB(args.db_sparseMetricDB);
 
     Analysis::CallPath::makeDatabase(*profGbl, args);
   }
@@ -447,8 +461,9 @@ realmain(int argc, char* const* argv)
 //****************************************************************************
 
 // myNormalizeProfileArgs: creates canonical list of profiles files and
-//   distributes chunks of size ceil(numFiles / numRanks) to each process.
-//   The last process may have a smaller chunk than the others.
+//   distributes chunks of about ceil(numFiles / numRanks) to each
+//   process, never splitting the files of one thread.  The last
+//   processes may have smaller chunks than the others.
 static Analysis::Util::NormalizeProfileArgs_t
 myNormalizeProfileArgs(const Analysis::Util::StringVec& profileFiles,
 		       vector<uint>& groupIdToGroupSizeMap,
@@ -477,22 +492,42 @@ myNormalizeProfileArgs(const Analysis::Util::StringVec& profileFiles,
 
     DIAG_Assert(nArgs.groupMax <= UCHAR_MAX, "myNormalizeProfileArgs: 'groupMax' cannot be packed into a uchar!");
 
-    uint chunkSz = (uint)
-      ceil( (double)canonicalFiles->size() / (double)numRanks);
-    
+    uint numFiles = canonicalFiles->size();
+    uint targetSz = (uint) ceil( (double)numFiles / (double)numRanks);
+
+    groupIdToGroupSizeMap.resize(groupIdMax + 1);
+
+    // all the files of a thread go to the same process (cf.
+    // makeSummaryMetrics), and the thread counts once in its group
+    vector<int> fileRank(numFiles);
+    vector<uint> rankSz(numRanks, 0);
+    uint chunkSz = 0;
+    int rank = 0;
+    for (uint i = 0, end; i < numFiles; i = end) {
+      end = Analysis::Util::profileThreadEnd(*canonicalFiles, i);
+      groupIdToGroupSizeMap[(*nArgs.groupMap)[i]]++;
+
+      if (rankSz[rank] >= targetSz && rank + 1 < numRanks) {
+	rank++;
+      }
+      for (uint k = i; k < end; k++) {
+	fileRank[k] = rank;
+      }
+      rankSz[rank] += (end - i);
+      chunkSz = std::max(chunkSz, rankSz[rank]);
+    }
+
     sendFilesChunkSz = chunkSz * (groupIdLen + pathLenMax + 1);
     sendFilesBufSz = sendFilesChunkSz * numRanks;
     sendFilesBuf = new char[sendFilesBufSz];
     memset(sendFilesBuf, '\0', sendFilesBufSz);
 
-    groupIdToGroupSizeMap.resize(groupIdMax + 1);
-    
-    for (uint i = 0, j = 0; i < canonicalFiles->size(); 
-	 i++, j += (groupIdLen + pathLenMax + 1)) {
+    std::fill(rankSz.begin(), rankSz.end(), 0);
+    for (uint i = 0; i < numFiles; i++) {
       const std::string& nm = (*canonicalFiles)[i];
       uint groupId = (*nArgs.groupMap)[i];
-
-      groupIdToGroupSizeMap[groupId]++;
+      int r = fileRank[i];
+      uint j = (r * chunkSz + rankSz[r]++) * (groupIdLen + pathLenMax + 1);
 
       // pack into sendFilesBuf
       sendFilesBuf[j] = (char)groupId;
@@ -592,10 +627,14 @@ makeSummaryMetrics(Prof::CallPath::Profile& profGbl,
   cctRoot->computeMetricsIncr(mMgrGbl, mDrvdBeg, mDrvdEnd,
 			      Prof::Metric::AExprIncr::FnInit);
 
-  for (uint i = 0; i < nArgs.paths->size(); ++i) {
-    const string& fnm = (*nArgs.paths)[i];
+  // each thread is one input to the summary metrics, however many
+  // files hpcrun wrote its profile to
+  for (uint i = 0, end; i < nArgs.paths->size(); i = end) {
+    end = Analysis::Util::profileThreadEnd(*nArgs.paths, i);
+    Analysis::Util::StringVec fnms(nArgs.paths->begin() + i,
+				   nArgs.paths->begin() + end);
     uint groupId = (*nArgs.groupMap)[i];
-    makeSummaryMetrics_Lcl(profGbl, fnm, args, groupId, nArgs.groupMax,
+    makeSummaryMetrics_Lcl(profGbl, fnms, args, groupId, nArgs.groupMax,
 			   groupIdToGroupMetricsMap, myRank);
   }
 
@@ -663,11 +702,21 @@ makeThreadMetrics(Prof::CallPath::Profile& profGbl,
 		  const vector<uint>& groupIdToGroupSizeMap,
 		  int myRank, int numRanks)
 {
-  for (uint i = 0; i < nArgs.paths->size(); ++i) {
-    string& fnm = (*nArgs.paths)[i];
+  // normalized trace files are written directly into the database
+  Prof::CallPath::TraceRemapper traceRemapper(args.db_dir, args.prof_jobs);
+  profGbl.traceRemapper(&traceRemapper);
+
+  for (uint i = 0, end; i < nArgs.paths->size(); i = end) {
+    end = Analysis::Util::profileThreadEnd(*nArgs.paths, i);
+    Analysis::Util::StringVec fnms(nArgs.paths->begin() + i,
+				   nArgs.paths->begin() + end);
     uint groupId = (*nArgs.groupMap)[i];
-    makeThreadMetrics_Lcl(profGbl, fnm, args, groupId, nArgs.groupMax, myRank);
+    makeThreadMetrics_Lcl(profGbl, fnms, args, groupId, nArgs.groupMax,
+			  myRank);
   }
+
+  traceRemapper.wait();
+  profGbl.traceRemapper(NULL);
 }
 
 
@@ -776,7 +825,7 @@ makeDerivedMetricDescs(Prof::CallPath::Profile& profGbl,
 // FIXME: abstract between makeSummaryMetrics_Lcl() & makeThreadMetrics_Lcl()
 static void
 makeSummaryMetrics_Lcl(Prof::CallPath::Profile& profGbl,
-		       const string& profileFile,
+		       const Analysis::Util::StringVec& profileFiles,
 		       const Analysis::Args& args, uint groupId, uint groupMax,
 		       vector<VMAIntervalSet*>& groupIdToGroupMetricsMap,
 		       int myRank)
@@ -793,7 +842,7 @@ makeSummaryMetrics_Lcl(Prof::CallPath::Profile& profGbl,
   uint rGroupId = (groupMax > 1) ? groupId : 0;
 
   Prof::CallPath::Profile* prof =
-    Analysis::CallPath::read(profileFile, rGroupId, rFlags);
+    readThreadProfile(profileFiles, rGroupId, rFlags);
 
   // -------------------------------------------------------
   // merge into canonical CCT
@@ -875,9 +924,15 @@ makeSummaryMetrics_Lcl(Prof::CallPath::Profile& profGbl,
 // exception: Each thread-level CCT does not have to be a subset of
 // 'profGbl' (the canonical CCT); in other words, 'profGbl' may be
 // pruned.
+//
+// The merge records which nodes of 'profGbl' the profile touched.
+// Because the profile's metrics are zero everywhere else, aggregating,
+// writing and re-zeroing them only visits those nodes and their
+// ancestors (a CCT::PartialTree), so the cost follows the size of the
+// profile rather than the size of the canonical CCT.
 static void
 makeThreadMetrics_Lcl(Prof::CallPath::Profile& profGbl,
-		      const string& profileFile,
+		      const Analysis::Util::StringVec& profileFiles,
 		      const Analysis::Args& args, uint groupId, uint groupMax,
 		      int myRank)
 {
@@ -893,7 +948,7 @@ makeThreadMetrics_Lcl(Prof::CallPath::Profile& profGbl,
   uint rGroupId = (groupMax > 1) ? groupId : 0;
 
   Prof::CallPath::Profile* prof =
-    Analysis::CallPath::read(profileFile, rGroupId, rFlags);
+    readThreadProfile(profileFiles, rGroupId, rFlags);
 
   // -------------------------------------------------------
   // merge into canonical CCT
@@ -916,9 +971,13 @@ makeThreadMetrics_Lcl(Prof::CallPath::Profile& profGbl,
   Analysis::CallPath::noteStaticStructureOnLeaves(*prof);
   prof->structure(NULL);
 
-  uint mBeg = profGbl.merge(*prof, mergeTy, mergeFlg); // [closed begin
+  vector<Prof::CCT::ANode*> mergedNodes;
+  uint mBeg = profGbl.merge(*prof, mergeTy, mergeFlg,  // [closed begin
+			    args.db_makeMetricDB ? &mergedNodes : NULL);
 
   if (args.db_makeMetricDB) {
+    Prof::CCT::PartialTree cctLcl(cctRootGbl, mergedNodes);
+
     uint mEnd = mBeg + prof->metricMgr()->size(); // open end)
 
     // -------------------------------------------------------
@@ -938,28 +997,51 @@ makeThreadMetrics_Lcl(Prof::CallPath::Profile& profGbl,
       }
     }
     
-    cctRootGbl->aggregateMetricsIncl(ivalsetIncl);
-    cctRootGbl->aggregateMetricsExcl(ivalsetExcl);
+    cctLcl.aggregateMetricsIncl(ivalsetIncl);
+    cctLcl.aggregateMetricsExcl(ivalsetExcl);
 
     // -------------------------------------------------------
     // write local sampled metric values into database
     // -------------------------------------------------------
 
-    string dbFnm = makeDBFileName(args.db_dir, groupId, profileFile);
-    writeMetricsDB(profGbl, mBeg, mEnd, dbFnm);
+    string dbFnm = makeDBFileName(args.db_dir, groupId, profileFiles[0]);
+    if (args.db_sparseMetricDB) {
+      writeSparseMetricsDB(profGbl, mBeg, mEnd, dbFnm, &cctLcl.nodes());
+    }
+    else {
+      writeMetricsDB(profGbl, mBeg, mEnd, dbFnm);
+    }
 
     // -------------------------------------------------------
     // reinitialize metric values for next time
     // -------------------------------------------------------
     
     // TODO: see corresponding comments in makeSummaryMetrics_Lcl()
-    cctRootGbl->zeroMetricsDeep(mBeg, mEnd); // cf. FnInitSrc
+    cctLcl.zeroMetrics(mBeg, mEnd); // cf. FnInitSrc
   }
 
   delete prof;
 }
 
 
+// readThreadProfile: reads the profile of one thread, which hpcrun
+// may have written to several files (the profile and its snapshots,
+// cf. Analysis::Util::normalizeProfileArgs), and merges the files.
+static Prof::CallPath::Profile*
+readThreadProfile(const Analysis::Util::StringVec& profileFiles,
+		  uint groupId, uint rFlags)
+{
+  if (profileFiles.size() == 1) {
+    return Analysis::CallPath::read(profileFiles[0], groupId, rFlags);
+  }
+
+  Analysis::Util::UIntVec groupMap(profileFiles.size(), groupId);
+  return Analysis::CallPath::read(profileFiles, &groupMap,
+				  Prof::CallPath::Profile::Merge_MergeMetricByName,
+				  rFlags);
+}
+
+
 static string
 makeDBFileName(const string& dbDir, uint groupId, const string& profileFile)
 {
@@ -1047,6 +1129,137 @@ badwrite:
 }
 
 
+// [mBegId, mEndId)
+//
+// Unlike writeMetricsDB(), does not pack metrics into a dense matrix:
+// only nodes with non-zero values in [mBegId, mEndId) are visited
+// twice (once to size the node index and once to write values).  If
+// 'nodes' is non-NULL, only those nodes may have non-zero values.
+static void
+writeSparseMetricsDB(Prof::CallPath::Profile& profGbl, uint mBegId,
+		     uint mEndId, const string& metricDBFnm,
+		     const vector<Prof::CCT::ANode*>* nodes)
+{
+  typedef std::pair<uint, Prof::CCT::ANode*> NodeIdPair;
+
+  const Prof::CCT::Tree& cct = *(profGbl.cct());
+
+  // -------------------------------------------------------
+  // find nodes with non-zero values (ordered by node id)
+  // -------------------------------------------------------
+  vector<NodeIdPair> nzNodes;
+  uint64_t numNZValues = 0;
+
+  vector<Prof::CCT::ANode*> allNodes;
+  if (!nodes) {
+    for (Prof::CCT::ANodeIterator it(cct.root()); it.Current(); ++it) {
+      allNodes.push_back(it.current());
+    }
+    nodes = &allNodes;
+  }
+
+  for (uint i = 0; i < nodes->size(); ++i) {
+    Prof::CCT::ANode* n = (*nodes)[i];
+    uint mEnd = std::min(mEndId, n->numMetrics());
+
+    uint numNZ = 0;
+    for (uint mId = mBegId; mId < mEnd; ++mId) {
+      if (n->hasMetric(mId)) {
+	numNZ++;
+      }
+    }
+
+    if (numNZ > 0) {
+      nzNodes.push_back(NodeIdPair(n->id(), n));
+      numNZValues += numNZ;
+    }
+  }
+
+  std::sort(nzNodes.begin(), nzNodes.end());
+
+  // -------------------------------------------------------
+  // write data
+  // -------------------------------------------------------
+  FILE* fs = hpcio_fopen_w(metricDBFnm.c_str(), 1);
+  if (!fs) {
+    std::string errorString;
+    hpcrun_getFileErrorString(metricDBFnm, errorString);
+
+    DIAG_EMsg("failed opening profile result file for writing " << 
+	      errorString << "; aborting."); 
+
+    prof_abort(-1);
+  }
+  DIAG_MsgIf(0, "writeSparseMetricsDB: " << metricDBFnm);
+
+  int ret;
+
+  // 1. header
+  hpcmetricDB_fmt_hdr_t hdr;
+  hdr.numNodes = cct.maxDenseId();
+  hdr.numMetrics = mEndId - mBegId; // [mBegId mEndId)
+  hdr.numNZNodes = nzNodes.size();
+  hdr.numNZValues = numNZValues;
+
+  ret = hpcmetricDB_fmt_sparse_hdr_fwrite(&hdr, fs);
+  if (ret == HPCFMT_ERR) goto badwrite;
+
+  // 2. node index (with sentinel)
+  {
+    hpcmetricDB_fmt_nzidx_t nzidx;
+    nzidx.valueIdx = 0;
+
+    for (uint i = 0; i < nzNodes.size(); ++i) {
+      Prof::CCT::ANode* n = nzNodes[i].second;
+      nzidx.nodeId = nzNodes[i].first;
+      ret = hpcmetricDB_fmt_nzidx_fwrite(&nzidx, fs);
+      if (ret == HPCFMT_ERR) goto badwrite;
+
+      uint mEnd = std::min(mEndId, n->numMetrics());
+      for (uint mId = mBegId; mId < mEnd; ++mId) {
+	if (n->hasMetric(mId)) {
+	  nzidx.valueIdx++;
+	}
+      }
+    }
+
+    nzidx.nodeId = HPCMETRICDB_FMT_NodeId_NULL;
+    ret = hpcmetricDB_fmt_nzidx_fwrite(&nzidx, fs);
+    if (ret == HPCFMT_ERR) goto badwrite;
+  }
+
+  // 3. metric values
+  //    - metric ids are relative to mBegId (cf. writeMetricsDB())
+  for (uint i = 0; i < nzNodes.size(); ++i) {
+    Prof::CCT::ANode* n = nzNodes[i].second;
+
+    uint mEnd = std::min(mEndId, n->numMetrics());
+    for (uint mId = mBegId; mId < mEnd; ++mId) {
+      if (n->hasMetric(mId)) {
+	hpcmetricDB_fmt_nzval_t nzval;
+	nzval.metricId = mId - mBegId;
+	nzval.value = n->metric(mId);
+	ret = hpcmetricDB_fmt_nzval_fwrite(&nzval, fs);
+	if (ret == HPCFMT_ERR) goto badwrite;
+      }
+    }
+  }
+
+  hpcio_fclose(fs);
+  return;
+
+badwrite:
+  {
+    std::string errorString;
+    hpcrun_getFileErrorString(metricDBFnm, errorString);
+
+    DIAG_EMsg("failed writing profile result file" << 
+	      errorString << "; aborting."); 
+    prof_abort(-1);
+  }
+}
+
+
 //***************************************************************************
 
 static void
@@ -154,16 +154,33 @@ realmain(int argc, char* const* argv)
     exit(-1);
   }
 
-  if (nArgs.paths->size() == 1 && !args.hpcprof_isMetricArg) {
+  // a thread's profile may come in several files (cf. snapshots),
+  // whose metrics share their [rank,thread] names, so the merge below
+  // adds them up into one thread's metrics
+  uint numThreads = 0;
+  for (uint i = 0; i < nArgs.paths->size();
+       i = Analysis::Util::profileThreadEnd(*nArgs.paths, i)) {
+    numThreads++;
+  }
+
+  if (numThreads == 1 && !args.hpcprof_isMetricArg) {
     args.prof_metrics = Analysis::Args::MetricFlg_Thread;
   }
 
   if (Analysis::Args::MetricFlg_isThread(args.prof_metrics)
-      && nArgs.paths->size() > 16
+      && numThreads > 16
       && !args.hpcprof_forceMetrics) {
-    DIAG_Throw("You have requested thread-level metrics for " << nArgs.paths->size() << " profile files.  Because this may result in an unusable database, to continue you must use the --force-metric option.");
+    DIAG_Throw("You have requested thread-level metrics for " << numThreads << " profiles.  Because this may result in an unusable database, to continue you must use the --force-metric option.");
   }
 
+  // -------------------------------------------------------
+  // 0. Make empty Experiment database (ensure file system works)
+  //
+  // N.B.: Normalized trace files are written directly into it.
+  // -------------------------------------------------------
+
+  args.makeDatabaseDir();
+
   // ------------------------------------------------------------
   // 1a. Create canonical CCT // Normalize trace files
   // ------------------------------------------------------------
@@ -178,17 +195,16 @@ realmain(int argc, char* const* argv)
   }
   uint mrgFlags = (Prof::CCT::MrgFlg_NormalizeTraceFileY);
 
-  Prof::CallPath::Profile* prof =
-    Analysis::CallPath::read(*nArgs.paths, groupMap, mergeTy, rFlags, mrgFlags);
-
-  prof->disable_redundancy(args.remove_redundancy);
+  Prof::CallPath::TraceRemapper* traceRemapper =
+    new Prof::CallPath::TraceRemapper(args.db_dir, args.prof_jobs);
 
+  Prof::CallPath::Profile* prof =
+    Analysis::CallPath::read(*nArgs.paths, groupMap, mergeTy, rFlags, mrgFlags,
+			     args.prof_jobs, traceRemapper);
 
-  // -------------------------------------------------------
-  // 0. Make empty Experiment database (ensure file system works)
-  // -------------------------------------------------------
+  delete traceRemapper; // waits for trace files
 
-  args.makeDatabaseDir();
+  prof->disable_redundancy(args.remove_redundancy);
 
   // ------------------------------------------------------------
   // 1b. Add static structure to canonical CCT
@@ -0,0 +1,261 @@
+// -*-Mode: C++;-*- // technically C99
+
+// * BeginRiceCopyright *****************************************************
+//
+// $HeadURL$
+// $Id$
+//
+// --------------------------------------------------------------------------
+// Part of HPCToolkit (hpctoolkit.org)
+//
+// Information about sources of support for research and development of
+// HPCToolkit is at 'hpctoolkit.org' and in 'README.Acknowledgments'.
+// --------------------------------------------------------------------------
+//
+// Copyright ((c)) 2002-2020, Rice University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+//
+// * Neither the name of Rice University (RICE) nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+//
+// This software is provided by RICE and contributors "as is" and any
+// express or implied warranties, including, but not limited to, the
+// implied warranties of merchantability and fitness for a particular
+// purpose are disclaimed. In no event shall RICE or contributors be
+// liable for any direct, indirect, incidental, special, exemplary, or
+// consequential damages (including, but not limited to, procurement of
+// substitute goods or services; loss of use, data, or profits; or
+// business interruption) however caused and on any theory of liability,
+// whether in contract, strict liability, or tort (including negligence
+// or otherwise) arising in any way out of the use of this software, even
+// if advised of the possibility of such damage.
+//
+// ******************************************************* EndRiceCopyright *
+//***************************************************************************
+//
+// File:
+//   cct2metrics_bench.c
+//
+// Purpose:
+//   Time the metric update that every sample makes at its cct leaf
+//   (cct_metric_data_increment()).
+//
+// Description:
+//   The program builds a cct with 1000 to 100000 leaves, each with
+//   metrics, and increments a metric at leaves picked at random.  It
+//   prints the time per update two ways: through the metric pointer
+//   of the cct node, which is what hpcrun does, and through a splay
+//   tree that maps a node to its metrics, which is what hpcrun did
+//   before the pointer (the cct2metrics_t map).  The map is rebuilt
+//   here for the comparison.
+//
+//   Build:
+//
+//     PL=../../../lib/prof-lean
+//     cc -O2 -D_GNU_SOURCE <hpcrun include flags> -o cct2metrics_bench
+//       cct2metrics_bench.c ../cct/cct.c ../cct2metrics.c ../metrics.c
+//       $PL/lush/lush-support.c
+//       $PL/{hpcio,hpcfmt,hpcrun-fmt,hpcio-buffer,producer_wfq}.c -lpthread
+//
+//   The functions below stand in for the parts of hpcrun that these
+//   files call but that play no role in a metric update.
+//
+//***************************************************************************
+
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <cct/cct.h>
+#include <cct2metrics.h>
+#include <lib/prof-lean/splay-macros.h>
+#include <messages/debug-flag.h>
+#include <messages/messages.h>
+#include <metrics.h>
+
+#define MAX_LEAVES   100000
+#define FANOUT       100
+#define NUM_SAMPLES  (1 << 22)
+
+//***************************************************************************
+// stand-ins for hpcrun
+//***************************************************************************
+
+void *
+hpcrun_malloc(size_t size)
+{
+  return calloc(1, size);
+}
+
+void *
+hpcrun_malloc_freeable(size_t size)
+{
+  return calloc(1, size);
+}
+
+void
+hpcrun_emsg(const char *fmt, ...)
+{
+}
+
+void
+hpcrun_pmsg(const char *tag, const char *fmt, ...)
+{
+}
+
+int
+debug_flag_get(dbg_category flag)
+{
+  return 0;
+}
+
+ip_normalized_t
+hpcrun_normalize_ip(void *unnormalized_ip, load_module_t *lm)
+{
+  ip_normalized_t ip = { .lm_id = 1, .lm_ip = (uintptr_t) unnormalized_ip };
+  return ip;
+}
+
+void
+monitor_real_abort(void)
+{
+  abort();
+}
+
+//***************************************************************************
+// the former cct node -> metrics map
+//***************************************************************************
+
+typedef struct splay_map_t {
+  cct_node_t *node;
+  metric_data_list_t *kind_metrics;
+  struct splay_map_t *left;
+  struct splay_map_t *right;
+} splay_map_t;
+
+static splay_map_t *splay_map = NULL;
+
+static splay_map_t *
+splay(splay_map_t *map, cct_node_t *node)
+{
+  REGULAR_SPLAY_TREE(splay_map_t, map, node, node, left, right);
+  return map;
+}
+
+static void
+splay_map_assoc(cct_node_t *node, metric_data_list_t *kind_metrics)
+{
+  splay_map_t *new = calloc(1, sizeof(splay_map_t));
+  new->node = node;
+  new->kind_metrics = kind_metrics;
+  if (splay_map) {
+    splay_map = splay(splay_map, node);
+    if (splay_map->node < node) {
+      new->left = splay_map;
+      new->right = splay_map->right;
+      splay_map->right = NULL;
+    }
+    else {
+      new->left = splay_map->left;
+      new->right = splay_map;
+      splay_map->left = NULL;
+    }
+  }
+  splay_map = new;
+}
+
+static metric_data_list_t *
+splay_map_reify(cct_node_t *node, int metric_id)
+{
+  if (splay_map) {
+    splay_map = splay(splay_map, node);
+    if (splay_map->node == node) return splay_map->kind_metrics;
+  }
+  metric_data_list_t *rv = hpcrun_new_metric_data_list(metric_id);
+  splay_map_assoc(node, rv);
+  return rv;
+}
+
+//***************************************************************************
+
+static double
+now_sec(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + 1.0e-9 * ts.tv_nsec;
+}
+
+int
+main(int argc, char **argv)
+{
+  static cct_node_t *leaf[MAX_LEAVES];
+  static uint32_t order[NUM_SAMPLES];
+
+  kind_info_t *kind = hpcrun_metrics_new_kind();
+  int metric_id = hpcrun_set_new_metric_info(kind, "SAMPLES");
+  hpcrun_close_kind(kind);
+  hpcrun_metrics_data_finalize();
+
+  for (uint32_t num_leaves = 1000; num_leaves <= MAX_LEAVES; num_leaves *= 10) {
+    // leaves under num_leaves / FANOUT call sites of one root
+    cct_node_t *root = hpcrun_cct_new();
+    for (uint32_t i = 0; i < num_leaves; i++) {
+      cct_addr_t site = NON_LUSH_ADDR_INI(1, 0x400000 + 16 * (i / FANOUT));
+      cct_addr_t addr = NON_LUSH_ADDR_INI(2, 0x800000 + 16 * i);
+      leaf[i] = hpcrun_cct_insert_addr(hpcrun_cct_insert_addr(root, &site), &addr);
+    }
+
+    unsigned int seed = 1;
+    for (uint32_t k = 0; k < NUM_SAMPLES; k++) {
+      order[k] = rand_r(&seed) % num_leaves;
+    }
+
+    double start = now_sec();
+    for (uint32_t k = 0; k < NUM_SAMPLES; k++) {
+      cct_metric_data_increment(metric_id, leaf[order[k]],
+				(cct_metric_data_t) { .i = 1 });
+    }
+    double node_secs = now_sec() - start;
+
+    splay_map = NULL;
+    start = now_sec();
+    for (uint32_t k = 0; k < NUM_SAMPLES; k++) {
+      metric_data_list_t *set = splay_map_reify(leaf[order[k]], metric_id);
+      hpcrun_metric_std_inc(metric_id, set, (cct_metric_data_t) { .i = 1 });
+    }
+    double splay_secs = now_sec() - start;
+
+    // the samples of a leaf are counted once in each of the two ways
+    for (uint32_t i = 0; i < num_leaves; i++) {
+      metric_data_list_t *set = hpcrun_get_metric_data_list(leaf[i]);
+      cct_metric_data_t *node_val = set ? hpcrun_metric_set_loc(set, metric_id) : NULL;
+      cct_metric_data_t *splay_val =
+	hpcrun_metric_set_loc(splay_map_reify(leaf[i], metric_id), metric_id);
+      if ((node_val ? node_val->i : 0) != splay_val->i) {
+	fprintf(stderr, "%u leaves: counts of leaf %u differ\n", num_leaves, i);
+	return 1;
+      }
+    }
+
+    printf("%6u leaves: %6.1f ns/sample with node metrics, %6.1f ns/sample with a splay map\n",
+	   num_leaves, 1.0e9 * node_secs / NUM_SAMPLES,
+	   1.0e9 * splay_secs / NUM_SAMPLES);
+  }
+  return 0;
+}
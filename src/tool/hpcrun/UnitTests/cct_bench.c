@@ -0,0 +1,197 @@
+// -*-Mode: C++;-*- // technically C99
+
+// * BeginRiceCopyright *****************************************************
+//
+// $HeadURL$
+// $Id$
+//
+// --------------------------------------------------------------------------
+// Part of HPCToolkit (hpctoolkit.org)
+//
+// Information about sources of support for research and development of
+// HPCToolkit is at 'hpctoolkit.org' and in 'README.Acknowledgments'.
+// --------------------------------------------------------------------------
+//
+// Copyright ((c)) 2002-2020, Rice University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+//
+// * Neither the name of Rice University (RICE) nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+//
+// This software is provided by RICE and contributors "as is" and any
+// express or implied warranties, including, but not limited to, the
+// implied warranties of merchantability and fitness for a particular
+// purpose are disclaimed. In no event shall RICE or contributors be
+// liable for any direct, indirect, incidental, special, exemplary, or
+// consequential damages (including, but not limited to, procurement of
+// substitute goods or services; loss of use, data, or profits; or
+// business interruption) however caused and on any theory of liability,
+// whether in contract, strict liability, or tort (including negligence
+// or otherwise) arising in any way out of the use of this software, even
+// if advised of the possibility of such damage.
+//
+// ******************************************************* EndRiceCopyright *
+//***************************************************************************
+//
+// File:
+//   cct_bench.c
+//
+// Purpose:
+//   Time hpcrun_cct_insert_addr() under nodes with many children, the
+//   case the child index of cct.c is for.
+//
+// Description:
+//   For fanouts from 16 to 65536, the program inserts that many
+//   distinct children under one node and then looks them up again in
+//   a scattered order, as the samples of a loop over many callees do.
+//   It prints the time per lookup.  Build it twice to compare the
+//   hash index with the plain sibling splay:
+//
+//     PL=../../../lib/prof-lean
+//     cc -O2 -D_GNU_SOURCE <hpcrun include flags> -o cct_bench
+//       cct_bench.c ../cct/cct.c $PL/lush/lush-support.c
+//       $PL/{hpcio,hpcfmt,hpcrun-fmt,hpcio-buffer,producer_wfq}.c -lpthread
+//
+//   and again with -DCCT_CHILD_INDEX_MIN=0xffffffff for the splay.
+//
+//   The functions below stand in for the parts of hpcrun that cct.c
+//   calls but that play no role in insertion.
+//
+//***************************************************************************
+
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <cct/cct.h>
+#include <messages/debug-flag.h>
+#include <cct2metrics.h>
+#include <messages/messages.h>
+#include <metrics.h>
+
+#define MAX_FANOUT   65536
+#define NUM_LOOKUPS  (1 << 22)
+
+//***************************************************************************
+// stand-ins for hpcrun
+//***************************************************************************
+
+void *
+hpcrun_malloc(size_t size)
+{
+  return calloc(1, size);
+}
+
+void *
+hpcrun_malloc_freeable(size_t size)
+{
+  return calloc(1, size);
+}
+
+void
+hpcrun_emsg(const char *fmt, ...)
+{
+}
+
+void
+hpcrun_pmsg(const char *tag, const char *fmt, ...)
+{
+}
+
+int
+debug_flag_get(dbg_category flag)
+{
+  return 0;
+}
+
+ip_normalized_t
+hpcrun_normalize_ip(void *unnormalized_ip, load_module_t *lm)
+{
+  ip_normalized_t ip = { .lm_id = 1, .lm_ip = (uintptr_t) unnormalized_ip };
+  return ip;
+}
+
+metric_data_list_t *
+hpcrun_get_metric_data_list(cct_node_t *node)
+{
+  return NULL;
+}
+
+int
+hpcrun_get_num_kind_metrics(void)
+{
+  return 0;
+}
+
+void
+hpcrun_metric_set_dense_copy(cct_metric_data_t *dest, metric_data_list_t *list,
+			     int num_metrics)
+{
+}
+
+//***************************************************************************
+
+static double
+now_sec(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + 1.0e-9 * ts.tv_nsec;
+}
+
+static cct_addr_t
+child_addr(uint32_t i)
+{
+  // return addresses a few bytes apart, as the calls of one function are
+  cct_addr_t addr = NON_LUSH_ADDR_INI(1, 0x400000 + 12 * i);
+  return addr;
+}
+
+int
+main(int argc, char **argv)
+{
+  static uint32_t order[NUM_LOOKUPS];
+
+  for (uint32_t fanout = 16; fanout <= MAX_FANOUT; fanout *= 4) {
+    cct_node_t *root = hpcrun_cct_new();
+    for (uint32_t i = 0; i < fanout; i++) {
+      cct_addr_t addr = child_addr(i);
+      hpcrun_cct_insert_addr(root, &addr);
+    }
+
+    unsigned int seed = 1;
+    for (uint32_t k = 0; k < NUM_LOOKUPS; k++) {
+      order[k] = rand_r(&seed) % fanout;
+    }
+
+    double start = now_sec();
+    uintptr_t check = 0;
+    for (uint32_t k = 0; k < NUM_LOOKUPS; k++) {
+      cct_addr_t addr = child_addr(order[k]);
+      check += (uintptr_t) hpcrun_cct_insert_addr(root, &addr);
+    }
+    double secs = now_sec() - start;
+
+    if (hpcrun_cct_num_nodes(root, true) != fanout + 1 || check == 0) {
+      fprintf(stderr, "fanout %u: lookups created children\n", fanout);
+      return 1;
+    }
+    printf("fanout %6u: %7.1f ns/lookup\n", fanout, 1.0e9 * secs / NUM_LOOKUPS);
+  }
+  return 0;
+}
@@ -0,0 +1,269 @@
+// -*-Mode: C++;-*- // technically C99
+
+// * BeginRiceCopyright *****************************************************
+//
+// $HeadURL$
+// $Id$
+//
+// --------------------------------------------------------------------------
+// Part of HPCToolkit (hpctoolkit.org)
+//
+// Information about sources of support for research and development of
+// HPCToolkit is at 'hpctoolkit.org' and in 'README.Acknowledgments'.
+// --------------------------------------------------------------------------
+//
+// Copyright ((c)) 2002-2020, Rice University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+//
+// * Neither the name of Rice University (RICE) nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+//
+// This software is provided by RICE and contributors "as is" and any
+// express or implied warranties, including, but not limited to, the
+// implied warranties of merchantability and fitness for a particular
+// purpose are disclaimed. In no event shall RICE or contributors be
+// liable for any direct, indirect, incidental, special, exemplary, or
+// consequential damages (including, but not limited to, procurement of
+// substitute goods or services; loss of use, data, or profits; or
+// business interruption) however caused and on any theory of liability,
+// whether in contract, strict liability, or tort (including negligence
+// or otherwise) arising in any way out of the use of this software, even
+// if advised of the possibility of such damage.
+//
+// ******************************************************* EndRiceCopyright *
+//***************************************************************************
+//***************************************************************************
+//
+// File:
+//   cct_write_bench.c
+//
+// Purpose:
+//   Time writing a cct into a profile (hpcrun_cct_fwrite()) through a
+//   buffered outbuf, as write_data.c does, and through stdio, one
+//   field at a time, as it did before.
+//
+// Description:
+//   The program builds ccts of 10^4 to 10^6 nodes, each node with four
+//   metrics of which the leaves set about half, and writes each cct to
+//   a scratch file both ways, with dense and with sparse metrics.  It
+//   prints the time per write and per node, and checks that both ways
+//   write the same bytes.
+//
+//   Build:
+//
+//     PL=../../../lib/prof-lean
+//     cc -O2 -D_GNU_SOURCE <hpcrun include flags> -o cct_write_bench
+//       cct_write_bench.c ../cct/cct.c ../cct2metrics.c ../metrics.c
+//       $PL/lush/lush-support.c
+//       $PL/{hpcio,hpcfmt,hpcrun-fmt,hpcio-buffer,producer_wfq}.c -lpthread
+//
+//   The functions below stand in for the parts of hpcrun that these
+//   files call but that play no role in writing a cct.
+//
+//***************************************************************************
+
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <cct/cct.h>
+#include <cct2metrics.h>
+#include <lib/prof-lean/hpcio-buffer.h>
+#include <lib/prof-lean/hpcrun-fmt.h>
+#include <messages/debug-flag.h>
+#include <messages/messages.h>
+#include <metrics.h>
+
+#define MAX_NODES    1000000
+#define FANOUT       16
+#define NUM_METRICS  4
+#define BUFFER_SZ    (4 * 1024 * 1024)
+
+//***************************************************************************
+// stand-ins for hpcrun
+//***************************************************************************
+
+void *
+hpcrun_malloc(size_t size)
+{
+  return calloc(1, size);
+}
+
+void *
+hpcrun_malloc_freeable(size_t size)
+{
+  return calloc(1, size);
+}
+
+void
+hpcrun_emsg(const char *fmt, ...)
+{
+}
+
+void
+hpcrun_pmsg(const char *tag, const char *fmt, ...)
+{
+}
+
+int
+debug_flag_get(dbg_category flag)
+{
+  return 0;
+}
+
+ip_normalized_t
+hpcrun_normalize_ip(void *unnormalized_ip, load_module_t *lm)
+{
+  ip_normalized_t ip = { .lm_id = 1, .lm_ip = (uintptr_t) unnormalized_ip };
+  return ip;
+}
+
+void
+monitor_real_abort(void)
+{
+  abort();
+}
+
+//***************************************************************************
+
+static double
+now_sec(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + 1.0e-9 * ts.tv_nsec;
+}
+
+// a tree of 'num_nodes' nodes below 'root', FANOUT children per node,
+// with metrics set at the leaves
+static void
+build_cct(cct_node_t *root, uint32_t num_nodes, int *metric_id)
+{
+  static cct_node_t *nodes[MAX_NODES];
+  unsigned int seed = 1;
+
+  nodes[0] = root;
+  for (uint32_t i = 1; i < num_nodes; i++) {
+    cct_addr_t addr = NON_LUSH_ADDR_INI(1 + i % 3, 0x400000 + 16 * i);
+    nodes[i] = hpcrun_cct_insert_addr(nodes[(i - 1) / FANOUT], &addr);
+  }
+  for (uint32_t i = (num_nodes - 1) / FANOUT + 1; i < num_nodes; i++) {
+    for (int m = 0; m < NUM_METRICS; m++) {
+      if (rand_r(&seed) % 2) {
+	cct_metric_data_increment(metric_id[m], nodes[i],
+				  (cct_metric_data_t) { .i = 1 + rand_r(&seed) % 1000 });
+      }
+    }
+  }
+}
+
+// write 'cct' to 'fs' through stdio, or through an outbuf on its
+// descriptor; return the seconds taken, including the flush
+static double
+write_cct(cct_node_t *cct, FILE *fs, epoch_flags_t flags, bool use_outbuf)
+{
+  static char buffer[BUFFER_SZ];
+
+  rewind(fs);
+  if (ftruncate(fileno(fs), 0) != 0) {
+    perror("ftruncate");
+    exit(1);
+  }
+
+  double start = now_sec();
+  if (use_outbuf) {
+    hpcio_outbuf_t *outbuf = NULL;
+    if (hpcio_outbuf_attach(&outbuf, fileno(fs), buffer, BUFFER_SZ,
+			    HPCIO_OUTBUF_UNLOCKED, hpcrun_malloc) != HPCFMT_OK) {
+      fprintf(stderr, "hpcio_outbuf_attach failed\n");
+      exit(1);
+    }
+    hpcrun_cct_fwrite(cct, fs, outbuf, flags);
+    hpcio_outbuf_detach(&outbuf);
+  }
+  else {
+    hpcrun_cct_fwrite(cct, fs, NULL, flags);
+    fflush(fs);
+  }
+  return now_sec() - start;
+}
+
+static bool
+same_contents(FILE *a, FILE *b)
+{
+  rewind(a);
+  rewind(b);
+  int ca, cb;
+  do {
+    ca = getc(a);
+    cb = getc(b);
+  } while (ca == cb && ca != EOF);
+  return ca == cb;
+}
+
+int
+main(int argc, char **argv)
+{
+  int metric_id[NUM_METRICS];
+  kind_info_t *kind = hpcrun_metrics_new_kind();
+  for (int m = 0; m < NUM_METRICS; m++) {
+    metric_id[m] = hpcrun_set_new_metric_info(kind, "SAMPLES");
+  }
+  hpcrun_close_kind(kind);
+  hpcrun_metrics_data_finalize();
+
+  FILE *fs_stdio = tmpfile();
+  FILE *fs_outbuf = tmpfile();
+  if (fs_stdio == NULL || fs_outbuf == NULL) {
+    perror("tmpfile");
+    return 1;
+  }
+
+  for (uint32_t num_nodes = 10000; num_nodes <= MAX_NODES; num_nodes *= 10) {
+    cct_node_t *root = hpcrun_cct_new();
+    build_cct(root, num_nodes, metric_id);
+
+    for (int sparse = 0; sparse <= 1; sparse++) {
+      epoch_flags_t flags = { .bits = 0 };
+      flags.fields.isSparseMetrics = sparse;
+
+      // the better of three runs each
+      double stdio_secs = 1.0e9, outbuf_secs = 1.0e9;
+      for (int run = 0; run < 3; run++) {
+	double t = write_cct(root, fs_stdio, flags, false);
+	if (t < stdio_secs) stdio_secs = t;
+	t = write_cct(root, fs_outbuf, flags, true);
+	if (t < outbuf_secs) outbuf_secs = t;
+      }
+
+      if (!same_contents(fs_stdio, fs_outbuf)) {
+	fprintf(stderr, "%u nodes: the outbuf wrote different bytes\n",
+		num_nodes);
+	return 1;
+      }
+
+      printf("%7u nodes, %-6s: stdio %8.2f ms (%5.1f ns/node), "
+	     "outbuf %8.2f ms (%5.1f ns/node)\n",
+	     num_nodes, sparse ? "sparse" : "dense",
+	     1.0e3 * stdio_secs, 1.0e9 * stdio_secs / num_nodes,
+	     1.0e3 * outbuf_secs, 1.0e9 * outbuf_secs / num_nodes);
+    }
+  }
+  return 0;
+}
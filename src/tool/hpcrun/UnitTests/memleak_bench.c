@@ -0,0 +1,136 @@
+// -*-Mode: C++;-*- // technically C99
+
+// * BeginRiceCopyright *****************************************************
+//
+// $HeadURL$
+// $Id$
+//
+// --------------------------------------------------------------------------
+// Part of HPCToolkit (hpctoolkit.org)
+//
+// Information about sources of support for research and development of
+// HPCToolkit is at 'hpctoolkit.org' and in 'README.Acknowledgments'.
+// --------------------------------------------------------------------------
+//
+// Copyright ((c)) 2002-2020, Rice University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+//
+// * Neither the name of Rice University (RICE) nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+//
+// This software is provided by RICE and contributors "as is" and any
+// express or implied warranties, including, but not limited to, the
+// implied warranties of merchantability and fitness for a particular
+// purpose are disclaimed. In no event shall RICE or contributors be
+// liable for any direct, indirect, incidental, special, exemplary, or
+// consequential damages (including, but not limited to, procurement of
+// substitute goods or services; loss of use, data, or profits; or
+// business interruption) however caused and on any theory of liability,
+// whether in contract, strict liability, or tort (including negligence
+// or otherwise) arising in any way out of the use of this software, even
+// if advised of the possibility of such damage.
+//
+// ******************************************************* EndRiceCopyright *
+//***************************************************************************
+//
+// File:
+//   memleak_bench.c
+//
+// Purpose:
+//   A multi-threaded malloc/free workload for timing the footer table
+//   of the MEMLEAK sample source (cf. memleak-overrides.c).
+//
+// Description:
+//   Each thread allocates and frees rounds of aligned blocks, which
+//   always get a footer in the table, and of plain blocks, which get
+//   a header.  The program prints the rate of malloc/free pairs for
+//   1, 2, 4, ... threads.  Compare a plain run with
+//
+//     hpcrun -e MEMLEAK ./memleak_bench
+//     hpcrun -e MEMLEAK -dd MEMLEAK_NO_HEADER ./memleak_bench  (all footers)
+//     hpcrun -e MEMLEAK -mp 1/10 ./memleak_bench  (untracked frees)
+//
+//   A table that serializes on one lock shows as a rate that falls as
+//   threads are added.
+//
+//   Build: cc -O2 -pthread memleak_bench.c -o memleak_bench
+//
+//***************************************************************************
+
+#define _GNU_SOURCE
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define MAX_THREADS  16
+#define NUM_ROUNDS   2000
+#define BATCH_SIZE   256
+
+static double
+now_sec(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + 1.0e-9 * ts.tv_nsec;
+}
+
+static void *
+worker(void *arg)
+{
+  void *blocks[BATCH_SIZE];
+  unsigned int seed = (unsigned int) (uintptr_t) arg;
+
+  for (int round = 0; round < NUM_ROUNDS; round++) {
+    for (int i = 0; i < BATCH_SIZE; i++) {
+      size_t bytes = 16 + rand_r(&seed) % 1024;
+      if (i % 2 == 0) {
+	if (posix_memalign(&blocks[i], 64, bytes) != 0) {
+	  blocks[i] = NULL;
+	}
+      }
+      else {
+	blocks[i] = malloc(bytes);
+      }
+    }
+    for (int i = 0; i < BATCH_SIZE; i++) {
+      free(blocks[i]);
+    }
+  }
+  return NULL;
+}
+
+int
+main(int argc, char **argv)
+{
+  pthread_t threads[MAX_THREADS];
+
+  for (int n = 1; n <= MAX_THREADS; n *= 2) {
+    double start = now_sec();
+    for (int t = 0; t < n; t++) {
+      pthread_create(&threads[t], NULL, worker, (void *) (uintptr_t) (t + 1));
+    }
+    for (int t = 0; t < n; t++) {
+      pthread_join(threads[t], NULL);
+    }
+    double secs = now_sec() - start;
+    double pairs = (double) n * NUM_ROUNDS * BATCH_SIZE;
+
+    printf("%2d threads: %8.2f M malloc/free pairs/s\n", n, pairs / secs / 1.0e6);
+  }
+  return 0;
+}
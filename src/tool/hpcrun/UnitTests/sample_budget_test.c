@@ -0,0 +1,209 @@
+// -*-Mode: C++;-*- // technically C99
+
+// * BeginRiceCopyright *****************************************************
+//
+// $HeadURL$
+// $Id$
+//
+// --------------------------------------------------------------------------
+// Part of HPCToolkit (hpctoolkit.org)
+//
+// Information about sources of support for research and development of
+// HPCToolkit is at 'hpctoolkit.org' and in 'README.Acknowledgments'.
+// --------------------------------------------------------------------------
+//
+// Copyright ((c)) 2002-2020, Rice University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+//
+// * Neither the name of Rice University (RICE) nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+//
+// This software is provided by RICE and contributors "as is" and any
+// express or implied warranties, including, but not limited to, the
+// implied warranties of merchantability and fitness for a particular
+// purpose are disclaimed. In no event shall RICE or contributors be
+// liable for any direct, indirect, incidental, special, exemplary, or
+// consequential damages (including, but not limited to, procurement of
+// substitute goods or services; loss of use, data, or profits; or
+// business interruption) however caused and on any theory of liability,
+// whether in contract, strict liability, or tort (including negligence
+// or otherwise) arising in any way out of the use of this software, even
+// if advised of the possibility of such damage.
+//
+// ******************************************************* EndRiceCopyright *
+//***************************************************************************
+//***************************************************************************
+//
+// File:
+//   sample_budget_test.c
+//
+// Purpose:
+//   Check that the overhead budget of sample_budget.c holds a synthetic
+//   load to its budget, in bursty phases and in quiet ones.
+//
+// Description:
+//   The program plays a sample source: it computes for a period of
+//   1 ms times the period scale, then spends a given time handling
+//   a "sample" between hpcrun_sample_budget_begin() and _end().  With
+//   a budget of 3%, it runs two phases of 1.5 s of thread CPU time
+//   each:
+//
+//     bursty  samples take 500 us: 33% overhead at the configured
+//             period, so the scale has to rise
+//     quiet   samples take 10 us: 1% overhead, so the scale has to fall
+//             below 1 and the phase get more samples
+//
+//   A sample's overhead also includes the clock reads of the budget,
+//   which take about a microsecond each where the thread CPU clock is
+//   a system call.  The program prints the overhead and scale at the
+//   end of each phase, and fails if the overhead is not within a
+//   factor of 1.5 of the budget or the scale moved the wrong way.
+//
+//   Build:
+//
+//     cc -O2 -D_GNU_SOURCE <hpcrun include flags> -o sample_budget_test
+//       sample_budget_test.c ../sample_budget.c ../env.c
+//
+//***************************************************************************
+
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include <env.h>
+#include <messages/debug-flag.h>
+#include <messages/messages.h>
+#include <sample_budget.h>
+
+#define BUDGET_PCT   3.0
+#define BASE_PERIOD  1000000     // ns
+#define PHASE_TIME   1500000000  // ns
+#define SETTLE_TIME  1000000000  // ns
+
+//***************************************************************************
+// stand-ins for hpcrun
+//***************************************************************************
+
+void
+hpcrun_emsg(const char *fmt, ...)
+{
+}
+
+void
+hpcrun_pmsg(const char *tag, const char *fmt, ...)
+{
+}
+
+int
+debug_flag_get(dbg_category flag)
+{
+  return 0;
+}
+
+//***************************************************************************
+// synthetic load
+//***************************************************************************
+
+static uint64_t
+cpu_time(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+  return ((uint64_t) ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+// compute for 'ns' from 'beg' on; return the time at the end
+static uint64_t
+spin(uint64_t beg, uint64_t ns)
+{
+  uint64_t now;
+  while ((now = cpu_time()) - beg < ns);
+  return now;
+}
+
+// run a phase whose samples take 'cost' ns; return the overhead after
+// the scale has had time to settle
+static double
+run_phase(const char *name, uint64_t cost)
+{
+  uint64_t beg = cpu_time();
+  uint64_t settled = 0, busy = 0, work_end = 0;
+  long samples = 0;
+
+  for (;;) {
+    // everything since the end of the previous period is overhead
+    uint64_t now = cpu_time();
+    if (settled) {
+      busy += now - work_end;
+      samples++;
+    }
+    if (now - beg >= PHASE_TIME) break;
+    if (settled == 0 && now - beg >= SETTLE_TIME) settled = now;
+
+    work_end = spin(now, BASE_PERIOD * hpcrun_sample_budget_scale());
+
+    uint64_t sample_beg = hpcrun_sample_budget_begin();
+    spin(cpu_time(), cost);
+    hpcrun_sample_budget_end(sample_beg);
+  }
+
+  double overhead = (double) busy / (cpu_time() - settled);
+  printf("%-8s  sample %6.1f us  overhead %5.2f%%  scale %7.3f  "
+         "samples/s %6.0f\n", name, cost / 1000.0, 100.0 * overhead,
+         hpcrun_sample_budget_scale(),
+         samples / ((PHASE_TIME - SETTLE_TIME) / 1.0e9));
+  return overhead;
+}
+
+static int
+check(const char *what, int ok)
+{
+  if (!ok) {
+    printf("FAILED: %s\n", what);
+  }
+  return ok ? 0 : 1;
+}
+
+//***************************************************************************
+// main
+//***************************************************************************
+
+int
+main(int argc, char **argv)
+{
+  char pct[32];
+  snprintf(pct, sizeof(pct), "%g", BUDGET_PCT);
+  setenv(HPCRUN_OVERHEAD_BUDGET, pct, 1);
+  hpcrun_sample_budget_init();
+
+  double budget = BUDGET_PCT / 100.0;
+  int failed = 0;
+
+  double bursty = run_phase("bursty", 500000);
+  failed += check("bursty phase within budget",
+                  bursty < 1.5 * budget && bursty > budget / 1.5);
+  failed += check("bursty phase scale above 1",
+                  hpcrun_sample_budget_scale() > 1.0);
+
+  double quiet = run_phase("quiet", 10000);
+  failed += check("quiet phase within budget",
+                  quiet < 1.5 * budget && quiet > budget / 1.5);
+  failed += check("quiet phase scale below 1",
+                  hpcrun_sample_budget_scale() < 1.0);
+
+  return failed ? 1 : 0;
+}
@@ -0,0 +1,225 @@
+// -*-Mode: C++;-*- // technically C99
+
+// * BeginRiceCopyright *****************************************************
+//
+// $HeadURL$
+// $Id$
+//
+// --------------------------------------------------------------------------
+// Part of HPCToolkit (hpctoolkit.org)
+//
+// Information about sources of support for research and development of
+// HPCToolkit is at 'hpctoolkit.org' and in 'README.Acknowledgments'.
+// --------------------------------------------------------------------------
+//
+// Copyright ((c)) 2002-2020, Rice University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+//
+// * Neither the name of Rice University (RICE) nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+//
+// This software is provided by RICE and contributors "as is" and any
+// express or implied warranties, including, but not limited to, the
+// implied warranties of merchantability and fitness for a particular
+// purpose are disclaimed. In no event shall RICE or contributors be
+// liable for any direct, indirect, incidental, special, exemplary, or
+// consequential damages (including, but not limited to, procurement of
+// substitute goods or services; loss of use, data, or profits; or
+// business interruption) however caused and on any theory of liability,
+// whether in contract, strict liability, or tort (including negligence
+// or otherwise) arising in any way out of the use of this software, even
+// if advised of the possibility of such damage.
+//
+// ******************************************************* EndRiceCopyright *
+//***************************************************************************
+//***************************************************************************
+//
+// File:
+//   stats_bench.c
+//
+// Purpose:
+//   Time the hpcrun_stats_*_inc() counter updates that each sample
+//   makes, from many threads at once, with the shared counters and
+//   with the per-thread blocks of hpcrun_stats.c.
+//
+// Description:
+//   Each of 1 to 16 threads plays 2^22 samples.  A sample makes the
+//   updates hpcrun_sample_callpath() makes: samples attempted and
+//   taken, the frames of its unwind, and an unwind interval.  In the
+//   "shared" run, the threads have no thread data, so every update
+//   goes to the process-wide atomic counters, as all updates did
+//   before the per-thread blocks.  In the "per-thread" run, each
+//   thread has thread data with a registered stats block.  The program
+//   prints the time per sample, and checks that the summed counters
+//   come out right.  Contention only shows with as many cores as
+//   threads.
+//
+//   Build:
+//
+//     cc -O2 -D_GNU_SOURCE <hpcrun include flags> -o stats_bench
+//       stats_bench.c ../hpcrun_stats.c -lpthread
+//
+//   The functions below stand in for the parts of hpcrun that
+//   hpcrun_stats.c calls but that play no role in counting.
+//
+//***************************************************************************
+
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include <disabled.h>
+#include <hpcrun_stats.h>
+#include <memory/hpcrun-malloc.h>
+#include <messages/debug-flag.h>
+#include <messages/messages.h>
+#include <thread_data.h>
+#include <unwind/common/validate_return_addr.h>
+
+#define MAX_THREADS   16
+#define NUM_SAMPLES   (1 << 22)
+#define FRAMES        10
+
+//***************************************************************************
+// stand-ins for hpcrun
+//***************************************************************************
+
+static __thread thread_data_t *my_td = NULL;
+
+static thread_data_t *
+bench_get_thread_data(void)
+{
+  return my_td;
+}
+
+static bool
+bench_td_avail(void)
+{
+  return my_td != NULL;
+}
+
+thread_data_t *(*hpcrun_get_thread_data)(void) = bench_get_thread_data;
+bool (*hpcrun_td_avail)(void) = bench_td_avail;
+
+void
+hpcrun_amsg(const char *fmt, ...)
+{
+}
+
+int
+debug_flag_get(dbg_category flag)
+{
+  return 0;
+}
+
+bool
+hpcrun_get_disabled(void)
+{
+  return false;
+}
+
+void
+hpcrun_memory_summary(void)
+{
+}
+
+void
+hpcrun_validation_summary(void)
+{
+}
+
+//***************************************************************************
+
+static bool per_thread;
+static pthread_barrier_t barrier;
+
+static double
+now_sec(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + 1.0e-9 * ts.tv_nsec;
+}
+
+static void *
+sampler(void *arg)
+{
+  if (per_thread) {
+    // blocks stay registered, as thread data does in hpcrun
+    if (posix_memalign((void **) &my_td, 128, sizeof(thread_data_t)) != 0) {
+      abort();
+    }
+    my_td->stats.self = NULL;
+    hpcrun_stats_thread_init(&my_td->stats);
+  }
+  pthread_barrier_wait(&barrier);
+
+  for (long k = 0; k < NUM_SAMPLES; k++) {
+    hpcrun_stats_num_samples_attempted_inc();
+    hpcrun_stats_frames_total_inc(FRAMES);
+    hpcrun_stats_num_unwind_intervals_total_inc();
+    hpcrun_stats_num_samples_total_inc();
+  }
+  return NULL;
+}
+
+// run 'num_threads' samplers; return the time per sample in ns
+static double
+run(int num_threads)
+{
+  pthread_t thread[MAX_THREADS];
+
+  hpcrun_stats_reinit();
+  pthread_barrier_init(&barrier, NULL, num_threads + 1);
+  for (int i = 0; i < num_threads; i++) {
+    pthread_create(&thread[i], NULL, sampler, NULL);
+  }
+  pthread_barrier_wait(&barrier);
+  double start = now_sec();
+  for (int i = 0; i < num_threads; i++) {
+    pthread_join(thread[i], NULL);
+  }
+  double secs = now_sec() - start;
+  pthread_barrier_destroy(&barrier);
+
+  long samples = (long) num_threads * NUM_SAMPLES;
+  if (hpcrun_stats_num_samples_attempted() != samples
+      || hpcrun_stats_num_samples_total() != samples
+      || hpcrun_stats_num_unwind_intervals_total() != samples
+      || hpcrun_stats_frames_total() != FRAMES * samples) {
+    fprintf(stderr, "%d threads: wrong counts\n", num_threads);
+    exit(1);
+  }
+  return 1.0e9 * secs / NUM_SAMPLES;
+}
+
+int
+main(int argc, char **argv)
+{
+  for (int num_threads = 1; num_threads <= MAX_THREADS; num_threads *= 2) {
+    per_thread = false;
+    double shared_ns = run(num_threads);
+    per_thread = true;
+    double per_thread_ns = run(num_threads);
+
+    printf("%2d threads: %6.1f ns/sample shared, %6.1f ns/sample per-thread\n",
+	   num_threads, shared_ns, per_thread_ns);
+  }
+  return 0;
+}
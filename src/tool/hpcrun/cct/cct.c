@@ -124,6 +124,15 @@ struct cct_node_t {
   struct cct_node_t* left;
   struct cct_node_t* right;
 
+  // hash index over the splay tree of children, created once the node
+  // has had CCT_CHILD_INDEX_MIN children inserted (cf. child_index_find)
+  struct cct_child_index_t* child_index;
+  uint32_t num_inserted;
+
+  // ---------------------------------------------------------
+  // metrics (NULL until the node gets a sample; cf. cct2metrics.h)
+  // ---------------------------------------------------------
+  metric_data_list_t* metrics;
 };
 
 #if 0
@@ -180,6 +189,9 @@ cct_node_create(cct_addr_t* addr, cct_node_t* parent)
   node->children = NULL;
   node->left = NULL;
   node->right = NULL;
+  node->child_index = NULL;
+  node->num_inserted = 0;
+  node->metrics = NULL;
 
   node->is_leaf = false;
 
@@ -212,6 +224,178 @@ splay(cct_node_t* cct, cct_addr_t* addr)
 #undef l_lt
 #undef l_gt
 
+//
+// ******* CHILD INDEX section ********
+//
+// A node with thousands of children (e.g. the root of a thread that
+// calls many distinct functions, or the unresolved root under OpenMP)
+// pays a splay -- O(log n) pointer chasing plus a rewrite of the
+// sibling links -- on every lookup.  Once a node has had
+// CCT_CHILD_INDEX_MIN children inserted, it gets an open-addressed
+// hash table (linear probing) that maps an addr to the child.  The
+// table is filled lazily and grows by rehashing its own live entries,
+// so neither step walks the (possibly very deep) splay tree in the
+// signal handler.
+//
+// The sibling splay tree remains the set of children: the walkers,
+// merge and the freelist only ever see the splay tree.  The index is a
+// cache in front of it.  A hit is trusted only if the entry still has
+// this node as its parent; on a miss, lookup falls back to the splay
+// and enters what it finds.  Tables come from hpcrun_malloc and are
+// abandoned (not freed) when the table grows or the child set is
+// replaced wholesale.
+//
+
+// UnitTests/cct_bench.c builds with a huge value to time the plain splay
+#ifndef CCT_CHILD_INDEX_MIN
+#define CCT_CHILD_INDEX_MIN  32
+#endif
+#define CCT_CHILD_INDEX_DEAD ((cct_node_t*) 1)  // tombstone
+
+typedef struct cct_child_index_t {
+  uint32_t mask;  // number of slots - 1; number of slots is a power of 2
+  uint32_t used;  // live entries + tombstones; kept <= 1/2 of the slots
+  cct_node_t* slot[];
+} cct_child_index_t;
+
+static inline uint32_t
+child_index_hash(cct_addr_t* addr)
+{
+  // cct_addr_eq implies equal ip_norm, so hashing ip_norm is consistent
+  // with it; the LUSH components only break ties in the probe sequence
+  uint64_t h = ((uint64_t) addr->ip_norm.lm_ip)
+    ^ ((uint64_t) addr->ip_norm.lm_id << 48);
+  return (uint32_t) ((h * 0x9E3779B97F4A7C15ULL) >> 32);
+}
+
+static cct_child_index_t*
+child_index_new(uint32_t nslots)
+{
+  size_t sz = sizeof(cct_child_index_t) + nslots * sizeof(cct_node_t*);
+  cct_child_index_t* index = hpcrun_malloc(sz);
+  if (! index) return NULL;
+
+  memset(index, 0, sz);
+  index->mask = nslots - 1;
+  return index;
+}
+
+// enter child in index, which is known to have room and not to contain it
+static void
+child_index_put(cct_child_index_t* index, cct_node_t* child)
+{
+  uint32_t i = child_index_hash(&child->addr) & index->mask;
+  while (index->slot[i] && index->slot[i] != CCT_CHILD_INDEX_DEAD)
+    i = (i + 1) & index->mask;
+
+  if (! index->slot[i]) index->used++;
+  index->slot[i] = child;
+}
+
+static void
+child_index_reset(cct_node_t* node)
+{
+  node->child_index = NULL;
+  node->num_inserted = 0;
+}
+
+// grow the index of node, keeping only entries that are still children
+static void
+child_index_grow(cct_node_t* node)
+{
+  cct_child_index_t* old = node->child_index;
+  uint32_t live = 0;
+  for (uint32_t i = 0; i <= old->mask; i++) {
+    cct_node_t* child = old->slot[i];
+    if (child && child != CCT_CHILD_INDEX_DEAD && child->parent == node) live++;
+  }
+
+  uint32_t nslots = old->mask + 1;
+  while (nslots < 4 * live) nslots *= 2;
+
+  cct_child_index_t* index = child_index_new(nslots);
+  if (index) {
+    for (uint32_t i = 0; i <= old->mask; i++) {
+      cct_node_t* child = old->slot[i];
+      if (child && child != CCT_CHILD_INDEX_DEAD && child->parent == node)
+        child_index_put(index, child);
+    }
+    node->child_index = index;
+  }
+  else {
+    // out of memory: drop the index and try again after another
+    // CCT_CHILD_INDEX_MIN inserts
+    child_index_reset(node);
+  }
+}
+
+static cct_node_t*
+child_index_find(cct_node_t* node, cct_addr_t* addr)
+{
+  cct_child_index_t* index = node->child_index;
+  uint32_t i = child_index_hash(addr) & index->mask;
+  cct_node_t* child;
+
+  for (; (child = index->slot[i]); i = (i + 1) & index->mask) {
+    if (child != CCT_CHILD_INDEX_DEAD && cct_addr_eq(addr, &child->addr)) {
+      if (child->parent == node) return child;
+      index->slot[i] = CCT_CHILD_INDEX_DEAD;  // stale: child moved away
+    }
+  }
+  return NULL;
+}
+
+// child has just joined the children of node
+static void
+child_index_add(cct_node_t* node, cct_node_t* child)
+{
+  cct_child_index_t* index = node->child_index;
+  if (! index) return;
+
+  if (2 * (index->used + 1) > index->mask + 1) {
+    child_index_grow(node);
+    if (! (index = node->child_index)) return;
+  }
+  child_index_put(index, child);
+}
+
+static void
+child_index_remove(cct_node_t* node, cct_node_t* child)
+{
+  cct_child_index_t* index = node->child_index;
+  if (! index) return;
+
+  uint32_t i = child_index_hash(&child->addr) & index->mask;
+  for (; index->slot[i]; i = (i + 1) & index->mask) {
+    if (index->slot[i] == child) {
+      index->slot[i] = CCT_CHILD_INDEX_DEAD;
+      return;
+    }
+  }
+}
+
+// insert_addr has created child under node
+static void
+child_index_note_insert(cct_node_t* node, cct_node_t* child)
+{
+  if (node->child_index) {
+    child_index_add(node, child);
+  }
+  else if (++node->num_inserted >= CCT_CHILD_INDEX_MIN) {
+    // children inserted so far are entered lazily, when a lookup
+    // misses in the index and finds them in the splay tree
+    node->child_index = child_index_new(4 * CCT_CHILD_INDEX_MIN);
+    if (node->child_index) {
+      child_index_put(node->child_index, child);
+    }
+    else {
+      // out of memory: back off for another CCT_CHILD_INDEX_MIN inserts
+      // rather than retrying the allocation on every insert
+      node->num_inserted = 0;
+    }
+  }
+}
+
 //
 // helper for walking functions
 // 
@@ -276,9 +460,9 @@ walk_path_l(cct_node_t* node, cct_op_t op, cct_op_arg_t arg, size_t level)
 typedef struct {
   hpcfmt_uint_t num_kind_metrics;
   FILE* fs;
+  hpcio_outbuf_t* outbuf;
   epoch_flags_t flags;
   hpcrun_fmt_cct_node_t* tmp_node;
-  cct2metrics_t* cct2metrics_map;
 } write_arg_t;
 
 //
@@ -290,20 +474,16 @@ collapse_dummy_node(cct_node_t *node, cct_op_arg_t arg, size_t level)
   if (!hpcrun_cct_is_dummy(node)) {
     return;
   }
-  
-  // get thread specific map
-  write_arg_t *write_arg = (write_arg_t *)arg;
-  cct2metrics_t **map = &(write_arg->cct2metrics_map);
 
   // merge dummy child metrics
   cct_node_t* parent = hpcrun_cct_parent(node);
-  metric_data_list_t *node_metrics = hpcrun_get_metric_data_list_specific(map, node);
+  metric_data_list_t *node_metrics = hpcrun_get_metric_data_list(node);
   if (node_metrics != NULL) {
-    metric_data_list_t *parent_metrics = hpcrun_get_metric_data_list_specific(map, parent);
+    metric_data_list_t *parent_metrics = hpcrun_get_metric_data_list(parent);
     if (parent_metrics != NULL) {
       hpcrun_merge_cct_metrics(parent_metrics, node_metrics);
     } else {
-      hpcrun_move_metric_data_list_specific(map, parent, node);
+      hpcrun_move_metric_data_list(parent, node);
     }
   }
 }
@@ -371,17 +551,21 @@ lwrite(cct_node_t* node, cct_op_arg_t arg, size_t level)
 #if 1
   // keren's code
   tmp->num_metrics = my_arg->num_kind_metrics;
-  metric_data_list_t *data_list = 
-    hpcrun_get_metric_data_list_specific(&(my_arg->cct2metrics_map), node);
+  metric_data_list_t *data_list = hpcrun_get_metric_data_list(node);
   hpcrun_metric_set_dense_copy(tmp->metrics, data_list, my_arg->num_kind_metrics);
 #else
   // code from master
   tmp->num_metrics = my_arg->num_metrics;
-  metric_set_t* ms = hpcrun_get_metric_set_specific(&(my_arg->cct2metrics_map), node);
+  metric_set_t* ms = hpcrun_get_metric_set(node);
 
   hpcrun_metric_set_dense_copy(tmp->metrics, ms, my_arg->num_metrics);
 #endif
-  hpcrun_fmt_cct_node_fwrite(tmp, flags, my_arg->fs);
+  if (my_arg->outbuf) {
+    hpcrun_fmt_cct_node_outbuf(tmp, flags, my_arg->outbuf);
+  }
+  else {
+    hpcrun_fmt_cct_node_fwrite(tmp, flags, my_arg->fs);
+  }
 }
 
 //
@@ -447,6 +631,20 @@ hpcrun_cct_addr(cct_node_t* node)
   return node ? &(node->addr) : NULL;
 }
 
+metric_data_list_t*
+hpcrun_cct_metrics(cct_node_t* node)
+{
+  return node ? node->metrics : NULL;
+}
+
+void
+hpcrun_cct_metrics_set(cct_node_t* node, metric_data_list_t* metrics)
+{
+  if (node) {
+    node->metrics = metrics;
+  }
+}
+
 bool
 hpcrun_cct_is_leaf(cct_node_t* node)
 {
@@ -511,6 +709,11 @@ hpcrun_cct_insert_addr(cct_node_t* node, cct_addr_t* frm)
   if ( ! node)
     return NULL;
 
+  if (node->child_index) {
+    cct_node_t* hit = child_index_find(node, frm);
+    if (hit) return hit;
+  }
+
   cct_node_t* found    = splay(node->children, frm);
     //
     // !! SPECIAL CASE for cct splay !!
@@ -523,25 +726,26 @@ hpcrun_cct_insert_addr(cct_node_t* node, cct_addr_t* frm)
   node->children = found;
  
   if (found && cct_addr_eq(frm, &(found->addr))){
+    child_index_add(node, found);
     return found;
   }
   //  cct_node_t* new = cct_node_create(frm->as_info, frm->ip_norm, frm->lip, node);
   cct_node_t* new = cct_node_create(frm, node);
 
   node->children = new;
-  if (! found){
-    return new;
-  }
-  if (cct_addr_lt(frm, &(found->addr))){
-    new->left = found->left;
-    new->right = found;
-    found->left = NULL;
-  }
-  else { // addr > addr of found
-    new->left = found;
-    new->right = found->right;
-    found->right = NULL;
+  if (found) {
+    if (cct_addr_lt(frm, &(found->addr))){
+      new->left = found->left;
+      new->right = found;
+      found->left = NULL;
+    }
+    else { // addr > addr of found
+      new->left = found;
+      new->right = found->right;
+      found->right = NULL;
+    }
   }
+  child_index_note_insert(node, new);
   return new;
 }
 
@@ -566,6 +770,8 @@ hpcrun_cct_delete_addr(cct_node_t* node, cct_addr_t* frm)
   if(!found || !cct_addr_eq(frm, &(found->addr))) 
     return NULL;
 
+  child_index_remove(node, found);
+
   if(node->children->left == NULL) {
     node->children = node->children->right;
     return found;
@@ -629,22 +835,21 @@ hpcrun_cct_insert_node(cct_node_t* target, cct_node_t* src)
 
   cct_node_t* found = splay(target->children, &(src->addr));
   target->children = src;
-  if (! found) {
-    return src;
-  }
-  
-  // NOTE: Assume equality cannot happen
+  if (found) {
+    // NOTE: Assume equality cannot happen
 
-  if (cct_addr_lt(&(src->addr), &(found->addr))){
-    src->left = found->left;
-    src->right = found;
-    found->left = NULL;
-  }
-  else { // addr > addr of found
-    src->left = found;
-    src->right = found->right;
-    found->right = NULL;
+    if (cct_addr_lt(&(src->addr), &(found->addr))){
+      src->left = found->left;
+      src->right = found;
+      found->left = NULL;
+    }
+    else { // addr > addr of found
+      src->left = found;
+      src->right = found->right;
+      found->right = NULL;
+    }
   }
+  child_index_add(target, src);
   return src;
 }
 
@@ -758,10 +963,16 @@ hpcrun_cct_insert_path(cct_node_t ** root, cct_node_t* path)
 //
 // Writing operation
 //
+// If 'outbuf' is non-NULL, the cct is written through it instead of
+// 'fs'; the caller must have flushed 'fs' (if any) and attached
+// 'outbuf' to the same file.  Through an outbuf, writing is
+// async-signal-safe if the outbuf's writer is.
+//
 int
-hpcrun_cct_fwrite(cct2metrics_t* cct2metrics_map, cct_node_t* cct, FILE* fs, epoch_flags_t flags)
+hpcrun_cct_fwrite(cct_node_t* cct, FILE* fs, hpcio_outbuf_t* outbuf,
+                  epoch_flags_t flags)
 {
-  if (!fs) return HPCRUN_ERR;
+  if (!fs && !outbuf) return HPCRUN_ERR;
 
   size_t nodes = 0;
   if (HPCRUN_CCT_KEEP_DUMMY) {
@@ -770,7 +981,17 @@ hpcrun_cct_fwrite(cct2metrics_t* cct2metrics_map, cct_node_t* cct, FILE* fs, epo
     nodes = hpcrun_cct_num_nodes(cct, false);
   }
 
-  hpcfmt_int8_fwrite((uint64_t) nodes, fs);
+  if (outbuf) {
+    unsigned char buf[sizeof(uint64_t)];
+    int k = 0;
+    for (int shift = 56; shift >= 0; shift -= 8) {
+      buf[k++] = ((uint64_t) nodes >> shift) & 0xff;
+    }
+    hpcio_outbuf_write(outbuf, buf, k);
+  }
+  else {
+    hpcfmt_int8_fwrite((uint64_t) nodes, fs);
+  }
   TMSG(DATA_WRITE, "num cct nodes = %d", nodes);
 
   hpcfmt_uint_t num_kind_metrics = hpcrun_get_num_kind_metrics();
@@ -781,12 +1002,9 @@ hpcrun_cct_fwrite(cct2metrics_t* cct2metrics_map, cct_node_t* cct, FILE* fs, epo
   write_arg_t write_arg = {
     .num_kind_metrics = num_kind_metrics,
     .fs          = fs,
+    .outbuf      = outbuf,
     .flags       = flags,
-    .tmp_node    = &tmp_node,
-
-    // multithreaded code: add personalized cct2metrics_map for multithreading programs
-    // this is to allow a thread to write the profile data of another thread.
-    .cct2metrics_map = cct2metrics_map
+    .tmp_node    = &tmp_node
   };
   
   hpcrun_metricVal_t metrics[num_kind_metrics];
@@ -824,6 +1042,11 @@ hpcrun_cct_find_addr(cct_node_t* cct, cct_addr_t* addr)
   if ( ! cct)
     return NULL;
 
+  if (cct->child_index) {
+    cct_node_t* hit = child_index_find(cct, addr);
+    if (hit) return hit;
+  }
+
   cct_node_t* found    = splay(cct->children, addr);
     //
     // !! SPECIAL CASE for cct splay !!
@@ -836,6 +1059,7 @@ hpcrun_cct_find_addr(cct_node_t* cct, cct_addr_t* addr)
   cct->children = found;
  
   if (found && cct_addr_eq(addr, &(found->addr))){
+    child_index_add(cct, found);
     return found;
   }
   return NULL;
@@ -871,6 +1095,9 @@ void
 hpcrun_cct_walkset_merge(cct_node_t* cct, cct_op_merge_t fn, cct_op_arg_t arg)
 {
   if(! cct->children) return;
+  // nodes disconnected below the root keep cct as their parent, so
+  // the index of cct cannot be trusted after the walk
+  child_index_reset(cct);
   // should children be disconnected
   if(! walkset_l_merge(cct->children, fn, arg, 0))
     cct->children = NULL;
@@ -919,6 +1146,8 @@ hpcrun_cct_merge(cct_node_t* cct_a, cct_node_t* cct_b,
   if (! cct_a->children){
       // FIXME: vi3 bug because cct_b->children has the same addr as cct_a
     cct_a->children = cct_b->children;
+    child_index_reset(cct_a);
+    child_index_reset(cct_b);
     // whole cct->children splay tree is used as kids of cct_a,
     // enough to disconnect children from cct_b (that's why hpcrun_cct_walkset is called)
     hpcrun_cct_walkset(cct_b, attach_to_a, (cct_op_arg_t) cct_a);
@@ -1000,6 +1229,7 @@ cct_disjoint_union_cached(cct_node_t* target, cct_node_t* src)
   if (!found) {
     target->children = src;
     src->parent = target;
+    child_index_add(target, src);
     return;
   }
 
@@ -1015,6 +1245,7 @@ cct_disjoint_union_cached(cct_node_t* target, cct_node_t* src)
   }
   target->children = src;
   src->parent = target;
+  child_index_add(target, src);
 }
 
 
@@ -1024,6 +1255,7 @@ cct_disjoint_union_cached(cct_node_t* target, cct_node_t* src)
 void
 cct_remove_my_subtree(cct_node_t* cct){
   cct->children = NULL;
+  child_index_reset(cct);
 //  printf("CHILDREN: %p\tLEFT: %p\tRIGHT: %p\n", cct->children, cct->left, cct->right);
 }
 
@@ -1097,6 +1329,7 @@ hpcrun_cct_set_children(cct_node_t* cct, cct_node_t* children)
   if(!cct)
     return;
   cct->children = children;
+  child_index_reset(cct);
 }
 
 void
@@ -86,6 +86,7 @@
 #include <hpcrun/utilities/ip-normalized.h>
 
 #include <lib/prof-lean/hpcio.h>
+#include <lib/prof-lean/hpcio-buffer.h>
 #include <lib/prof-lean/hpcfmt.h>
 #include <lib/prof-lean/hpcrun-fmt.h>
 
@@ -139,6 +140,12 @@ extern cct_node_t* hpcrun_cct_children(cct_node_t* node);
 extern int32_t hpcrun_cct_persistent_id(cct_node_t* node);
 extern cct_addr_t* hpcrun_cct_addr(cct_node_t* node);
 extern bool hpcrun_cct_is_leaf(cct_node_t* node);
+//
+// the metric data list of a node (NULL if the node has no metrics);
+// cf. cct2metrics.h for the usual interface
+//
+extern metric_data_list_t* hpcrun_cct_metrics(cct_node_t* node);
+extern void hpcrun_cct_metrics_set(cct_node_t* node, metric_data_list_t* metrics);
 extern cct_node_t* hpcrun_cct_insert_path_return_leaf(cct_node_t *root, cct_node_t *path);
 extern void hpcrun_cct_delete_self(cct_node_t *node);
 //
@@ -261,14 +268,8 @@ extern void hpcrun_cct_walkset(cct_node_t* cct, cct_op_t fn, cct_op_arg_t arg);
 //
 // Writing operation
 //
-// cct2metrics_t is defined in cct2metrics.h but we cannot include this header
-//  beceause cct2metrics.h includes this file (cct.h)
-//
-// TODO: need to declare cct2metrics_t here to avoid to cyclic inclusion
-typedef struct cct2metrics_t cct2metrics_t;
-
-int hpcrun_cct_fwrite(cct2metrics_t* cct2metrics_map,
-                      cct_node_t* cct, FILE* fs, epoch_flags_t flags);
+int hpcrun_cct_fwrite(cct_node_t* cct, FILE* fs, hpcio_outbuf_t* outbuf,
+                      epoch_flags_t flags);
 //
 // Utilities
 //
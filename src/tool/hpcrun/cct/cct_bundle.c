@@ -104,19 +104,22 @@ hpcrun_cct_bundle_init(cct_bundle_t* bundle, cct_ctxt_t* ctxt)
 // Write to file for cct bundle: 
 //
 int 
-hpcrun_cct_bundle_fwrite(FILE* fs, epoch_flags_t flags, cct_bundle_t* bndl,
-                         cct2metrics_t* cct2metrics_map)
+hpcrun_cct_bundle_fwrite(FILE* fs, hpcio_outbuf_t* outbuf,
+                         epoch_flags_t flags, cct_bundle_t* bndl)
 {
-  if (!fs) { return HPCRUN_ERR; }
+  if (!fs && !outbuf) { return HPCRUN_ERR; }
 
   cct_node_t* final = bndl->tree_root;
   cct_node_t* partial_insert = final;
 
 
   //
-  // attach partial unwinds at appointed slot
+  // attach partial unwinds at appointed slot (only once: a profile
+  // snapshot writes the same bundle again later)
   //
-  hpcrun_cct_insert_node(partial_insert, bndl->partial_unw_root);
+  if (hpcrun_cct_parent(bndl->partial_unw_root) != partial_insert) {
+    hpcrun_cct_insert_node(partial_insert, bndl->partial_unw_root);
+  }
 
   //
   // attach unresolved root
@@ -126,7 +129,7 @@ hpcrun_cct_bundle_fwrite(FILE* fs, epoch_flags_t flags, cct_bundle_t* bndl,
 
   // write out newly constructed cct
 
-  return hpcrun_cct_fwrite(cct2metrics_map, bndl->top, fs, flags);
+  return hpcrun_cct_fwrite(bndl->top, fs, outbuf, flags);
 }
 
 //
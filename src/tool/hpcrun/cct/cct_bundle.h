@@ -92,8 +92,8 @@ extern void hpcrun_cct_bundle_init(cct_bundle_t* bundle, cct_ctxt_t* ctxt);
 //
 // IO for cct bundle
 //
-extern int hpcrun_cct_bundle_fwrite(FILE* fs, epoch_flags_t flags, cct_bundle_t* x,
-                                    cct2metrics_t* cct2metrics_map);
+extern int hpcrun_cct_bundle_fwrite(FILE* fs, hpcio_outbuf_t* outbuf,
+                                    epoch_flags_t flags, cct_bundle_t* x);
 
 //
 // utility functions
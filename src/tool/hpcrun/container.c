@@ -0,0 +1,490 @@
+// -*-Mode: C++;-*- // technically C99
+
+// * BeginRiceCopyright *****************************************************
+//
+// $HeadURL$
+// $Id$
+//
+// --------------------------------------------------------------------------
+// Part of HPCToolkit (hpctoolkit.org)
+//
+// Information about sources of support for research and development of
+// HPCToolkit is at 'hpctoolkit.org' and in 'README.Acknowledgments'.
+// --------------------------------------------------------------------------
+//
+// Copyright ((c)) 2002-2020, Rice University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+//
+// * Neither the name of Rice University (RICE) nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+//
+// This software is provided by RICE and contributors "as is" and any
+// express or implied warranties, including, but not limited to, the
+// implied warranties of merchantability and fitness for a particular
+// purpose are disclaimed. In no event shall RICE or contributors be
+// liable for any direct, indirect, incidental, special, exemplary, or
+// consequential damages (including, but not limited to, procurement of
+// substitute goods or services; loss of use, data, or profits; or
+// business interruption) however caused and on any theory of liability,
+// whether in contract, strict liability, or tort (including negligence
+// or otherwise) arising in any way out of the use of this software, even
+// if advised of the possibility of such damage.
+//
+// ******************************************************* EndRiceCopyright *
+
+//***************************************************************************
+//
+// The output container of a process is opened when its first member
+// is opened and pre-sized (HPCRUN_OUTPUT_CONTAINER_SIZE bytes) so the
+// file system can allocate it in large extents.  Each flush of a
+// member's buffer becomes one segment: the writer reserves space for
+// it with an atomic fetch-and-add on the end of the container and
+// fills it with pwrite().  Threads never share a lock or a file
+// offset, and writing a segment is safe inside signal handlers.
+//
+// A member's name is written when it is closed; at process exit, the
+// index of all segments and the trailer are appended, the container
+// is truncated to its final size and renamed to the process's rank.
+//
+//***************************************************************************
+
+//***************************************************************
+// global includes 
+//***************************************************************
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/types.h>
+
+
+//***************************************************************
+// local includes 
+//***************************************************************
+
+#include "container.h"
+#include "env.h"
+#include "files.h"
+#include "rank.h"
+#include "sample_prob.h"
+
+#include <memory/hpcrun-malloc.h>
+#include <memory/mmap.h>
+#include <messages/messages.h>
+
+#include <lib/prof-lean/hpcio.h>
+#include <lib/prof-lean/hpcrun-fmt.h>
+#include <lib/prof-lean/spinlock.h>
+#include <lib/prof-lean/stdatomic.h>
+
+
+//***************************************************************
+// macros
+//***************************************************************
+
+// The index grows in chunks of CONTAINER_IDX_CHUNK_LEN entries,
+// mapped when a segment first lands in them, up to CONTAINER_IDX_MAX
+// entries (64M segments).  A process writing more segments than that
+// gets no index (readers then scan the container).
+#define CONTAINER_IDX_CHUNK_LEN  8192
+#define CONTAINER_IDX_NUM_CHUNKS 8192
+#define CONTAINER_IDX_MAX \
+  ((uint64_t) CONTAINER_IDX_CHUNK_LEN * CONTAINER_IDX_NUM_CHUNKS)
+
+#define CONTAINER_SIZE_DEFAULT  (16 * HPCIO_RWBufferSz)
+
+// index entries encoded per pwrite()
+#define CONTAINER_IDX_CHUNK  64
+
+
+struct hpcrun_container_member_s {
+  uint32_t id;
+  int  thread;
+  const char *suffix;
+  int  rank;  // for hpcrun_container_member_fopen()
+};
+
+
+//***************************************************************
+// local data 
+//***************************************************************
+
+static int container_enabled = 0;
+
+// The lock protects opening and closing the container, and the pid
+// (the container is reopened after fork).
+static spinlock_t container_lock = SPINLOCK_UNLOCKED;
+static pid_t container_pid = 0;
+static int container_fd = -1;
+
+static atomic_uint_least64_t container_end = ATOMIC_VAR_INIT(0);
+static atomic_uint_least32_t container_num_members = ATOMIC_VAR_INIT(0);
+
+static _Atomic(hpccontainer_fmt_seg_t *)
+  container_idx[CONTAINER_IDX_NUM_CHUNKS];
+static atomic_uint_least32_t container_idx_len = ATOMIC_VAR_INIT(0);
+static atomic_int container_idx_lost = ATOMIC_VAR_INIT(0);
+
+
+//***************************************************************
+// private operations
+//***************************************************************
+
+// Returns: 0 on success, else -1.
+static int
+container_pwrite(const void *data, size_t size, uint64_t offset)
+{
+  const char *buf = (const char *) data;
+  size_t amt_done = 0;
+
+  while (amt_done < size) {
+    ssize_t ret = pwrite(container_fd, buf + amt_done, size - amt_done,
+			 offset + amt_done);
+    if (ret > 0) {
+      amt_done += ret;
+    }
+    else if (ret < 0 && errno == EINTR) {
+      continue;
+    }
+    else {
+      return -1;
+    }
+  }
+  return 0;
+}
+
+
+// Returns: index entry 'slot', mapping its chunk if needed, or NULL
+// if the index is full or out of memory.
+static hpccontainer_fmt_seg_t *
+container_idx_entry(uint32_t slot)
+{
+  if (slot >= CONTAINER_IDX_MAX) {
+    return NULL;
+  }
+
+  uint32_t c = slot / CONTAINER_IDX_CHUNK_LEN;
+  size_t chunk_sz = CONTAINER_IDX_CHUNK_LEN * sizeof(hpccontainer_fmt_seg_t);
+  hpccontainer_fmt_seg_t *chunk =
+    atomic_load_explicit(&container_idx[c], memory_order_acquire);
+
+  if (chunk == NULL) {
+    hpccontainer_fmt_seg_t *new_chunk = hpcrun_mmap_anon(chunk_sz);
+    if (new_chunk == NULL) {
+      return NULL;
+    }
+    // another thread may have mapped the chunk meanwhile
+    if (atomic_compare_exchange_strong_explicit(&container_idx[c], &chunk,
+						new_chunk,
+						memory_order_acq_rel,
+						memory_order_acquire)) {
+      chunk = new_chunk;
+    }
+    else {
+      munmap(new_chunk, chunk_sz);
+    }
+  }
+  return &chunk[slot % CONTAINER_IDX_CHUNK_LEN];
+}
+
+
+// Reserve space for a segment, write it and note it in the index.
+// The payload is written before the segment header: until then, a
+// reader scanning the container sees unwritten space.
+//
+// Returns: 0 on success, else -1.
+static int
+container_segment_write(uint32_t kind, uint32_t member_id,
+			const void *data, size_t size)
+{
+  hpccontainer_fmt_seg_t seg;
+  unsigned char hdr[HPCCONTAINER_FMT_SegHdrLen];
+
+  seg.kind = kind;
+  seg.memberId = member_id;
+  seg.len = size;
+  seg.offset = atomic_fetch_add_explicit(&container_end,
+					 HPCCONTAINER_FMT_SegHdrLen + size,
+					 memory_order_relaxed);
+
+  hpccontainer_fmt_seg_hdr_encode(&seg, hdr);
+  if (container_pwrite(data, size, seg.offset + HPCCONTAINER_FMT_SegHdrLen) != 0
+      || container_pwrite(hdr, sizeof(hdr), seg.offset) != 0) {
+    return -1;
+  }
+
+  uint32_t slot = atomic_fetch_add_explicit(&container_idx_len, 1,
+					    memory_order_relaxed);
+  hpccontainer_fmt_seg_t *entry = container_idx_entry(slot);
+  if (entry != NULL) {
+    *entry = seg;
+  }
+  else {
+    atomic_store_explicit(&container_idx_lost, 1, memory_order_relaxed);
+  }
+  return 0;
+}
+
+
+// Open the container for this process, if not already open.  Must
+// hold the container lock.
+//
+// Returns: 0 on success, else -1.
+static int
+container_open(void)
+{
+  pid_t pid = getpid();
+  if (container_pid == pid) {
+    return (container_fd >= 0) ? 0 : -1;
+  }
+
+  // after fork, the child writes its own container
+  if (container_fd >= 0) {
+    close(container_fd);
+  }
+  container_pid = pid;
+  container_fd = hpcrun_open_container_file();
+
+  atomic_store_explicit(&container_end, HPCCONTAINER_FMT_HeaderLen,
+			memory_order_relaxed);
+  atomic_store_explicit(&container_num_members, 0, memory_order_relaxed);
+  atomic_store_explicit(&container_idx_len, 0, memory_order_relaxed);
+  atomic_store_explicit(&container_idx_lost, 0, memory_order_relaxed);
+
+  // pre-size; not every file system supports this, which is harmless
+  char *str = getenv(HPCRUN_OUTPUT_CONTAINER_SIZE);
+  off_t size = (str) ? strtoll(str, NULL, 10) : CONTAINER_SIZE_DEFAULT;
+  if (size > 0) {
+    posix_fallocate(container_fd, 0, size);
+  }
+
+  unsigned char hdr[HPCCONTAINER_FMT_HeaderLen];
+  hpccontainer_fmt_hdr_encode(hdr);
+  if (container_pwrite(hdr, sizeof(hdr), 0) != 0) {
+    EMSG("unable to write output container header: %s", strerror(errno));
+    close(container_fd);
+    container_fd = -1;
+    return -1;
+  }
+
+  return 0;
+}
+
+
+// Append the index and trailer.
+//
+// Returns: the end of the container.
+static uint64_t
+container_index_write(void)
+{
+  uint32_t num_segs = atomic_load_explicit(&container_idx_len,
+					   memory_order_relaxed);
+  uint64_t end = atomic_load_explicit(&container_end, memory_order_relaxed);
+
+  if (atomic_load_explicit(&container_idx_lost, memory_order_relaxed)) {
+    EMSG("output container has %u segments: no index written", num_segs);
+    return end;
+  }
+
+  hpccontainer_fmt_seg_t idx;
+  idx.kind = HPCCONTAINER_FMT_SegIndex;
+  idx.memberId = 0;
+  idx.len = (uint64_t) num_segs * HPCCONTAINER_FMT_IdxEntryLen;
+  idx.offset = atomic_fetch_add_explicit(&container_end,
+					 HPCCONTAINER_FMT_SegHdrLen + idx.len
+					 + HPCCONTAINER_FMT_TrailerLen,
+					 memory_order_relaxed);
+
+  unsigned char buf[CONTAINER_IDX_CHUNK * HPCCONTAINER_FMT_IdxEntryLen];
+  uint64_t off = idx.offset;
+
+  hpccontainer_fmt_seg_hdr_encode(&idx, buf);
+  if (container_pwrite(buf, HPCCONTAINER_FMT_SegHdrLen, off) != 0) {
+    goto error;
+  }
+  off += HPCCONTAINER_FMT_SegHdrLen;
+
+  for (uint32_t i = 0; i < num_segs; i += CONTAINER_IDX_CHUNK) {
+    uint32_t n = num_segs - i;
+    if (n > CONTAINER_IDX_CHUNK) {
+      n = CONTAINER_IDX_CHUNK;
+    }
+    for (uint32_t k = 0; k < n; k++) {
+      hpccontainer_fmt_idx_entry_encode(container_idx_entry(i + k),
+					buf + k * HPCCONTAINER_FMT_IdxEntryLen);
+    }
+    if (container_pwrite(buf, n * HPCCONTAINER_FMT_IdxEntryLen, off) != 0) {
+      goto error;
+    }
+    off += n * HPCCONTAINER_FMT_IdxEntryLen;
+  }
+
+  hpccontainer_fmt_trailer_encode(idx.offset, buf);
+  if (container_pwrite(buf, HPCCONTAINER_FMT_TrailerLen, off) != 0) {
+    goto error;
+  }
+  return off + HPCCONTAINER_FMT_TrailerLen;
+
+error:
+  EMSG("unable to write output container index: %s", strerror(errno));
+  return idx.offset;
+}
+
+
+static ssize_t
+container_stream_write(void *cookie, const char *buf, size_t size)
+{
+  return hpcrun_container_member_write(cookie, buf, size);
+}
+
+
+static int
+container_stream_close(void *cookie)
+{
+  hpcrun_container_member_t *member = (hpcrun_container_member_t *) cookie;
+  return (hpcrun_container_member_close(member, member->rank) == 0) ? 0 : EOF;
+}
+
+
+//***************************************************************
+// interface operations
+//***************************************************************
+
+void
+hpcrun_container_init(void)
+{
+  container_enabled = (getenv(HPCRUN_OUTPUT_CONTAINER) != NULL);
+}
+
+
+// With fractional sampling, an inactive process writes its (empty)
+// files to /dev/null as usual.
+int
+hpcrun_container_isactive(void)
+{
+  return container_enabled && hpcrun_sample_prob_active();
+}
+
+
+// Returns: a new member of this process's container, or NULL if the
+// container is not available (the caller should write a separate
+// file instead).
+hpcrun_container_member_t *
+hpcrun_container_member_open(int thread, const char *suffix)
+{
+  spinlock_lock(&container_lock);
+  int ret = container_open();
+  spinlock_unlock(&container_lock);
+
+  if (ret != 0) {
+    return NULL;
+  }
+
+  hpcrun_container_member_t *member = hpcrun_malloc(sizeof(*member));
+  if (member == NULL) {
+    return NULL;
+  }
+  member->id = atomic_fetch_add_explicit(&container_num_members, 1,
+					 memory_order_relaxed);
+  member->thread = thread;
+  member->suffix = suffix;
+  member->rank = 0;
+
+  return member;
+}
+
+
+// Each call writes one segment, so 'member' is best written through
+// an outbuf or a buffered stream.
+//
+// Returns: 'size' on success, else -1.
+ssize_t
+hpcrun_container_member_write(void *member, const void *data, size_t size)
+{
+  hpcrun_container_member_t *m = (hpcrun_container_member_t *) member;
+
+  if (size == 0) {
+    return 0;
+  }
+  if (container_segment_write(HPCCONTAINER_FMT_SegData, m->id, data, size) != 0) {
+    return -1;
+  }
+  return size;
+}
+
+
+// Name the member after the (rank, thread) file it replaces.  Its data
+// must be flushed first.
+//
+// Returns: 0 on success, else -1.
+int
+hpcrun_container_member_close(hpcrun_container_member_t *member, int rank)
+{
+  char name[PATH_MAX];
+
+  if (rank < 0) {
+    rank = 0;
+  }
+  if (hpcrun_files_member_name(name, PATH_MAX, rank, member->thread,
+			       member->suffix) != 0) {
+    return -1;
+  }
+  return container_segment_write(HPCCONTAINER_FMT_SegName, member->id,
+				 name, strlen(name));
+}
+
+
+// Returns: a buffered stream writing to 'member'.  Closing the stream
+// closes the member with 'rank'.
+FILE *
+hpcrun_container_member_fopen(hpcrun_container_member_t *member, int rank)
+{
+  cookie_io_functions_t fns = {
+    NULL, container_stream_write, NULL, container_stream_close
+  };
+
+  member->rank = rank;
+  return fopencookie(member, "w", fns);
+}
+
+
+// Write the index, trim the pre-sized container and rename it to the
+// process's rank.  All members must be closed.
+void
+hpcrun_container_fini(void)
+{
+  spinlock_lock(&container_lock);
+
+  if (container_fd >= 0 && container_pid == getpid()) {
+    uint64_t end = container_index_write();
+    if (ftruncate(container_fd, end) != 0) {
+      EMSG("unable to truncate output container: %s", strerror(errno));
+    }
+    close(container_fd);
+    container_fd = -1;
+
+    int rank = hpcrun_get_rank();
+    if (rank >= 0) {
+      hpcrun_rename_container_file(rank);
+    }
+  }
+
+  spinlock_unlock(&container_lock);
+}
@@ -0,0 +1,83 @@
+// -*-Mode: C++;-*- // technically C99
+
+// * BeginRiceCopyright *****************************************************
+//
+// $HeadURL$
+// $Id$
+//
+// --------------------------------------------------------------------------
+// Part of HPCToolkit (hpctoolkit.org)
+//
+// Information about sources of support for research and development of
+// HPCToolkit is at 'hpctoolkit.org' and in 'README.Acknowledgments'.
+// --------------------------------------------------------------------------
+//
+// Copyright ((c)) 2002-2020, Rice University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+//
+// * Neither the name of Rice University (RICE) nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+//
+// This software is provided by RICE and contributors "as is" and any
+// express or implied warranties, including, but not limited to, the
+// implied warranties of merchantability and fitness for a particular
+// purpose are disclaimed. In no event shall RICE or contributors be
+// liable for any direct, indirect, incidental, special, exemplary, or
+// consequential damages (including, but not limited to, procurement of
+// substitute goods or services; loss of use, data, or profits; or
+// business interruption) however caused and on any theory of liability,
+// whether in contract, strict liability, or tort (including negligence
+// or otherwise) arising in any way out of the use of this software, even
+// if advised of the possibility of such damage.
+//
+// ******************************************************* EndRiceCopyright *
+
+//***************************************************************************
+//
+// Output container: with HPCRUN_OUTPUT_CONTAINER set, the profiles and
+// traces of all threads of a process are written as members of one
+// file, progname-rank-000-hostid-pid-gen.hpccontainer, instead of two
+// files per thread (see hpccontainer_fmt_* in hpcrun-fmt.h).
+//
+//***************************************************************************
+
+#ifndef hpcrun_container_h
+#define hpcrun_container_h
+
+#include <stdio.h>
+#include <sys/types.h>
+
+// opaque type
+
+typedef struct hpcrun_container_member_s hpcrun_container_member_t;
+
+void hpcrun_container_init(void);
+int  hpcrun_container_isactive(void);
+void hpcrun_container_fini(void);
+
+hpcrun_container_member_t *
+hpcrun_container_member_open(int thread, const char *suffix);
+
+// an hpcio_outbuf_writer_t for 'member'
+ssize_t
+hpcrun_container_member_write(void *member, const void *data, size_t size);
+
+int
+hpcrun_container_member_close(hpcrun_container_member_t *member, int rank);
+
+FILE *
+hpcrun_container_member_fopen(hpcrun_container_member_t *member, int rank);
+
+#endif // hpcrun_container_h
@@ -1,6 +1,7 @@
 #ifndef CORE_PROFILE_TRACE_DATA_H
 #define CORE_PROFILE_TRACE_DATA_H
 
+#include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <lib/prof-lean/hpcio-buffer.h>
@@ -19,10 +20,6 @@ typedef struct core_profile_trace_data_t {
   // ----------------------------------------
   epoch_t* epoch;
 
-  //metrics: this is needed otherwise 
-  //hpcprof does not pick them up
-  cct2metrics_t* cct2metrics_map;
-
   // for metric scale (openmp uses)
   void (*scale_fn)(void*);
   // ----------------------------------------
@@ -35,8 +32,16 @@ typedef struct core_profile_trace_data_t {
   // IO support
   // ----------------------------------------
   FILE* hpcrun_file;
+  void* profile_buffer;
   void* trace_buffer;
   hpcio_outbuf_t *trace_outbuf;
+  struct hpctrace_fmt_blk_t *trace_blk; // compact traces: block being written
+  struct hpcrun_container_member_s *profile_member; // if writing to a container
+  struct hpcrun_container_member_s *trace_member;
+  int profile_rank;      // rank in the name of hpcrun_file
+  bool profile_flushed;  // hpcrun_file is <profile>.flushed.hpcrun
+  uint32_t snapshot_seq; // last profile snapshot taken (cf. snapshot.h)
+  struct snapshot_job_t *snapshot_job; // for the snapshot writer thread
 
   // ----------------------------------------
   // Perf support
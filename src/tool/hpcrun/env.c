@@ -48,7 +48,17 @@
 const char* HPCRUN_OPT_LUSH_AGENTS = "HPCRUN_OPT_LUSH_AGENTS";
 
 const char* HPCRUN_OUT_PATH        = "HPCRUN_OUT_PATH";
+const char* HPCRUN_OUTPUT_CONTAINER      = "HPCRUN_OUTPUT_CONTAINER";
+const char* HPCRUN_OUTPUT_CONTAINER_SIZE = "HPCRUN_OUTPUT_CONTAINER_SIZE";
 const char* HPCRUN_TRACE           = "HPCRUN_TRACE";
+const char* HPCRUN_TRACE_COMPACT   = "HPCRUN_TRACE_COMPACT";
+const char* HPCRUN_TRACE_ASYNC_BUFFERS = "HPCRUN_TRACE_ASYNC_BUFFERS";
+
+const char* HPCRUN_SNAPSHOT_SIGNAL   = "HPCRUN_SNAPSHOT_SIGNAL";
+const char* HPCRUN_SNAPSHOT_INTERVAL = "HPCRUN_SNAPSHOT_INTERVAL";
+const char* HPCRUN_SNAPSHOT_DELTA    = "HPCRUN_SNAPSHOT_DELTA";
+
+const char* HPCRUN_OVERHEAD_BUDGET   = "HPCRUN_OVERHEAD_BUDGET";
 
 const char* PAPI_EVENT_LIST        = "PAPI_EVENT_LIST";
 
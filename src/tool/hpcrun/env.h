@@ -82,8 +82,18 @@
 extern const char* HPCRUN_OPT_LUSH_AGENTS;
 
 extern const char* HPCRUN_OUT_PATH;
+extern const char* HPCRUN_OUTPUT_CONTAINER;
+extern const char* HPCRUN_OUTPUT_CONTAINER_SIZE;
 
 extern const char* HPCRUN_TRACE;
+extern const char* HPCRUN_TRACE_COMPACT;
+extern const char* HPCRUN_TRACE_ASYNC_BUFFERS;
+
+extern const char* HPCRUN_SNAPSHOT_SIGNAL;
+extern const char* HPCRUN_SNAPSHOT_INTERVAL;
+extern const char* HPCRUN_SNAPSHOT_DELTA;
+
+extern const char* HPCRUN_OVERHEAD_BUDGET;
 
 extern const char* HPCRUN_EVENT_LIST;
 extern const char* HPCRUN_MEMSIZE;
@@ -138,8 +138,11 @@
 // macros
 //***************************************************************
 
+// progname-rank-thread-hostid-pid-gen.suffix
+#define BASENAME_TEMPLATE  "%s-%06u-%03d-" HOSTID_FORMAT "-%u-%d.%s"
+
 // directory/progname-rank-thread-hostid-pid-gen.suffix
-#define FILENAME_TEMPLATE  "%s/%s-%06u-%03d-" HOSTID_FORMAT "-%u-%d.%s"
+#define FILENAME_TEMPLATE  "%s/" BASENAME_TEMPLATE
 
 #define FILES_RANDOM_GEN  4
 #define FILES_MAX_GEN     11
@@ -484,6 +487,94 @@ hpcrun_open_profile_file(int rank, int thread)
 }
 
 
+// Open a snapshot of the profile file: same name, but ending in
+// 'suffix' (eg, "snap000003.hpcrun") instead of "hpcrun".
+int
+hpcrun_open_profile_snapshot_file(int rank, int thread, const char *suffix)
+{
+  int ret;
+
+  spinlock_lock(&files_lock);
+  hpcrun_files_init();
+  hpcrun_rename_log_file_early(rank);
+  ret = hpcrun_open_file(rank, thread, suffix, FILES_LATE);
+  spinlock_unlock(&files_lock);
+
+  return ret;
+}
+
+
+// Give a file opened with hpcrun_open_profile_snapshot_file() and
+// 'suffix' the name of the profile file (ending in "hpcrun").  As in
+// hpcrun_rename_file(), link(2) fails if the profile file exists.
+//
+// Returns: 0 on success, else -1 on failure.
+int
+hpcrun_rename_profile_snapshot_file(int rank, int thread, const char *suffix)
+{
+  char old_name[PATH_MAX], new_name[PATH_MAX];
+  int ret = -1;
+
+  if (! hpcrun_sample_prob_active()) {
+    return 0;
+  }
+
+  spinlock_lock(&files_lock);
+  errno = ENAMETOOLONG;
+  if (snprintf(old_name, PATH_MAX, FILENAME_TEMPLATE, output_directory,
+	       executable_name, rank, thread, lateid.host, mypid, lateid.gen,
+	       suffix) < PATH_MAX
+      && snprintf(new_name, PATH_MAX, FILENAME_TEMPLATE, output_directory,
+		  executable_name, rank, thread, lateid.host, mypid, lateid.gen,
+		  HPCRUN_ProfileFnmSfx) < PATH_MAX) {
+    ret = link(old_name, new_name);
+    if (ret == 0) {
+      unlink(old_name);
+    }
+  }
+  spinlock_unlock(&files_lock);
+
+  if (ret < 0) {
+    EMSG("hpctoolkit: unable to rename %s file: '%s': %s",
+	 suffix, old_name, strerror(errno));
+  }
+
+  return ret;
+}
+
+
+// Remove a file opened with hpcrun_open_profile_snapshot_file() and
+// 'suffix'.
+//
+// Returns: 0 on success, else -1 on failure.
+int
+hpcrun_unlink_profile_snapshot_file(int rank, int thread, const char *suffix)
+{
+  char name[PATH_MAX];
+  int ret = -1;
+
+  if (! hpcrun_sample_prob_active()) {
+    return 0;
+  }
+
+  spinlock_lock(&files_lock);
+  errno = ENAMETOOLONG;
+  if (snprintf(name, PATH_MAX, FILENAME_TEMPLATE, output_directory,
+	       executable_name, rank, thread, lateid.host, mypid, lateid.gen,
+	       suffix) < PATH_MAX) {
+    ret = unlink(name);
+  }
+  spinlock_unlock(&files_lock);
+
+  if (ret < 0) {
+    EMSG("hpctoolkit: unable to remove %s file: '%s': %s",
+	 suffix, name, strerror(errno));
+  }
+
+  return ret;
+}
+
+
 // Note: we use the log file as the lock for the file names, so we
 // need to rename the log file as the first late action.  Since this
 // is out of sequence, we save the return value and return it when the
@@ -531,6 +622,60 @@ hpcrun_rename_trace_file(int rank, int thread)
 }
 
 
+// Returns: file descriptor for the output container (all profiles and
+// traces of this process).  Like the trace files, the container is
+// opened early and renamed late.
+int
+hpcrun_open_container_file(void)
+{
+  int ret;
+
+  spinlock_lock(&files_lock);
+  hpcrun_files_init();
+  ret = hpcrun_open_file(0, 0, HPCRUN_ContainerFnmSfx, FILES_EARLY);
+  spinlock_unlock(&files_lock);
+
+  return ret;
+}
+
+
+// Returns: 0 on success, else -1 on failure.
+int
+hpcrun_rename_container_file(int rank)
+{
+  int ret;
+
+  spinlock_lock(&files_lock);
+  hpcrun_rename_log_file_early(rank);
+  ret = hpcrun_rename_file(rank, 0, HPCRUN_ContainerFnmSfx);
+  spinlock_unlock(&files_lock);
+
+  return ret;
+}
+
+
+// Write into 'name' the base name that the (rank, thread) file with
+// 'suffix' would have if it were not written to the output container,
+// using the late id.
+//
+// Returns: 0 on success, else -1 if the name does not fit.
+int
+hpcrun_files_member_name(char *name, size_t len, int rank, int thread,
+			 const char *suffix)
+{
+  int ret;
+
+  spinlock_lock(&files_lock);
+  hpcrun_files_init();
+  hpcrun_rename_log_file_early(rank);
+  ret = snprintf(name, len, BASENAME_TEMPLATE, executable_name, rank, thread,
+		 lateid.host, mypid, lateid.gen, suffix);
+  spinlock_unlock(&files_lock);
+
+  return (ret >= 0 && ret < len) ? 0 : -1;
+}
+
+
 // Record the contents of a [vdso] file, if one exists. Die on failure.
 void
 hpcrun_save_vdso()
@@ -47,6 +47,8 @@
 #ifndef files_h
 #define files_h
 
+#include <stddef.h>
+
 
 //*****************************************************************************
 // forward declarations
@@ -63,9 +65,17 @@ const char *hpcrun_files_output_directory();
 int hpcrun_open_log_file(void);
 int hpcrun_open_trace_file(int thread);
 int hpcrun_open_profile_file(int rank, int thread);
+int hpcrun_open_profile_snapshot_file(int rank, int thread, const char *suffix);
+int hpcrun_rename_profile_snapshot_file(int rank, int thread, const char *suffix);
+int hpcrun_unlink_profile_snapshot_file(int rank, int thread, const char *suffix);
 int hpcrun_rename_log_file(int rank);
 int hpcrun_rename_trace_file(int rank, int thread);
 
+int hpcrun_open_container_file(void);
+int hpcrun_rename_container_file(int rank);
+int hpcrun_files_member_name(char *name, size_t len, int rank, int thread,
+			     const char *suffix);
+
 // storing the hash of the vdso for the current process
 extern char vdso_hash_str[];
 void hpcrun_save_vdso();
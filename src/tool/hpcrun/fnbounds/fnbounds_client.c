@@ -75,6 +75,14 @@
 // 6. The bottom of this file has code for an interactive, stand-alone
 // client for testing hpcfnbounds in server mode.
 //
+// 7. If HPCRUN_FNBOUNDS_CACHE names a directory, then answers from
+// the server are saved there, keyed by the file's ELF build-id (or a
+// hash of its contents), its size and the hpcfnbounds that made the
+// entry.  Later queries for the same binary mmap the saved table
+// instead of asking the server.  New entries are written to a private
+// temp file and renamed into place, so any number of processes may
+// share one cache directory.
+//
 // Todo:
 //
 
@@ -124,6 +132,8 @@ char	*outfile;
 #include <err.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <limits.h>
+#include <link.h>
 #include <sched.h>
 #include <signal.h>
 #include <stdbool.h>
@@ -141,6 +151,8 @@ char	*outfile;
 #include "messages.h"
 #include "sample_sources_all.h"
 #include "monitor.h"
+#include <include/hpctoolkit-config.h>
+#include <lib/prof-lean/crypto-hash.h>
 #else
 #include "syserv-mesg.h"
 #include "fnbounds_file_header.h"
@@ -176,8 +188,15 @@ static long mem_limit = SERVER_MEM_LIMIT * 1024;
 static int  num_queries = 0;
 static int  mem_warning = 0;
 
+static char *cache_dir = NULL;
+static char cache_server_tag[20];
+
 extern char **environ;
 
+#if !defined(STAND_ALONE_CLIENT)
+static bool fnb_cache_server_tag(const char *server_cmd);
+#endif
+
 
 //*****************************************************************
 // I/O helper functions
@@ -517,6 +536,24 @@ hpcrun_syserv_init(void)
   }
   mem_limit = size * 1024;
 
+  // optional directory for the persistent fnbounds cache
+  cache_dir = getenv("HPCRUN_FNBOUNDS_CACHE");
+  if (cache_dir != NULL && cache_dir[0] == 0) {
+    cache_dir = NULL;
+  }
+  if (cache_dir != NULL && mkdir(cache_dir, 0755) != 0 && errno != EEXIST) {
+    EMSG("SYSTEM_SERVER: unable to create fnbounds cache: %s", cache_dir);
+    cache_dir = NULL;
+  }
+#if !defined(STAND_ALONE_CLIENT)
+  if (cache_dir != NULL && !fnb_cache_server_tag(server)) {
+    EMSG("SYSTEM_SERVER: unable to identify hpcfnbounds for the cache");
+    cache_dir = NULL;
+  }
+#endif
+  TMSG(SYSTEM_SERVER, "fnbounds cache: %s, server tag: %s",
+       (cache_dir != NULL) ? cache_dir : "(none)", cache_server_tag);
+
   // Allocate enough space for fnbounds summoning.
   // Twice as much to allow for growth in either direction.
   server_stack = mmap_anon(SERVER_STACK_SIZE * 1024 * 2);
@@ -566,24 +603,396 @@ hpcrun_syserv_fini(void)
 }
 
 
+//*****************************************************************
+// Persistent fnbounds Cache
+//*****************************************************************
+
+#if !defined(STAND_ALONE_CLIENT)
+
+#define FNB_CACHE_MAGIC    0x464e4243   // "FNBC"
+#define FNB_CACHE_VERSION  2
+
+// The address array starts at a fixed offset that is a multiple of
+// any page size we run on, so it can be mmap'd directly.
+#define FNB_CACHE_DATA_OFFSET  (64 * 1024)
+
+#define BUILD_ID_MAX   64
+#define NOTE_BUF_SIZE  2048
+#define SERVER_TAG_LEN 16
+
+#define ELFCLASS_NATIVE  \
+  ((__ELF_NATIVE_CLASS == 64) ? ELFCLASS64 : ELFCLASS32)
+
+struct fnb_cache_hdr {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t ptr_size;
+  int32_t  is_relocatable;
+  uint64_t num_entries;
+  uint64_t reference_offset;
+};
+
+static size_t
+note_align(size_t len)
+{
+  return (len + 3) & ~((size_t) 3);
+}
+
+// Read the GNU build-id note from the program headers of the ELF
+// file open on fd.  This is done with pread() into stack buffers
+// because we may be inside dlopen.
+//
+// Returns: length of the build-id in 'id', or 0 if none.
+//
+static size_t
+elf_build_id(int fd, unsigned char *id, size_t id_size)
+{
+  ElfW(Ehdr) ehdr;
+
+  if (pread(fd, &ehdr, sizeof(ehdr), 0) != sizeof(ehdr)
+      || memcmp(ehdr.e_ident, ELFMAG, SELFMAG) != 0
+      || ehdr.e_ident[EI_CLASS] != ELFCLASS_NATIVE
+      || ehdr.e_phentsize != sizeof(ElfW(Phdr))) {
+    return 0;
+  }
+
+  for (int i = 0; i < ehdr.e_phnum; i++) {
+    ElfW(Phdr) phdr;
+    off_t off = ehdr.e_phoff + i * sizeof(phdr);
+
+    if (pread(fd, &phdr, sizeof(phdr), off) != sizeof(phdr)) {
+      return 0;
+    }
+    if (phdr.p_type != PT_NOTE || phdr.p_filesz > NOTE_BUF_SIZE) {
+      continue;
+    }
+
+    ElfW(Nhdr) note_buf[NOTE_BUF_SIZE / sizeof(ElfW(Nhdr))];
+    char *buf = (char *) note_buf;
+    size_t size = phdr.p_filesz;
+
+    if (pread(fd, buf, size, phdr.p_offset) != (ssize_t) size) {
+      continue;
+    }
+
+    size_t pos = 0;
+    while (pos + sizeof(ElfW(Nhdr)) <= size) {
+      ElfW(Nhdr) *note = (ElfW(Nhdr) *) (buf + pos);
+      size_t name_pos = pos + sizeof(ElfW(Nhdr));
+      size_t desc_pos = name_pos + note_align(note->n_namesz);
+      size_t next_pos = desc_pos + note_align(note->n_descsz);
+
+      if (next_pos > size) {
+	break;
+      }
+      if (note->n_type == NT_GNU_BUILD_ID
+	  && note->n_namesz == 4 && memcmp(buf + name_pos, "GNU", 4) == 0
+	  && note->n_descsz > 0 && note->n_descsz <= id_size) {
+	memcpy(id, buf + desc_pos, note->n_descsz);
+	return note->n_descsz;
+      }
+      pos = next_pos;
+    }
+  }
+
+  return 0;
+}
+
+// Cache entry names.  A binary with a build-id is named by the
+// build-id and its size, since stripped and unstripped copies of a
+// binary share the build-id but not their symbols.  Other binaries
+// are named by a hash of their contents, which costs a full read of
+// the file.  So, the entry for such a binary is reached through a
+// symlink named by the file's (dev, inode, size, mtime), and the hash
+// is only computed when the symlink is missing.  All names end with
+// the server tag, so entries made by another hpcfnbounds are not
+// used.
+//
+// path  = name of the entry for the contents
+// alias = name of the symlink for the file, or "" for build-ids
+//
+struct fnb_cache_names {
+  char path[PATH_MAX];
+  char alias[PATH_MAX];
+};
+
+static void
+hex_string(const unsigned char *id, size_t len, char *str)
+{
+  static const char hex[] = "0123456789abcdef";
+
+  for (size_t i = 0; i < len; i++) {
+    str[2*i] = hex[id[i] >> 4];
+    str[2*i + 1] = hex[id[i] & 0xf];
+  }
+  str[2*len] = 0;
+}
+
+// Compute the tag for the hpcfnbounds server: a hash of the cache
+// format version, the hpctoolkit version and the identity of the
+// server script and of the hpcfnbounds-bin next to it.
+//
+// Returns: true on success.
+//
+static bool
+fnb_cache_server_tag(const char *server_cmd)
+{
+  char buf[3 * PATH_MAX];
+  char bin_path[PATH_MAX];
+  unsigned char id[BUILD_ID_MAX];
+  struct stat st;
+
+  int len = snprintf(buf, sizeof(buf), "%d %s", FNB_CACHE_VERSION,
+		     HPCTOOLKIT_VERSION_STRING);
+
+  const char *slash = strrchr(server_cmd, '/');
+  int dir_len = (slash != NULL) ? (int) (slash - server_cmd + 1) : 0;
+  snprintf(bin_path, sizeof(bin_path), "%.*shpcfnbounds-bin",
+	   dir_len, server_cmd);
+
+  const char *files[2] = { server_cmd, bin_path };
+  for (int i = 0; i < 2; i++) {
+    if (stat(files[i], &st) == 0 && len < sizeof(buf)) {
+      len += snprintf(buf + len, sizeof(buf) - len, " %s %lld %lld.%09ld",
+		      files[i], (long long) st.st_size,
+		      (long long) st.st_mtim.tv_sec, (long) st.st_mtim.tv_nsec);
+    }
+  }
+  if (len >= sizeof(buf) || crypto_hash_length() > sizeof(id)
+      || crypto_hash_compute((unsigned char *) buf, len, id, sizeof(id)) != 0) {
+    return false;
+  }
+
+  char hex[2 * BUILD_ID_MAX + 1];
+  hex_string(id, crypto_hash_length(), hex);
+  snprintf(cache_server_tag, sizeof(cache_server_tag), "%.*s",
+	   SERVER_TAG_LEN, hex);
+
+  return true;
+}
+
+// Hash the contents of the file fname, for binaries without a
+// build-id, and fill in the entry name.
+//
+// Returns: true on success.
+//
+static bool
+fnb_cache_hash_path(const char *fname, struct fnb_cache_names *names)
+{
+  unsigned char id[BUILD_ID_MAX];
+  char key[2 * BUILD_ID_MAX + 1];
+  struct stat st;
+  size_t len = crypto_hash_length();
+
+  int fd = open(fname, O_RDONLY);
+  if (fd < 0) {
+    return false;
+  }
+  if (len > sizeof(id) || fstat(fd, &st) != 0 || st.st_size <= 0) {
+    close(fd);
+    return false;
+  }
+
+  void *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED) {
+    return false;
+  }
+  int ret = crypto_hash_compute(data, st.st_size, id, sizeof(id));
+  munmap(data, st.st_size);
+  if (ret != 0) {
+    return false;
+  }
+
+  hex_string(id, len, key);
+  ret = snprintf(names->path, sizeof(names->path), "%s/h-%s-%llx-%s.fnb",
+		 cache_dir, key, (long long) st.st_size, cache_server_tag);
+
+  return ret > 0 && ret < sizeof(names->path);
+}
+
+// Fill in the cache entry names for fname, without reading more of
+// the file than its ELF headers.  Pseudo files like [vdso] that can't
+// be opened are not cached.  For a binary without a build-id, only
+// the alias is filled in (cf. fnb_cache_hash_path).
+//
+// Returns: true if fname has cache entry names.
+//
+static bool
+fnb_cache_names(const char *fname, struct fnb_cache_names *names)
+{
+  unsigned char id[BUILD_ID_MAX];
+  char key[2 * BUILD_ID_MAX + 1];
+  struct stat st;
+  int ret;
+
+  names->path[0] = 0;
+  names->alias[0] = 0;
+
+  if (cache_dir == NULL) {
+    return false;
+  }
+
+  int fd = open(fname, O_RDONLY);
+  if (fd < 0) {
+    return false;
+  }
+  if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+    close(fd);
+    return false;
+  }
+  size_t len = elf_build_id(fd, id, sizeof(id));
+  close(fd);
+
+  if (len > 0) {
+    hex_string(id, len, key);
+    ret = snprintf(names->path, sizeof(names->path), "%s/b-%s-%llx-%s.fnb",
+		   cache_dir, key, (long long) st.st_size, cache_server_tag);
+    return ret > 0 && ret < sizeof(names->path);
+  }
+
+  ret = snprintf(names->alias, sizeof(names->alias),
+		 "%s/s-%llx-%llx-%llx-%llx.%09ld-%s.fnb", cache_dir,
+		 (long long) st.st_dev, (long long) st.st_ino,
+		 (long long) st.st_size, (long long) st.st_mtim.tv_sec,
+		 (long) st.st_mtim.tv_nsec, cache_server_tag);
+
+  return ret > 0 && ret < sizeof(names->alias);
+}
+
+// Point the alias for a binary without a build-id at the entry for
+// its contents.  An existing link is left alone.
+//
+static void
+fnb_cache_link(struct fnb_cache_names *names)
+{
+  if (names->alias[0] == 0 || names->path[0] == 0) {
+    return;
+  }
+
+  // link relative to the cache directory, so it can be moved
+  const char *target = strrchr(names->path, '/');
+  target = (target != NULL) ? target + 1 : names->path;
+
+  if (symlink(target, names->alias) != 0 && errno != EEXIST) {
+    TMSG(SYSTEM_SERVER, "cache: unable to link: %s", names->alias);
+  }
+}
+
+// Map the address array from a cache file.  The mapping is private
+// and writable, the same as an answer from the server.
+//
+// Returns: pointer to array of void * and fills in the file header,
+// or else NULL if there is no valid entry.
+//
+static void *
+fnb_cache_read(const char *path, struct fnbounds_file_header *fh)
+{
+  struct fnb_cache_hdr hdr;
+  struct stat st;
+
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    return NULL;
+  }
+
+  if (pread(fd, &hdr, sizeof(hdr), 0) != sizeof(hdr)
+      || hdr.magic != FNB_CACHE_MAGIC
+      || hdr.version != FNB_CACHE_VERSION
+      || hdr.ptr_size != sizeof(void *)
+      || hdr.num_entries == 0
+      || fstat(fd, &st) != 0
+      || st.st_size != FNB_CACHE_DATA_OFFSET + hdr.num_entries * sizeof(void *))
+  {
+    TMSG(SYSTEM_SERVER, "cache: invalid entry: %s", path);
+    close(fd);
+    return NULL;
+  }
+
+  size_t num_bytes = hdr.num_entries * sizeof(void *);
+  size_t mmap_size = page_align(num_bytes);
+  void *addr = mmap(NULL, mmap_size, PROT_READ | PROT_WRITE, MAP_PRIVATE,
+		    fd, FNB_CACHE_DATA_OFFSET);
+  close(fd);
+
+  if (addr == MAP_FAILED) {
+    TMSG(SYSTEM_SERVER, "cache: mmap failed: %s", path);
+    return NULL;
+  }
+
+  fh->num_entries = hdr.num_entries;
+  fh->reference_offset = hdr.reference_offset;
+  fh->is_relocatable = hdr.is_relocatable;
+  fh->mmap_size = mmap_size;
+
+  return addr;
+}
+
+// Save an answer from the server.  Write a temp file unique to this
+// process and rename it into place, so readers never see a partial
+// entry and concurrent writers of the same entry are harmless.
+//
+static void
+fnb_cache_write(const char *path, void *addr, struct fnbounds_file_header *fh)
+{
+  char tmp_path[PATH_MAX];
+  struct fnb_cache_hdr hdr;
+
+  if (fh->num_entries == 0) {
+    return;
+  }
+
+  int ret = snprintf(tmp_path, sizeof(tmp_path), "%s.%lx-%d.tmp",
+		     path, (long) gethostid(), (int) getpid());
+  if (ret <= 0 || ret >= sizeof(tmp_path)) {
+    return;
+  }
+
+  int fd = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC | O_EXCL, 0644);
+  if (fd < 0) {
+    TMSG(SYSTEM_SERVER, "cache: unable to create: %s", tmp_path);
+    return;
+  }
+
+  memset(&hdr, 0, sizeof(hdr));
+  hdr.magic = FNB_CACHE_MAGIC;
+  hdr.version = FNB_CACHE_VERSION;
+  hdr.ptr_size = sizeof(void *);
+  hdr.is_relocatable = fh->is_relocatable;
+  hdr.num_entries = fh->num_entries;
+  hdr.reference_offset = fh->reference_offset;
+
+  int ok = write_all(fd, &hdr, sizeof(hdr)) == SUCCESS
+    && lseek(fd, FNB_CACHE_DATA_OFFSET, SEEK_SET) == FNB_CACHE_DATA_OFFSET
+    && write_all(fd, addr, fh->num_entries * sizeof(void *)) == SUCCESS;
+
+  if (close(fd) != 0 || !ok || rename(tmp_path, path) != 0) {
+    TMSG(SYSTEM_SERVER, "cache: unable to write: %s", path);
+    unlink(tmp_path);
+    return;
+  }
+
+  TMSG(SYSTEM_SERVER, "cache: saved: %s", path);
+}
+
+#endif  // ! STAND_ALONE_CLIENT
+
+
 //*****************************************************************
 // Query the System Server
 //*****************************************************************
 
+// Ask the server for the function addresses in fname.
+//
 // Returns: pointer to array of void * and fills in the file header,
 // or else NULL on error.
 //
-void *
-hpcrun_syserv_query(const char *fname, struct fnbounds_file_header *fh)
+static void *
+syserv_query_server(const char *fname, struct fnbounds_file_header *fh)
 {
   struct syserv_mesg mesg;
   void *addr;
 
-  if (fname == NULL || fh == NULL) {
-    EMSG("SYSTEM_SERVER ERROR: passed NULL pointer to %s", __func__);
-    return NULL;
-  }
-
   if (client_status != SYSERV_ACTIVE || my_pid != getpid()) {
     launch_server();
   }
@@ -688,6 +1097,56 @@ hpcrun_syserv_query(const char *fname, struct fnbounds_file_header *fh)
 }
 
 
+// Returns: pointer to array of void * and fills in the file header,
+// or else NULL on error.
+//
+void *
+hpcrun_syserv_query(const char *fname, struct fnbounds_file_header *fh)
+{
+  if (fname == NULL || fh == NULL) {
+    EMSG("SYSTEM_SERVER ERROR: passed NULL pointer to %s", __func__);
+    return NULL;
+  }
+
+#if !defined(STAND_ALONE_CLIENT)
+  struct fnb_cache_names names;
+  bool use_cache = fnb_cache_names(fname, &names);
+
+  if (use_cache && names.alias[0] != 0) {
+    void *addr = fnb_cache_read(names.alias, fh);
+    if (addr != NULL) {
+      TMSG(SYSTEM_SERVER, "cache hit: %s -> %s, symbols: %ld",
+	   fname, names.alias, (long) fh->num_entries);
+      return addr;
+    }
+    // miss: another copy of the same contents may have an entry
+    use_cache = fnb_cache_hash_path(fname, &names);
+  }
+
+  if (use_cache) {
+    void *addr = fnb_cache_read(names.path, fh);
+    if (addr != NULL) {
+      TMSG(SYSTEM_SERVER, "cache hit: %s -> %s, symbols: %ld",
+	   fname, names.path, (long) fh->num_entries);
+      fnb_cache_link(&names);
+      return addr;
+    }
+  }
+
+  void *addr = syserv_query_server(fname, fh);
+
+  if (addr != NULL && use_cache) {
+    fnb_cache_write(names.path, addr, fh);
+    fnb_cache_link(&names);
+  }
+
+  return addr;
+#else
+  return syserv_query_server(fname, fh);
+#endif
+}
+
+
 //*****************************************************************
 // Stand Alone Client
 //*****************************************************************
@@ -188,15 +188,30 @@ fnbounds_init()
   return 0;
 }
 
+// The common case looks up the published loadmap index without the
+// fnbounds lock.  Only an address outside every indexed module takes
+// the lock, to search the full list and possibly map a new module.
 bool
 fnbounds_enclosing_addr(void* ip, void** start, void** end, load_module_t** lm)
 {
-  FNBOUNDS_LOCK;
-
   bool ret = false; // failure unless otherwise reset to 0 below
-  
-  load_module_t* lm_ = fnbounds_get_loadModule(ip);
-  dso_info_t* dso = (lm_) ? lm_->dso_info : NULL;
+
+  dso_info_t dso_copy;
+  dso_info_t* dso = NULL;
+
+  load_module_t* lm_ = hpcrun_loadmap_findByAddrInfo(ip, ip, &dso_copy);
+  if (lm_) {
+    dso = &dso_copy;
+  }
+  else {
+    FNBOUNDS_LOCK;
+    lm_ = fnbounds_get_loadModule(ip);
+    if (lm_ && lm_->dso_info) {
+      dso_copy = *(lm_->dso_info);
+      dso = &dso_copy;
+    }
+    FNBOUNDS_UNLOCK;
+  }
   
   if (dso && dso->nsymbols > 0) {
     void* ip_norm = ip;
@@ -225,8 +240,6 @@ fnbounds_enclosing_addr(void* ip, void** start, void** end, load_module_t** lm)
     *lm = lm_;
   }
 
-  FNBOUNDS_UNLOCK;
-
   return ret;
 }
 
@@ -242,6 +255,11 @@ void
 fnbounds_map_open_dsos()
 {
   dylib_map_open_dsos();
+
+  // publish the new modules once for the whole batch
+  FNBOUNDS_LOCK;
+  hpcrun_loadmap_publish();
+  FNBOUNDS_UNLOCK;
 }
 
 
@@ -378,6 +396,7 @@ fnbounds_unmap_closed_dsos()
     }
     current = current->next;
   }
+  hpcrun_loadmap_publish();
 
   FNBOUNDS_UNLOCK;
 }
@@ -526,6 +545,7 @@ fnbounds_get_loadModule(void *ip)
       dso = fnbounds_compute(module_name, mstart, mend);
       if (dso) {
         lm = hpcrun_loadmap_map(dso);
+        hpcrun_loadmap_publish();
       }
     }
   }
@@ -547,5 +567,6 @@ fnbounds_map_executable()
   //}
   FNBOUNDS_LOCK;
   hpcrun_loadmap_map(fnbounds_dso_exec());
+  hpcrun_loadmap_publish();
   FNBOUNDS_UNLOCK;
 }
@@ -102,6 +102,7 @@ fnbounds_init()
     hpcrun_dso_make(hpcrun_files_executable_pathname(), (void*)hpcrun_nm_addrs, 
 		    &fh, lm_beg_fn, lm_end_fn, lm_size);
   fnbounds_executable_dso = hpcrun_loadmap_map(dso);
+  hpcrun_loadmap_publish();
 
   return 0;
 }
@@ -50,6 +50,8 @@
 //***************************************************************************
 #include "sample_event.h"
 #include "disabled.h"
+#include "hpcrun_stats.h"
+#include "thread_data.h"
 
 #include <memory/hpcrun-malloc.h>
 #include <messages/messages.h>
@@ -63,27 +65,58 @@
 // local variables
 //***************************************************************************
 
-static atomic_long num_samples_total = ATOMIC_VAR_INIT(0);
-static atomic_long num_samples_attempted = ATOMIC_VAR_INIT(0);
-static atomic_long num_samples_blocked_async = ATOMIC_VAR_INIT(0);
-static atomic_long num_samples_blocked_dlopen = ATOMIC_VAR_INIT(0);
-static atomic_long num_samples_dropped = ATOMIC_VAR_INIT(0);
-static atomic_long num_samples_segv = ATOMIC_VAR_INIT(0);
-static atomic_long num_samples_partial = ATOMIC_VAR_INIT(0);
-static atomic_long num_samples_yielded = ATOMIC_VAR_INIT(0);
+// counters for threads without thread data
+static atomic_long global_stats[HPCRUN_NUM_STATS];
 
-static atomic_long num_unwind_intervals_total = ATOMIC_VAR_INIT(0);
-static atomic_long num_unwind_intervals_suspicious = ATOMIC_VAR_INIT(0);
+// all per-thread stats blocks that have ever been initialized
+static _Atomic(hpcrun_thread_stats_t *) thread_stats_list = ATOMIC_VAR_INIT(NULL);
 
-static atomic_long trolled = ATOMIC_VAR_INIT(0);
-static atomic_long frames_total = ATOMIC_VAR_INIT(0);
-static atomic_long trolled_frames = ATOMIC_VAR_INIT(0);
-static atomic_long frames_libfail_total = ATOMIC_VAR_INIT(0);
 
-static atomic_long acc_trace_records = ATOMIC_VAR_INIT(0);
-static atomic_long acc_trace_records_dropped = ATOMIC_VAR_INIT(0);
-static atomic_long acc_samples = ATOMIC_VAR_INIT(0);
-static atomic_long acc_samples_dropped = ATOMIC_VAR_INIT(0);
+//***************************************************************************
+// private operations
+//***************************************************************************
+
+// Add to this thread's own counter if it has an initialized stats
+// block, else to the shared one.  The per-thread add is still atomic
+// (a sample handler may interrupt a synchronous update), but the
+// cache line is not shared, so it costs no more than a local add.
+//
+static inline void
+stat_add(hpcrun_stat_t stat, long amt)
+{
+  if (hpcrun_td_avail()) {
+    hpcrun_thread_stats_t *stats = &(hpcrun_get_thread_data()->stats);
+    if (stats->self == stats) {
+      atomic_fetch_add_explicit(&stats->counter[stat], amt, memory_order_relaxed);
+      return;
+    }
+  }
+  atomic_fetch_add_explicit(&global_stats[stat], amt, memory_order_relaxed);
+}
+
+
+static long
+stat_sum(hpcrun_stat_t stat)
+{
+  long sum = atomic_load_explicit(&global_stats[stat], memory_order_relaxed);
+
+  hpcrun_thread_stats_t *stats =
+    atomic_load_explicit(&thread_stats_list, memory_order_acquire);
+  for (; stats != NULL; stats = stats->next) {
+    sum += atomic_load_explicit(&stats->counter[stat], memory_order_relaxed);
+  }
+  return sum;
+}
+
+
+static void
+stats_zero(atomic_long *counter)
+{
+  for (int i = 0; i < HPCRUN_NUM_STATS; i++) {
+    atomic_store_explicit(&counter[i], 0, memory_order_relaxed);
+  }
+}
+
 
 //***************************************************************************
 // interface operations
@@ -92,25 +125,36 @@ static atomic_long acc_samples_dropped = ATOMIC_VAR_INIT(0);
 void
 hpcrun_stats_reinit(void)
 {
-  atomic_store_explicit(&num_samples_total, 0, memory_order_relaxed);
-  atomic_store_explicit(&num_samples_attempted, 0, memory_order_relaxed);
-  atomic_store_explicit(&num_samples_blocked_async, 0, memory_order_relaxed);
-  atomic_store_explicit(&num_samples_blocked_dlopen, 0, memory_order_relaxed);
-  atomic_store_explicit(&num_samples_segv, 0, memory_order_relaxed);
+  stats_zero(global_stats);
+
+  // after fork, the blocks of the parent's other threads are still on
+  // the list, so clear them all.
+  hpcrun_thread_stats_t *stats =
+    atomic_load_explicit(&thread_stats_list, memory_order_acquire);
+  for (; stats != NULL; stats = stats->next) {
+    stats_zero(stats->counter);
+  }
+}
 
-  atomic_store_explicit(&num_unwind_intervals_total, 0, memory_order_relaxed);
-  atomic_store_explicit(&num_unwind_intervals_suspicious, 0, memory_order_relaxed);
 
-  atomic_store_explicit(&trolled, 0, memory_order_relaxed);
-  atomic_store_explicit(&frames_total, 0, memory_order_relaxed);
-  atomic_store_explicit(&trolled_frames, 0, memory_order_relaxed);
-  atomic_store_explicit(&frames_libfail_total, 0, memory_order_relaxed);
+// The thread data is wiped on init, except for the registry links, so
+// a block that is already on the list (thread 0 in a forked child) is
+// not pushed twice.
+//
+void
+hpcrun_stats_thread_init(hpcrun_thread_stats_t *stats)
+{
+  stats_zero(stats->counter);
 
-  atomic_store_explicit(&acc_trace_records, 0, memory_order_relaxed);
-  atomic_store_explicit(&acc_trace_records_dropped, 0, memory_order_relaxed);
+  if (stats->self == stats) {
+    return;
+  }
 
-  atomic_store_explicit(&acc_samples, 0, memory_order_relaxed);
-  atomic_store_explicit(&acc_samples_dropped, 0, memory_order_relaxed);
+  stats->next = atomic_load_explicit(&thread_stats_list, memory_order_relaxed);
+  while (! atomic_compare_exchange_weak_explicit(&thread_stats_list, &stats->next,
+						stats, memory_order_release,
+						memory_order_relaxed));
+  stats->self = stats;
 }
 
 
@@ -121,14 +165,14 @@ hpcrun_stats_reinit(void)
 void
 hpcrun_stats_num_samples_total_inc(void)
 {
-  atomic_fetch_add_explicit(&num_samples_total, 1L, memory_order_relaxed);
+  stat_add(HPCRUN_STAT_SAMPLES_TOTAL, 1L);
 }
 
 
 long
 hpcrun_stats_num_samples_total(void)
 {
-  return atomic_load_explicit(&num_samples_total, memory_order_relaxed);
+  return stat_sum(HPCRUN_STAT_SAMPLES_TOTAL);
 }
 
 
@@ -140,14 +184,14 @@ hpcrun_stats_num_samples_total(void)
 void
 hpcrun_stats_num_samples_attempted_inc(void)
 {
-  atomic_fetch_add_explicit(&num_samples_attempted, 1L, memory_order_relaxed);
+  stat_add(HPCRUN_STAT_SAMPLES_ATTEMPTED, 1L);
 }
 
 
 long
 hpcrun_stats_num_samples_attempted(void)
 {
-  return atomic_load_explicit(&num_samples_attempted, memory_order_relaxed);
+  return stat_sum(HPCRUN_STAT_SAMPLES_ATTEMPTED);
 }
 
 
@@ -161,15 +205,15 @@ hpcrun_stats_num_samples_attempted(void)
 void
 hpcrun_stats_num_samples_blocked_async_inc(void)
 {
-  atomic_fetch_add_explicit(&num_samples_blocked_async, 1L, memory_order_relaxed);
-  atomic_fetch_add_explicit(&num_samples_total, 1L, memory_order_relaxed);
+  stat_add(HPCRUN_STAT_SAMPLES_BLOCKED_ASYNC, 1L);
+  stat_add(HPCRUN_STAT_SAMPLES_TOTAL, 1L);
 }
 
 
 long
 hpcrun_stats_num_samples_blocked_async(void)
 {
-  return atomic_load_explicit(&num_samples_blocked_async, memory_order_relaxed);
+  return stat_sum(HPCRUN_STAT_SAMPLES_BLOCKED_ASYNC);
 }
 
 
@@ -181,14 +225,14 @@ hpcrun_stats_num_samples_blocked_async(void)
 void
 hpcrun_stats_num_samples_blocked_dlopen_inc(void)
 {
-  atomic_fetch_add_explicit(&num_samples_blocked_dlopen, 1L, memory_order_relaxed);
+  stat_add(HPCRUN_STAT_SAMPLES_BLOCKED_DLOPEN, 1L);
 }
 
 
 long
 hpcrun_stats_num_samples_blocked_dlopen(void)
 {
-  return atomic_load_explicit(&num_samples_blocked_dlopen, memory_order_relaxed);
+  return stat_sum(HPCRUN_STAT_SAMPLES_BLOCKED_DLOPEN);
 }
 
 
@@ -200,14 +244,14 @@ hpcrun_stats_num_samples_blocked_dlopen(void)
 void
 hpcrun_stats_num_samples_dropped_inc(void)
 {
-  atomic_fetch_add_explicit(&num_samples_dropped, 1L, memory_order_relaxed);
+  stat_add(HPCRUN_STAT_SAMPLES_DROPPED, 1L);
 }
 
 
 long
 hpcrun_stats_num_samples_dropped(void)
 {
-  return atomic_load_explicit(&num_samples_dropped, memory_order_relaxed);
+  return stat_sum(HPCRUN_STAT_SAMPLES_DROPPED);
 }
 
 
@@ -218,14 +262,14 @@ hpcrun_stats_num_samples_dropped(void)
 void
 hpcrun_stats_acc_samples_add(long value)
 {
-  atomic_fetch_add_explicit(&acc_samples, value, memory_order_relaxed);
+  stat_add(HPCRUN_STAT_ACC_SAMPLES, value);
 }
 
 
 long
 hpcrun_stats_acc_samples(void)
 {
-  return atomic_load_explicit(&acc_samples, memory_order_relaxed);
+  return stat_sum(HPCRUN_STAT_ACC_SAMPLES);
 }
 
 
@@ -236,14 +280,14 @@ hpcrun_stats_acc_samples(void)
 void
 hpcrun_stats_acc_samples_dropped_add(long value)
 {
-  atomic_fetch_add_explicit(&acc_samples_dropped, value, memory_order_relaxed);
+  stat_add(HPCRUN_STAT_ACC_SAMPLES_DROPPED, value);
 }
 
 
 long
 hpcrun_stats_acc_samples_dropped(void)
 {
-  return atomic_load_explicit(&acc_samples_dropped, memory_order_relaxed);
+  return stat_sum(HPCRUN_STAT_ACC_SAMPLES_DROPPED);
 }
 
 
@@ -254,14 +298,14 @@ hpcrun_stats_acc_samples_dropped(void)
 void
 hpcrun_stats_acc_trace_records_add(long value)
 {
-  atomic_fetch_add_explicit(&acc_trace_records, value, memory_order_relaxed);
+  stat_add(HPCRUN_STAT_ACC_TRACE_RECORDS, value);
 }
 
 
 long
 hpcrun_stats_acc_trace_records(void)
 {
-  return atomic_load_explicit(&acc_trace_records, memory_order_relaxed);
+  return stat_sum(HPCRUN_STAT_ACC_TRACE_RECORDS);
 }
 
 
@@ -272,14 +316,14 @@ hpcrun_stats_acc_trace_records(void)
 void
 hpcrun_stats_acc_trace_records_dropped_add(long value)
 {
-  atomic_fetch_add_explicit(&acc_trace_records_dropped, value, memory_order_relaxed);
+  stat_add(HPCRUN_STAT_ACC_TRACE_RECORDS_DROPPED, value);
 }
 
 
 long
 hpcrun_stats_acc_trace_records_dropped(void)
 {
-  return atomic_load_explicit(&acc_trace_records_dropped, memory_order_relaxed);
+  return stat_sum(HPCRUN_STAT_ACC_TRACE_RECORDS_DROPPED);
 }
 
 
@@ -290,13 +334,13 @@ hpcrun_stats_acc_trace_records_dropped(void)
 void
 hpcrun_stats_num_samples_partial_inc(void)
 {
-  atomic_fetch_add_explicit(&num_samples_partial, 1L, memory_order_relaxed);
+  stat_add(HPCRUN_STAT_SAMPLES_PARTIAL, 1L);
 }
 
 long
 hpcrun_stats_num_samples_partial(void)
 {
-  return atomic_load_explicit(&num_samples_partial, memory_order_relaxed);
+  return stat_sum(HPCRUN_STAT_SAMPLES_PARTIAL);
 }
 
 //-----------------------------
@@ -306,14 +350,14 @@ hpcrun_stats_num_samples_partial(void)
 void
 hpcrun_stats_num_samples_segv_inc(void)
 {
-  atomic_fetch_add_explicit(&num_samples_segv, 1L, memory_order_relaxed);
+  stat_add(HPCRUN_STAT_SAMPLES_SEGV, 1L);
 }
 
 
 long
 hpcrun_stats_num_samples_segv(void)
 {
-  return atomic_load_explicit(&num_samples_segv, memory_order_relaxed);
+  return stat_sum(HPCRUN_STAT_SAMPLES_SEGV);
 }
 
 
@@ -326,14 +370,14 @@ hpcrun_stats_num_samples_segv(void)
 void
 hpcrun_stats_num_unwind_intervals_total_inc(void)
 {
-  atomic_fetch_add_explicit(&num_unwind_intervals_total, 1L, memory_order_relaxed);
+  stat_add(HPCRUN_STAT_UNWIND_INTERVALS_TOTAL, 1L);
 }
 
 
 long
 hpcrun_stats_num_unwind_intervals_total(void)
 {
-  return atomic_load_explicit(&num_unwind_intervals_total, memory_order_relaxed);
+  return stat_sum(HPCRUN_STAT_UNWIND_INTERVALS_TOTAL);
 }
 
 
@@ -345,14 +389,14 @@ hpcrun_stats_num_unwind_intervals_total(void)
 void
 hpcrun_stats_num_unwind_intervals_suspicious_inc(void)
 {
-  atomic_fetch_add_explicit(&num_unwind_intervals_suspicious, 1L, memory_order_relaxed);
+  stat_add(HPCRUN_STAT_UNWIND_INTERVALS_SUSPICIOUS, 1L);
 }
 
 
 long
 hpcrun_stats_num_unwind_intervals_suspicious(void)
 {
-  return atomic_load_explicit(&num_unwind_intervals_suspicious, memory_order_relaxed);
+  return stat_sum(HPCRUN_STAT_UNWIND_INTERVALS_SUSPICIOUS);
 }
 
 //------------------------------------------------------
@@ -362,13 +406,13 @@ hpcrun_stats_num_unwind_intervals_suspicious(void)
 void
 hpcrun_stats_trolled_inc(void)
 {
-  atomic_fetch_add_explicit(&trolled, 1L, memory_order_relaxed);
+  stat_add(HPCRUN_STAT_TROLLED, 1L);
 }
 
 long
 hpcrun_stats_trolled(void)
 {
-  return atomic_load_explicit(&trolled, memory_order_relaxed);
+  return stat_sum(HPCRUN_STAT_TROLLED);
 }
 
 //------------------------------------------------------
@@ -378,13 +422,13 @@ hpcrun_stats_trolled(void)
 void
 hpcrun_stats_frames_total_inc(long amt)
 {
-  atomic_fetch_add_explicit(&frames_total, amt, memory_order_relaxed);
+  stat_add(HPCRUN_STAT_FRAMES_TOTAL, amt);
 }
 
 long
 hpcrun_stats_frames_total(void)
 {
-  return atomic_load_explicit(&frames_total, memory_order_relaxed);
+  return stat_sum(HPCRUN_STAT_FRAMES_TOTAL);
 }
 //-------------------------------------------------------
 // number of (unwind) frames where libunwind failed
@@ -393,13 +437,13 @@ hpcrun_stats_frames_total(void)
 void
 hpcrun_stats_frames_libfail_total_inc(long amt)
 {
-  atomic_fetch_add_explicit(&frames_libfail_total, amt, memory_order_relaxed);
+  stat_add(HPCRUN_STAT_FRAMES_LIBFAIL_TOTAL, amt);
 }
 
 long
 hpcrun_stats_frames_libfail_total(void)
 {
-  return atomic_load_explicit(&frames_libfail_total, memory_order_relaxed);
+  return stat_sum(HPCRUN_STAT_FRAMES_LIBFAIL_TOTAL);
 }
 
 //---------------------------------------------------------------------
@@ -409,13 +453,13 @@ hpcrun_stats_frames_libfail_total(void)
 void
 hpcrun_stats_trolled_frames_inc(long amt)
 {
-  atomic_fetch_add_explicit(&trolled_frames, amt, memory_order_relaxed);
+  stat_add(HPCRUN_STAT_TROLLED_FRAMES, amt);
 }
 
 long
 hpcrun_stats_trolled_frames(void)
 {
-  return atomic_load_explicit(&trolled_frames, memory_order_relaxed);
+  return stat_sum(HPCRUN_STAT_TROLLED_FRAMES);
 }
 
 //----------------------------
@@ -425,13 +469,13 @@ hpcrun_stats_trolled_frames(void)
 void
 hpcrun_stats_num_samples_yielded_inc(void)
 {
-  atomic_fetch_add_explicit(&num_samples_yielded, 1L, memory_order_relaxed);
+  stat_add(HPCRUN_STAT_SAMPLES_YIELDED, 1L);
 }
 
 long
 hpcrun_stats_num_samples_yielded(void)
 {
-  return atomic_load_explicit(&num_samples_yielded, memory_order_relaxed);
+  return stat_sum(HPCRUN_STAT_SAMPLES_YIELDED);
 }
 
 //-----------------------------
@@ -441,30 +485,30 @@ hpcrun_stats_num_samples_yielded(void)
 void
 hpcrun_stats_print_summary(void)
 {
-  long cpu_blocked_async  = atomic_load_explicit(&num_samples_blocked_async, memory_order_relaxed);
-  long cpu_blocked_dlopen = atomic_load_explicit(&num_samples_blocked_dlopen, memory_order_relaxed);
+  long cpu_blocked_async  = stat_sum(HPCRUN_STAT_SAMPLES_BLOCKED_ASYNC);
+  long cpu_blocked_dlopen = stat_sum(HPCRUN_STAT_SAMPLES_BLOCKED_DLOPEN);
   long cpu_blocked = cpu_blocked_async + cpu_blocked_dlopen;
 
-  long cpu_dropped = atomic_load_explicit(&num_samples_dropped, memory_order_relaxed);
-  long cpu_segv = atomic_load_explicit(&num_samples_segv, memory_order_relaxed);
-  long cpu_valid = atomic_load_explicit(&num_samples_attempted, memory_order_relaxed);
-  long cpu_yielded = atomic_load_explicit(&num_samples_yielded, memory_order_relaxed);
-  long cpu_total = atomic_load_explicit(&num_samples_total, memory_order_relaxed);
+  long cpu_dropped = stat_sum(HPCRUN_STAT_SAMPLES_DROPPED);
+  long cpu_segv = stat_sum(HPCRUN_STAT_SAMPLES_SEGV);
+  long cpu_valid = stat_sum(HPCRUN_STAT_SAMPLES_ATTEMPTED);
+  long cpu_yielded = stat_sum(HPCRUN_STAT_SAMPLES_YIELDED);
+  long cpu_total = stat_sum(HPCRUN_STAT_SAMPLES_TOTAL);
 
-  long cpu_trolled = atomic_load_explicit(&trolled, memory_order_relaxed);
+  long cpu_trolled = stat_sum(HPCRUN_STAT_TROLLED);
 
-  long cpu_frames = atomic_load_explicit(&frames_total, memory_order_relaxed);
-  long cpu_frames_trolled = atomic_load_explicit(&trolled_frames, memory_order_relaxed);
-  long cpu_frames_libfail_total = atomic_load_explicit(&frames_libfail_total, memory_order_relaxed);
+  long cpu_frames = stat_sum(HPCRUN_STAT_FRAMES_TOTAL);
+  long cpu_frames_trolled = stat_sum(HPCRUN_STAT_TROLLED_FRAMES);
+  long cpu_frames_libfail_total = stat_sum(HPCRUN_STAT_FRAMES_LIBFAIL_TOTAL);
 
-  long cpu_intervals_total = atomic_load_explicit(&num_unwind_intervals_total, memory_order_relaxed);
-  long cpu_intervals_susp = atomic_load_explicit(&num_unwind_intervals_suspicious, memory_order_relaxed);
+  long cpu_intervals_total = stat_sum(HPCRUN_STAT_UNWIND_INTERVALS_TOTAL);
+  long cpu_intervals_susp = stat_sum(HPCRUN_STAT_UNWIND_INTERVALS_SUSPICIOUS);
 
-  long acc_samp = atomic_load_explicit(&acc_samples, memory_order_relaxed);
-  long acc_samp_dropped = atomic_load_explicit(&acc_samples_dropped, memory_order_relaxed);
+  long acc_samp = stat_sum(HPCRUN_STAT_ACC_SAMPLES);
+  long acc_samp_dropped = stat_sum(HPCRUN_STAT_ACC_SAMPLES_DROPPED);
 
-  long acc_trace = atomic_load_explicit(&acc_trace_records, memory_order_relaxed);
-  long acc_trace_dropped = atomic_load_explicit(&acc_trace_records_dropped, memory_order_relaxed);
+  long acc_trace = stat_sum(HPCRUN_STAT_ACC_TRACE_RECORDS);
+  long acc_trace_dropped = stat_sum(HPCRUN_STAT_ACC_TRACE_RECORDS_DROPPED);
 
   hpcrun_memory_summary();
 
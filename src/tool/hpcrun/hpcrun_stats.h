@@ -45,12 +45,66 @@
 // ******************************************************* EndRiceCopyright *
 
 
+#ifndef HPCRUN_STATS_H
+#define HPCRUN_STATS_H
+
+//***************************************************************************
+// global include files
+//***************************************************************************
+
+#include <lib/prof-lean/stdatomic.h>
+
+
+//***************************************************************************
+// type declarations
+//***************************************************************************
+
+typedef enum {
+  HPCRUN_STAT_SAMPLES_TOTAL,
+  HPCRUN_STAT_SAMPLES_ATTEMPTED,
+  HPCRUN_STAT_SAMPLES_BLOCKED_ASYNC,
+  HPCRUN_STAT_SAMPLES_BLOCKED_DLOPEN,
+  HPCRUN_STAT_SAMPLES_DROPPED,
+  HPCRUN_STAT_SAMPLES_SEGV,
+  HPCRUN_STAT_SAMPLES_PARTIAL,
+  HPCRUN_STAT_SAMPLES_YIELDED,
+  HPCRUN_STAT_UNWIND_INTERVALS_TOTAL,
+  HPCRUN_STAT_UNWIND_INTERVALS_SUSPICIOUS,
+  HPCRUN_STAT_TROLLED,
+  HPCRUN_STAT_FRAMES_TOTAL,
+  HPCRUN_STAT_TROLLED_FRAMES,
+  HPCRUN_STAT_FRAMES_LIBFAIL_TOTAL,
+  HPCRUN_STAT_ACC_TRACE_RECORDS,
+  HPCRUN_STAT_ACC_TRACE_RECORDS_DROPPED,
+  HPCRUN_STAT_ACC_SAMPLES,
+  HPCRUN_STAT_ACC_SAMPLES_DROPPED,
+  HPCRUN_NUM_STATS
+} hpcrun_stat_t;
+
+// Per-thread counters, kept in thread_data_t so that the sample
+// handlers of different threads never write to a shared cache line.
+// The blocks are never freed, and each one is linked into a
+// process-wide list once, so the totals can be summed at report
+// time.  Threads without thread data use the global counters.
+//
+typedef struct hpcrun_thread_stats_t {
+  atomic_long counter[HPCRUN_NUM_STATS];
+
+  // registry links: preserved when the thread data is reinitialized
+  struct hpcrun_thread_stats_t *next;
+  struct hpcrun_thread_stats_t *self;
+} __attribute__((aligned(128))) hpcrun_thread_stats_t;
+
+
 //***************************************************************************
 // interface operations
 //***************************************************************************
 
 void hpcrun_stats_reinit(void);
 
+// zero the counters of a thread's stats block and register it
+void hpcrun_stats_thread_init(hpcrun_thread_stats_t *stats);
+
 //-----------------------------
 // samples total 
 //-----------------------------
@@ -200,3 +254,5 @@ long hpcrun_stats_trolled_frames(void);
 //-----------------------------
 
 void hpcrun_stats_print_summary(void);
+
+#endif // HPCRUN_STATS_H
@@ -77,6 +77,11 @@ hpctoolkit_sampling_is_active(void)
   return 0;
 }
 
+void __attribute__ ((weak))
+hpctoolkit_snapshot(void)
+{
+}
+
 // Fortran aliases
 
 // FIXME: The Fortran functions really need a separate API with
@@ -89,3 +94,6 @@ void hpctoolkit_sampling_start__(void) __attribute__ ((weak, alias ("hpctoolkit_
 
 void hpctoolkit_sampling_stop_ (void) __attribute__ ((weak, alias ("hpctoolkit_sampling_stop")));
 void hpctoolkit_sampling_stop__(void) __attribute__ ((weak, alias ("hpctoolkit_sampling_stop")));
+
+void hpctoolkit_snapshot_ (void) __attribute__ ((weak, alias ("hpctoolkit_snapshot")));
+void hpctoolkit_snapshot__(void) __attribute__ ((weak, alias ("hpctoolkit_snapshot")));
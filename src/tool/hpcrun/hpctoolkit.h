@@ -54,6 +54,7 @@ extern "C" {
 void hpctoolkit_sampling_start(void);
 void hpctoolkit_sampling_stop(void);
 int  hpctoolkit_sampling_is_active(void);
+void hpctoolkit_snapshot(void);
 
 #ifdef __cplusplus
 }
@@ -57,6 +57,7 @@
 
 #include <lib/prof-lean/hpcfmt.h>
 #include <lib/prof-lean/spinlock.h>
+#include <lib/prof-lean/stdatomic.h>
 
 #define LOADMAP_DEBUG 0
 
@@ -68,6 +69,42 @@ static hpcrun_loadmap_t* s_loadmap_ptr = NULL;
 static dso_info_t* s_dso_free_list = NULL;
 
 
+// A read-mostly index of the mapped load modules, sorted by start
+// address.  Each version is immutable once published and holds a
+// private copy of each module's dso info, because dso_info_t's are
+// recycled through the free list.  Lookups binary search whatever
+// version they load, so they never lock or see a partial update.
+//
+// hpcrun_malloc() memory can't be freed, so superseded versions go on
+// a retired list and are recycled by a later publish.  Lookups count
+// themselves in s_loadmap_index_readers around their use of a
+// version.  When the writer sees no readers after swapping in a new
+// version, no lookup can still hold an old one, and the retired list
+// moves to the free list.  The writer never waits for readers (they
+// may be a sample in its own thread), so a version is only kept past
+// the next publish if that publish races with a lookup.
+typedef struct loadmap_index_entry_t {
+  load_module_t* lm;
+  dso_info_t dso;
+} loadmap_index_entry_t;
+
+typedef struct loadmap_index_t {
+  struct loadmap_index_t* next;   // retired and free lists
+  size_t cap;
+  size_t len;
+  bool overlap;   // if true, search the list instead
+  loadmap_index_entry_t entry[];
+} loadmap_index_t;
+
+static _Atomic(loadmap_index_t*) s_loadmap_index = ATOMIC_VAR_INIT(NULL);
+static atomic_long s_loadmap_index_readers = ATOMIC_VAR_INIT(0);
+static bool s_loadmap_index_dirty = false;
+
+// owned by the writer (under the fnbounds lock)
+static loadmap_index_t* s_loadmap_index_retired = NULL;
+static loadmap_index_t* s_loadmap_index_free = NULL;
+
+
 /* locking functions to ensure that loadmaps are consistent */
 static spinlock_t loadmap_lock = SPINLOCK_UNLOCKED;
 
@@ -288,8 +325,8 @@ hpcrun_loadmap_print(hpcrun_loadmap_t* loadmap)
 
 //***************************************************************************
 
-load_module_t*
-hpcrun_loadmap_findByAddr(void* begin, void* end)
+static load_module_t*
+hpcrun_loadmap_findByAddr_list(void* begin, void* end)
 {
   TMSG(LOADMAP, "find by address %p -- %p", begin, end);
   for (load_module_t* x = s_loadmap_ptr->lm_head; (x); x = x->next) {
@@ -314,6 +351,177 @@ hpcrun_loadmap_findByAddr(void* begin, void* end)
 }
 
 
+// Binary search the published index for the module containing
+// [begin, end], and copy out its load module and (if 'dso' is
+// non-NULL) its dso info.  Returns false if not found or if there is
+// no index that can answer the query.
+static bool
+hpcrun_loadmap_index_find(void* begin, void* end, load_module_t** lm,
+			  dso_info_t* dso)
+{
+  bool found = false;
+
+  atomic_fetch_add_explicit(&s_loadmap_index_readers, 1L, memory_order_seq_cst);
+  loadmap_index_t* index =
+    atomic_load_explicit(&s_loadmap_index, memory_order_seq_cst);
+
+  if (index != NULL && ! index->overlap) {
+    // find the last entry with start_addr <= begin
+    size_t lo = 0, hi = index->len;
+    while (lo < hi) {
+      size_t mid = lo + (hi - lo) / 2;
+      if (index->entry[mid].dso.start_addr <= begin) {
+	lo = mid + 1;
+      }
+      else {
+	hi = mid;
+      }
+    }
+    if (lo > 0 && end <= index->entry[lo - 1].dso.end_addr) {
+      loadmap_index_entry_t* e = &index->entry[lo - 1];
+      *lm = e->lm;
+      if (dso != NULL) {
+	*dso = e->dso;
+      }
+      found = true;
+    }
+  }
+
+  atomic_fetch_add_explicit(&s_loadmap_index_readers, -1L, memory_order_release);
+  return found;
+}
+
+
+// Fall back to the list when the address is not in the index: the
+// module may have been mapped since the last publish.
+load_module_t*
+hpcrun_loadmap_findByAddr(void* begin, void* end)
+{
+  load_module_t* lm;
+
+  if (hpcrun_loadmap_index_find(begin, end, &lm, NULL)) {
+    return lm;
+  }
+  return hpcrun_loadmap_findByAddr_list(begin, end);
+}
+
+
+load_module_t*
+hpcrun_loadmap_findByAddrInfo(void* begin, void* end, dso_info_t* dso)
+{
+  load_module_t* lm;
+
+  if (hpcrun_loadmap_index_find(begin, end, &lm, dso)) {
+    return lm;
+  }
+  return NULL;
+}
+
+
+// Swap in a new index version (or NULL) and retire the old one.  If
+// no lookup is running after the swap, then none can hold any
+// retired version, so they can all be reused.
+static void
+hpcrun_loadmap_index_swap(loadmap_index_t* index)
+{
+  loadmap_index_t* old =
+    atomic_exchange_explicit(&s_loadmap_index, index, memory_order_seq_cst);
+
+  if (old != NULL) {
+    old->next = s_loadmap_index_retired;
+    s_loadmap_index_retired = old;
+  }
+
+  if (atomic_load_explicit(&s_loadmap_index_readers, memory_order_seq_cst) == 0) {
+    while (s_loadmap_index_retired != NULL) {
+      loadmap_index_t* x = s_loadmap_index_retired;
+      s_loadmap_index_retired = x->next;
+      x->next = s_loadmap_index_free;
+      s_loadmap_index_free = x;
+    }
+  }
+}
+
+
+// Take a free version with room for 'len' entries, else allocate one.
+static loadmap_index_t*
+hpcrun_loadmap_index_alloc(size_t len)
+{
+  for (loadmap_index_t** p = &s_loadmap_index_free; *p != NULL; p = &(*p)->next) {
+    if ((*p)->cap >= len) {
+      loadmap_index_t* index = *p;
+      *p = index->next;
+      return index;
+    }
+  }
+
+  loadmap_index_t* index =
+    hpcrun_malloc(sizeof(loadmap_index_t) + len * sizeof(loadmap_index_entry_t));
+  if (index != NULL) {
+    index->cap = len;
+  }
+  return index;
+}
+
+
+void
+hpcrun_loadmap_publish()
+{
+  if (! s_loadmap_index_dirty) {
+    return;
+  }
+
+  size_t len = 0;
+  for (load_module_t* x = s_loadmap_ptr->lm_head; (x); x = x->next) {
+    if (x->dso_info) {
+      len++;
+    }
+  }
+
+  loadmap_index_t* index = hpcrun_loadmap_index_alloc(len);
+  if (index == NULL) {
+    EMSG("hpcrun_loadmap_publish: allocation failed, using unindexed lookups");
+    hpcrun_loadmap_index_swap(NULL);
+    return;
+  }
+
+  // insertion sort by start address: the list is short and mostly
+  // ordered by map time, and qsort() may call malloc.
+  index->next = NULL;
+  index->len = 0;
+  index->overlap = false;
+  for (load_module_t* x = s_loadmap_ptr->lm_head; (x); x = x->next) {
+    if (x->dso_info == NULL) {
+      continue;
+    }
+    size_t k = index->len++;
+    while (k > 0 && index->entry[k - 1].dso.start_addr > x->dso_info->start_addr) {
+      index->entry[k] = index->entry[k - 1];
+      k--;
+    }
+    index->entry[k].lm = x;
+    index->entry[k].dso = *(x->dso_info);
+    index->entry[k].dso.next = NULL;
+    index->entry[k].dso.prev = NULL;
+  }
+
+  for (size_t k = 1; k < index->len; k++) {
+    if (index->entry[k].dso.start_addr < index->entry[k - 1].dso.end_addr) {
+      TMSG(LOADMAP, "publish: overlap %s and %s", index->entry[k - 1].lm->name,
+	   index->entry[k].lm->name);
+      index->overlap = true;
+      break;
+    }
+  }
+
+  hpcrun_loadmap_index_swap(index);
+  s_loadmap_index_dirty = false;
+
+  TMSG(LOADMAP, "publish: %ld modules, overlap: %d", (long) index->len,
+       (int) index->overlap);
+}
+
+
 load_module_t*
 hpcrun_loadmap_findByName(const char* name)
 {
@@ -451,6 +659,8 @@ hpcrun_loadmap_map(dso_info_t* dso)
 
   }
 
+  s_loadmap_index_dirty = true;
+
   hpcrun_loadmap_notify_map(lm->dso_info->start_addr, 
 			    lm->dso_info->end_addr);
 
@@ -474,6 +684,7 @@ hpcrun_loadmap_unmap(load_module_t* lm)
   void *end_addr = old_dso->end_addr;
 
   lm->dso_info = NULL;
+  s_loadmap_index_dirty = true;
 
   // tallent: For now, do not move the loadmap to the back of the
   //   list.  If we want to enable, this, we could have
@@ -526,6 +737,12 @@ hpcrun_initLoadmap()
   hpcrun_loadmap_init(s_loadmap_ptr);
 
   s_dso_free_list = NULL;
+
+  atomic_store_explicit(&s_loadmap_index, NULL, memory_order_relaxed);
+  atomic_store_explicit(&s_loadmap_index_readers, 0L, memory_order_relaxed);
+  s_loadmap_index_dirty = false;
+  s_loadmap_index_retired = NULL;
+  s_loadmap_index_free = NULL;
 }
 
 
@@ -195,6 +195,24 @@ load_module_t*
 hpcrun_loadmap_findByAddr(void* begin, void* end);
 
 
+// hpcrun_loadmap_findByAddrInfo: Like hpcrun_loadmap_findByAddr(), but
+//   also copies the module's dso info, as of the last published
+//   version of the address index, into 'dso'.  Takes no lock, and the
+//   copy stays valid even if the module is unmapped concurrently.
+//   Returns NULL if the address is not in the index (the caller may
+//   retry under the fnbounds lock).
+load_module_t*
+hpcrun_loadmap_findByAddrInfo(void* begin, void* end, dso_info_t* dso);
+
+
+// hpcrun_loadmap_publish: Rebuild the address index and make it
+//   visible to lock-free lookups, if any module has been mapped or
+//   unmapped since the last publish.  Must be called by the (single)
+//   writer of the load map, ie, under the fnbounds lock.
+void
+hpcrun_loadmap_publish();
+
+
 // hpcrun_loadmap_findByName: Find a load module by name.
 load_module_t*
 hpcrun_loadmap_findByName(const char* name);
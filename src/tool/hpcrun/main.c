@@ -81,6 +81,7 @@
 
 #include "main.h"
 
+#include "container.h"
 #include "disabled.h"
 #include "env.h"
 #include "loadmap.h"
@@ -94,6 +95,8 @@
 #include "hpcrun_stats.h"
 #include "hpcrun_flag_stacks.h"
 #include "name.h"
+#include "sample_budget.h"
+#include "snapshot.h"
 #include "start-stop.h"
 #include "custom-init.h"
 #include "cct_insert_backtrace.h"
@@ -460,6 +463,7 @@ hpcrun_init_internal(bool is_child)
   hpcrun_options__init(&opts);
   hpcrun_options__getopts(&opts);
 
+  hpcrun_container_init();
   hpcrun_trace_init(); // this must go after thread initialization
   hpcrun_trace_open(&(TD_GET(core_profile_trace_data)));
 
@@ -512,6 +516,8 @@ hpcrun_init_internal(bool is_child)
 
   hpcrun_stats_reinit();
   hpcrun_start_stop_internal_init();
+  hpcrun_snapshot_init();
+  hpcrun_sample_budget_init();
 
   // sample source setup
 
@@ -700,6 +706,9 @@ hpcrun_fini_internal()
 
     // write all threads' profile data and close trace file
     hpcrun_threadMgr_data_fini(hpcrun_get_thread_data());
+    hpcrun_snapshot_fini();
+    hpcrun_trace_fini();
+    hpcrun_container_fini();
 
     fnbounds_fini();
     hpcrun_stats_print_summary();
@@ -107,6 +107,7 @@ static metric_desc_list_t* pre_alloc = NULL;
 // unimplemented at this time
 
 struct kind_info_t {
+  int id;      // index of the kind in a metric_data_list_t
   int idx;     // current index in kind
   bool has_set_max;
   kind_info_t* link; // all kinds linked together in singly linked list
@@ -124,6 +125,7 @@ struct kind_info_t {
 
 static kind_info_t *first_kind = NULL;
 static kind_info_t **next_kind = &first_kind;
+static int num_kinds = 0;
 typedef enum { KIND_UNINITIALIZED, KIND_INITIALIZING, KIND_INITIALIZED } kind_state_t;
 static _Atomic(kind_state_t) kind_state = ATOMIC_VAR_INIT(KIND_UNINITIALIZED);
 static int num_kind_metrics;
@@ -137,17 +139,30 @@ static struct dmap {
 kind_info_t*
 hpcrun_metrics_new_kind(void)
 {
+  if (atomic_load(&kind_state) != KIND_UNINITIALIZED) {
+    // the kind tables of cct nodes have no slot for this kind, and
+    // the metric table has no entries for its metrics
+    EMSG("Metric kind created after the metrics were finalized");
+    return NULL;
+  }
+
   kind_info_t* rv = (kind_info_t*) hpcrun_malloc(sizeof(kind_info_t));
-  *rv = (kind_info_t) {.idx = 0, .metric_data = NULL, .has_set_max = 0, .link = NULL};
+  *rv = (kind_info_t) {.id = num_kinds++, .idx = 0, .metric_data = NULL,
+                       .has_set_max = 0, .link = NULL};
   *next_kind = rv;
   next_kind = &rv->link;
   return rv;
 }
 
+//
+// the metrics of a cct node: a table indexed by kind id, with a
+// dense metric array for each kind the node has metrics of (NULL
+// otherwise). Arrays are allocated when first needed, so that a
+// metric update is a table lookup, not a search.
+//
 typedef struct metric_data_list_t {
-  struct metric_data_list_t* next;
-  kind_info_t *kind;
-  metric_set_t *metrics;
+  int n_kinds;                   // num_kinds when allocated
+  metric_set_t *kind_metrics[];  // [n_kinds]
 } metric_data_list_t;
 
 
@@ -155,6 +170,26 @@ typedef struct metric_data_list_t {
 //  Local functions
 //***************************************************************************
 
+static metric_data_list_t *
+new_kind_table(void *(*alloc)(size_t))
+{
+  size_t sz = sizeof(metric_data_list_t) + num_kinds * sizeof(metric_set_t *);
+  metric_data_list_t *table = alloc(sz);
+  memset(table, 0, sz);
+  table->n_kinds = num_kinds;
+  return table;
+}
+
+
+static metric_set_t *
+new_kind_metrics(kind_info_t *kind, void *(*alloc)(size_t))
+{
+  int n_metrics = hpcrun_get_num_metrics(kind);
+  metric_set_t *metrics = alloc(n_metrics * sizeof(hpcrun_metricVal_t));
+  memset(metrics, 0, n_metrics * sizeof(hpcrun_metricVal_t));
+  return metrics;
+}
+
 
 //***************************************************************************
 //  Interface functions
@@ -270,6 +305,7 @@ hpcrun_get_num_metrics(kind_info_t *kind)
 
 void hpcrun_close_kind(kind_info_t *kind) 
 {
+  if (kind == NULL) return;
   hpcrun_get_num_metrics(kind);
 }
 
@@ -358,7 +394,7 @@ hpcrun_set_new_metric_desc(kind_info_t *kind, const char* name,
 				MetricFlags_ValFmt_t valFmt, size_t period,
 				metric_upd_proc_t upd_fn, metric_desc_properties_t prop)
 {
-  if (kind->has_set_max)
+  if (kind == NULL || kind->has_set_max)
     return -1;
 
   int metric_id = num_kind_metrics++;
@@ -438,16 +474,14 @@ hpcrun_set_new_metric_info(kind_info_t *kind, const char* name)
 cct_metric_data_t*
 hpcrun_metric_set_loc(metric_data_list_t *rv, int id)
 {
-  metric_data_list_t *curr;
-  for (curr = rv; curr != NULL && curr->kind != metric_data[id].kind;
-    rv = curr, curr = curr->next);
-  if (curr == NULL) {
-    curr = hpcrun_new_metric_data_list(id);
-    rv->next = curr;
+  kind_info_t *kind = metric_data[id].kind;
+  metric_set_t *metrics = rv->kind_metrics[kind->id];
+  if (metrics == NULL) {
+    metrics = new_kind_metrics(kind, hpcrun_malloc);
+    rv->kind_metrics[kind->id] = metrics;
   }
-  rv = curr;
 
-  return &(rv->metrics->v1) + metric_data[id].id;
+  return &(metrics->v1) + metric_data[id].id;
 }
 
 
@@ -500,32 +534,16 @@ hpcrun_metric_std_inc(int metric_id, metric_data_list_t* set,
 metric_data_list_t *
 hpcrun_new_metric_data_list(int metric_id)
 {
-  metric_data_list_t *curr = hpcrun_malloc(sizeof(metric_data_list_t));
   hpcrun_get_num_kind_metrics();
-  curr->kind = metric_data[metric_id].kind;
-  int n_metrics = hpcrun_get_num_metrics(curr->kind);
-  curr->metrics = hpcrun_malloc(n_metrics * sizeof(hpcrun_metricVal_t));
-  // FIXME(Keren): duplicate?
-  for (int i = 0; i < n_metrics; i++)
-    curr->metrics[i].v1 = curr->kind->null_metrics[i];
-  memset(curr->metrics, 0, n_metrics * sizeof(hpcrun_metricVal_t));
-  curr->next = NULL;
-  return curr;
+  return hpcrun_new_metric_data_list_kind(metric_data[metric_id].kind);
 }
 
 metric_data_list_t *
 hpcrun_new_metric_data_list_kind(kind_info_t *kind)
 {
-  metric_data_list_t *curr = hpcrun_malloc(sizeof(metric_data_list_t));
   hpcrun_get_num_kind_metrics();
-  curr->kind = kind;
-  int n_metrics = hpcrun_get_num_metrics(curr->kind);
-  curr->metrics = hpcrun_malloc(n_metrics * sizeof(hpcrun_metricVal_t));
-  // FIXME(Keren): duplicate?
-  for (int i = 0; i < n_metrics; i++)
-    curr->metrics[i].v1 = curr->kind->null_metrics[i];
-  memset(curr->metrics, 0, n_metrics * sizeof(hpcrun_metricVal_t));
-  curr->next = NULL;
+  metric_data_list_t *curr = new_kind_table(hpcrun_malloc);
+  curr->kind_metrics[kind->id] = new_kind_metrics(kind, hpcrun_malloc);
   return curr;
 }
 
@@ -533,16 +551,9 @@ hpcrun_new_metric_data_list_kind(kind_info_t *kind)
 metric_data_list_t *
 hpcrun_new_metric_data_list_kind_final(kind_info_t *kind)
 {
-  metric_data_list_t *curr = malloc(sizeof(metric_data_list_t));
   hpcrun_get_num_kind_metrics();
-  curr->kind = kind;
-  int n_metrics = hpcrun_get_num_metrics(curr->kind);
-  curr->metrics = malloc(n_metrics * sizeof(hpcrun_metricVal_t));
-  // FIXME(Keren): duplicate?
-  for (int i = 0; i < n_metrics; i++)
-    curr->metrics[i].v1 = curr->kind->null_metrics[i];
-  memset(curr->metrics, 0, n_metrics * sizeof(hpcrun_metricVal_t));
-  curr->next = NULL;
+  metric_data_list_t *curr = new_kind_table(malloc);
+  curr->kind_metrics[kind->id] = new_kind_metrics(kind, malloc);
   return curr;
 }
 
@@ -555,16 +566,31 @@ hpcrun_metric_set_dense_copy(cct_metric_data_t* dest,
 			     int num_metrics)
 {
   kind_info_t *curr_k;
-  metric_data_list_t *curr;
 
   for (curr_k = first_kind; curr_k != NULL; curr_k = curr_k->link) {
-    for (curr = list; curr != NULL && curr->kind != curr_k; curr = curr->next);
-    metric_set_t* actual = curr ? curr->metrics : (metric_set_t*) curr_k->null_metrics;
+    metric_set_t* actual = list ? list->kind_metrics[curr_k->id] : NULL;
+    if (actual == NULL) {
+      actual = (metric_set_t*) curr_k->null_metrics;
+    }
     memcpy((char*) dest, (char*) actual, curr_k->idx * sizeof(cct_metric_data_t));
     dest += curr_k->idx;
   }
 }
 
+//
+// reset all values in a metric data list to zero
+//
+void
+hpcrun_metric_data_list_clear(metric_data_list_t *list)
+{
+  for (kind_info_t *kind = first_kind; kind != NULL; kind = kind->link) {
+    metric_set_t *metrics = list->kind_metrics[kind->id];
+    if (metrics != NULL) {
+      memset(metrics, 0, hpcrun_get_num_metrics(kind) * sizeof(hpcrun_metricVal_t));
+    }
+  }
+}
+
 //
 // merge two metrics list
 // pre-condition: dest_list is not NULL
@@ -572,21 +598,20 @@ hpcrun_metric_set_dense_copy(cct_metric_data_t* dest,
 metric_data_list_t *
 hpcrun_merge_cct_metrics(metric_data_list_t *dest_list, metric_data_list_t *source_list)
 {
-  metric_data_list_t *curr_source = NULL;
-  metric_data_list_t *curr_dest = NULL;
-
-  for (curr_source = source_list; curr_source != NULL; curr_source = curr_source->next) {
-    metric_data_list_t *rv = dest_list;
-    for (curr_dest = rv; curr_dest != NULL && curr_dest->kind != curr_source->kind;
-      rv = curr_dest, curr_dest = curr_dest->next);
-    // Allocate a new metric_data_list
-    if (curr_dest == NULL) {
-      curr_dest = hpcrun_new_metric_data_list_kind_final(curr_source->kind);
-      rv->next = curr_dest;
+  for (kind_info_t *kind = first_kind; kind != NULL; kind = kind->link) {
+    metric_set_t *source = source_list->kind_metrics[kind->id];
+    if (source == NULL) {
+      continue;
+    }
+    metric_set_t *dest = dest_list->kind_metrics[kind->id];
+    // Allocate new metrics for the kind
+    if (dest == NULL) {
+      dest = new_kind_metrics(kind, malloc);
+      dest_list->kind_metrics[kind->id] = dest;
     }
-    int n_metrics = hpcrun_get_num_metrics(curr_source->kind);
+    int n_metrics = hpcrun_get_num_metrics(kind);
     for (int i = 0; i < n_metrics; i++)
-      curr_dest->metrics[i].v1.i += curr_source->metrics[i].v1.i;
+      dest[i].v1.i += source[i].v1.i;
   }
 
   return dest_list;
@@ -104,6 +104,9 @@ typedef cct_metric_data_t (*metric_bin_fn)(cct_metric_data_t v1, cct_metric_data
 
 typedef struct kind_info_t kind_info_t;
 
+// returns NULL once the metrics are finalized (cf.
+// hpcrun_metrics_data_finalize); a metric of a NULL kind, or of a
+// closed kind, gets id -1, which callers must not sample
 kind_info_t* hpcrun_metrics_new_kind();
 
 void hpcrun_close_kind(kind_info_t *kind);
@@ -169,6 +172,8 @@ extern void hpcrun_metric_set_dense_copy(cct_metric_data_t* dest,
 					 metric_data_list_t* list,
 					 int num_metrics);
 
+extern void hpcrun_metric_data_list_clear(metric_data_list_t *list);
+
 extern metric_data_list_t *hpcrun_merge_cct_metrics(metric_data_list_t *dest, metric_data_list_t *source);
 
 #endif // METRICS_H
@@ -290,13 +290,15 @@ ompt_mutex_blame_shift_register
 }
 
 
-static void
+static int
 ompt_register_mutex_metrics
 (
  void
 )
 {
   kind_info_t *mut_kind = hpcrun_metrics_new_kind();
+  if (mut_kind == NULL) return 0; // metrics already finalized
+
   omp_mutex_blame_info.wait_metric_id = 
     hpcrun_set_new_metric_info_and_period(mut_kind, "OMP_MUTEX_WAIT", 
 				    MetricFlags_ValFmt_Int, 1, metric_property_none);
@@ -305,6 +307,7 @@ ompt_register_mutex_metrics
     hpcrun_set_new_metric_info_and_period(mut_kind, "OMP_MUTEX_BLAME",
 				    MetricFlags_ValFmt_Int, 1, metric_property_none);
   hpcrun_close_kind(mut_kind);
+  return 1;
 }
 
 
@@ -915,8 +918,16 @@ ompt_mutex_blame_shift_request
   void
 )
 {
-  ompt_mutex_blame_requested = 1;
-  ompt_register_mutex_metrics();
+  // ompt_initialize repeats the request of the OMP_MUTEX sample source
+  if (ompt_mutex_blame_requested) return;
+
+  if (ompt_register_mutex_metrics()) {
+    ompt_mutex_blame_requested = 1;
+  } else {
+    printf("hpcrun warning: OMP_MUTEX blame was requested after hpcrun\n"
+           "began sampling. As a result OMP_MUTEX blame will not be\n"
+           "monitored or reported.\n");
+  }
 }
 
 
@@ -94,6 +94,7 @@
 #include <hpcrun/main.h>
 #include <hpcrun/metrics.h>
 #include <hpcrun/safe-sampling.h>
+#include <hpcrun/sample_budget.h>
 #include <hpcrun/sample_event.h>
 #include <hpcrun/sample_sources_registered.h>
 #include <hpcrun/thread_data.h>
@@ -207,6 +208,9 @@ static sigset_t timer_mask;
 
 static __thread bool wallclock_ok = false;
 
+// overhead-budget scale of the period the timer was last armed with
+static __thread double timer_scale = 1.0;
+
 // ****************************************************************************
 // * public helper function
 // ****************************************************************************
@@ -286,16 +290,31 @@ hpcrun_settime(thread_data_t *td, struct itimerspec *spec)
   return timer_settime(mytimer, 0, spec, NULL);
 }
 
+// The period is stretched by the thread's overhead-budget scale
+// (cf. sample_budget.c).
 static int
 hpcrun_start_timer(thread_data_t *td)
 {
+  timer_scale = hpcrun_sample_budget_scale();
+  uint64_t usec = (uint64_t) (period * timer_scale);
+  if (usec < 1) {
+    // a zero it_value would disarm the timer
+    usec = 1;
+  }
+
 #ifdef ENABLE_CLOCK_REALTIME
   if (use_realtime || use_cputime) {
-    return hpcrun_settime(td, &itspec_start);
+    struct itimerspec spec = itspec_start;
+    spec.it_value.tv_sec = usec / 1000000;
+    spec.it_value.tv_nsec = 1000 * (usec % 1000000);
+    return hpcrun_settime(td, &spec);
   }
 #endif
 
-  return setitimer(ITIMER_TYPE, &itval_start, NULL);
+  struct itimerval val = itval_start;
+  val.it_value.tv_sec = usec / 1000000;
+  val.it_value.tv_usec = usec % 1000000;
+  return setitimer(ITIMER_TYPE, &val, NULL);
 }
 
 static int
@@ -734,6 +753,10 @@ itimer_signal_handler(int sig, siginfo_t* siginfo, void* context)
 #endif
   // convert microseconds to seconds
   hpcrun_metricVal_t metric_delta = {.r = metric_incr / 1.0e6}; 
+#if !defined (USE_ELAPSED_TIME_FOR_WALLCLOCK)
+  // a sample of a stretched period stands for that much more time
+  metric_delta.r *= timer_scale;
+#endif
 
   int metric_id = hpcrun_event2metric(self, ITIMER_EVENT);
   sample_val_t sv = hpcrun_sample_callpath(context, metric_id, metric_delta,
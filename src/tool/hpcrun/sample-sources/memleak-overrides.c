@@ -62,6 +62,7 @@
 #include <sys/time.h>
 #include <sys/types.h>
 #include <assert.h>
+#include <pthread.h>
 #include <errno.h>
 #include <fcntl.h>
 #include <stdint.h>
@@ -94,7 +95,7 @@
 #include <sample_event.h>
 #include <monitor-exts/monitor_ext.h>
 #include <lib/prof-lean/spinlock.h>
-#include <lib/prof-lean/splay-macros.h>
+#include <lib/prof-lean/stdatomic.h>
 
 // FIXME: the inline getcontext macro is broken on 32-bit x86, so
 // revert to the getcontext syscall for now.
@@ -117,10 +118,16 @@ typedef struct leakinfo_s {
   cct_node_t *context;
   size_t bytes;
   void *memblock;
-  struct leakinfo_s *left;
-  struct leakinfo_s *right;
+  struct leakinfo_s *next;
 } leakinfo_t;
 
+// One chain of the footer table.  Each bucket has its own lock, so
+// threads only contend when their blocks hash to the same bucket.
+typedef struct memleak_bucket_s {
+  spinlock_t lock;
+  _Atomic(leakinfo_t *) head;
+} memleak_bucket_t;
+
 leakinfo_t leakinfo_NULL = { .magic = 0, .context = NULL, .bytes = 0 };
 
 typedef void *memalign_fcn(size_t, size_t);
@@ -140,6 +147,10 @@ typedef void *realloc_fcn(void *, size_t);
 #define MEMLEAK_MAGIC 0x68706374
 #define MEMLEAK_DEFAULT_PAGESIZE  4096
 
+// number of buckets in the footer table, as a power of 2
+#define MEMLEAK_TABLE_BITS  14
+#define MEMLEAK_TABLE_SIZE  (1 << MEMLEAK_TABLE_BITS)
+
 #define HPCRUN_MEMLEAK_PROB  "HPCRUN_MEMLEAK_PROB"
 #define DEFAULT_PROB  0.1
 
@@ -170,12 +181,15 @@ extern realloc_fcn        real_realloc;
  *****************************************************************************/
 
 static int leak_detection_enabled = 0; // default is off
-static int leak_detection_init = 0;    // default is uninitialized
+static pthread_once_t leak_detection_once = PTHREAD_ONCE_INIT;
 static int use_memleak_prob = 0;
 static float memleak_prob = 0.0;
 
-static struct leakinfo_s *memleak_tree_root = NULL;
-static spinlock_t memtree_lock = SPINLOCK_UNLOCKED;
+// Leakinfo structs stored as footers, indexed by application pointer.
+// Headers are found from the pointer itself and are not in the table.
+// N.B.: a zeroed spinlock is not unlocked, so the table must not be
+// used before memleak_table_init() (cf. memleak_initialize).
+static memleak_bucket_t memleak_table[MEMLEAK_TABLE_SIZE];
 
 static int leakinfo_size = sizeof(struct leakinfo_s);
 static long memleak_pagesize = MEMLEAK_DEFAULT_PAGESIZE;
@@ -193,81 +207,83 @@ static char *loc_name[4] = {
 
 
 /******************************************************************************
- * splay operations
+ * footer table operations
  *****************************************************************************/
 
 
-static struct leakinfo_s *
-splay(struct leakinfo_s *root, void *key)
+static void
+memleak_table_init(void)
+{
+  for (int i = 0; i < MEMLEAK_TABLE_SIZE; i++) {
+    spinlock_init(&memleak_table[i].lock);
+    atomic_init(&memleak_table[i].head, NULL);
+  }
+}
+
+
+// Fibonacci hash of the block address.  The low bits are dropped
+// because malloc returns (at least) 16-byte aligned blocks.
+static inline memleak_bucket_t *
+memleak_table_bucket(void *memblock)
 {
-  REGULAR_SPLAY_TREE(leakinfo_s, root, key, memblock, left, right);
-  return root;
+  uint64_t key = ((uintptr_t) memblock) >> 4;
+
+  return &memleak_table[(key * 11400714819323198485ull)
+			>> (64 - MEMLEAK_TABLE_BITS)];
 }
 
 
 static void
-splay_insert(struct leakinfo_s *node)
+memleak_table_insert(struct leakinfo_s *node)
 {
-  void *memblock = node->memblock;
-
-  node->left = node->right = NULL;
-
-  spinlock_lock(&memtree_lock);  
-  if (memleak_tree_root != NULL) {
-    memleak_tree_root = splay(memleak_tree_root, memblock);
-
-    if (memblock < memleak_tree_root->memblock) {
-      node->left = memleak_tree_root->left;
-      node->right = memleak_tree_root;
-      memleak_tree_root->left = NULL;
-    } else if (memblock > memleak_tree_root->memblock) {
-      node->left = memleak_tree_root;
-      node->right = memleak_tree_root->right;
-      memleak_tree_root->right = NULL;
-    } else {
-      TMSG(MEMLEAK, "memleak splay tree: unable to insert %p (already present)", 
-	   node->memblock);
-      assert(0);
-    }
-  }
-  memleak_tree_root = node;
-  spinlock_unlock(&memtree_lock);  
+  memleak_bucket_t *bucket = memleak_table_bucket(node->memblock);
+
+  spinlock_lock(&bucket->lock);
+  node->next = atomic_load_explicit(&bucket->head, memory_order_relaxed);
+  atomic_store_explicit(&bucket->head, node, memory_order_release);
+  spinlock_unlock(&bucket->lock);
 }
 
 
 static struct leakinfo_s *
-splay_delete(void *memblock)
+memleak_table_delete(void *memblock)
 {
-  struct leakinfo_s *result = NULL;
-
-  spinlock_lock(&memtree_lock);  
-  if (memleak_tree_root == NULL) {
-    spinlock_unlock(&memtree_lock);  
-    TMSG(MEMLEAK, "memleak splay tree empty: unable to delete %p", memblock);
+  memleak_bucket_t *bucket = memleak_table_bucket(memblock);
+
+  // Most frees are of blocks that were never put in the table, and
+  // most buckets are empty, so check without taking the lock.  This
+  // is safe because a block being freed was inserted (if at all)
+  // before the application could pass it to free.
+  if (atomic_load_explicit(&bucket->head, memory_order_acquire) == NULL) {
+    TMSG(MEMLEAK, "memleak table: %p not in table", memblock);
     return NULL;
   }
 
-  memleak_tree_root = splay(memleak_tree_root, memblock);
+  spinlock_lock(&bucket->lock);
 
-  if (memblock != memleak_tree_root->memblock) {
-    spinlock_unlock(&memtree_lock);  
-    TMSG(MEMLEAK, "memleak splay tree: %p not in tree", memblock);
-    return NULL;
+  struct leakinfo_s *prev = NULL;
+  struct leakinfo_s *node =
+    atomic_load_explicit(&bucket->head, memory_order_relaxed);
+  while (node != NULL && node->memblock != memblock) {
+    prev = node;
+    node = node->next;
   }
 
-  result = memleak_tree_root;
-
-  if (memleak_tree_root->left == NULL) {
-    memleak_tree_root = memleak_tree_root->right;
-    spinlock_unlock(&memtree_lock);  
-    return result;
+  if (node != NULL) {
+    if (prev == NULL) {
+      atomic_store_explicit(&bucket->head, node->next, memory_order_relaxed);
+    } else {
+      prev->next = node->next;
+    }
+    node->next = NULL;
   }
 
-  memleak_tree_root->left = splay(memleak_tree_root->left, memblock);
-  memleak_tree_root->left->right = memleak_tree_root->right;
-  memleak_tree_root =  memleak_tree_root->left;
-  spinlock_unlock(&memtree_lock);  
-  return result;
+  spinlock_unlock(&bucket->lock);
+
+  if (node == NULL) {
+    TMSG(MEMLEAK, "memleak table: %p not in table", memblock);
+  }
+  return node;
 }
 
 
@@ -300,16 +316,13 @@ string_to_prob(char *str)
 
 
 static void
-memleak_initialize(void)
+memleak_initialize_once(void)
 {
   struct timeval tv;
   char *prob_str;
   unsigned int seed;
   int fd;
 
-  if (leak_detection_init)
-    return;
-
 #ifdef _SC_PAGESIZE
   memleak_pagesize = sysconf(_SC_PAGESIZE);
 #else
@@ -335,14 +348,26 @@ memleak_initialize(void)
     srandom(seed);
   }
 
+  memleak_table_init();
+
   // unconditionally enable leak detection for now
   leak_detection_enabled = 1;
-  leak_detection_init = 1;
 
   TMSG(MEMLEAK, "init");
 }
 
 
+// Threads may malloc concurrently from the start, so initialize the
+// table exactly once, and make the others wait until it is ready.
+// Any malloc within the initialization goes straight to the real one,
+// because the caller is in hpcrun (cf. hpcrun_safe_enter).
+static void
+memleak_initialize(void)
+{
+  pthread_once(&leak_detection_once, memleak_initialize_once);
+}
+
+
 // Returns: 1 if p1 and p2 are on the same physical page.
 //
 static inline int
@@ -412,7 +437,7 @@ memleak_get_free_loc(void *appl_ptr, void **sys_ptr, leakinfo_t **info_ptr)
 
   // always try footer
   *sys_ptr = appl_ptr;
-  *info_ptr = splay_delete(appl_ptr);
+  *info_ptr = memleak_table_delete(appl_ptr);
   if (*info_ptr == NULL) {
     return MEMLEAK_LOC_NONE;
   }
@@ -435,7 +460,7 @@ memleak_get_free_loc(void *appl_ptr, void **sys_ptr, leakinfo_t **info_ptr)
 }
 
 
-// Fill in the leakinfo struct, add metric to CCT, add to splay tree
+// Fill in the leakinfo struct, add metric to CCT, add to footer table
 // (if footer) and print TMSG.
 //
 static void
@@ -455,8 +480,7 @@ memleak_add_leakinfo(const char *name, void *sys_ptr, void *appl_ptr,
   info_ptr->magic = MEMLEAK_MAGIC;
   info_ptr->bytes = bytes;
   info_ptr->memblock = appl_ptr;
-  info_ptr->left = NULL;
-  info_ptr->right = NULL;
+  info_ptr->next = NULL;
   if (hpcrun_memleak_active()) {
     sample_val_t smpl =
       hpcrun_sample_callpath(uc, hpcrun_memleak_alloc_id(), 
@@ -469,7 +493,7 @@ memleak_add_leakinfo(const char *name, void *sys_ptr, void *appl_ptr,
     loc_str = "inactive";
   }
   if (loc == MEMLEAK_LOC_FOOT) {
-    splay_insert(info_ptr);
+    memleak_table_insert(info_ptr);
   }
 
   TMSG(MEMLEAK, "%s: bytes: %ld sys: %p appl: %p info: %p cct: %p (%s)",
@@ -98,6 +98,7 @@
 #include <hpcrun/messages/messages.h>
 #include <hpcrun/metrics.h>
 #include <hpcrun/safe-sampling.h>
+#include <hpcrun/sample_budget.h>
 #include <hpcrun/sample_event.h>
 #include <hpcrun/sample_sources_registered.h>
 #include <hpcrun/sample-sources/blame-shift/blame-shift.h>
@@ -272,6 +273,49 @@ perf_stop_all(int nevents, event_thread_t *event_thread)
   }
 }
 
+/*
+ * Stretch the sampling period of the events by the thread's
+ * overhead-budget scale (cf. sample_budget.c), or divide their
+ * frequency by it.  Context switches are counted one by one.
+ */
+static void
+perf_scale_all(int nevents, event_thread_t *event_thread)
+{
+#ifdef PERF_EVENT_IOC_PERIOD
+  double scale = hpcrun_sample_budget_scale();
+  int i;
+
+  for(i=0; i<nevents; i++) {
+    event_thread_t *et = &event_thread[i];
+    if (et->fd<0 || et->event == NULL || et->event->attr.context_switch)
+      continue;
+
+    struct perf_event_attr *attr = &et->event->attr;
+    u64 period;
+    if (attr->freq) {
+      // the kernel refuses a frequency above its maximum sample rate
+      double freq = attr->sample_freq / scale;
+      double max_freq = perf_util_get_max_sample_rate() - 1;
+      period = (freq < 1) ? 1 : ((freq > max_freq) ? max_freq : freq);
+    } else {
+      period = attr->sample_period * scale;
+      if (period < 1)
+        period = 1;
+    }
+    if (period == et->period)
+      continue;
+
+    int ret = ioctl(et->fd, PERF_EVENT_IOC_PERIOD, &period);
+    if (ret == -1) {
+      EMSG("Can't set period %lu for event with fd: %d: %s",
+           period, et->fd, strerror(errno));
+    } else {
+      et->period = period;
+    }
+  }
+#endif
+}
+
 static int
 perf_get_pmu_support(const char *name, struct perf_event_attr *event_attr)
 {
@@ -379,6 +423,7 @@ static bool
 perf_thread_init(event_info_t *event, event_thread_t *et)
 {
   et->event = event;
+  et->period = event->attr.sample_period;
   // ask sys to "create" the event
   // it returns -1 if it fails.
   et->fd = perf_event_open(&event->attr,
@@ -502,11 +547,18 @@ record_sample(event_thread_t *current, perf_mmap_data_t *mmap_data,
 
   // ----------------------------------------------------------------------------
   // for event with frequency, we need to increase the counter by its period
-  // sampling taken by perf event kernel
+  // sampling taken by perf event kernel.
+  // for event with a period, a sample taken with a period stretched or
+  // shrunk by the overhead budget (cf. perf_scale_all) weighs that much
+  // more or less
   // ----------------------------------------------------------------------------
-  uint64_t metric_inc = 1;
+  double metric_inc = 1;
   if (current->event->attr.freq==1 && mmap_data->period > 0)
     metric_inc = mmap_data->period;
+  else if (mmap_data->period > 0
+           && mmap_data->period != current->event->attr.sample_period
+           && current->event->attr.sample_period > 0)
+    metric_inc = (double) mmap_data->period / current->event->attr.sample_period;
 
   // ----------------------------------------------------------------------------
   // record time enabled and time running
@@ -1165,6 +1217,7 @@ perf_event_handler(
 
   } while (more_data);
 
+  perf_scale_all(nevents, event_thread);
   perf_start_all(nevents, event_thread);
 
   hpcrun_safe_exit();
@@ -137,6 +137,7 @@ typedef struct event_thread_s {
   pe_mmap_t    *mmap;  // mmap buffer
   int          fd;     // file descriptor of the event
   event_info_t *event; // pointer to main event description
+  u64          period; // sampling period (or frequency) in effect
 
 } event_thread_t;
 
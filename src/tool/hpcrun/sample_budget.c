@@ -0,0 +1,215 @@
+// -*-Mode: C++;-*- // technically C99
+
+// * BeginRiceCopyright *****************************************************
+//
+// $HeadURL$
+// $Id$
+//
+// --------------------------------------------------------------------------
+// Part of HPCToolkit (hpctoolkit.org)
+//
+// Information about sources of support for research and development of
+// HPCToolkit is at 'hpctoolkit.org' and in 'README.Acknowledgments'.
+// --------------------------------------------------------------------------
+//
+// Copyright ((c)) 2002-2020, Rice University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+//
+// * Neither the name of Rice University (RICE) nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+//
+// This software is provided by RICE and contributors "as is" and any
+// express or implied warranties, including, but not limited to, the
+// implied warranties of merchantability and fitness for a particular
+// purpose are disclaimed. In no event shall RICE or contributors be
+// liable for any direct, indirect, incidental, special, exemplary, or
+// consequential damages (including, but not limited to, procurement of
+// substitute goods or services; loss of use, data, or profits; or
+// business interruption) however caused and on any theory of liability,
+// whether in contract, strict liability, or tort (including negligence
+// or otherwise) arising in any way out of the use of this software, even
+// if advised of the possibility of such damage.
+//
+// ******************************************************* EndRiceCopyright *
+//***************************************************************************
+//
+// File:
+//   sample_budget.c
+//
+// Purpose:
+//   Overhead-budgeted sampling.  With HPCRUN_OVERHEAD_BUDGET=<pct>, each
+//   thread measures the CPU time it spends in hpcrun_sample_callpath()
+//   and, once per window of about 100 ms of its CPU time, compares it
+//   with <pct> percent of the window.  The thread's scale is multiplied
+//   by the ratio of the two (at most halved or doubled per window) and
+//   kept between SAMPLE_BUDGET_MIN_SCALE and SAMPLE_BUDGET_MAX_SCALE.
+//   So, the scale rises in bursty phases with deep stacks, and falls
+//   below 1 in quiet ones, which then get more samples than the
+//   configured period gives.
+//
+//   Both times are thread CPU times (CLOCK_THREAD_CPUTIME_ID): the
+//   budget is a share of what the thread computes, so that time the
+//   thread is blocked or descheduled does not hide the overhead.
+//
+//   Sample sources that can change their period on the fly multiply
+//   it by the scale of the thread when they rearm (itimer, perf).  Each
+//   sample then stands for a longer period, and a source weighs it by
+//   the period that was actually in effect, so that metric totals
+//   stay unbiased:
+//
+//   - itimer: WALLCLOCK/REALTIME/CPUTIME already measure the time
+//     elapsed since the previous sample.
+//   - perf: the kernel reports the period of each sample
+//     (PERF_SAMPLE_PERIOD).
+//
+//   The state is per thread and only ever touched by the thread in its
+//   own sample handler, so there is no locking.  Without a budget, the
+//   scale is always 1 and the clock is never read.
+//
+//   UnitTests/sample_budget_test.c runs a synthetic load through it.
+//
+//***************************************************************************
+
+//***************************************************************************
+// system include files
+//***************************************************************************
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <time.h>
+
+
+//***************************************************************************
+// user include files
+//***************************************************************************
+
+#include "env.h"
+#include "sample_budget.h"
+
+#include <messages/messages.h>
+
+
+//***************************************************************************
+// local constants
+//***************************************************************************
+
+// length of a measurement window (in ns of thread CPU time)
+#define SAMPLE_BUDGET_WINDOW     100000000
+
+// at most 8 times as many samples as the configured period gives, so
+// that periods stay well above the resolution of the timers
+#define SAMPLE_BUDGET_MIN_SCALE  0.125
+#define SAMPLE_BUDGET_MAX_SCALE  1000.0
+
+
+//***************************************************************************
+// local data
+//***************************************************************************
+
+// fraction of time a thread may spend handling samples, 0 = no budget
+static double sample_budget = 0.0;
+
+static __thread uint64_t window_beg = 0;
+static __thread uint64_t window_busy = 0;
+static __thread double   window_scale = 1.0;
+
+
+//***************************************************************************
+// private operations
+//***************************************************************************
+
+static uint64_t
+sample_budget_time(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+  return ((uint64_t) ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+
+static double
+clamp(double x, double lo, double hi)
+{
+  return (x < lo) ? lo : ((x > hi) ? hi : x);
+}
+
+
+//***************************************************************************
+// interface functions
+//***************************************************************************
+
+void
+hpcrun_sample_budget_init(void)
+{
+  char* str = getenv(HPCRUN_OVERHEAD_BUDGET);
+  if (str == NULL) {
+    return;
+  }
+
+  double pct = atof(str);
+  if (pct <= 0.0 || pct >= 100.0) {
+    EMSG("invalid %s: '%s'", HPCRUN_OVERHEAD_BUDGET, str);
+    return;
+  }
+  sample_budget = pct / 100.0;
+  TMSG(SAMPLE, "overhead budget: %g%%", pct);
+}
+
+
+uint64_t
+hpcrun_sample_budget_begin(void)
+{
+  return (sample_budget > 0.0) ? sample_budget_time() : 0;
+}
+
+
+void
+hpcrun_sample_budget_end(uint64_t beg)
+{
+  if (beg == 0) {
+    return;
+  }
+
+  uint64_t now = sample_budget_time();
+  if (window_beg == 0) {
+    window_beg = beg;
+  }
+  window_busy += now - beg;
+
+  uint64_t elapsed = now - window_beg;
+  if (elapsed < SAMPLE_BUDGET_WINDOW) {
+    return;
+  }
+
+  // the overhead is inversely proportional to the period, so scaling
+  // by the ratio converges in a few windows
+  double overhead = (double) window_busy / elapsed;
+  double ratio = clamp(overhead / sample_budget, 0.5, 2.0);
+  window_scale = clamp(window_scale * ratio, SAMPLE_BUDGET_MIN_SCALE,
+                       SAMPLE_BUDGET_MAX_SCALE);
+
+  TMSG(SAMPLE, "overhead %.2f%% of budget %.2f%%: period scale %g",
+       100.0 * overhead, 100.0 * sample_budget, window_scale);
+
+  window_beg = now;
+  window_busy = 0;
+}
+
+
+double
+hpcrun_sample_budget_scale(void)
+{
+  return window_scale;
+}
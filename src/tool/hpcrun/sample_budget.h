@@ -0,0 +1,77 @@
+// -*-Mode: C++;-*- // technically C99
+
+// * BeginRiceCopyright *****************************************************
+//
+// $HeadURL$
+// $Id$
+//
+// --------------------------------------------------------------------------
+// Part of HPCToolkit (hpctoolkit.org)
+//
+// Information about sources of support for research and development of
+// HPCToolkit is at 'hpctoolkit.org' and in 'README.Acknowledgments'.
+// --------------------------------------------------------------------------
+//
+// Copyright ((c)) 2002-2020, Rice University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+//
+// * Neither the name of Rice University (RICE) nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+//
+// This software is provided by RICE and contributors "as is" and any
+// express or implied warranties, including, but not limited to, the
+// implied warranties of merchantability and fitness for a particular
+// purpose are disclaimed. In no event shall RICE or contributors be
+// liable for any direct, indirect, incidental, special, exemplary, or
+// consequential damages (including, but not limited to, procurement of
+// substitute goods or services; loss of use, data, or profits; or
+// business interruption) however caused and on any theory of liability,
+// whether in contract, strict liability, or tort (including negligence
+// or otherwise) arising in any way out of the use of this software, even
+// if advised of the possibility of such damage.
+//
+// ******************************************************* EndRiceCopyright *
+//***************************************************************************
+//
+// File:
+//   sample_budget.h
+//
+// Purpose:
+//   Hold the measurement overhead of each thread to a budget by
+//   stretching its sampling periods (cf. sample_budget.c).
+//
+//***************************************************************************
+
+#ifndef _HPCRUN_SAMPLE_BUDGET_H_
+#define _HPCRUN_SAMPLE_BUDGET_H_
+
+#include <stdint.h>
+
+// read the overhead budget from the environment
+void hpcrun_sample_budget_init(void);
+
+// called at the start of handling a sample: returns a time stamp to
+// pass to hpcrun_sample_budget_end(), or 0 when there is no budget
+uint64_t hpcrun_sample_budget_begin(void);
+
+// called at the end of handling a sample: charge its time to the
+// calling thread and adjust the thread's scale
+void hpcrun_sample_budget_end(uint64_t beg);
+
+// factor (1.0 without a budget) by which the calling thread should
+// multiply its sampling periods, or divide its sampling frequencies
+double hpcrun_sample_budget_scale(void);
+
+#endif // _HPCRUN_SAMPLE_BUDGET_H_
@@ -60,7 +60,9 @@
 #include "metrics_types.h"
 #include "cct2metrics.h"
 #include "metrics.h"
+#include "sample_budget.h"
 #include "segv_handler.h"
+#include "snapshot.h"
 #include "epoch.h"
 #include "thread_data.h"
 #include "trace.h"
@@ -209,6 +211,8 @@ hpcrun_sample_callpath(void* context, int metricId,
   TMSG(SAMPLE_CALLPATH, "attempting sample");
   hpcrun_stats_num_samples_attempted_inc();
 
+  uint64_t budget_beg = hpcrun_sample_budget_begin();
+
   thread_data_t* td   = hpcrun_get_thread_data();
   sigjmp_buf_t* it    = &(td->bad_unwind);
   sigjmp_buf_t* old   = td->current_jmp_buf;
@@ -308,6 +312,9 @@ hpcrun_sample_callpath(void* context, int metricId,
   }
 
   hpcrun_clear_handling_sample(td);
+  // taking a snapshot's image of the cct counts against the budget
+  hpcrun_snapshot_poll(&(TD_GET(core_profile_trace_data)));
+  hpcrun_sample_budget_end(budget_beg);
   if (TD_GET(mem_low) || ENABLED(FLUSH_EVERY_SAMPLE)) {
     hpcrun_flush_epochs(&(TD_GET(core_profile_trace_data)));
     hpcrun_reclaim_freeable_mem();
@@ -0,0 +1,552 @@
+// -*-Mode: C++;-*- // technically C99
+
+// * BeginRiceCopyright *****************************************************
+//
+// $HeadURL$
+// $Id$
+//
+// --------------------------------------------------------------------------
+// Part of HPCToolkit (hpctoolkit.org)
+//
+// Information about sources of support for research and development of
+// HPCToolkit is at 'hpctoolkit.org' and in 'README.Acknowledgments'.
+// --------------------------------------------------------------------------
+//
+// Copyright ((c)) 2002-2020, Rice University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+//
+// * Neither the name of Rice University (RICE) nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+//
+// This software is provided by RICE and contributors "as is" and any
+// express or implied warranties, including, but not limited to, the
+// implied warranties of merchantability and fitness for a particular
+// purpose are disclaimed. In no event shall RICE or contributors be
+// liable for any direct, indirect, incidental, special, exemplary, or
+// consequential damages (including, but not limited to, procurement of
+// substitute goods or services; loss of use, data, or profits; or
+// business interruption) however caused and on any theory of liability,
+// whether in contract, strict liability, or tort (including negligence
+// or otherwise) arising in any way out of the use of this software, even
+// if advised of the possibility of such damage.
+//
+// ******************************************************* EndRiceCopyright *
+
+//***************************************************************************
+//
+// File:
+//   snapshot.c
+//
+// Purpose:
+//   Snapshots of the profiles of a long-running process, which may
+//   never exit cleanly and so never write its profiles.  A snapshot is
+//   requested by
+//
+//   (1) the signal given by HPCRUN_SNAPSHOT_SIGNAL,
+//   (2) every HPCRUN_SNAPSHOT_INTERVAL seconds, or
+//   (3) the application, with hpctoolkit_snapshot().
+//
+//   A request bumps the process-wide snapshot sequence number.  A
+//   thread only ever takes a snapshot of its own profile: at its next
+//   sample after a request, the sample handler encodes the thread's
+//   ccts into memory of their own (cf. hpcrun_profile_image_new) and
+//   queues this image for a writer thread, which writes it to
+//   <profile>.snap<seq>.hpcrun.  The handler neither opens files nor
+//   uses stdio, and the encoding counts against the sample budget.
+//   Thus, the snapshot of a thread is consistent without stopping any
+//   thread, and is taken within one sampling period of the request.  A
+//   thread that takes no sample after a request takes no snapshot for
+//   it, and one whose previous snapshot is still being written takes
+//   the next one at a later sample.
+//
+//   With HPCRUN_SNAPSHOT_DELTA, a thread zeroes its metrics after each
+//   snapshot, so that each snapshot (<profile>.delta<seq>.hpcrun) and
+//   the final profile hold what was measured since the one before, and
+//   hpcprof adds them up.  Otherwise, snapshots are cumulative and
+//   hpcprof uses the final profile of a thread or else its newest
+//   snapshot.  A thread keeps only its newest cumulative snapshot on
+//   disk.
+//
+//   A thread low on memory flushes its epochs to <profile>.flushed.hpcrun
+//   (cf. hpcrun_flush_epochs) and starts over with empty ones, so that
+//   the file is renamed to the profile only once the thread ends.  The
+//   flush also removes the thread's cumulative snapshot, which the
+//   flushed epochs contain: a cumulative snapshot always holds what
+//   was measured since the last flush, and hpcprof adds it to the
+//   flushed profile of a thread that did not end.
+//
+//***************************************************************************
+
+//***************************************************************************
+// system include files
+//***************************************************************************
+
+#include <errno.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+
+//***************************************************************************
+// libmonitor include files
+//***************************************************************************
+
+#include <monitor.h>
+
+
+//***************************************************************************
+// user include files
+//***************************************************************************
+
+#include "disabled.h"
+#include "env.h"
+#include "files.h"
+#include "metrics.h"
+#include "safe-sampling.h"
+#include "snapshot.h"
+#include "thread_data.h"
+#include "write_data.h"
+#include "hpcrun_return_codes.h"
+#include "rank.h"
+
+#include "sample_prob.h"
+#include "cct/cct.h"
+
+#include <memory/hpcrun-malloc.h>
+#include <messages/messages.h>
+#include <lib/prof-lean/hpcrun-fmt.h>
+#include <lib/prof-lean/producer_wfq.h>
+
+
+//***************************************************************************
+// type declarations
+//***************************************************************************
+
+enum {
+  JOB_IDLE,     // the thread owns the job
+  JOB_QUEUED,   // the writer owns the job
+  JOB_DISCARD   // ... and must remove the snapshot once written
+};
+
+enum {
+  WRITER_NONE,
+  WRITER_STARTING,
+  WRITER_RUNNING,
+  WRITER_FAILED
+};
+
+// A thread's snapshot for the writer thread.  Each thread has one,
+// which it queues again for each of its snapshots.
+typedef struct snapshot_job_t {
+  producer_wfq_element_ptr_t next; // must be first
+  atomic_int state;
+  hpcrun_profile_image_t* image;
+  int tid;
+  int rank;
+  uint32_t seq;
+  uint32_t file_seq;   // cumulative snapshot file on disk, or 0
+  int file_rank;       // ... and the rank in its name
+} snapshot_job_t;
+
+
+//***************************************************************************
+// local data
+//***************************************************************************
+
+static atomic_uint_least32_t snapshot_seq = ATOMIC_VAR_INIT(0);
+
+// with an interval, the next request is due at this time (in ns)
+static atomic_uint_least64_t snapshot_deadline = ATOMIC_VAR_INIT(0);
+static uint64_t snapshot_interval = 0;
+
+static bool snapshot_delta = false;
+
+static atomic_int writer_state = ATOMIC_VAR_INIT(WRITER_NONE);
+static atomic_int writer_stop = ATOMIC_VAR_INIT(0);
+static pthread_t writer;
+static producer_wfq_t writer_queue;
+static sem_t writer_wakeup;
+
+
+//***************************************************************************
+// private operations
+//***************************************************************************
+
+static uint64_t
+snapshot_time(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ((uint64_t) ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+
+static void
+snapshot_request(void)
+{
+  atomic_fetch_add_explicit(&snapshot_seq, 1, memory_order_relaxed);
+}
+
+
+static int
+snapshot_signal_handler(int sig, siginfo_t* siginfo, void* context)
+{
+  snapshot_request();
+  return 0;
+}
+
+
+// Returns: the signal number in 'str' (eg, "12", "USR2" or "SIGUSR2"),
+// else 0.
+static int
+snapshot_signal_parse(const char* str)
+{
+  if (strncmp(str, "SIG", 3) == 0) {
+    str += 3;
+  }
+  if (strcmp(str, "USR1") == 0) {
+    return SIGUSR1;
+  }
+  if (strcmp(str, "USR2") == 0) {
+    return SIGUSR2;
+  }
+  return atoi(str);
+}
+
+
+static void
+clear_metrics(cct_node_t* node, cct_op_arg_t arg, size_t level)
+{
+  metric_data_list_t* metrics = hpcrun_cct_metrics(node);
+  if (metrics) {
+    hpcrun_metric_data_list_clear(metrics);
+  }
+}
+
+
+static void
+snapshot_suffix(char *suffix, size_t len, uint32_t seq)
+{
+  snprintf(suffix, len, "%s%06u.%s",
+	   (snapshot_delta ? HPCRUN_SnapshotDeltaFnmInfix : HPCRUN_SnapshotFnmInfix),
+	   seq, HPCRUN_ProfileFnmSfx);
+}
+
+
+// remove the cumulative snapshot file of 'job', if any
+static void
+snapshot_remove(snapshot_job_t *job)
+{
+  char suffix[64];
+
+  if (job->file_seq != 0) {
+    snapshot_suffix(suffix, sizeof(suffix), job->file_seq);
+    hpcrun_unlink_profile_snapshot_file(job->file_rank, job->tid, suffix);
+    job->file_seq = 0;
+  }
+}
+
+
+// In the writer thread: write the snapshot of 'job' and hand the job
+// back to its thread.
+static void
+snapshot_write(snapshot_job_t *job)
+{
+  char suffix[64];
+  char seqStr[32];
+
+  snapshot_suffix(suffix, sizeof(suffix), job->seq);
+  snprintf(seqStr, sizeof(seqStr), "%u", job->seq);
+
+  TMSG(DATA_WRITE, "thread %d: profile snapshot %u", job->tid, job->seq);
+  int ret = hpcrun_profile_image_write(job->image, job->tid, job->rank,
+				       suffix, seqStr);
+  hpcrun_profile_image_free(job->image);
+  job->image = NULL;
+
+  if (ret == HPCRUN_OK && ! snapshot_delta) {
+    // the new snapshot supersedes the one before
+    snapshot_remove(job);
+    job->file_seq = job->seq;
+    job->file_rank = job->rank;
+  }
+
+  int state = JOB_QUEUED;
+  if (! atomic_compare_exchange_strong(&job->state, &state, JOB_IDLE)) {
+    // the thread flushed its epochs meanwhile (JOB_DISCARD)
+    snapshot_remove(job);
+    atomic_store(&job->state, JOB_IDLE);
+  }
+}
+
+
+static void *
+snapshot_writer(void *arg)
+{
+  // the writer must never run a signal handler
+  sigset_t all;
+  sigfillset(&all);
+  monitor_real_pthread_sigmask(SIG_BLOCK, &all, NULL);
+
+  snapshot_job_t *job;
+  for (;;) {
+    while (sem_wait(&writer_wakeup) != 0 && errno == EINTR)
+      ;
+
+    while ((job = (snapshot_job_t *) producer_wfq_dequeue(&writer_queue))
+	   != NULL) {
+      snapshot_write(job);
+    }
+    if (atomic_load(&writer_stop)) {
+      break;
+    }
+  }
+  return NULL;
+}
+
+
+// Start the thread that writes the snapshots, unless it is running.
+// Without it, no snapshots are taken.
+static void
+snapshot_writer_start(void)
+{
+  int state = WRITER_NONE;
+  if (! atomic_compare_exchange_strong(&writer_state, &state,
+				       WRITER_STARTING)) {
+    return;
+  }
+
+  if (sem_init(&writer_wakeup, 0, 0) != 0) {
+    EMSG("unable to start profile snapshot writer thread");
+    atomic_store(&writer_state, WRITER_FAILED);
+    return;
+  }
+  producer_wfq_init(&writer_queue);
+  atomic_store(&writer_stop, 0);
+
+  // the writer is not an application thread: hide it from libmonitor
+  monitor_disable_new_threads();
+  int ret = pthread_create(&writer, NULL, snapshot_writer, NULL);
+  monitor_enable_new_threads();
+
+  if (ret != 0) {
+    EMSG("unable to start profile snapshot writer thread");
+    atomic_store(&writer_state, WRITER_FAILED);
+    return;
+  }
+  atomic_store(&writer_state, WRITER_RUNNING);
+}
+
+
+static snapshot_job_t *
+snapshot_job(core_profile_trace_data_t *cptd)
+{
+  snapshot_job_t *job = cptd->snapshot_job;
+  if (job == NULL) {
+    job = hpcrun_malloc(sizeof(snapshot_job_t));
+    if (job == NULL) {
+      return NULL;
+    }
+    memset(job, 0, sizeof(snapshot_job_t));
+    atomic_init(&job->state, JOB_IDLE);
+    job->tid = cptd->id;
+    cptd->snapshot_job = job;
+  }
+  return job;
+}
+
+
+// wait until the writer is done with the snapshot of 'cptd', if any
+static void
+snapshot_wait(core_profile_trace_data_t *cptd)
+{
+  snapshot_job_t *job = cptd->snapshot_job;
+  if (job == NULL) {
+    return;
+  }
+  struct timespec pause = { 0, 1000000 };
+  while (atomic_load(&job->state) != JOB_IDLE) {
+    nanosleep(&pause, NULL);
+  }
+}
+
+
+//***************************************************************************
+// interface functions
+//***************************************************************************
+
+void
+hpcrun_snapshot_init(void)
+{
+  snapshot_delta = (getenv(HPCRUN_SNAPSHOT_DELTA) != NULL);
+
+  char* str = getenv(HPCRUN_SNAPSHOT_INTERVAL);
+  long seconds = (str) ? atol(str) : 0;
+  if (seconds > 0) {
+    snapshot_interval = ((uint64_t) seconds) * 1000000000;
+    atomic_store_explicit(&snapshot_deadline,
+			  snapshot_time() + snapshot_interval,
+			  memory_order_relaxed);
+  }
+
+  // in a forked child, the parent's writer does not exist
+  atomic_store(&writer_state, WRITER_NONE);
+
+  str = getenv(HPCRUN_SNAPSHOT_SIGNAL);
+  if (str) {
+    int sig = snapshot_signal_parse(str);
+    if (sig <= 0 || sig >= NSIG) {
+      EMSG("invalid %s: '%s'", HPCRUN_SNAPSHOT_SIGNAL, str);
+      str = NULL;
+    }
+    else if (monitor_sigaction(sig, &snapshot_signal_handler, 0, NULL) != 0) {
+      EMSG("unable to install profile snapshot handler for signal %d", sig);
+      str = NULL;
+    }
+  }
+
+  if ((str || snapshot_interval != 0)
+      && ! hpcrun_get_disabled() && hpcrun_sample_prob_active()) {
+    snapshot_writer_start();
+  }
+}
+
+
+// Stop the writer after all profiles are written.  Any snapshot still
+// queued is written first.
+void
+hpcrun_snapshot_fini(void)
+{
+  int state = WRITER_RUNNING;
+  if (! atomic_compare_exchange_strong(&writer_state, &state, WRITER_NONE)) {
+    return;
+  }
+  atomic_store(&writer_stop, 1);
+  sem_post(&writer_wakeup);
+  pthread_join(writer, NULL);
+}
+
+
+uint32_t
+hpcrun_snapshot_seq(void)
+{
+  return atomic_load_explicit(&snapshot_seq, memory_order_relaxed);
+}
+
+
+void
+hpcrun_snapshot_poll(core_profile_trace_data_t *cptd)
+{
+  if (snapshot_interval != 0) {
+    uint64_t now = snapshot_time();
+    uint64_t deadline =
+      atomic_load_explicit(&snapshot_deadline, memory_order_relaxed);
+    // exactly one thread wins the request for each deadline
+    if (now >= deadline
+	&& atomic_compare_exchange_strong(&snapshot_deadline, &deadline,
+					  now + snapshot_interval)) {
+      snapshot_request();
+    }
+  }
+
+  uint32_t seq = hpcrun_snapshot_seq();
+  if (seq == cptd->snapshot_seq
+      || atomic_load(&writer_state) != WRITER_RUNNING) {
+    return;
+  }
+
+  snapshot_job_t *job = snapshot_job(cptd);
+  if (job == NULL || atomic_load(&job->state) != JOB_IDLE) {
+    // the previous snapshot is still being written: try again later
+    return;
+  }
+
+  // first: do not retry a failed snapshot on every sample
+  cptd->snapshot_seq = seq;
+
+  hpcrun_profile_image_t *image = hpcrun_profile_image_new(cptd);
+  if (image == NULL) {
+    return;
+  }
+
+  if (snapshot_delta) {
+    // the cct nodes stay (trace records refer to them), only their
+    // metrics restart from zero
+    for (epoch_t* e = cptd->epoch; e; e = e->next) {
+      hpcrun_cct_walk_node_1st(e->csdata.top, clear_metrics, NULL);
+    }
+  }
+
+  int rank = hpcrun_get_rank();
+  job->image = image;
+  job->rank = (rank < 0) ? 0 : rank;
+  job->seq = seq;
+  atomic_store(&job->state, JOB_QUEUED);
+
+  // N.B.: both are safe inside signal handlers
+  producer_wfq_enqueue(&writer_queue, (producer_wfq_element_t *) job);
+  sem_post(&writer_wakeup);
+}
+
+
+// The flushed epochs contain the cumulative snapshot of 'cptd': remove
+// it, or have the writer remove the one it is writing.
+void
+hpcrun_snapshot_flushed(core_profile_trace_data_t *cptd)
+{
+  snapshot_job_t *job = cptd->snapshot_job;
+  if (snapshot_delta || job == NULL) {
+    return;
+  }
+  int state = JOB_QUEUED;
+  if (! atomic_compare_exchange_strong(&job->state, &state, JOB_DISCARD)
+      && state == JOB_IDLE) {
+    snapshot_remove(job);
+  }
+}
+
+
+// Request a snapshot of all profiles, and take the calling thread's
+// one right away.  Returns once it is written.
+void
+hpctoolkit_snapshot(void)
+{
+  if (hpcrun_get_disabled() || ! hpcrun_sample_prob_active()) {
+    return;
+  }
+  snapshot_writer_start();
+  snapshot_request();
+
+  core_profile_trace_data_t *cptd = &(TD_GET(core_profile_trace_data));
+  snapshot_wait(cptd);
+  if (hpcrun_safe_enter()) {
+    hpcrun_snapshot_poll(cptd);
+    hpcrun_safe_exit();
+  }
+  snapshot_wait(cptd);
+}
+
+
+// Fortran aliases
+
+void hpctoolkit_snapshot_ (void) __attribute__ ((alias ("hpctoolkit_snapshot")));
+void hpctoolkit_snapshot__(void) __attribute__ ((alias ("hpctoolkit_snapshot")));
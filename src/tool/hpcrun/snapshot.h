@@ -0,0 +1,89 @@
+// -*-Mode: C++;-*- // technically C99
+
+// * BeginRiceCopyright *****************************************************
+//
+// $HeadURL$
+// $Id$
+//
+// --------------------------------------------------------------------------
+// Part of HPCToolkit (hpctoolkit.org)
+//
+// Information about sources of support for research and development of
+// HPCToolkit is at 'hpctoolkit.org' and in 'README.Acknowledgments'.
+// --------------------------------------------------------------------------
+//
+// Copyright ((c)) 2002-2020, Rice University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+//
+// * Neither the name of Rice University (RICE) nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+//
+// This software is provided by RICE and contributors "as is" and any
+// express or implied warranties, including, but not limited to, the
+// implied warranties of merchantability and fitness for a particular
+// purpose are disclaimed. In no event shall RICE or contributors be
+// liable for any direct, indirect, incidental, special, exemplary, or
+// consequential damages (including, but not limited to, procurement of
+// substitute goods or services; loss of use, data, or profits; or
+// business interruption) however caused and on any theory of liability,
+// whether in contract, strict liability, or tort (including negligence
+// or otherwise) arising in any way out of the use of this software, even
+// if advised of the possibility of such damage.
+//
+// ******************************************************* EndRiceCopyright *
+
+//***************************************************************************
+//
+// File:
+//   snapshot.h
+//
+// Purpose:
+//   Snapshots of the profiles of a running process (cf. snapshot.c).
+//
+//***************************************************************************
+
+#ifndef _HPCRUN_SNAPSHOT_H_
+#define _HPCRUN_SNAPSHOT_H_
+
+#include <stdint.h>
+
+#include "core_profile_trace_data.h"
+
+// The outside API
+#include "hpctoolkit.h"
+
+// Internal functions
+
+// read the snapshot options from the environment, and start the
+// snapshot writer thread if they ask for snapshots
+void hpcrun_snapshot_init(void);
+
+// stop the snapshot writer thread once it has written every snapshot
+// queued so far
+void hpcrun_snapshot_fini(void);
+
+// sequence number of the most recent snapshot request
+uint32_t hpcrun_snapshot_seq(void);
+
+// called by a thread in the sample handler: queue an image of the
+// thread's profile for the writer thread if a snapshot was requested
+// since its last one
+void hpcrun_snapshot_poll(core_profile_trace_data_t *cptd);
+
+// called by a thread after it has flushed its epochs to its profile
+// file (cf. hpcrun_flush_epochs)
+void hpcrun_snapshot_flushed(core_profile_trace_data_t *cptd);
+
+#endif // _HPCRUN_SNAPSHOT_H_
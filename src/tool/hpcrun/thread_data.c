@@ -62,6 +62,7 @@
 #include "newmem.h"
 #include "epoch.h"
 #include "handling_sample.h"
+#include "snapshot.h"
 
 #include "thread_data.h"
 #include "trace.h"
@@ -226,11 +227,6 @@ core_profile_trace_data_init(core_profile_trace_data_t * cptd, int id, cct_ctxt_
   cptd->epoch = hpcrun_malloc(sizeof(epoch_t));
   cptd->epoch->csdata_ctxt = copy_thr_ctxt(thr_ctxt);
 
-  // ----------------------------------------
-  // cct2metrics map: associate a metric_set with
-  //                  a cct node
-  hpcrun_cct2metrics_init(&(cptd->cct2metrics_map));
-
   // ----------------------------------------
   // tracing
   // ----------------------------------------
@@ -241,8 +237,16 @@ core_profile_trace_data_init(core_profile_trace_data_t * cptd, int id, cct_ctxt_
   // IO support
   // ----------------------------------------
   cptd->hpcrun_file  = NULL;
+  cptd->profile_buffer = NULL;
   cptd->trace_buffer = NULL;
   cptd->trace_outbuf = NULL;
+  cptd->trace_blk = NULL;
+  cptd->profile_member = NULL;
+  cptd->trace_member = NULL;
+  cptd->profile_rank = 0;
+  cptd->profile_flushed = false;
+  cptd->snapshot_seq = hpcrun_snapshot_seq();
+  cptd->snapshot_job = NULL;
 
   // ----------------------------------------
   // perf event support
@@ -276,16 +280,25 @@ hpcrun_thread_data_init(int id, cct_ctxt_t* thr_ctxt, int is_child, size_t n_sou
   // ----------------------------------------
 
   // Wipe the thread data with a bogus bit pattern, but save the
-  // memstore so we can reuse it in the child after fork.  This must
-  // come first.
+  // memstore (and the stats registry links) so we can reuse it in the
+  // child after fork.  This must come first.
   td->inside_hpcrun = 1;
   memstore = td->memstore;
+  hpcrun_thread_stats_t *stats_next = td->stats.next;
+  hpcrun_thread_stats_t *stats_self = td->stats.self;
   memset(td, 0xfe, sizeof(thread_data_t));
   td->inside_hpcrun = 1;
   td->memstore = memstore;
   hpcrun_make_memstore(&td->memstore, is_child);
   td->mem_low = 0;
 
+  // ----------------------------------------
+  // statistics counters, keep the registry links
+  // ----------------------------------------
+  td->stats.next = stats_next;
+  td->stats.self = stats_self;
+  hpcrun_stats_thread_init(&td->stats);
+
   // ----------------------------------------
   // normalized thread id (monitor-generated)
   // ----------------------------------------
@@ -63,6 +63,7 @@
 #include "epoch.h"
 #include "cct2metrics.h"
 #include "core_profile_trace_data.h"
+#include "hpcrun_stats.h"
 #include "ompt/omp-tools.h"
 
 #include <lush/lush-pthread.i>
@@ -194,7 +195,6 @@ typedef struct thread_data_t {
   // ----------------------------------------
   // core_profile_trace_data contains the following
   // epoch: loadmap + cct + cct_ctxt
-  // cct2metrics map: associate a metric_set with
   // tracing: trace_min_time_us and trace_max_time_us
   // IO support file handle: hpcrun_file;
   // Perf event support
@@ -262,6 +262,11 @@ typedef struct thread_data_t {
   // ----------------------------------------
   lushPthr_t     pthr_metrics;
 
+  // ----------------------------------------
+  // statistics counters (see hpcrun_stats.c)
+  // ----------------------------------------
+  hpcrun_thread_stats_t stats;
+
 
   // ----------------------------------------
   // debug stuff
@@ -289,6 +294,7 @@ typedef struct thread_data_t {
 
 
 static const size_t HPCRUN_TraceBufferSz = HPCIO_RWBufferSz;
+static const size_t HPCRUN_ProfileBufferSz = HPCIO_RWBufferSz;
 
 
 void hpcrun_init_pthread_key(void);
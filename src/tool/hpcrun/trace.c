@@ -49,9 +49,12 @@
 //*********************************************************************
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <sys/time.h>
 #include <assert.h>
 #include <limits.h>
+#include <pthread.h>
+#include <signal.h>
 
 
 //*********************************************************************
@@ -60,6 +63,7 @@
 
 #include <include/hpctoolkit-config.h>
 
+#include "container.h"
 #include "disabled.h"
 #include "env.h"
 #include "files.h"
@@ -71,6 +75,7 @@
 #include "sample_prob.h"
 
 #include <memory/hpcrun-malloc.h>
+#include <memory/mmap.h>
 #include <messages/messages.h>
 
 #include <lib/prof-lean/hpcfmt.h>
@@ -90,6 +95,7 @@
 //*********************************************************************
 
 static void hpcrun_trace_file_validate(int valid, char *op);
+static void hpcrun_trace_writer_start(void);
 static inline void hpcrun_trace_append_with_time_real(core_profile_trace_data_t *cptd, unsigned int call_path_id, uint metric_id, uint32_t dLCA, uint64_t nanotime);
 
 
@@ -98,6 +104,9 @@ static inline void hpcrun_trace_append_with_time_real(core_profile_trace_data_t
 //*********************************************************************
 
 static int tracing = 0;
+static int tracing_compact = 0; // write compact (delta-encoded) records
+static int tracing_async = 0;   // flush trace buffers in trace_writer
+static pthread_t trace_writer;
 
 //*********************************************************************
 // interface operations
@@ -117,6 +126,26 @@ hpcrun_trace_init()
       tracing = 1;
       TMSG(TRACE, "Tracing is ON");
   }
+  if (tracing && getenv(HPCRUN_TRACE_COMPACT)) {
+      tracing_compact = 1;
+      TMSG(TRACE, "Trace records are compact");
+  }
+  if (tracing && getenv(HPCRUN_TRACE_ASYNC_BUFFERS)
+      && ! hpcrun_get_disabled() && hpcrun_sample_prob_active()) {
+      hpcrun_trace_writer_start();
+  }
+}
+
+
+// Stop the background trace writer after all trace files are closed.
+void
+hpcrun_trace_fini()
+{
+  if (tracing_async) {
+    hpcio_outbuf_async_stop();
+    pthread_join(trace_writer, NULL);
+    tracing_async = 0;
+  }
 }
 
 
@@ -139,12 +168,29 @@ hpcrun_trace_open(core_profile_trace_data_t * cptd)
     // I think unlocked is ok here (we don't overlap any system
     // locks).  At any rate, locks only protect against threads, they
     // don't help with signal handlers (that's much harder).
-    fd = hpcrun_open_trace_file(cptd->id);
-    hpcrun_trace_file_validate(fd >= 0, "open");
+    int outbuf_flags = HPCIO_OUTBUF_UNLOCKED;
+    if (tracing_async) {
+      outbuf_flags |= HPCIO_OUTBUF_ASYNC;
+    }
+    if (hpcrun_container_isactive()) {
+      cptd->trace_member =
+        hpcrun_container_member_open(cptd->id, HPCRUN_TraceFnmSfx);
+    }
     cptd->trace_buffer = hpcrun_malloc(HPCRUN_TraceBufferSz);
-    ret = hpcio_outbuf_attach(&cptd->trace_outbuf, fd, cptd->trace_buffer,
-			      HPCRUN_TraceBufferSz, HPCIO_OUTBUF_UNLOCKED,
-                              hpcrun_malloc);
+    if (cptd->trace_member) {
+      ret = hpcio_outbuf_attach_writer(&cptd->trace_outbuf,
+                                       hpcrun_container_member_write,
+                                       cptd->trace_member, cptd->trace_buffer,
+                                       HPCRUN_TraceBufferSz, outbuf_flags,
+                                       hpcrun_malloc);
+    }
+    else {
+      fd = hpcrun_open_trace_file(cptd->id);
+      hpcrun_trace_file_validate(fd >= 0, "open");
+      ret = hpcio_outbuf_attach(&cptd->trace_outbuf, fd, cptd->trace_buffer,
+                                HPCRUN_TraceBufferSz, outbuf_flags,
+                                hpcrun_malloc);
+    }
     hpcrun_trace_file_validate(ret == HPCFMT_OK, "open");
 
     hpctrace_hdr_flags_t flags = hpctrace_hdr_flags_NULL;
@@ -161,7 +207,14 @@ hpcrun_trace_open(core_profile_trace_data_t * cptd)
     HPCTRACE_HDR_FLAGS_SET_BIT(flags, HPCTRACE_HDR_FLAGS_LCA_RECORDED_BIT_POS, false);
 #endif
     
-    ret = hpctrace_fmt_hdr_outbuf(flags, cptd->trace_outbuf);
+    if (tracing_compact) {
+      cptd->trace_blk = hpcrun_malloc(sizeof(hpctrace_fmt_blk_t));
+      hpctrace_fmt_blk_init(cptd->trace_blk);
+      ret = hpctrace_fmt_hdr_compact_outbuf(flags, cptd->trace_outbuf);
+    }
+    else {
+      ret = hpctrace_fmt_hdr_outbuf(flags, cptd->trace_outbuf);
+    }
     hpcrun_trace_file_validate(ret == HPCFMT_OK, "write header to");
   }
   TMSG(TRACE, "Trace open done");
@@ -221,13 +274,24 @@ hpcrun_trace_close(core_profile_trace_data_t * cptd)
   if (tracing && hpcrun_sample_prob_active()) {
 
     TMSG(TRACE, "Trace active close code");
+    if (cptd->trace_blk) {
+      int ret = hpctrace_fmt_blk_outbuf(cptd->trace_blk, cptd->trace_outbuf);
+      if (ret != HPCFMT_OK) {
+        EMSG("unable to write last block of trace file");
+      }
+    }
     int ret = hpcio_outbuf_close(&cptd->trace_outbuf);
     if (ret != HPCFMT_OK) {
       EMSG("unable to flush and close trace file");
     }
 
     int rank = hpcrun_get_rank();
-    if (rank >= 0) {
+    if (cptd->trace_member) {
+      if (hpcrun_container_member_close(cptd->trace_member, rank) != 0) {
+        EMSG("unable to close trace in output container");
+      }
+    }
+    else if (rank >= 0) {
       hpcrun_rename_trace_file(rank, cptd->id);
     }
   }
@@ -276,11 +340,70 @@ static inline void hpcrun_trace_append_with_time_real(core_profile_trace_data_t
     HPCTRACE_HDR_FLAGS_SET_BIT(flags, HPCTRACE_HDR_FLAGS_LCA_RECORDED_BIT_POS, false);
 #endif
     
-    int ret = hpctrace_fmt_datum_outbuf(&trace_datum, flags, cptd->trace_outbuf);
+    int ret;
+    if (cptd->trace_blk) {
+      ret = hpctrace_fmt_datum_blk_outbuf(&trace_datum, flags, cptd->trace_blk,
+                                          cptd->trace_outbuf);
+    }
+    else {
+      ret = hpctrace_fmt_datum_outbuf(&trace_datum, flags, cptd->trace_outbuf);
+    }
     hpcrun_trace_file_validate(ret == HPCFMT_OK, "append");
 }
 
 
+static void *
+hpcrun_trace_writer(void *arg)
+{
+  // the writer must never run a signal handler
+  sigset_t all;
+  sigfillset(&all);
+  monitor_real_pthread_sigmask(SIG_BLOCK, &all, NULL);
+
+  return hpcio_outbuf_async_writer(arg);
+}
+
+
+// Start a thread that writes full trace buffers in the background,
+// with a pool of HPCRUN_TRACE_ASYNC_BUFFERS spare buffers.  On
+// failure, trace buffers are written synchronously, as usual.
+static void
+hpcrun_trace_writer_start(void)
+{
+  // in a forked child, the parent's writer does not exist
+  tracing_async = 0;
+
+  long num_bufs = atol(getenv(HPCRUN_TRACE_ASYNC_BUFFERS));
+  if (num_bufs <= 0) {
+    return;
+  }
+  if (num_bufs > HPCIO_OUTBUF_ASYNC_MAX_BUFS) {
+    num_bufs = HPCIO_OUTBUF_ASYNC_MAX_BUFS;
+  }
+
+  if (hpcio_outbuf_async_init(num_bufs, HPCRUN_TraceBufferSz,
+                              hpcrun_mmap_anon) != HPCFMT_OK) {
+    EMSG("unable to allocate %ld trace buffers, writing traces synchronously",
+         num_bufs);
+    return;
+  }
+
+  // the writer is not an application thread: hide it from libmonitor
+  monitor_disable_new_threads();
+  int ret = pthread_create(&trace_writer, NULL, hpcrun_trace_writer, NULL);
+  monitor_enable_new_threads();
+
+  if (ret != 0) {
+    hpcio_outbuf_async_stop();
+    EMSG("unable to start trace writer thread, writing traces synchronously");
+    return;
+  }
+  tracing_async = 1;
+  TMSG(TRACE, "Trace buffers are written by a background thread (%ld spare)",
+       num_bufs);
+}
+
+
 static void
 hpcrun_trace_file_validate(int valid, char *op)
 {
@@ -54,6 +54,7 @@
 void trace_other_close(void *thread_data);
 
 void hpcrun_trace_init();
+void hpcrun_trace_fini();
 void hpcrun_trace_open(core_profile_trace_data_t * cptd);
 void hpcrun_trace_append(core_profile_trace_data_t *cptd, cct_node_t* node, uint metric_id, uint32_t dLCA);
 void hpcrun_trace_append_with_time(core_profile_trace_data_t *st, unsigned int call_path_id, uint metric_id, uint64_t nanotime);
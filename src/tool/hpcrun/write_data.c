@@ -50,7 +50,10 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
 #include <setjmp.h>
+#include <sys/mman.h>
 
 //*****************************************************************************
 // local includes
@@ -59,6 +62,7 @@
 #include "fname_max.h"
 #include "backtrace.h"
 #include "files.h"
+#include "container.h"
 #include "epoch.h"
 #include "rank.h"
 #include "thread_data.h"
@@ -67,13 +71,17 @@
 #include "write_data.h"
 #include "loadmap.h"
 #include "sample_prob.h"
+#include "snapshot.h"
 #include "cct/cct_bundle.h"
 
+#include <memory/hpcrun-malloc.h>
+#include <memory/mmap.h>
 #include <messages/messages.h>
 
 #include <lush/lush-backtrace.h>
 
 #include <lib/prof-lean/hpcio.h>
+#include <lib/prof-lean/hpcio-buffer.h>
 #include <lib/prof-lean/hpcfmt.h>
 #include <lib/prof-lean/hpcrun-fmt.h>
 
@@ -90,6 +98,31 @@ static epoch_flags_t epoch_flags = {
 
 static const uint64_t default_measurement_granularity = 1;
 
+// A profile image holds the encoded ccts of a thread's epochs in
+// mmap-ed chunks, so that the rest of the profile can be written from
+// another thread while sampling goes on into the epochs.
+typedef struct image_chunk_t {
+  struct image_chunk_t* next;
+  size_t size;   // bytes mapped, including this header
+  size_t used;   // bytes of data[] in use
+  char data[];
+} image_chunk_t;
+
+typedef struct image_epoch_t {
+  epoch_flags_t flags;
+  hpcrun_loadmap_t* loadmap;
+  uint32_t num_lm;       // modules of 'loadmap' when the image was taken
+  image_chunk_t* cct;    // first chunk of the encoded cct
+  image_chunk_t* last;   // chunk being appended to
+} image_epoch_t;
+
+struct hpcrun_profile_image_t {
+  size_t size;   // bytes mapped for this struct
+  metric_aux_info_t* aux_info;
+  uint32_t num_epochs;
+  image_epoch_t epoch[];
+};
+
 
 
 //*****************************************************************************
@@ -130,32 +163,19 @@ static const uint64_t default_measurement_granularity = 1;
 //   2) When sample data memory is low. In this case, the profile data is written
 //      out, but the sample memory is reclaimed so that more profile data may be
 //      collected.
+//   3) A profile snapshot.  In this case, the sample handler encodes the
+//      ccts into a profile image, and the snapshot writer thread writes
+//      the rest (cf. snapshot.c).
 //
 //***************************************************************************
 
-static FILE *
-lazy_open_data_file(core_profile_trace_data_t * cptd)
+// Write the file header of the profile of thread 'tid', or of a
+// snapshot of it if 'snapshotStr' (the snapshot's sequence number) is
+// not NULL.
+static void
+write_file_header(FILE* fs, int tid, int rank, uint64_t trace_min_time_us,
+		  uint64_t trace_max_time_us, const char* snapshotStr)
 {
-  FILE* fs = cptd->hpcrun_file;
-  if (fs) {
-    return fs;
-  }
-
-  int rank = hpcrun_get_rank();
-  if (rank < 0) {
-    rank = 0;
-  }
-  int fd = hpcrun_open_profile_file(rank, cptd->id);
-  fs = fdopen(fd, "w");
-  if (fs == NULL) {
-    EEMSG("HPCToolkit: %s: unable to open profile file", __func__);
-    return NULL;
-  }
-  cptd->hpcrun_file = fs;
-
-  if (! hpcrun_sample_prob_active())
-    return fs;
-
   const uint bufSZ = 32; // sufficient to hold a 64-bit integer in base 10
 
   const char* jobIdStr = OSUtil_jobid();
@@ -168,7 +188,7 @@ lazy_open_data_file(core_profile_trace_data_t * cptd)
   snprintf(mpiRankStr, bufSZ, "%d", rank);
 
   char tidStr[bufSZ];
-  snprintf(tidStr, bufSZ, "%d", cptd->id);
+  snprintf(tidStr, bufSZ, "%d", tid);
 
   char hostidStr[bufSZ];
   snprintf(hostidStr, bufSZ, "%lx", OSUtil_hostid());
@@ -176,11 +196,15 @@ lazy_open_data_file(core_profile_trace_data_t * cptd)
   char pidStr[bufSZ];
   snprintf(pidStr, bufSZ, "%u", OSUtil_pid());
 
+  // N.B.: a snapshot does not refer to the trace file; the trace
+  // belongs to the profile written at exit.
   char traceMinTimeStr[bufSZ];
-  snprintf(traceMinTimeStr, bufSZ, "%"PRIu64, cptd->trace_min_time_us);
-
   char traceMaxTimeStr[bufSZ];
-  snprintf(traceMaxTimeStr, bufSZ, "%"PRIu64, cptd->trace_max_time_us);
+  traceMinTimeStr[0] = traceMaxTimeStr[0] = '\0';
+  if (snapshotStr == NULL) {
+    snprintf(traceMinTimeStr, bufSZ, "%"PRIu64, trace_min_time_us);
+    snprintf(traceMaxTimeStr, bufSZ, "%"PRIu64, trace_max_time_us);
+  }
 
   //
   // ==== file hdr =====
@@ -198,13 +222,187 @@ lazy_open_data_file(core_profile_trace_data_t * cptd)
                         HPCRUN_FMT_NV_pid, pidStr,
 			HPCRUN_FMT_NV_traceMinTime, traceMinTimeStr,
 			HPCRUN_FMT_NV_traceMaxTime, traceMaxTimeStr,
+			// last: a NULL name ends the list for a profile
+			(snapshotStr ? HPCRUN_FMT_NV_snapshot : NULL), snapshotStr,
                         NULL);
+}
+
+
+static void
+flushed_suffix(char* suffix, size_t len)
+{
+  snprintf(suffix, len, "%s.%s", HPCRUN_FlushedFnmInfix, HPCRUN_ProfileFnmSfx);
+}
+
+
+// Open the profile file of 'cptd', unless it is open.  A plain profile
+// file opened to 'flush' epochs before the thread ends is named
+// <profile>.flushed.hpcrun until the thread writes the rest of its
+// profile, so that hpcprof can tell it from a complete one.  (A
+// container member becomes visible only once the container is closed.)
+static FILE *
+lazy_open_data_file(core_profile_trace_data_t * cptd, bool flush)
+{
+  FILE* fs = cptd->hpcrun_file;
+  if (fs) {
+    return fs;
+  }
+
+  int rank = hpcrun_get_rank();
+  if (rank < 0) {
+    rank = 0;
+  }
+  if (hpcrun_container_isactive()) {
+    cptd->profile_member =
+      hpcrun_container_member_open(cptd->id, HPCRUN_ProfileFnmSfx);
+  }
+  if (cptd->profile_member) {
+    fs = hpcrun_container_member_fopen(cptd->profile_member, rank);
+  }
+  else if (flush) {
+    char suffix[64];
+    flushed_suffix(suffix, sizeof(suffix));
+    int fd = hpcrun_open_profile_snapshot_file(rank, cptd->id, suffix);
+    fs = fdopen(fd, "w");
+    cptd->profile_rank = rank;
+    cptd->profile_flushed = true;
+  }
+  else {
+    int fd = hpcrun_open_profile_file(rank, cptd->id);
+    fs = fdopen(fd, "w");
+  }
+  if (fs == NULL) {
+    EEMSG("HPCToolkit: %s: unable to open profile file", __func__);
+    return NULL;
+  }
+  cptd->hpcrun_file = fs;
+
+  if (! hpcrun_sample_prob_active())
+    return fs;
+
+  write_file_header(fs, cptd->id, rank, cptd->trace_min_time_us,
+		    cptd->trace_max_time_us, NULL);
   return fs;
 }
 
 
+// Attach an outbuf to the profile file (or container 'member') so the
+// cct, by far the largest part of an epoch, is encoded into one large
+// per-thread buffer and written with write() instead of a stdio call
+// per field.  The buffer is allocated on first use and reused for
+// later epochs, flushes and snapshots.
+//
+// Returns: the outbuf, or NULL if the caller should fall back to 'fs'.
+static hpcio_outbuf_t*
+profile_outbuf_attach(FILE* fs, core_profile_trace_data_t * cptd,
+		      hpcrun_container_member_t* member)
+{
+  if (cptd->profile_buffer == NULL) {
+    cptd->profile_buffer = hpcrun_malloc(HPCRUN_ProfileBufferSz);
+    if (cptd->profile_buffer == NULL) {
+      return NULL;
+    }
+  }
+
+  // N.B.: everything written through 'fs' so far must reach the file
+  // (or container member) before the outbuf writes to it.
+  if (fflush(fs) != 0) {
+    return NULL;
+  }
+
+  hpcio_outbuf_t* outbuf = NULL;
+  int ret;
+  if (member) {
+    ret = hpcio_outbuf_attach_writer(&outbuf, hpcrun_container_member_write,
+				     member, cptd->profile_buffer,
+				     HPCRUN_ProfileBufferSz,
+				     HPCIO_OUTBUF_UNLOCKED, hpcrun_malloc);
+  }
+  else {
+    ret = hpcio_outbuf_attach(&outbuf, fileno(fs), cptd->profile_buffer,
+			      HPCRUN_ProfileBufferSz, HPCIO_OUTBUF_UNLOCKED,
+			      hpcrun_malloc);
+  }
+  return (ret == HPCFMT_OK) ? outbuf : NULL;
+}
+
+
+static epoch_flags_t
+profile_epoch_flags(void)
+{
+  epoch_flags.fields.isLogicalUnwind = hpcrun_isLogicalUnwind();
+  TMSG(LUSH,"epoch lush flag set to %s", epoch_flags.fields.isLogicalUnwind ? "true" : "false");
+
+  // most cct nodes have only a few nonzero metrics; write just those
+  epoch_flags.fields.isSparseMetrics =
+    (hpcrun_get_num_kind_metrics() <= UINT16_MAX);
+
+  TMSG(DATA_WRITE,"epoch flags = %"PRIx64"", epoch_flags.bits);
+  return epoch_flags;
+}
+
+
+// Write everything of an epoch that precedes its cct: the epoch
+// header, the metric tables and the first 'num_lm' modules of
+// 'loadmap'.
+static void
+write_epoch_prefix(FILE* fs, epoch_flags_t flags, metric_aux_info_t* aux_info,
+		   hpcrun_loadmap_t* loadmap, uint32_t num_lm)
+{
+  //
+  //  == epoch header ==
+  //
+
+  TMSG(DATA_WRITE," epoch header");
+  hpcrun_fmt_epochHdr_fwrite(fs, flags,
+			     default_measurement_granularity,
+			     "TODO:epoch-name","TODO:epoch-value",
+			     NULL);
+
+  //
+  // == metrics ==
+  //
+
+  kind_info_t *curr = NULL;
+  metric_desc_p_tbl_t *metric_tbl = hpcrun_get_metric_tbl(&curr);
+
+  hpcfmt_int4_fwrite(hpcrun_get_num_kind_metrics(), fs);
+  while (curr != NULL) {
+    TMSG(DATA_WRITE, "metric tbl len = %d", metric_tbl->len);
+    hpcrun_fmt_metricTbl_fwrite(metric_tbl, aux_info, fs);
+    metric_tbl = hpcrun_get_metric_tbl(&curr);
+  }
+
+  TMSG(DATA_WRITE, "Done writing metric data");
+
+  //
+  // == load map ==
+  //
+
+  TMSG(DATA_WRITE, "Preparing to write loadmap");
+
+  hpcfmt_int4_fwrite(num_lm, fs);
+
+  // N.B.: Write in reverse order to obtain nicely ascending LM ids.
+  // Modules are added at the front, so the oldest 'num_lm' of them
+  // stay put while others are added.
+  load_module_t* lm_src = loadmap->lm_end;
+  for (uint32_t i = 0; i < num_lm && lm_src; i++, lm_src = lm_src->prev) {
+    loadmap_entry_t lm_entry;
+    lm_entry.id = lm_src->id;
+    lm_entry.name = lm_src->name;
+    lm_entry.flags = 0;
+
+    hpcrun_fmt_loadmapEntry_fwrite(&lm_entry, fs);
+  }
+
+  TMSG(DATA_WRITE, "Done writing loadmap");
+}
+
+
 static int
-write_epochs(FILE* fs, core_profile_trace_data_t * cptd, epoch_t* epoch)
+write_epochs(FILE* fs, core_profile_trace_data_t * cptd, epoch_t* epoch,
+	     hpcrun_container_member_t* member)
 {
   uint32_t num_epochs = 0;
 
@@ -238,69 +436,20 @@ write_epochs(FILE* fs, core_profile_trace_data_t * cptd, epoch_t* epoch)
       }
     }
 #endif
-    //
-    //  == epoch header ==
-    //
-
-    TMSG(DATA_WRITE," epoch header");
-    //
-    // set epoch flags before writing
-    //
-
-    epoch_flags.fields.isLogicalUnwind = hpcrun_isLogicalUnwind();
-    TMSG(LUSH,"epoch lush flag set to %s", epoch_flags.fields.isLogicalUnwind ? "true" : "false");
-    
-    TMSG(DATA_WRITE,"epoch flags = %"PRIx64"", epoch_flags.bits);
-    hpcrun_fmt_epochHdr_fwrite(fs, epoch_flags,
-			       default_measurement_granularity,
-			       "TODO:epoch-name","TODO:epoch-value",
-			       NULL);
-
-    //
-    // == metrics ==
-    //
-
-    kind_info_t *curr = NULL;
-    metric_desc_p_tbl_t *metric_tbl = hpcrun_get_metric_tbl(&curr);
-
-    hpcfmt_int4_fwrite(hpcrun_get_num_kind_metrics(), fs);
-    while (curr != NULL) {
-      TMSG(DATA_WRITE, "metric tbl len = %d", metric_tbl->len);
-      hpcrun_fmt_metricTbl_fwrite(metric_tbl, cptd->perf_event_info, fs);
-      metric_tbl = hpcrun_get_metric_tbl(&curr);
-    }
-
-    TMSG(DATA_WRITE, "Done writing metric data");
-
-    //
-    // == load map ==
-    //
-
-    TMSG(DATA_WRITE, "Preparing to write loadmap");
-
-    hpcrun_loadmap_t* current_loadmap = s->loadmap;
-    
-    hpcfmt_int4_fwrite(current_loadmap->size, fs);
-
-    // N.B.: Write in reverse order to obtain nicely ascending LM ids.
-    for (load_module_t* lm_src = current_loadmap->lm_end;
-	 (lm_src); lm_src = lm_src->prev) {
-      loadmap_entry_t lm_entry;
-      lm_entry.id = lm_src->id;
-      lm_entry.name = lm_src->name;
-      lm_entry.flags = 0;
-      
-      hpcrun_fmt_loadmapEntry_fwrite(&lm_entry, fs);
-    }
-
-    TMSG(DATA_WRITE, "Done writing loadmap");
+    epoch_flags_t flags = profile_epoch_flags();
+    write_epoch_prefix(fs, flags, cptd->perf_event_info, s->loadmap,
+		       s->loadmap->size);
 
     //
     // == cct ==
     //
 
     cct_bundle_t* cct      = &(s->csdata);
-    int ret = hpcrun_cct_bundle_fwrite(fs, epoch_flags, cct, cptd->cct2metrics_map);
+    hpcio_outbuf_t* outbuf = profile_outbuf_attach(fs, cptd, member);
+    int ret = hpcrun_cct_bundle_fwrite(fs, outbuf, flags, cct);
+    if (outbuf && hpcio_outbuf_detach(&outbuf) != HPCFMT_OK) {
+      ret = HPCRUN_ERR;
+    }
     if(ret != HPCRUN_OK) {
       TMSG(DATA_WRITE, "Error writing tree %#lx", cct);
       TMSG(DATA_WRITE, "Number of tree nodes lost: %ld", cct->num_nodes);
@@ -311,7 +460,6 @@ write_epochs(FILE* fs, core_profile_trace_data_t * cptd, epoch_t* epoch)
     else {
       TMSG(DATA_WRITE, "saved profile data to hpcrun file ");
     }
-    current_loadmap++;
 
   } // epoch loop
 
@@ -322,12 +470,16 @@ write_epochs(FILE* fs, core_profile_trace_data_t * cptd, epoch_t* epoch)
 void
 hpcrun_flush_epochs(core_profile_trace_data_t * cptd)
 {
-  FILE *fs = lazy_open_data_file(cptd);
+  FILE *fs = lazy_open_data_file(cptd, true);
   if (fs == NULL)
     return;
 
-  write_epochs(fs, cptd, cptd->epoch);
+  write_epochs(fs, cptd, cptd->epoch, cptd->profile_member);
+  fflush(fs);
   hpcrun_epoch_reset();
+
+  // a snapshot taken before now overlaps what was just written
+  hpcrun_snapshot_flushed(cptd);
 }
 
 int
@@ -336,19 +488,218 @@ hpcrun_write_profile_data(core_profile_trace_data_t * cptd)
   if(cptd->scale_fn) cptd->scale_fn((void*)cptd);
 
   TMSG(DATA_WRITE,"Writing hpcrun profile data");
-  FILE* fs = lazy_open_data_file(cptd);
+  FILE* fs = lazy_open_data_file(cptd, false);
   if (fs == NULL)
     return HPCRUN_ERR;
 
-  write_epochs(fs, cptd, cptd->epoch);
+  write_epochs(fs, cptd, cptd->epoch, cptd->profile_member);
 
   TMSG(DATA_WRITE,"closing file");
   hpcio_fclose(fs);
+
+  // the profile is complete now
+  if (cptd->profile_flushed) {
+    char suffix[64];
+    flushed_suffix(suffix, sizeof(suffix));
+    hpcrun_rename_profile_snapshot_file(cptd->profile_rank, cptd->id, suffix);
+    cptd->profile_flushed = false;
+  }
   TMSG(DATA_WRITE,"Done!");
 
   return HPCRUN_OK;
 }
 
+//***************************************************************************
+// profile images, for snapshots
+//***************************************************************************
+
+static image_chunk_t*
+image_chunk_new(size_t min_data)
+{
+  size_t size = sizeof(image_chunk_t) + min_data;
+  if (size < HPCRUN_ProfileBufferSz) {
+    size = HPCRUN_ProfileBufferSz;
+  }
+  image_chunk_t* chunk = hpcrun_mmap_anon(size);
+  if (chunk == NULL) {
+    return NULL;
+  }
+  chunk->next = NULL;
+  chunk->size = size;
+  chunk->used = 0;
+  return chunk;
+}
+
+
+// The writer of the outbuf that encodes an epoch's cct into its image:
+// append 'data' to the chunks of the epoch 'arg'.
+static ssize_t
+image_append(void* arg, const void* data, size_t size)
+{
+  image_epoch_t* e = (image_epoch_t*) arg;
+  const char* src = (const char*) data;
+  size_t left = size;
+
+  while (left > 0) {
+    image_chunk_t* chunk = e->last;
+    size_t room = chunk ? chunk->size - sizeof(image_chunk_t) - chunk->used : 0;
+    if (room == 0) {
+      image_chunk_t* next = image_chunk_new(left);
+      if (next == NULL) {
+	return -1;
+      }
+      if (chunk) {
+	chunk->next = next;
+      }
+      else {
+	e->cct = next;
+      }
+      e->last = chunk = next;
+      room = chunk->size - sizeof(image_chunk_t);
+    }
+    size_t n = (left < room) ? left : room;
+    memcpy(chunk->data + chunk->used, src, n);
+    chunk->used += n;
+    src += n;
+    left -= n;
+  }
+  return size;
+}
+
+
+// Take an image of the profile of 'cptd': encode the cct of each epoch
+// into memory of the image's own and note what else the epoch needs.
+// Sampling may go on into the epochs while the image is written.
+//
+// N.B.: safe inside the sample handler: neither this nor the cct
+// encoding uses malloc or stdio.
+//
+// Returns: the image, or NULL if there is nothing to write or memory
+// ran out.
+hpcrun_profile_image_t*
+hpcrun_profile_image_new(core_profile_trace_data_t * cptd)
+{
+  if (! hpcrun_sample_prob_active())
+    return NULL;
+
+  if (cptd->profile_buffer == NULL) {
+    cptd->profile_buffer = hpcrun_malloc(HPCRUN_ProfileBufferSz);
+    if (cptd->profile_buffer == NULL) {
+      return NULL;
+    }
+  }
+
+  uint32_t num_epochs = 0;
+  for (epoch_t* s = cptd->epoch; s; s = s->next) {
+    num_epochs++;
+  }
+
+  size_t size = sizeof(hpcrun_profile_image_t)
+    + num_epochs * sizeof(image_epoch_t);
+  hpcrun_profile_image_t* image = hpcrun_mmap_anon(size);
+  if (image == NULL) {
+    return NULL;
+  }
+  image->size = size;
+  image->aux_info = cptd->perf_event_info;
+  image->num_epochs = 0;
+
+  for (epoch_t* s = cptd->epoch; s; s = s->next) {
+    image_epoch_t* e = &image->epoch[image->num_epochs++];
+    e->flags = profile_epoch_flags();
+    e->loadmap = s->loadmap;
+    e->cct = e->last = NULL;
+
+    // modules the loadmap held at this point (see write_epoch_prefix)
+    e->num_lm = 0;
+    for (load_module_t* lm = s->loadmap->lm_end;
+	 lm && e->num_lm < s->loadmap->size; lm = lm->prev) {
+      e->num_lm++;
+    }
+
+    hpcio_outbuf_t* outbuf = NULL;
+    int ret = HPCRUN_ERR;
+    if (hpcio_outbuf_attach_writer(&outbuf, image_append, e,
+				   cptd->profile_buffer, HPCRUN_ProfileBufferSz,
+				   HPCIO_OUTBUF_UNLOCKED, hpcrun_malloc)
+	== HPCFMT_OK) {
+      ret = hpcrun_cct_bundle_fwrite(NULL, outbuf, e->flags, &(s->csdata));
+      if (hpcio_outbuf_detach(&outbuf) != HPCFMT_OK) {
+	ret = HPCRUN_ERR;
+      }
+    }
+    if (ret != HPCRUN_OK) {
+      EMSG("unable to take an image of the profile for a snapshot");
+      hpcrun_profile_image_free(image);
+      return NULL;
+    }
+  }
+
+  return image;
+}
+
+
+void
+hpcrun_profile_image_free(hpcrun_profile_image_t* image)
+{
+  if (image == NULL) {
+    return;
+  }
+  for (uint32_t i = 0; i < image->num_epochs; i++) {
+    image_chunk_t* chunk = image->epoch[i].cct;
+    while (chunk) {
+      image_chunk_t* next = chunk->next;
+      munmap(chunk, chunk->size);
+      chunk = next;
+    }
+  }
+  munmap(image, image->size);
+}
+
+
+// Write 'image', a snapshot of the profile of thread 'tid', to a file
+// of its own, named for 'rank' and with 'suffix' instead of "hpcrun".
+// Unlike hpcrun_flush_epochs(), the epochs stay in place and sampling
+// goes on into them.
+//
+// N.B.: not safe inside signal handlers: it is for the snapshot writer
+// thread.  Snapshots never go into the output container: a
+// long-running process may never get to write the container's index.
+int
+hpcrun_profile_image_write(hpcrun_profile_image_t* image, int tid, int rank,
+			   const char* suffix, const char* snapshotStr)
+{
+  TMSG(DATA_WRITE,"Writing hpcrun profile snapshot %s", snapshotStr);
+  int fd = hpcrun_open_profile_snapshot_file(rank, tid, suffix);
+  FILE* fs = (fd >= 0) ? fdopen(fd, "w") : NULL;
+  if (fs == NULL) {
+    EMSG("unable to open profile snapshot file");
+    return HPCRUN_ERR;
+  }
+
+  write_file_header(fs, tid, rank, 0, 0, snapshotStr);
+  for (uint32_t i = 0; i < image->num_epochs; i++) {
+    image_epoch_t* e = &image->epoch[i];
+    write_epoch_prefix(fs, e->flags, image->aux_info, e->loadmap, e->num_lm);
+    for (image_chunk_t* chunk = e->cct; chunk; chunk = chunk->next) {
+      fwrite(chunk->data, 1, chunk->used, fs);
+    }
+  }
+
+  int ret = HPCRUN_OK;
+  if (ferror(fs)) {
+    ret = HPCRUN_ERR;
+  }
+  if (hpcio_fclose(fs) != 0) {
+    ret = HPCRUN_ERR;
+  }
+  if (ret != HPCRUN_OK) {
+    EMSG("could not write profile snapshot %s", snapshotStr);
+    hpcrun_unlink_profile_snapshot_file(rank, tid, suffix);
+  }
+  return ret;
+}
+
 //
 // DEBUG: fetch and print current loadmap
 //
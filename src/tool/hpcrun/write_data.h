@@ -53,4 +53,14 @@
 extern int hpcrun_write_profile_data(core_profile_trace_data_t * cptd);
 extern void hpcrun_flush_epochs(core_profile_trace_data_t * cptd);
 
+// a copy of a profile taken for a snapshot; see write_data.c
+typedef struct hpcrun_profile_image_t hpcrun_profile_image_t;
+
+extern hpcrun_profile_image_t*
+hpcrun_profile_image_new(core_profile_trace_data_t * cptd);
+extern int hpcrun_profile_image_write(hpcrun_profile_image_t* image,
+				      int tid, int rank, const char* suffix,
+				      const char* snapshotStr);
+extern void hpcrun_profile_image_free(hpcrun_profile_image_t* image);
+
 #endif // WRITE_DATA_H
@@ -58,8 +58,15 @@
 //***************************************************************************
 
 #include <stdint.h>                     // for uint64_t
+#include <algorithm>                    // for min, max
+#include <atomic>                       // for atomic
+#include <condition_variable>           // for condition_variable
+#include <deque>                        // for deque
+#include <exception>                    // for exception_ptr
 #include <iostream>                     // for operator<<, basic_ostream, etc
+#include <mutex>                        // for mutex, lock_guard
 #include <string>                       // for string
+#include <thread>                       // for thread
 #include <vector>                       // for vector, vector<>::iterator
 
 #include "Communication.hpp"            // for Communication
@@ -101,46 +108,168 @@ void Communication::sendStartGetData(SpaceTimeDataController* contr, int process
 
 
 }
-void Communication::sendEndGetData(DataSocketStream* stream, ProgressBar* prog, SpaceTimeDataController* controller)
+//A trace line that has been read in and compressed, waiting to be sent
+struct CompressedLine
+{
+	int line;
+	int numEntries;
+	Time begTime;
+	Time endTime;
+	DataCompressionLayer* comprStr;
+};
+
+//Lines finished by the workers, in the order they finished
+class CompressedLineQueue
 {
-	// TODO: Make this so that the Lines get sent as soon as they are
-	// filled.
+public:
+	CompressedLineQueue(int _numWorkers) : numWorkersRunning(_numWorkers) {}
 
-	controller->fillTraces();
-	for (int i = 0; i < controller->tracesLength; i++)
+	void push(const CompressedLine& line)
 	{
+		lock_guard<mutex> guard(lock);
+		lines.push_back(line);
+		ready.notify_one();
+	}
 
-		ProcessTimeline* timeline = controller->traces[i];
-		stream->writeInt( timeline->line());
-		vector<TimeCPID> data = *timeline->data->listCPID;
-		stream->writeInt( data.size());
-		// Begin time
-		stream->writeLong( data[0].timestamp);
-		//End time
-		stream->writeLong( data[data.size() - 1].timestamp);
+	void workerDone(exception_ptr err)
+	{
+		lock_guard<mutex> guard(lock);
+		if (err && !error)
+			error = err;
+		numWorkersRunning--;
+		ready.notify_one();
+	}
 
-		DataCompressionLayer comprStr;
+	//Blocks until a line is available. Returns false once every worker has
+	//finished and all lines have been taken.
+	bool pop(CompressedLine& line)
+	{
+		unique_lock<mutex> guard(lock);
+		ready.wait(guard, [this] { return !lines.empty() || numWorkersRunning == 0; });
+		if (lines.empty())
+			return false;
+		line = lines.front();
+		lines.pop_front();
+		return true;
+	}
 
-		vector<TimeCPID>::iterator it;
-		DEBUGCOUT(2) << "Sending process timeline with " << data.size() << " entries" << endl;
+	exception_ptr getError()
+	{
+		lock_guard<mutex> guard(lock);
+		return error;
+	}
 
+private:
+	mutex lock;
+	condition_variable ready;
+	deque<CompressedLine> lines;
+	int numWorkersRunning;
+	exception_ptr error;
+};
 
-		Time currentTime = data[0].timestamp;
-		for (it = data.begin(); it != data.end(); ++it)
+//Reads in and compresses lines until there are none left to claim
+static void computeLines(SpaceTimeDataController* controller, atomic<int>* nextLine,
+		CompressedLineQueue* queue)
+{
+	exception_ptr err;
+	try
+	{
+		for (int i = (*nextLine)++; i < controller->tracesLength; i = (*nextLine)++)
 		{
-			comprStr.writeInt( (int)(it->timestamp - currentTime));
-			comprStr.writeInt( it->cpid);
-			currentTime = it->timestamp;
+			ProcessTimeline* timeline = controller->getTrace(i);
+			timeline->readInData();
+			controller->addNextTrace(timeline);
+
+			const vector<TimeCPID>& data = *timeline->data->listCPID;
+			DEBUGCOUT(2) << "Sending process timeline with " << data.size() << " entries" << endl;
+
+			CompressedLine line;
+			line.line = timeline->line();
+			line.numEntries = data.size();
+			line.begTime = data[0].timestamp;
+			line.endTime = data[data.size() - 1].timestamp;
+			line.comprStr = new DataCompressionLayer();
+
+			Time currentTime = data[0].timestamp;
+			for (vector<TimeCPID>::const_iterator it = data.begin(); it != data.end(); ++it)
+			{
+				line.comprStr->writeInt( (int)(it->timestamp - currentTime));
+				line.comprStr->writeInt( it->cpid);
+				currentTime = it->timestamp;
+			}
+			line.comprStr->flush();
+
+			queue->push(line);
 		}
-		comprStr.flush();
-		int outputBufferLen = comprStr.getOutputLength();
-		char* outputBuffer = (char*)comprStr.getOutputBuffer();
+	}
+	catch (...)
+	{
+		//Stop handing out lines so the other workers finish quickly
+		*nextLine = controller->tracesLength;
+		err = current_exception();
+	}
+	queue->workerDone(err);
+}
+
+void Communication::sendEndGetData(DataSocketStream* stream, ProgressBar* prog, SpaceTimeDataController* controller)
+{
+	//Lines are read in and compressed by a pool of worker threads and sent
+	//as soon as they are finished. Each line carries its line number, so
+	//the order in which they are sent does not matter (this is what the MPI
+	//version does as well).
+	controller->resetTraces();
 
-		stream->writeInt(outputBufferLen);
+	int numThreads = numWorkerThreads;
+	if (numThreads <= 0)
+		numThreads = max(1u, thread::hardware_concurrency());
+	numThreads = max(1, min(numThreads, controller->tracesLength));
+
+	atomic<int> nextLine(0);
+	CompressedLineQueue queue(numThreads);
+	vector<thread> workers;
+	for (int i = 0; i < numThreads; i++)
+		workers.push_back(thread(computeLines, controller, &nextLine, &queue));
+
+	CompressedLine line;
+	try
+	{
+		while (queue.pop(line))
+		{
+			stream->writeInt( line.line);
+			stream->writeInt( line.numEntries);
+			// Begin time
+			stream->writeLong( line.begTime);
+			//End time
+			stream->writeLong( line.endTime);
 
-		stream->writeRawData(outputBuffer, outputBufferLen);
-		prog->incrementProgress();
+			int outputBufferLen = line.comprStr->getOutputLength();
+			char* outputBuffer = (char*)line.comprStr->getOutputBuffer();
+
+			stream->writeInt(outputBufferLen);
+
+			stream->writeRawData(outputBuffer, outputBufferLen);
+			delete line.comprStr;
+			prog->incrementProgress();
+		}
+	}
+	catch (...)
+	{
+		//The socket failed: let the workers run out of lines, then clean up
+		nextLine = controller->tracesLength;
+		while (queue.pop(line))
+			delete line.comprStr;
+		for (size_t i = 0; i < workers.size(); i++)
+			workers[i].join();
+		throw;
 	}
+
+	for (size_t i = 0; i < workers.size(); i++)
+		workers[i].join();
+
+	exception_ptr err = queue.getError();
+	if (err)
+		rethrow_exception(err);
+
 	stream->flush();
 }
 
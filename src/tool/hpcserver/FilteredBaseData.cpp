@@ -120,7 +120,10 @@ int FilteredBaseData::getInt(FileOffset position)
 {
 	return baseDataFile->getMasterBuffer()->getInt(position);
 }
-
+void FilteredBaseData::getBytes(FileOffset position, char* dst, size_t len)
+{
+	baseDataFile->getMasterBuffer()->getBytes(position, dst, len);
+}
 int FilteredBaseData::getNumberOfRanks()
 {
 	return rankMapping.size();
@@ -82,6 +82,7 @@ namespace TraceviewerServer
 		FileOffset getMaxLoc(int pseudoRank);
 		int64_t getLong(FileOffset position);
 		int getInt(FileOffset position);
+		void getBytes(FileOffset position, char* dst, size_t len);
 		int getNumberOfRanks();
 		int* getProcessIDs();
 		short* getThreadIDs();
@@ -131,6 +131,7 @@ namespace TraceviewerServer
 
 	int LargeByteBuffer::getInt(FileOffset pos)
 	{
+		lock_guard<mutex> guard(pageLock);
 		int Page = pos / mmPageSize;
 		int loc = pos % mmPageSize;
 		char* p2D = masterBuffer[Page].get() + loc;
@@ -139,6 +140,7 @@ namespace TraceviewerServer
 	}
 	Long LargeByteBuffer::getLong(FileOffset pos)
 	{
+		lock_guard<mutex> guard(pageLock);
 		int Page = pos / mmPageSize;
 		int loc = pos % mmPageSize;
 		char* p2D = masterBuffer[Page].get() + loc;
@@ -146,6 +148,23 @@ namespace TraceviewerServer
 		return val;
 
 	}
+	//Copies len bytes starting at pos into dst with a single acquisition of
+	//the lock, which is much cheaper than one getLong/getInt per field when
+	//reading a run of records.
+	void LargeByteBuffer::getBytes(FileOffset pos, char* dst, size_t len)
+	{
+		lock_guard<mutex> guard(pageLock);
+		while (len > 0)
+		{
+			int Page = pos / mmPageSize;
+			FileOffset loc = pos % mmPageSize;
+			size_t amt = min((FileOffset) len, mmPageSize - loc);
+			copy(masterBuffer[Page].get() + loc, masterBuffer[Page].get() + loc + amt, dst);
+			pos += amt;
+			dst += amt;
+			len -= amt;
+		}
+	}
 	//Could very well be a template, but we only use it for uint64_t
 	uint64_t LargeByteBuffer::lcm(uint64_t _a, uint64_t _b)
 	{
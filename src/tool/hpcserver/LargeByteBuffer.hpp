@@ -65,6 +65,7 @@
 #include "FileUtils.hpp" //For FileOffset
 #include "LRUList.hpp"
 
+#include <mutex>
 #include <string>
 #include <vector>
 #include <stdint.h>
@@ -80,12 +81,16 @@ namespace TraceviewerServer
 		FileOffset size();
 		Long getLong(FileOffset);
 		int getInt(FileOffset);
+		void getBytes(FileOffset, char*, size_t);
 	private:
 		static uint64_t lcm(uint64_t, uint64_t);
 		static uint64_t getRamSize();
 		vector<VersatileMemoryPage> masterBuffer;
 		int numPages;
 		LRUList<VersatileMemoryPage>* pageManagementList;
+		//Guards the page list and the mappings. It is held until a value has
+		//been read so another thread cannot unmap the page underneath us.
+		std::mutex pageLock;
 
 	};
 
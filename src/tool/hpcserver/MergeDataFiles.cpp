@@ -65,6 +65,10 @@
 #include "DebugUtils.hpp"
 #include "ProgressBar.hpp"
 
+#include <lib/prof-lean/hpcfmt.h>
+#include <lib/prof-lean/hpcio-container.h>
+#include <lib/prof-lean/hpcrun-fmt.h>
+
 #include <string>
 #include <algorithm>
 #include <cstdlib>
@@ -118,12 +122,26 @@ namespace TraceviewerServer
 
 		vector<string> allPaths = FileUtils::getAllFilesInDir(directory);
 		vector<string> filteredFileNames;
+		vector<string> traceFileNames; //the files among filteredFileNames
 		vector<string>::iterator it;
 		for (it = allPaths.begin(); it != allPaths.end(); it++)
 		{
 			string val = *it;
-			if (val.find(".hpctrace") < string::npos)//This is hardcoded, which isn't great but will have to do because GlobInputFile is regex-style ("*.hpctrace")
+			if (isContainer(val))
+			{
+				//The traces in an output container merge like trace files
+				uint32_t numPaths = 0;
+				char** paths = hpcio_container_member_paths(val.c_str(), HPCRUN_TraceFnmSfx, &numPaths);
+				for (uint32_t i = 0; i < numPaths; i++)
+					filteredFileNames.push_back(paths[i]);
+				if (paths != NULL)
+					hpcio_container_member_paths_free(paths, numPaths);
+			}
+			else if (val.find(".hpctrace") < string::npos)//This is hardcoded, which isn't great but will have to do because GlobInputFile is regex-style ("*.hpctrace")
+			{
 				filteredFileNames.push_back(val);
+				traceFileNames.push_back(val);
+			}
 		}
 		// on linux, we have to sort the files
 		//To sort them, we need a random access iterator, which means we need to load all of them into a vector
@@ -149,7 +167,9 @@ namespace TraceviewerServer
 
 			 string Filename = *it2;
 			 int last_pos_basic_name = Filename.length() - suffix.length();
-			 string Basic_name = Filename.substr(FileUtils::combinePaths(directory, "").length(),//This ensures we count the "/" at the end of the path
+			 const char* member_name = hpcio_container_member_name(Filename.c_str());
+			 string Basic_name = (member_name != NULL) ? string(member_name)
+					: Filename.substr(FileUtils::combinePaths(directory, "").length(),//This ensures we count the "/" at the end of the path
 					last_pos_basic_name);
 
 			vector<string> tokens = splitString(Basic_name, '-');
@@ -177,7 +197,7 @@ namespace TraceviewerServer
 			if (Thread != 0)
 				type |= MULTI_THREADING;
 			dos.writeLong(currentOffset);
-			currentOffset += FileUtils::getFileSize(Filename);
+			currentOffset += getTraceSize(Filename);
 		}
 		//-----------------------------------------------------
 		// 3. Copy all data from the multiple files into one file
@@ -187,17 +207,7 @@ namespace TraceviewerServer
 		{
 			string i = *it2;
 
-			ifstream dis(i.c_str(), ios_base::binary | ios_base::in);
-			char data[PAGE_SIZE_GUESS];
-			dis.read(data, PAGE_SIZE_GUESS);
-			int bytesRead = dis.gcount();
-			while (bytesRead > 0)
-			{
-				dos.write(data, bytesRead);
-				dis.read(data, PAGE_SIZE_GUESS);
-				bytesRead = dis.gcount();
-			}
-			dis.close();
+			copyTrace(&dos, i);
 			prog.incrementProgress();
 		}
 		insertMarker(&dos);
@@ -214,8 +224,9 @@ namespace TraceviewerServer
 
 		//-----------------------------------------------------
 		// 5. remove old files
+		//  (output containers are kept)
 		//-----------------------------------------------------
-		removeFiles(filteredFileNames);
+		removeFiles(traceFileNames);
 		return SUCCESS_MERGED;
 	}
 
@@ -269,13 +280,132 @@ namespace TraceviewerServer
 				continue;
 			string supposedext = filename.substr(l - ending.length());
 
-			if (ending == supposedext)
+			if (ending == supposedext || isContainer(filename))
 			{
 				return true;
 			}
 		}
 		return false;
 	}
+	//Returns the size of the trace file with its records in the fixed-size form
+	//(the file size, unless it is compact). Only reads the block headers.
+	Long MergeDataFiles::getTraceSize(string filename)
+	{
+		FILE* fs = openTrace(filename);
+		if (fs == NULL)
+			return FileUtils::getFileSize(filename);
+
+		//The stored size, which for a container member is not a file size
+		fseeko(fs, 0, SEEK_END);
+		Long fileSize = ftello(fs);
+		rewind(fs);
+
+		hpctrace_fmt_hdr_t hdr;
+		if (hpctrace_fmt_hdr_fread(&hdr, fs) != HPCFMT_OK || !HPCTRACE_FMT_IsCompact(&hdr))
+		{
+			fclose(fs);
+			return fileSize;
+		}
+
+		Long recordSize = SIZEOF_LONG + SIZEOF_INT;
+		if (HPCTRACE_HDR_FLAGS_GET_BIT(hdr.flags, HPCTRACE_HDR_FLAGS_DATA_CENTRIC_BIT_POS))
+			recordSize += SIZEOF_INT;
+
+		//Stop where hpctrace_fmt_blk_fread() would: at an invalid or truncated block
+		Long numRecords = 0;
+		unsigned char buffer[HPCTRACE_FMT_BlkHdrLen];
+		hpctrace_fmt_blk_hdr_t blkHdr;
+		while (fread(buffer, 1, HPCTRACE_FMT_BlkHdrLen, fs) == HPCTRACE_FMT_BlkHdrLen
+				&& hpctrace_fmt_blk_hdr_decode(&blkHdr, buffer, HPCTRACE_FMT_BlkHdrLen) == HPCFMT_OK
+				&& ftell(fs) + (Long) blkHdr.numBytes <= fileSize)
+		{
+			numRecords += blkHdr.numDatum;
+			if (fseek(fs, blkHdr.numBytes, SEEK_CUR) != 0)
+				break;
+		}
+		fclose(fs);
+		return HPCTRACE_FMT_HeaderLen + numRecords * recordSize;
+	}
+
+	//Appends the trace file to the merged file, expanding compact records to
+	//the fixed-size records (and the version 1.01 header) the reader expects
+	void MergeDataFiles::copyTrace(DataOutputFileStream* dos, string filename)
+	{
+		FILE* fs = openTrace(filename);
+		if (fs == NULL)
+			return;
+
+		hpctrace_fmt_hdr_t hdr;
+		bool isCompact = (hpctrace_fmt_hdr_fread(&hdr, fs) == HPCFMT_OK
+				&& HPCTRACE_FMT_IsCompact(&hdr));
+
+		if (!isCompact)
+		{
+			rewind(fs);
+			char data[PAGE_SIZE_GUESS];
+			size_t bytesRead = fread(data, 1, PAGE_SIZE_GUESS, fs);
+			while (bytesRead > 0)
+			{
+				dos->write(data, bytesRead);
+				bytesRead = fread(data, 1, PAGE_SIZE_GUESS, fs);
+			}
+			fclose(fs);
+			return;
+		}
+
+		dos->write(HPCTRACE_FMT_Magic, HPCTRACE_FMT_MagicLen);
+		dos->write(HPCTRACE_FMT_Version, HPCTRACE_FMT_VersionLen);
+		dos->write(HPCTRACE_FMT_Endian, HPCTRACE_FMT_EndianLen);
+		dos->writeLong(hdr.flags);
+
+		bool isDataCentric = HPCTRACE_HDR_FLAGS_GET_BIT(hdr.flags,
+				HPCTRACE_HDR_FLAGS_DATA_CENTRIC_BIT_POS);
+
+		//The records must match the count getTraceSize() found, so a corrupt
+		//block ends the file at a block boundary
+		hpctrace_fmt_blk_t* blk = new hpctrace_fmt_blk_t;
+		hpctrace_fmt_blk_init(blk);
+		while (hpctrace_fmt_blk_fread(blk, fs) == HPCFMT_OK)
+		{
+			hpctrace_fmt_datum_t datum;
+			const unsigned char* p = blk->buf;
+			const unsigned char* end = blk->buf + blk->hdr.numBytes;
+			for (uint32_t i = 0; i < blk->hdr.numDatum; i++)
+			{
+				if (p != NULL)
+				{
+					p = hpctrace_fmt_datum_decode(&datum, &blk->prev, hdr.flags, p, end);
+					if (p == NULL)
+						cerr << "Warning! Trace file " << filename << " has a corrupt block" << endl;
+				}
+				if (p == NULL)
+					datum = blk->prev; //keep the record count
+				blk->prev = datum;
+
+				dos->writeLong(datum.comp);
+				dos->writeInt(datum.cpId);
+				if (isDataCentric)
+					dos->writeInt(datum.metricId);
+			}
+		}
+		delete blk;
+		fclose(fs);
+	}
+
+	FILE* MergeDataFiles::openTrace(string filename)
+	{
+		if (hpcio_container_member_name(filename.c_str()) != NULL)
+			return hpcio_container_member_fopen_r(filename.c_str());
+		return fopen(filename.c_str(), "r");
+	}
+
+	bool MergeDataFiles::isContainer(string filename)
+	{
+		string ending = string(".") + HPCRUN_ContainerFnmSfx;
+		return (filename.length() > ending.length()
+				&& filename.compare(filename.length() - ending.length(), ending.length(), ending) == 0);
+	}
+
 	//From http://stackoverflow.com/questions/236129/splitting-a-string-in-c
 	vector<string> MergeDataFiles::splitString(string toSplit, char delimiter)
 	{
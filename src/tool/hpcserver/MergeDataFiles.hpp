@@ -63,6 +63,7 @@
 #include <vector>
 #include <string>
 #include <stdint.h>
+#include <cstdio>
 
 using namespace std;
 namespace TraceviewerServer
@@ -89,6 +90,14 @@ namespace TraceviewerServer
 		static bool removeFiles(vector<string>);
 		//This was in Util.java in a modified form but is more useful here
 		static bool atLeastOneValidFile(string);
+		//Compact (delta-encoded) trace files are expanded to fixed-size
+		//records while merging; these return the expanded size and copy it
+		static Long getTraceSize(string);
+		static void copyTrace(DataOutputFileStream*, string);
+		//Opens a trace file or a trace in an hpcrun output container
+		//("<container>#<member>")
+		static FILE* openTrace(string);
+		static bool isContainer(string);
 
 
 
@@ -109,14 +109,21 @@ namespace TraceviewerServer
 		if (attributes->lineNum
 				< min(attributes->numPixelsV, attributes->endProcess - attributes->begProcess))
 		{
-			ProcessTimeline* toReturn  = new ProcessTimeline(*attributes, attributes->lineNum, dataTrace,
-					minBegTime + attributes->begTime, headerSize);
+			ProcessTimeline* toReturn  = getTrace(attributes->lineNum);
 			attributes->lineNum++;
 			return toReturn;
 		}
 		return NULL;
 	}
 
+	//Unlike getNextTrace, this does not touch attributes->lineNum, so several
+	//threads may create (and read in) different lines at the same time.
+	ProcessTimeline* SpaceTimeDataController::getTrace(int line)
+	{
+		return new ProcessTimeline(*attributes, line, dataTrace,
+				minBegTime + attributes->begTime, headerSize);
+	}
+
 	void SpaceTimeDataController::addNextTrace(ProcessTimeline* NextPtl)
 	{
 		if (NextPtl == NULL)
@@ -159,7 +166,9 @@ namespace TraceviewerServer
 
 		deleteTraces();
 
-		traces = new ProcessTimeline*[numTraces];
+		//Value-initialized: a worker that fails leaves the rest of its lines
+		//unassigned, and deleteTraces() must be able to delete them all
+		traces = new ProcessTimeline*[numTraces]();
 		tracesLength = numTraces;
 		tracesInitialized = true;
 
@@ -78,8 +78,10 @@ namespace TraceviewerServer
 		virtual ~SpaceTimeDataController();
 		void setInfo(Time, Time, int);
 		ProcessTimeline* getNextTrace();
+		ProcessTimeline* getTrace(int);
 		void addNextTrace(ProcessTimeline*);
 		void fillTraces();
+		void resetTraces();
 		ProcessTimeline* fillTrace(bool);
 		void applyFilters(FilterSet filters);
 		//The number of processes in the database, independent of the current display size
@@ -93,7 +95,6 @@ namespace TraceviewerServer
 		ProcessTimeline** traces;
 		int tracesLength;
 	private:
-		void resetTraces();
 		void deleteTraces();
 
 		FilteredBaseData* dataTrace;
@@ -61,6 +61,7 @@
 #include <algorithm>
 #include <cstdlib> // previously: cmath but it causes ambuguity in abs function for gcc 4.4.6
 #include "Constants.hpp"
+#include "ByteUtilities.hpp"
 #include <iostream>
 
 namespace TraceviewerServer
@@ -94,6 +95,19 @@ namespace TraceviewerServer
 		// get the number of records data to display
 		 Long numRec = 1 + getNumberOfRecords(startLoc, endLoc);
 
+		// Samples are appended in time order: the record before the interval (if
+		// any), the records or samples inside it, and the record after it (if any).
+		listCPID->reserve(min(numRec, (Long) numPixelsH) + 2);
+
+		// --------------------------------------------------------------------------------------------------
+		// get the first data if necessary: the leftmost time is still bigger than the lower limit
+		//	similarly, we add to the list
+		// --------------------------------------------------------------------------------------------------
+		if (startLoc > minloc)
+		{
+			listCPID->push_back(getData(startLoc - SIZE_OF_TRACE_RECORD));
+		}
+
 		// --------------------------------------------------------------------------------------------------
 		// if the data-to-display is fit in the display zone, we don't need to use recursive binary search
 		//	we just simply display everything from the file
@@ -101,19 +115,14 @@ namespace TraceviewerServer
 		if (numRec <= numPixelsH)
 		{
 			// display all the records
-			for (FileOffset i = startLoc; i <= endLoc;)
-			{
-				listCPID->push_back(getData(i));
-				// one record of data contains of an integer (cpid) and a long (time)
-				i = i + SIZE_OF_TRACE_RECORD;
-			}
+			getDataRange(startLoc, endLoc);
 		}
 		else
 		{
 			// the data is too big: try to fit the "big" data into the display
 
 			//fills in the rest of the data for this process timeline
-			sampleTimeLine(startLoc, endLoc, 0, numPixelsH, 0, pixelLength, timeStart);
+			sampleTimeLine(startLoc, endLoc, 0, numPixelsH, pixelLength, timeStart);
 		}
 		// --------------------------------------------------------------------------------------------------
 		// get the last data if necessary: the rightmost time is still less then the upper limit
@@ -121,18 +130,7 @@ namespace TraceviewerServer
 		// --------------------------------------------------------------------------------------------------
 		if (endLoc < maxloc)
 		{
-			 TimeCPID dataLast = getData(endLoc);
-			addSample(listCPID->size(), dataLast);
-		}
-
-		// --------------------------------------------------------------------------------------------------
-		// get the first data if necessary: the leftmost time is still bigger than the lower limit
-		//	similarly, we add to the list
-		// --------------------------------------------------------------------------------------------------
-		if (startLoc > minloc)
-		{
-			 TimeCPID dataFirst = getData(startLoc - SIZE_OF_TRACE_RECORD);
-			addSample(0, dataFirst);
+			listCPID->push_back(getData(endLoc));
 		}
 		postProcess();
 	}
@@ -141,19 +139,17 @@ namespace TraceviewerServer
 	 * Takes in two pixel locations as endpoints and finds the timestamp that owns the pixel
 	 * in between these two. It then recursively calls itself twice - once with the beginning
 	 * location and the newfound location as endpoints and once with the newfound location
-	 * and the end location as endpoints. Effectively updates times and timeLine by calculating
-	 * the index in which to insert the next data. This way, it keeps times and timeLine sorted.
+	 * and the end location as endpoints. The sample for the middle pixel is appended between
+	 * the two calls, so the samples come out in time order and each one is a push_back.
 	 * @author Reed Landrum and Michael Franco
 	 * @param minLoc The beginning location in the file to bound the search.
 	 * @param maxLoc The end location in the file to bound the search.
 	 * @param startPixel The beginning pixel in the image that corresponds to minLoc.
 	 * @param endPixel The end pixel in the image that corresponds to maxLoc.
-	 * @param minIndex An index used for calculating the index in which the data is to be inserted.
-	 * @return Returns the index that shows the size of the recursive subtree that has been read.
-	 * Used for calculating the index in which the data is to be inserted.
+	 * @return Returns the number of samples appended.
 	 ******************************************************************************************/
 	int TraceDataByRank::sampleTimeLine(FileOffset minLoc, FileOffset maxLoc, int startPixel,
-			int endPixel, int minIndex, double pixelLength, Time startingTime)
+			int endPixel, double pixelLength, Time startingTime)
 	{
 		int midPixel = (startPixel + endPixel) / 2;
 		if (midPixel == startPixel)
@@ -162,15 +158,42 @@ namespace TraceviewerServer
 		Long loc = findTimeInInterval((long)(midPixel * pixelLength + startingTime), minLoc,
 				maxLoc);
 		 TimeCPID nextData = getData(loc);
-		addSample(minIndex, nextData);
-		int addedLeft = sampleTimeLine(minLoc, loc, startPixel, midPixel, minIndex,
+		int addedLeft = sampleTimeLine(minLoc, loc, startPixel, midPixel,
 				pixelLength, startingTime);
+		listCPID->push_back(nextData);
 		int addedRight = sampleTimeLine(loc, maxLoc, midPixel, endPixel,
-				minIndex + addedLeft + 1, pixelLength, startingTime);
+				pixelLength, startingTime);
 
 		return (addedLeft + addedRight + 1);
 	}
 
+	/*******************************************************************************************
+	 * Appends every record from startLoc to endLoc (inclusive). The records are copied
+	 * out of the file in batches rather than with two reads per record.
+	 ******************************************************************************************/
+	void TraceDataByRank::getDataRange(FileOffset startLoc, FileOffset endLoc)
+	{
+		const Long RECORDS_PER_BATCH = 1024;
+		char buffer[RECORDS_PER_BATCH * SIZE_OF_TRACE_RECORD];
+
+		Long numRec = 1 + getNumberOfRecords(startLoc, endLoc);
+		FileOffset loc = startLoc;
+		while (numRec > 0)
+		{
+			Long batch = min(numRec, RECORDS_PER_BATCH);
+			data->getBytes(loc, buffer, batch * SIZE_OF_TRACE_RECORD);
+			for (Long i = 0; i < batch; i++)
+			{
+				// one record of data contains of a long (time) and an integer (cpid)
+				char* record = buffer + i * SIZE_OF_TRACE_RECORD;
+				listCPID->push_back(TimeCPID(ByteUtilities::readLong(record),
+						ByteUtilities::readInt(record + SIZEOF_LONG)));
+			}
+			loc += batch * SIZE_OF_TRACE_RECORD;
+			numRec -= batch;
+		}
+	}
+
 
 	/*********************************************************************************
 	 *	Returns the location in the traceFile of the trace data (time stamp and cpid)
@@ -190,27 +213,55 @@ namespace TraceviewerServer
 		FileOffset l_index = getRelativeLocation(l_boundOffset);
 		FileOffset r_index = getRelativeLocation(r_boundOffset);
 
-		Time l_time = data->getLong(l_boundOffset);
-		Time r_time = data->getLong(r_boundOffset);
+		// Every read from the file takes the lock of its page cache, which the
+		// workers of Communication::computeLines share. Once the interval is
+		// down to SEARCH_WINDOW records, copy them all with one read and
+		// finish the search in the copy.
+		char window[SEARCH_WINDOW * SIZE_OF_TRACE_RECORD];
+		bool inWindow = false;
+		FileOffset windowBeg = 0;
+
+		Time l_time, r_time;
+		if (r_index - l_index < SEARCH_WINDOW)
+		{
+			windowBeg = loadWindow(window, l_index, r_index);
+			inWindow = true;
+			l_time = windowTime(window, windowBeg, l_index);
+			r_time = windowTime(window, windowBeg, r_index);
+		}
+		else
+		{
+			l_time = data->getLong(l_boundOffset);
+			r_time = data->getLong(r_boundOffset);
+		}
 	
 		// apply "Newton's method" to find target time
 		while (r_index - l_index > 1)
 		{
+			if (!inWindow && r_index - l_index < SEARCH_WINDOW)
+			{
+				windowBeg = loadWindow(window, l_index, r_index);
+				inWindow = true;
+			}
+
 			FileOffset predicted_index;
 			//pat2 7/1/13: We only ever divide by rate, and double multiplication
 			//is faster than division (confirmed with a benchmark) so compute inverse
 			//rate instead. This line of code and the one in the else block account for
 			//about 40% of the computation once the data is in memory
 			//double rate = (r_time - l_time) / (r_index - l_index);
-			double invrate = (r_index - l_index) / (r_time - l_time);
-			Time mtime = (r_time - l_time) / 2;
+			//The rate is computed in floating point: Time is unsigned, so the
+			//integer quotient was 0 whenever records are more than one time unit
+			//apart on average, and the search degenerated into a linear scan.
+			double invrate = (double) (r_index - l_index) / (r_time - l_time);
+			Time mtime = l_time + (r_time - l_time) / 2;
 			if (time <= mtime)
 			{
-				predicted_index = max((Long) ((time - l_time) * invrate) + l_index, l_index);
+				predicted_index = l_index + (Long) max(0.0, ((double) time - l_time) * invrate);
 			}
 			else
 			{
-				predicted_index = min((r_index - (long) ((r_time - time) * invrate)), r_index);
+				predicted_index = r_index - (Long) max(0.0, ((double) r_time - time) * invrate);
 			}
 			// adjust so that the predicted index differs from both ends
 			// except in the case where the interval is of length only 1
@@ -220,7 +271,8 @@ namespace TraceviewerServer
 			if (predicted_index >= r_index)
 				predicted_index = r_index - 1;
 
-			Time temp = data->getLong(getAbsoluteLocation(predicted_index));
+			Time temp = inWindow ? windowTime(window, windowBeg, predicted_index)
+					: data->getLong(getAbsoluteLocation(predicted_index));
 			if (time >= temp)
 			{
 				l_index = predicted_index;
@@ -235,9 +287,7 @@ namespace TraceviewerServer
 		FileOffset l_offset = getAbsoluteLocation(l_index);
 		FileOffset r_offset = getAbsoluteLocation(r_index);
 
-		l_time = data->getLong(l_offset);
-		r_time = data->getLong(r_offset);
-
+		// l_time and r_time are the times at l_index and r_index
 		int leftDiff = time - l_time;
 		int rightDiff = r_time - time;
 		 bool is_left_closer = abs(leftDiff) < abs(rightDiff);
@@ -248,6 +298,22 @@ namespace TraceviewerServer
 		else
 			return maxloc;
 	}
+	/*********************************************************************************
+	 *	Copies the records from l_index to r_index (inclusive) into window and
+	 *	returns the index of the first one
+	 ********************************************************************************/
+	FileOffset TraceDataByRank::loadWindow(char* window, FileOffset l_index, FileOffset r_index)
+	{
+		data->getBytes(getAbsoluteLocation(l_index), window,
+				(r_index - l_index + 1) * SIZE_OF_TRACE_RECORD);
+		return l_index;
+	}
+
+	Time TraceDataByRank::windowTime(char* window, FileOffset windowBeg, FileOffset index)
+	{
+		return ByteUtilities::readLong(window + (index - windowBeg) * SIZE_OF_TRACE_RECORD);
+	}
+
 	FileOffset TraceDataByRank::getAbsoluteLocation(FileOffset relativePosition)
 	{
 		return minloc + (relativePosition * SIZE_OF_TRACE_RECORD);
@@ -257,26 +323,14 @@ namespace TraceviewerServer
 	{
 		return (absolutePosition - minloc) / SIZE_OF_TRACE_RECORD;
 	}
-	void TraceDataByRank::addSample(unsigned int index, TimeCPID dataCpid)
-	{
-		if (index == listCPID->size())
-		{
-			listCPID->push_back(dataCpid);
-		}
-		else
-		{
-			vector<TimeCPID>::iterator it = listCPID->begin();
-			it += index;
-			listCPID->insert(it, dataCpid);
-		}
-	}
 
 	TimeCPID TraceDataByRank::getData(FileOffset location)
 	{
-
-		 Time time = data->getLong(location);
-		 int CPID = data->getInt(location + SIZEOF_LONG);
-		TimeCPID ToReturn(time, CPID);
+		// one read of the whole record rather than one per field
+		char record[SIZE_OF_TRACE_RECORD];
+		data->getBytes(location, record, SIZE_OF_TRACE_RECORD);
+		TimeCPID ToReturn(ByteUtilities::readLong(record),
+				ByteUtilities::readInt(record + SIZEOF_LONG));
 		return ToReturn;
 	}
 
@@ -291,19 +345,11 @@ namespace TraceviewerServer
 
 	void TraceDataByRank::postProcess()
 	{
-		int len = listCPID->size();
-		for (int i = 0; i < len - 2; i++)
-		{
-
-			while (i < len - 1 && (*listCPID)[i].timestamp == (*listCPID)[i + 1].timestamp)
-			{
-				vector<TimeCPID>::iterator it = listCPID->begin();
-				it += (i + 1);
-				listCPID->erase(it);
-				len--;
-			}
-
-		}
+		// samples are in time order, so duplicates are adjacent: keep the first
+		// sample of each run of equal timestamps
+		vector<TimeCPID>::iterator last = unique(listCPID->begin(), listCPID->end(),
+				[](const TimeCPID& a, const TimeCPID& b) { return a.timestamp == b.timestamp; });
+		listCPID->erase(last, listCPID->end());
 	}
 
 	TraceDataByRank::~TraceDataByRank()
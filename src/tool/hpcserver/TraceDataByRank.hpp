@@ -77,7 +77,7 @@ namespace TraceviewerServer
 		virtual ~TraceDataByRank();
 
 		void getData(Time timeStart, Time timeRange, double pixelLength);
-		int sampleTimeLine(FileOffset minLoc, FileOffset maxLoc, int startPixel, int endPixel, int minIndex, double pixelLength, Time startingTime);
+		int sampleTimeLine(FileOffset minLoc, FileOffset maxLoc, int startPixel, int endPixel, double pixelLength, Time startingTime);
 		FileOffset findTimeInInterval(Time time, FileOffset l_boundOffset, FileOffset r_boundOffset);
 
 
@@ -91,11 +91,16 @@ namespace TraceviewerServer
 		FileOffset maxloc;
 		int numPixelsH;
 
+		//Number of records below which findTimeInInterval searches a local copy
+		static const int SEARCH_WINDOW = 256;
+
+		FileOffset loadWindow(char*, FileOffset, FileOffset);
+		static Time windowTime(char*, FileOffset, FileOffset);
 		FileOffset getAbsoluteLocation(FileOffset);
 
 		FileOffset getRelativeLocation(FileOffset);
-		void addSample(unsigned int, TimeCPID);
 		TimeCPID getData(FileOffset);
+		void getDataRange(FileOffset, FileOffset);
 		Long getNumberOfRecords(FileOffset, FileOffset);
 		void postProcess();
 	};
@@ -0,0 +1,156 @@
+// -*-Mode: C++;-*-
+
+// * BeginRiceCopyright *****************************************************
+//
+// $HeadURL$
+// $Id$
+//
+// --------------------------------------------------------------------------
+// Part of HPCToolkit (hpctoolkit.org)
+//
+// Information about sources of support for research and development of
+// HPCToolkit is at 'hpctoolkit.org' and in 'README.Acknowledgments'.
+// --------------------------------------------------------------------------
+//
+// Copyright ((c)) 2002-2020, Rice University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+//
+// * Neither the name of Rice University (RICE) nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+//
+// This software is provided by RICE and contributors "as is" and any
+// express or implied warranties, including, but not limited to, the
+// implied warranties of merchantability and fitness for a particular
+// purpose are disclaimed. In no event shall RICE or contributors be
+// liable for any direct, indirect, incidental, special, exemplary, or
+// consequential damages (including, but not limited to, procurement of
+// substitute goods or services; loss of use, data, or profits; or
+// business interruption) however caused and on any theory of liability,
+// whether in contract, strict liability, or tort (including negligence
+// or otherwise) arising in any way out of the use of this software, even
+// if advised of the possibility of such damage.
+//
+// ******************************************************* EndRiceCopyright *
+
+//***************************************************************************
+//
+// File:
+//   TraceDataByRank_test.cpp
+//
+// Purpose:
+//   Checks timeline sampling on a synthetic single-rank trace database
+//   and times it at wide-monitor pixel widths.
+//
+//***************************************************************************
+
+
+#undef NDEBUG
+
+#include "../TraceDataByRank.hpp"
+#include "../FilteredBaseData.hpp"
+#include "../ByteUtilities.hpp"
+#include "../Constants.hpp"
+
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <iostream>
+#include <vector>
+#include <unistd.h>
+using namespace std;
+
+using namespace TraceviewerServer;
+
+static const int TEST_HEADER_SIZE = 24;
+static const Long TEST_NUM_RECORDS = 2000000;
+
+//Writes a trace database with one rank and returns the time of its last record
+static Time writeTestTrace(const char* path)
+{
+	vector<char> buf(TEST_HEADER_SIZE + TEST_HEADER_SIZE
+			+ TEST_NUM_RECORDS * SIZE_OF_TRACE_RECORD + SIZEOF_END_OF_FILE_MARKER);
+	char* p = &buf[0];
+
+	ByteUtilities::writeInt(p, MULTI_PROCESSES); p += SIZEOF_INT;
+	ByteUtilities::writeInt(p, 1); p += SIZEOF_INT; //number of ranks
+	ByteUtilities::writeInt(p, 0); p += SIZEOF_INT; //process id
+	ByteUtilities::writeInt(p, 0); p += SIZEOF_INT; //thread id
+	ByteUtilities::writeLong(p, TEST_HEADER_SIZE); p += SIZEOF_LONG; //start of rank 0
+	p += TEST_HEADER_SIZE; //header of rank 0
+
+	srand(8192);
+	Time t = 1000;
+	for (Long i = 0; i < TEST_NUM_RECORDS; i++)
+	{
+		t += 1 + rand() % 100;
+		ByteUtilities::writeLong(p, t); p += SIZEOF_LONG;
+		ByteUtilities::writeInt(p, rand() % 5000); p += SIZEOF_INT;
+	}
+
+	FILE* f = fopen(path, "wb");
+	assert(f != NULL);
+	assert(fwrite(&buf[0], 1, buf.size(), f) == buf.size());
+	fclose(f);
+	return t;
+}
+
+static void checkTimeline(TraceDataByRank& line)
+{
+	vector<TimeCPID>& samples = *line.listCPID;
+	assert(!samples.empty());
+	for (size_t i = 1; i < samples.size(); i++)
+		assert(samples[i - 1].timestamp < samples[i].timestamp);
+}
+
+void traceDataByRankTest()
+{
+	char path[64];
+	snprintf(path, sizeof(path), "/tmp/hpcserver-tracedata-%d", (int) getpid());
+	Time lastTime = writeTestTrace(path);
+
+	FilteredBaseData data(path, TEST_HEADER_SIZE);
+	Time begTime = 1000;
+	Time range = lastTime - begTime;
+
+	//Sampled: many more records than pixels
+	int widths[] = { 4096, 6144, 8192 };
+	for (int w = 0; w < 3; w++)
+	{
+		TraceDataByRank line(&data, 0, widths[w], TEST_HEADER_SIZE);
+		clock_t start = clock();
+		line.getData(begTime, range, range / (double) widths[w]);
+		double ms = 1000.0 * (clock() - start) / CLOCKS_PER_SEC;
+
+		checkTimeline(line);
+		assert(line.listCPID->size() <= (size_t) widths[w] + 2);
+		cout << "Sampled " << widths[w] << " pixels into " << line.listCPID->size()
+				<< " samples in " << ms << " ms" << endl;
+	}
+
+	//Zoomed in: every record in the window is returned
+	{
+		int width = 8192;
+		Time zoomRange = 5000 * 50; //about 5000 records
+		TraceDataByRank line(&data, 0, width, TEST_HEADER_SIZE);
+		line.getData(begTime + range / 2, zoomRange, zoomRange / (double) width);
+
+		checkTimeline(line);
+		assert(line.listCPID->size() > 1000 && line.listCPID->size() <= (size_t) width + 2);
+		cout << "Zoomed window returned " << line.listCPID->size() << " records" << endl;
+	}
+
+	unlink(path);
+}
@@ -103,11 +103,20 @@ main(int argc, char **argv)
     exit(-1);
   }
 
+  bool isCompact = HPCTRACE_FMT_IsCompact(&hdr);
+  hpctrace_fmt_blk_t blk;
+  hpctrace_fmt_blk_init(&blk);
+
   // read and dump trace records until EOF 
   while ( !feof(infs) ) {
     hpctrace_fmt_datum_t datum;
 
-    ret = hpctrace_fmt_datum_fread(&datum, hdr.flags, infs);
+    if (isCompact) {
+      ret = hpctrace_fmt_datum_blk_fread(&datum, hdr.flags, &blk, infs);
+    }
+    else {
+      ret = hpctrace_fmt_datum_fread(&datum, hdr.flags, infs);
+    }
 
     if (ret == HPCFMT_EOF) {
       break;